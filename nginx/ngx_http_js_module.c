@@ -12,15 +12,28 @@
 #include <njs.h>
 
 
+/* The number of the per-worker finished clones kept for reuse. */
+#define NGX_HTTP_JS_FREE_VMS  16
+
+
 typedef struct {
     njs_vm_t            *vm;
+    ngx_str_t            include;
     ngx_array_t         *paths;
     const njs_extern_t  *req_proto;
+    ngx_int_t            max_steps;
+    ngx_msec_t           max_time;
+    ngx_flag_t           preempt;
+    ngx_flag_t           presize;
+    ngx_flag_t           request_pool;
+    ngx_uint_t           nfree_vms;
+    njs_vm_t            *free_vms[NGX_HTTP_JS_FREE_VMS];
 } ngx_http_js_main_conf_t;
 
 
 typedef struct {
     ngx_str_t            content;
+    size_t               max_memory;
 } ngx_http_js_loc_conf_t;
 
 
@@ -32,6 +45,7 @@ typedef struct {
     njs_opaque_value_t   request;
     njs_opaque_value_t   request_body;
     ngx_str_t            redirect_uri;
+    ngx_event_t          resume;
 } ngx_http_js_ctx_t;
 
 
@@ -59,6 +73,10 @@ static ngx_int_t ngx_http_js_variable(ngx_http_request_t *r,
 static ngx_int_t ngx_http_js_init_vm(ngx_http_request_t *r);
 static void ngx_http_js_cleanup_ctx(void *data);
 static void ngx_http_js_cleanup_vm(void *data);
+static void *ngx_http_js_alloc(void *mem, size_t size);
+static void *ngx_http_js_zalloc(void *mem, size_t size);
+static void *ngx_http_js_align(void *mem, size_t alignment, size_t size);
+static void ngx_http_js_free(void *mem, void *p);
 
 static njs_ret_t ngx_http_js_ext_get_string(njs_vm_t *vm, njs_value_t *value,
     void *obj, uintptr_t data);
@@ -139,11 +157,18 @@ static void ngx_http_js_clear_timer(njs_external_ptr_t external,
 static void ngx_http_js_timer_handler(ngx_event_t *ev);
 static void ngx_http_js_handle_event(ngx_http_request_t *r,
     njs_vm_event_t vm_event, njs_value_t *args, nxt_uint_t nargs);
+static void ngx_http_js_run(ngx_http_request_t *r, ngx_http_js_ctx_t *ctx);
+static void ngx_http_js_post_resume(ngx_http_request_t *r,
+    ngx_http_js_ctx_t *ctx);
+static void ngx_http_js_resume_handler(ngx_event_t *ev);
 static njs_ret_t ngx_http_js_string(njs_vm_t *vm, const njs_value_t *value,
     nxt_str_t *str);
 
 static char *ngx_http_js_include(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_http_js_init_main_conf(ngx_conf_t *cf, void *conf);
+static char *ngx_http_js_pool_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 static char *ngx_http_js_set(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 static char *ngx_http_js_content(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
@@ -169,6 +194,41 @@ static ngx_command_t  ngx_http_js_commands[] = {
       offsetof(ngx_http_js_main_conf_t, paths),
       NULL },
 
+    { ngx_string("js_max_steps"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      offsetof(ngx_http_js_main_conf_t, max_steps),
+      NULL },
+
+    { ngx_string("js_max_time"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_msec_slot,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      offsetof(ngx_http_js_main_conf_t, max_time),
+      NULL },
+
+    { ngx_string("js_preempt"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      offsetof(ngx_http_js_main_conf_t, preempt),
+      NULL },
+
+    { ngx_string("js_presize"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      offsetof(ngx_http_js_main_conf_t, presize),
+      NULL },
+
+    { ngx_string("js_request_pool"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      offsetof(ngx_http_js_main_conf_t, request_pool),
+      NULL },
+
     { ngx_string("js_set"),
       NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE2,
       ngx_http_js_set,
@@ -183,6 +243,20 @@ static ngx_command_t  ngx_http_js_commands[] = {
       0,
       NULL },
 
+    { ngx_string("js_pool_cache"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE2,
+      ngx_http_js_pool_cache,
+      0,
+      0,
+      NULL },
+
+    { ngx_string("js_max_memory"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_js_loc_conf_t, max_memory),
+      NULL },
+
       ngx_null_command
 };
 
@@ -192,7 +266,7 @@ static ngx_http_module_t  ngx_http_js_module_ctx = {
     NULL,                          /* postconfiguration */
 
     ngx_http_js_create_main_conf,  /* create main configuration */
-    NULL,                          /* init main configuration */
+    ngx_http_js_init_main_conf,    /* init main configuration */
 
     NULL,                          /* create server configuration */
     NULL,                          /* merge server configuration */
@@ -496,6 +570,19 @@ static njs_vm_ops_t ngx_http_js_ops = {
 };
 
 
+/* The VM memory allocated from the nginx pools. */
+
+static const nxt_mem_proto_t  ngx_http_js_mem_proto = {
+    ngx_http_js_alloc,
+    ngx_http_js_zalloc,
+    ngx_http_js_align,
+    NULL,
+    ngx_http_js_free,
+    NULL,
+    NULL,
+};
+
+
 static ngx_int_t
 ngx_http_js_content_handler(ngx_http_request_t *r)
 {
@@ -560,7 +647,9 @@ ngx_http_js_content_event_handler(ngx_http_request_t *r)
 
     ctx->status = NGX_HTTP_INTERNAL_SERVER_ERROR;
 
-    if (njs_vm_call(ctx->vm, func, njs_value_arg(&ctx->request), 1) != NJS_OK) {
+    rc = njs_vm_call(ctx->vm, func, njs_value_arg(&ctx->request), 1);
+
+    if (rc == NJS_ERROR) {
         njs_vm_retval_to_ext_string(ctx->vm, &exception);
 
         ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
@@ -570,6 +659,10 @@ ngx_http_js_content_event_handler(ngx_http_request_t *r)
         return;
     }
 
+    if (rc == NJS_AGAIN) {
+        ngx_http_js_post_resume(r, ctx);
+    }
+
     if (njs_vm_pending(ctx->vm)) {
         r->write_event_handler = ngx_http_js_content_write_event_handler;
         return;
@@ -692,7 +785,15 @@ ngx_http_js_variable(ngx_http_request_t *r, ngx_http_variable_value_t *v,
 
     pending = njs_vm_pending(ctx->vm);
 
-    if (njs_vm_call(ctx->vm, func, njs_value_arg(&ctx->request), 1) != NJS_OK) {
+    /*
+     * Variable handlers cannot be resumed, so the exhausted budget
+     * throws InternalError instead of preempting the execution.
+     */
+
+    rc = njs_vm_call_nonpreemptive(ctx->vm, func,
+                                   njs_value_arg(&ctx->request), 1);
+
+    if (rc != NJS_OK) {
         njs_vm_retval_to_ext_string(ctx->vm, &exception);
 
         ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
@@ -729,6 +830,7 @@ ngx_http_js_init_vm(ngx_http_request_t *r)
     nxt_str_t                 exception;
     ngx_http_js_ctx_t        *ctx;
     ngx_pool_cleanup_t       *cln;
+    ngx_http_js_loc_conf_t   *jlcf;
     ngx_http_js_main_conf_t  *jmcf;
 
     jmcf = ngx_http_get_module_main_conf(r, ngx_http_js_module);
@@ -751,11 +853,34 @@ ngx_http_js_init_vm(ngx_http_request_t *r)
         return NGX_OK;
     }
 
-    ctx->vm = njs_vm_clone(jmcf->vm, r);
-    if (ctx->vm == NULL) {
-        return NGX_ERROR;
+    if (jmcf->request_pool) {
+        ctx->vm = njs_vm_clone_mem(jmcf->vm, r, r->pool);
+        if (ctx->vm == NULL) {
+            return NGX_ERROR;
+        }
+
+    } else {
+        if (jmcf->nfree_vms != 0) {
+            ctx->vm = jmcf->free_vms[--jmcf->nfree_vms];
+
+            if (njs_vm_reset(ctx->vm, r) != NXT_OK) {
+                njs_vm_destroy(ctx->vm);
+                ctx->vm = NULL;
+            }
+        }
+
+        if (ctx->vm == NULL) {
+            ctx->vm = njs_vm_clone(jmcf->vm, r);
+            if (ctx->vm == NULL) {
+                return NGX_ERROR;
+            }
+        }
     }
 
+    jlcf = ngx_http_get_module_loc_conf(r, ngx_http_js_module);
+
+    njs_vm_memory_limit(ctx->vm, jlcf->max_memory);
+
     cln = ngx_pool_cleanup_add(r->pool, 0);
     if (cln == NULL) {
         return NGX_ERROR;
@@ -790,8 +915,29 @@ ngx_http_js_cleanup_ctx(void *data)
 {
     ngx_http_js_ctx_t *ctx = data;
 
+    ngx_http_js_main_conf_t  *jmcf;
+
+    if (ctx->resume.timer_set) {
+        ngx_del_timer(&ctx->resume);
+    }
+
+    jmcf = ngx_http_cycle_get_module_main_conf(ngx_cycle, ngx_http_js_module);
+
     if (njs_vm_pending(ctx->vm)) {
         ngx_log_error(NGX_LOG_ERR, ctx->log, 0, "pending events");
+
+    } else if (!jmcf->request_pool
+               && jmcf->nfree_vms < NGX_HTTP_JS_FREE_VMS)
+    {
+        /* The clone is reset by njs_vm_reset() when it is reused. */
+        jmcf->free_vms[jmcf->nfree_vms++] = ctx->vm;
+        return;
+    }
+
+    if (jmcf->request_pool) {
+        /* The clone memory is freed with the request pool. */
+        njs_vm_release(ctx->vm);
+        return;
     }
 
     njs_vm_destroy(ctx->vm);
@@ -801,9 +947,47 @@ ngx_http_js_cleanup_ctx(void *data)
 static void
 ngx_http_js_cleanup_vm(void *data)
 {
-    njs_vm_t *vm = data;
+    ngx_http_js_main_conf_t *jmcf = data;
+
+    while (jmcf->nfree_vms != 0) {
+        njs_vm_destroy(jmcf->free_vms[--jmcf->nfree_vms]);
+    }
+
+    if (jmcf->request_pool) {
+        /* The VM memory is freed with the configuration pool. */
+        njs_vm_release(jmcf->vm);
+        return;
+    }
+
+    njs_vm_destroy(jmcf->vm);
+}
+
+
+static void *
+ngx_http_js_alloc(void *mem, size_t size)
+{
+    return ngx_palloc(mem, size);
+}
+
 
-    njs_vm_destroy(vm);
+static void *
+ngx_http_js_zalloc(void *mem, size_t size)
+{
+    return ngx_pcalloc(mem, size);
+}
+
+
+static void *
+ngx_http_js_align(void *mem, size_t alignment, size_t size)
+{
+    return ngx_pmemalign(mem, size, alignment);
+}
+
+
+static void
+ngx_http_js_free(void *mem, void *p)
+{
+    (void) ngx_pfree(mem, p);
 }
 
 
@@ -2069,6 +2253,11 @@ ngx_http_js_set_timer(njs_external_ptr_t external, uint64_t delay,
 
     r = (ngx_http_request_t *) external;
 
+    if (r == NULL) {
+        /* The global code is run without a request. */
+        return NULL;
+    }
+
     ev = ngx_pcalloc(r->pool, sizeof(ngx_event_t));
     if (ev == NULL) {
         return NULL;
@@ -2127,14 +2316,28 @@ static void
 ngx_http_js_handle_event(ngx_http_request_t *r, njs_vm_event_t vm_event,
     njs_value_t *args, nxt_uint_t nargs)
 {
-    njs_ret_t           rc;
-    nxt_str_t           exception;
     ngx_http_js_ctx_t  *ctx;
 
     ctx = ngx_http_get_module_ctx(r, ngx_http_js_module);
 
     njs_vm_post_event(ctx->vm, vm_event, args, nargs);
 
+    ngx_http_js_run(r, ctx);
+}
+
+
+static void
+ngx_http_js_run(ngx_http_request_t *r, ngx_http_js_ctx_t *ctx)
+{
+    njs_ret_t  rc;
+    nxt_str_t  exception;
+
+    /* njs_vm_run() resumes the preempted execution as well. */
+
+    if (ctx->resume.timer_set) {
+        ngx_del_timer(&ctx->resume);
+    }
+
     rc = njs_vm_run(ctx->vm);
 
     if (rc == NJS_ERROR) {
@@ -2149,6 +2352,50 @@ ngx_http_js_handle_event(ngx_http_request_t *r, njs_vm_event_t vm_event,
     if (rc == NJS_OK) {
         ngx_http_post_request(r, NULL);
     }
+
+    if (rc == NJS_AGAIN && njs_vm_posted(ctx->vm)) {
+        ngx_http_js_post_resume(r, ctx);
+    }
+}
+
+
+/*
+ * The preempted execution is resumed by a zero timer, so other
+ * connections are processed in between.
+ */
+
+static void
+ngx_http_js_post_resume(ngx_http_request_t *r, ngx_http_js_ctx_t *ctx)
+{
+    ngx_event_t  *ev;
+
+    ev = &ctx->resume;
+
+    ev->data = r;
+    ev->log = r->connection->log;
+    ev->handler = ngx_http_js_resume_handler;
+
+    ngx_add_timer(ev, 0);
+}
+
+
+static void
+ngx_http_js_resume_handler(ngx_event_t *ev)
+{
+    ngx_connection_t    *c;
+    ngx_http_request_t  *r;
+    ngx_http_js_ctx_t   *ctx;
+
+    r = ev->data;
+    c = r->connection;
+
+    ctx = ngx_http_get_module_ctx(r, ngx_http_js_module);
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0, "http js resume");
+
+    ngx_http_js_run(r, ctx);
+
+    ngx_http_run_posted_requests(c);
 }
 
 
@@ -2174,11 +2421,34 @@ ngx_http_js_include(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
     ngx_http_js_main_conf_t *jmcf = conf;
 
+    ngx_str_t  *value;
+
+    if (jmcf->include.data != NULL) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+    jmcf->include = value[1];
+
+    return NGX_CONF_OK;
+}
+
+
+/*
+ * The VM is created after the main configuration is parsed, so the VM
+ * options do not depend on the order of the directives.
+ */
+
+static char *
+ngx_http_js_init_main_conf(ngx_conf_t *cf, void *conf)
+{
+    ngx_http_js_main_conf_t *jmcf = conf;
+
     size_t                 size;
     u_char                *start, *end;
     ssize_t                n;
     ngx_fd_t               fd;
-    ngx_str_t             *m, *value, file;
+    ngx_str_t             *m, file;
     nxt_int_t              rc;
     nxt_str_t              text, path;
     ngx_uint_t             i;
@@ -2186,12 +2456,13 @@ ngx_http_js_include(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     ngx_file_info_t        fi;
     ngx_pool_cleanup_t    *cln;
 
-    if (jmcf->vm) {
-        return "is duplicate";
+    ngx_conf_init_value(jmcf->request_pool, 0);
+
+    if (jmcf->include.data == NULL) {
+        return NGX_CONF_OK;
     }
 
-    value = cf->args->elts;
-    file = value[1];
+    file = jmcf->include;
 
     if (ngx_conf_full_name(cf->cycle, &file, 1) != NGX_OK) {
         return NGX_CONF_ERROR;
@@ -2250,7 +2521,23 @@ ngx_http_js_include(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     options.backtrace = 1;
     options.ops = &ngx_http_js_ops;
 
-    file = value[1];
+    if (jmcf->max_steps != NGX_CONF_UNSET) {
+        options.max_steps = jmcf->max_steps;
+    }
+
+    if (jmcf->max_time != NGX_CONF_UNSET_MSEC) {
+        options.max_time = jmcf->max_time;
+    }
+
+    options.preempt = (jmcf->preempt == 1);
+    options.no_presize = (jmcf->presize == 0);
+
+    if (jmcf->request_pool) {
+        options.mem_proto = &ngx_http_js_mem_proto;
+        options.mem = cf->pool;
+    }
+
+    file = jmcf->include;
     options.file.start = file.data;
     options.file.length = file.len;
 
@@ -2266,7 +2553,7 @@ ngx_http_js_include(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     }
 
     cln->handler = ngx_http_js_cleanup_vm;
-    cln->data = jmcf->vm;
+    cln->data = jmcf;
 
     path.start = ngx_cycle->prefix.data;
     path.length = ngx_cycle->prefix.len;
@@ -2321,6 +2608,59 @@ ngx_http_js_include(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_ERROR;
     }
 
+    /*
+     * The global code is run once here, the clones restore its
+     * resulting state instead of running it for each request.
+     */
+
+    rc = njs_vm_snapshot(jmcf->vm);
+
+    if (rc == NJS_ERROR) {
+        njs_vm_retval_to_ext_string(jmcf->vm, &text);
+
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "js exception: %*s, included",
+                           text.length, text.start);
+        return NGX_CONF_ERROR;
+    }
+
+    if (rc != NJS_OK) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "js global code cannot add events, included");
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
+
+
+/*
+ * The cache of free VM memory pool clusters is process-wide, so it is
+ * shared by the http and stream modules.
+ */
+
+static char *
+ngx_http_js_pool_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ssize_t     low, high;
+    ngx_str_t  *value;
+
+    value = cf->args->elts;
+
+    low = ngx_parse_size(&value[1]);
+    high = ngx_parse_size(&value[2]);
+
+    if (low == NGX_ERROR || high == NGX_ERROR || low > high) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid watermarks \"%V %V\"",
+                           &value[1], &value[2]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (njs_vm_cache_init(low, high) != NJS_OK) {
+        return NGX_CONF_ERROR;
+    }
+
     return NGX_CONF_OK;
 }
 
@@ -2397,10 +2737,17 @@ ngx_http_js_create_main_conf(ngx_conf_t *cf)
      * set by ngx_pcalloc():
      *
      *     conf->vm = NULL;
+     *     conf->include = { 0, NULL };
      *     conf->req_proto = NULL;
+     *     conf->nfree_vms = 0;
      */
 
     conf->paths = NGX_CONF_UNSET_PTR;
+    conf->max_steps = NGX_CONF_UNSET;
+    conf->max_time = NGX_CONF_UNSET_MSEC;
+    conf->preempt = NGX_CONF_UNSET;
+    conf->presize = NGX_CONF_UNSET;
+    conf->request_pool = NGX_CONF_UNSET;
 
     return conf;
 }
@@ -2422,6 +2769,8 @@ ngx_http_js_create_loc_conf(ngx_conf_t *cf)
      *     conf->content = { 0, NULL };
      */
 
+    conf->max_memory = NGX_CONF_UNSET_SIZE;
+
     return conf;
 }
 
@@ -2429,5 +2778,10 @@ ngx_http_js_create_loc_conf(ngx_conf_t *cf)
 static char *
 ngx_http_js_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
 {
+    ngx_http_js_loc_conf_t *prev = parent;
+    ngx_http_js_loc_conf_t *conf = child;
+
+    ngx_conf_merge_size_value(conf->max_memory, prev->max_memory, 0);
+
     return NGX_CONF_OK;
 }
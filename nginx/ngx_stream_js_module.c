@@ -13,10 +13,21 @@
 #include <njs.h>
 
 
+/* The number of the per-worker finished clones kept for reuse. */
+#define NGX_STREAM_JS_FREE_VMS      16
+
+
 typedef struct {
     njs_vm_t              *vm;
+    ngx_str_t              include;
     ngx_array_t           *paths;
     const njs_extern_t    *proto;
+    ngx_flag_t             presize;
+    ngx_flag_t             request_pool;
+    size_t                 gc_threshold;
+    ngx_int_t              gc_pause;
+    ngx_uint_t             nfree_vms;
+    njs_vm_t              *free_vms[NGX_STREAM_JS_FREE_VMS];
 } ngx_stream_js_main_conf_t;
 
 
@@ -24,6 +35,7 @@ typedef struct {
     ngx_str_t              access;
     ngx_str_t              preread;
     ngx_str_t              filter;
+    size_t                 max_memory;
 } ngx_stream_js_srv_conf_t;
 
 
@@ -64,6 +76,10 @@ static ngx_int_t ngx_stream_js_variable(ngx_stream_session_t *s,
 static ngx_int_t ngx_stream_js_init_vm(ngx_stream_session_t *s);
 static void ngx_stream_js_cleanup_ctx(void *data);
 static void ngx_stream_js_cleanup_vm(void *data);
+static void *ngx_stream_js_alloc(void *mem, size_t size);
+static void *ngx_stream_js_zalloc(void *mem, size_t size);
+static void *ngx_stream_js_align(void *mem, size_t alignment, size_t size);
+static void ngx_stream_js_free(void *mem, void *p);
 static njs_ret_t ngx_stream_js_buffer_arg(ngx_stream_session_t *s,
     njs_value_t *buffer);
 static njs_ret_t ngx_stream_js_flags_arg(ngx_stream_session_t *s,
@@ -115,6 +131,9 @@ static njs_ret_t ngx_stream_js_string(njs_vm_t *vm, const njs_value_t *value,
 
 static char *ngx_stream_js_include(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_stream_js_init_main_conf(ngx_conf_t *cf, void *conf);
+static char *ngx_stream_js_pool_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 static char *ngx_stream_js_set(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static void *ngx_stream_js_create_main_conf(ngx_conf_t *cf);
@@ -147,6 +166,34 @@ static ngx_command_t  ngx_stream_js_commands[] = {
       0,
       NULL },
 
+    { ngx_string("js_presize"),
+      NGX_STREAM_MAIN_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_STREAM_MAIN_CONF_OFFSET,
+      offsetof(ngx_stream_js_main_conf_t, presize),
+      NULL },
+
+    { ngx_string("js_request_pool"),
+      NGX_STREAM_MAIN_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_STREAM_MAIN_CONF_OFFSET,
+      offsetof(ngx_stream_js_main_conf_t, request_pool),
+      NULL },
+
+    { ngx_string("js_gc_threshold"),
+      NGX_STREAM_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_STREAM_MAIN_CONF_OFFSET,
+      offsetof(ngx_stream_js_main_conf_t, gc_threshold),
+      NULL },
+
+    { ngx_string("js_gc_pause"),
+      NGX_STREAM_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_STREAM_MAIN_CONF_OFFSET,
+      offsetof(ngx_stream_js_main_conf_t, gc_pause),
+      NULL },
+
     { ngx_string("js_access"),
       NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_str_slot,
@@ -168,6 +215,20 @@ static ngx_command_t  ngx_stream_js_commands[] = {
       offsetof(ngx_stream_js_srv_conf_t, filter),
       NULL },
 
+    { ngx_string("js_pool_cache"),
+      NGX_STREAM_MAIN_CONF|NGX_CONF_TAKE2,
+      ngx_stream_js_pool_cache,
+      0,
+      0,
+      NULL },
+
+    { ngx_string("js_max_memory"),
+      NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_STREAM_SRV_CONF_OFFSET,
+      offsetof(ngx_stream_js_srv_conf_t, max_memory),
+      NULL },
+
       ngx_null_command
 };
 
@@ -177,7 +238,7 @@ static ngx_stream_module_t  ngx_stream_js_module_ctx = {
     ngx_stream_js_init,             /* postconfiguration */
 
     ngx_stream_js_create_main_conf, /* create main configuration */
-    NULL,                           /* init main configuration */
+    ngx_stream_js_init_main_conf,   /* init main configuration */
 
     ngx_stream_js_create_srv_conf,  /* create server configuration */
     ngx_stream_js_merge_srv_conf,   /* merge server configuration */
@@ -371,6 +432,19 @@ static njs_vm_ops_t ngx_stream_js_ops = {
 };
 
 
+/* The VM memory allocated from the nginx pools. */
+
+static const nxt_mem_proto_t  ngx_stream_js_mem_proto = {
+    ngx_stream_js_alloc,
+    ngx_stream_js_zalloc,
+    ngx_stream_js_align,
+    NULL,
+    ngx_stream_js_free,
+    NULL,
+    NULL,
+};
+
+
 static ngx_stream_filter_pt  ngx_stream_next_filter;
 
 
@@ -702,6 +776,7 @@ ngx_stream_js_init_vm(ngx_stream_session_t *s)
     nxt_str_t                   exception;
     ngx_pool_cleanup_t         *cln;
     ngx_stream_js_ctx_t        *ctx;
+    ngx_stream_js_srv_conf_t   *jscf;
     ngx_stream_js_main_conf_t  *jmcf;
 
     jmcf = ngx_stream_get_module_main_conf(s, ngx_stream_js_module);
@@ -724,11 +799,34 @@ ngx_stream_js_init_vm(ngx_stream_session_t *s)
         return NGX_OK;
     }
 
-    ctx->vm = njs_vm_clone(jmcf->vm, s);
-    if (ctx->vm == NULL) {
-        return NGX_ERROR;
+    if (jmcf->request_pool) {
+        ctx->vm = njs_vm_clone_mem(jmcf->vm, s, s->connection->pool);
+        if (ctx->vm == NULL) {
+            return NGX_ERROR;
+        }
+
+    } else {
+        if (jmcf->nfree_vms != 0) {
+            ctx->vm = jmcf->free_vms[--jmcf->nfree_vms];
+
+            if (njs_vm_reset(ctx->vm, s) != NXT_OK) {
+                njs_vm_destroy(ctx->vm);
+                ctx->vm = NULL;
+            }
+        }
+
+        if (ctx->vm == NULL) {
+            ctx->vm = njs_vm_clone(jmcf->vm, s);
+            if (ctx->vm == NULL) {
+                return NGX_ERROR;
+            }
+        }
     }
 
+    jscf = ngx_stream_get_module_srv_conf(s, ngx_stream_js_module);
+
+    njs_vm_memory_limit(ctx->vm, jscf->max_memory);
+
     cln = ngx_pool_cleanup_add(s->connection->pool, 0);
     if (cln == NULL) {
         return NGX_ERROR;
@@ -763,6 +861,8 @@ ngx_stream_js_cleanup_ctx(void *data)
 {
     ngx_stream_js_ctx_t *ctx = data;
 
+    ngx_stream_js_main_conf_t  *jmcf;
+
     if (ctx->upload_event != NULL) {
         njs_vm_del_event(ctx->vm, ctx->upload_event);
         ctx->upload_event = NULL;
@@ -773,8 +873,24 @@ ngx_stream_js_cleanup_ctx(void *data)
         ctx->download_event = NULL;
     }
 
+    jmcf = ngx_stream_cycle_get_module_main_conf(ngx_cycle,
+                                                 ngx_stream_js_module);
+
     if (njs_vm_pending(ctx->vm)) {
         ngx_log_error(NGX_LOG_ERR, ctx->log, 0, "pending events");
+
+    } else if (!jmcf->request_pool
+               && jmcf->nfree_vms < NGX_STREAM_JS_FREE_VMS)
+    {
+        /* The clone is reset by njs_vm_reset() when it is reused. */
+        jmcf->free_vms[jmcf->nfree_vms++] = ctx->vm;
+        return;
+    }
+
+    if (jmcf->request_pool) {
+        /* The clone memory is freed with the connection pool. */
+        njs_vm_release(ctx->vm);
+        return;
     }
 
     njs_vm_destroy(ctx->vm);
@@ -784,9 +900,47 @@ ngx_stream_js_cleanup_ctx(void *data)
 static void
 ngx_stream_js_cleanup_vm(void *data)
 {
-    njs_vm_t *vm = data;
+    ngx_stream_js_main_conf_t *jmcf = data;
+
+    while (jmcf->nfree_vms != 0) {
+        njs_vm_destroy(jmcf->free_vms[--jmcf->nfree_vms]);
+    }
+
+    if (jmcf->request_pool) {
+        /* The VM memory is freed with the configuration pool. */
+        njs_vm_release(jmcf->vm);
+        return;
+    }
+
+    njs_vm_destroy(jmcf->vm);
+}
+
+
+static void *
+ngx_stream_js_alloc(void *mem, size_t size)
+{
+    return ngx_palloc(mem, size);
+}
+
+
+static void *
+ngx_stream_js_zalloc(void *mem, size_t size)
+{
+    return ngx_pcalloc(mem, size);
+}
+
+
+static void *
+ngx_stream_js_align(void *mem, size_t alignment, size_t size)
+{
+    return ngx_pmemalign(mem, size, alignment);
+}
+
 
-    njs_vm_destroy(vm);
+static void
+ngx_stream_js_free(void *mem, void *p)
+{
+    (void) ngx_pfree(mem, p);
 }
 
 
@@ -1298,6 +1452,11 @@ ngx_stream_js_set_timer(njs_external_ptr_t external, uint64_t delay,
 
     s = (ngx_stream_session_t *) external;
 
+    if (s == NULL) {
+        /* The global code is run without a session. */
+        return NULL;
+    }
+
     ev = ngx_pcalloc(s->connection->pool, sizeof(ngx_event_t));
     if (ev == NULL) {
         return NULL;
@@ -1398,11 +1557,34 @@ ngx_stream_js_include(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
     ngx_stream_js_main_conf_t *jmcf = conf;
 
+    ngx_str_t  *value;
+
+    if (jmcf->include.data != NULL) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+    jmcf->include = value[1];
+
+    return NGX_CONF_OK;
+}
+
+
+/*
+ * The VM is created after the main configuration is parsed, so the VM
+ * options do not depend on the order of the directives.
+ */
+
+static char *
+ngx_stream_js_init_main_conf(ngx_conf_t *cf, void *conf)
+{
+    ngx_stream_js_main_conf_t *jmcf = conf;
+
     size_t                 size;
     u_char                *start, *end;
     ssize_t                n;
     ngx_fd_t               fd;
-    ngx_str_t             *m, *value, file;
+    ngx_str_t             *m, file;
     nxt_int_t              rc;
     nxt_str_t              text, path;
     ngx_uint_t             i;
@@ -1410,12 +1592,15 @@ ngx_stream_js_include(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     ngx_file_info_t        fi;
     ngx_pool_cleanup_t    *cln;
 
-    if (jmcf->vm) {
-        return "is duplicate";
+    ngx_conf_init_value(jmcf->request_pool, 0);
+    ngx_conf_init_size_value(jmcf->gc_threshold, 0);
+    ngx_conf_init_value(jmcf->gc_pause, 0);
+
+    if (jmcf->include.data == NULL) {
+        return NGX_CONF_OK;
     }
 
-    value = cf->args->elts;
-    file = value[1];
+    file = jmcf->include;
 
     if (ngx_conf_full_name(cf->cycle, &file, 1) != NGX_OK) {
         return NGX_CONF_ERROR;
@@ -1473,8 +1658,53 @@ ngx_stream_js_include(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     options.backtrace = 1;
     options.ops = &ngx_stream_js_ops;
+    options.no_presize = (jmcf->presize == 0);
+
+    /*
+     * The garbage collector is off by default.  The values kept by nginx
+     * outside the VM are not roots, so they must stay reachable from
+     * the global variables of the script.
+     */
+
+    if (jmcf->gc_threshold > NGX_MAX_UINT32_VALUE) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"js_gc_threshold\" is too large");
+        return NGX_CONF_ERROR;
+    }
+
+    if (jmcf->gc_pause > NGX_MAX_INT32_VALUE) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"js_gc_pause\" is too large");
+        return NGX_CONF_ERROR;
+    }
+
+    if (jmcf->gc_pause != 0 && jmcf->gc_pause < 100) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"js_gc_pause\" must be at least 100");
+        return NGX_CONF_ERROR;
+    }
+
+    options.gc_threshold = jmcf->gc_threshold;
+    options.gc_pause = jmcf->gc_pause;
+
+    /*
+     * The blocks freed by the garbage collector during a long session
+     * would leave their headers in the connection pool.
+     */
+
+    if (jmcf->request_pool && options.gc_threshold != 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"js_request_pool\" cannot be used "
+                           "with \"js_gc_threshold\"");
+        return NGX_CONF_ERROR;
+    }
 
-    file = value[1];
+    if (jmcf->request_pool) {
+        options.mem_proto = &ngx_stream_js_mem_proto;
+        options.mem = cf->pool;
+    }
+
+    file = jmcf->include;
     options.file.start = file.data;
     options.file.length = file.len;
 
@@ -1490,7 +1720,7 @@ ngx_stream_js_include(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     }
 
     cln->handler = ngx_stream_js_cleanup_vm;
-    cln->data = jmcf->vm;
+    cln->data = jmcf;
 
     path.start = ngx_cycle->prefix.data;
     path.length = ngx_cycle->prefix.len;
@@ -1546,6 +1776,59 @@ ngx_stream_js_include(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_ERROR;
     }
 
+    /*
+     * The global code is run once here, the clones restore its
+     * resulting state instead of running it for each session.
+     */
+
+    rc = njs_vm_snapshot(jmcf->vm);
+
+    if (rc == NJS_ERROR) {
+        njs_vm_retval_to_ext_string(jmcf->vm, &text);
+
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "js exception: %*s, included",
+                           text.length, text.start);
+        return NGX_CONF_ERROR;
+    }
+
+    if (rc != NJS_OK) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "js global code cannot add events, included");
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
+
+
+/*
+ * The cache of free VM memory pool clusters is process-wide, so it is
+ * shared by the http and stream modules.
+ */
+
+static char *
+ngx_stream_js_pool_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ssize_t     low, high;
+    ngx_str_t  *value;
+
+    value = cf->args->elts;
+
+    low = ngx_parse_size(&value[1]);
+    high = ngx_parse_size(&value[2]);
+
+    if (low == NGX_ERROR || high == NGX_ERROR || low > high) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid watermarks \"%V %V\"",
+                           &value[1], &value[2]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (njs_vm_cache_init(low, high) != NJS_OK) {
+        return NGX_CONF_ERROR;
+    }
+
     return NGX_CONF_OK;
 }
 
@@ -1600,10 +1883,16 @@ ngx_stream_js_create_main_conf(ngx_conf_t *cf)
      * set by ngx_pcalloc():
      *
      *     conf->vm = NULL;
+     *     conf->include = { 0, NULL };
      *     conf->proto = NULL;
+     *     conf->nfree_vms = 0;
      */
 
     conf->paths = NGX_CONF_UNSET_PTR;
+    conf->presize = NGX_CONF_UNSET;
+    conf->request_pool = NGX_CONF_UNSET;
+    conf->gc_threshold = NGX_CONF_UNSET_SIZE;
+    conf->gc_pause = NGX_CONF_UNSET;
 
     return conf;
 }
@@ -1627,6 +1916,8 @@ ngx_stream_js_create_srv_conf(ngx_conf_t *cf)
      *     conf->filter = { 0, NULL };
      */
 
+    conf->max_memory = NGX_CONF_UNSET_SIZE;
+
     return conf;
 }
 
@@ -1640,6 +1931,7 @@ ngx_stream_js_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_str_value(conf->access, prev->access, "");
     ngx_conf_merge_str_value(conf->preread, prev->preread, "");
     ngx_conf_merge_str_value(conf->filter, prev->filter, "");
+    ngx_conf_merge_size_value(conf->max_memory, prev->max_memory, 0);
 
     return NGX_CONF_OK;
 }
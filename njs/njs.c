@@ -9,10 +9,29 @@
 #include <string.h>
 
 
+static nxt_mp_t *njs_vm_mp_create(const nxt_mem_proto_t *proto, void *mem);
+static void njs_vm_release_events(njs_vm_t *vm);
+static nxt_int_t njs_vm_clone_init(njs_vm_t *nvm, njs_vm_t *vm, nxt_mp_t *nmp,
+    njs_external_ptr_t external);
+static void njs_vm_presize(njs_vm_t *nvm, njs_vm_t *vm);
+static void njs_vm_presize_update(njs_vm_t *vm);
+static uint32_t njs_vm_percentile(const uint32_t *samples, nxt_uint_t n);
 static nxt_int_t njs_vm_init(njs_vm_t *vm);
+static nxt_int_t njs_vm_global_init(njs_vm_t *vm, njs_frame_t *frame);
+static nxt_int_t njs_vm_prop_cache_alloc(njs_vm_t *vm);
 static nxt_int_t njs_vm_handle_events(njs_vm_t *vm);
 
 
+/*
+ * The global frame contains the global scope and a spare space
+ * for the first function frames.
+ */
+#define njs_vm_global_frame_size(vm)                                          \
+    nxt_align_size(NJS_GLOBAL_FRAME_SIZE + NJS_INDEX_GLOBAL_OFFSET            \
+                   + (vm)->scope_size + NJS_FRAME_SPARE_SIZE,                 \
+                   NJS_FRAME_SPARE_SIZE)
+
+
 static void *
 njs_alloc(void *mem, size_t size)
 {
@@ -60,6 +79,10 @@ const nxt_mem_proto_t  njs_vm_mp_proto = {
 };
 
 
+/* The process-wide cache of free VM memory pool clusters. */
+static nxt_mp_cache_t  *njs_vm_cache;
+
+
 static void *
 njs_array_mem_alloc(void *mem, size_t size)
 {
@@ -94,8 +117,7 @@ njs_vm_create(njs_vm_opt_t *options)
     nxt_array_t           *debug;
     njs_regexp_pattern_t  *pattern;
 
-    mp = nxt_mp_create(&njs_vm_mp_proto, NULL, NULL, 2 * nxt_pagesize(),
-                       128, 512, 16);
+    mp = njs_vm_mp_create(options->mem_proto, options->mem);
     if (nxt_slow_path(mp == NULL)) {
         return NULL;
     }
@@ -105,11 +127,6 @@ njs_vm_create(njs_vm_opt_t *options)
     if (nxt_fast_path(vm != NULL)) {
         vm->mem_pool = mp;
 
-        ret = njs_regexp_init(vm);
-        if (nxt_slow_path(ret != NXT_OK)) {
-            return NULL;
-        }
-
         vm->options = *options;
 
         if (options->shared != NULL) {
@@ -122,6 +139,7 @@ njs_vm_create(njs_vm_opt_t *options)
             }
 
             options->shared = vm->shared;
+            vm->shared_owner = 1;
 
             nxt_lvlhsh_init(&vm->shared->keywords_hash);
 
@@ -131,6 +149,7 @@ njs_vm_create(njs_vm_opt_t *options)
             }
 
             nxt_lvlhsh_init(&vm->shared->values_hash);
+            nxt_lvlhsh_init(&vm->shared->atoms_hash);
 
             pattern = njs_regexp_pattern_create(vm, (u_char *) "(?:)",
                                                 nxt_length("(?:)"), 0);
@@ -149,6 +168,7 @@ njs_vm_create(njs_vm_opt_t *options)
         }
 
         nxt_lvlhsh_init(&vm->values_hash);
+        nxt_lvlhsh_init(&vm->atoms_hash);
 
         vm->external = options->external;
 
@@ -167,7 +187,9 @@ njs_vm_create(njs_vm_opt_t *options)
         vm->trace.handler = njs_parser_trace_handler;
         vm->trace.data = vm;
 
-        if (options->backtrace) {
+        if (options->backtrace || options->profile
+            || options->sample_interval != 0)
+        {
             debug = nxt_array_create(4, sizeof(njs_function_debug_t),
                                      &njs_array_mem_proto, vm->mem_pool);
             if (nxt_slow_path(debug == NULL)) {
@@ -177,12 +199,33 @@ njs_vm_create(njs_vm_opt_t *options)
             vm->debug = debug;
         }
 
+        if (options->profile || options->sample_interval != 0) {
+            ret = njs_profile_init(vm);
+            if (nxt_slow_path(ret != NXT_OK)) {
+                return NULL;
+            }
+        }
+
+        /*
+         * The presize samples are allocated in advance, so the clone
+         * destruction does not allocate from the parent pool.
+         */
+
+        if (!options->no_presize && !options->accumulative) {
+            vm->presize = nxt_mp_zalloc(mp, sizeof(njs_presize_t));
+            if (nxt_slow_path(vm->presize == NULL)) {
+                return NULL;
+            }
+        }
+
         if (options->accumulative) {
             ret = njs_vm_init(vm);
             if (nxt_slow_path(ret != NXT_OK)) {
                 return NULL;
             }
         }
+
+        nxt_mp_limit(mp, options->max_memory);
     }
 
     return vm;
@@ -191,6 +234,30 @@ njs_vm_create(njs_vm_opt_t *options)
 
 void
 njs_vm_destroy(njs_vm_t *vm)
+{
+    njs_vm_release(vm);
+
+    nxt_mp_destroy(vm->mem_pool);
+}
+
+
+void
+njs_vm_release(njs_vm_t *vm)
+{
+    njs_vm_release_events(vm);
+
+    if (vm->parent != NULL) {
+        njs_vm_presize_update(vm);
+    }
+
+    if (vm->shared_owner) {
+        njs_jit_destroy(vm->shared);
+    }
+}
+
+
+static void
+njs_vm_release_events(njs_vm_t *vm)
 {
     njs_event_t        *event;
     nxt_lvlhsh_each_t  lhe;
@@ -208,8 +275,6 @@ njs_vm_destroy(njs_vm_t *vm)
             njs_del_event(vm, event, NJS_EVENT_RELEASE);
         }
     }
-
-    nxt_mp_destroy(vm->mem_pool);
 }
 
 
@@ -286,6 +351,11 @@ njs_vm_compile(njs_vm_t *vm, u_char **start, u_char *end)
 
     vm->variables_hash = scope->variables;
 
+    ret = njs_vm_prop_cache_alloc(vm);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NJS_ERROR;
+    }
+
     if (vm->options.init) {
         ret = njs_vm_init(vm);
         if (nxt_slow_path(ret != NXT_OK)) {
@@ -303,14 +373,56 @@ fail:
 }
 
 
+nxt_int_t
+njs_vm_compile_from_image(njs_vm_t *vm, const u_char *start, const u_char *end)
+{
+    nxt_int_t  ret;
+
+    if (vm->parser != NULL || vm->code != NULL || vm->options.accumulative) {
+        return NJS_ERROR;
+    }
+
+    if (vm->backtrace != NULL) {
+        nxt_array_reset(vm->backtrace);
+    }
+
+    vm->retval = njs_value_undefined;
+
+    ret = njs_image_load(vm, start, end);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        vm->code = NULL;
+        return NJS_ERROR;
+    }
+
+    ret = njs_vm_prop_cache_alloc(vm);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NJS_ERROR;
+    }
+
+    if (vm->options.init) {
+        ret = njs_vm_init(vm);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+    }
+
+    return NJS_OK;
+}
+
+
 njs_vm_t *
 njs_vm_clone(njs_vm_t *vm, njs_external_ptr_t external)
 {
-    nxt_mp_t     *nmp;
-    njs_vm_t     *nvm;
-    uint32_t     items;
-    nxt_int_t    ret;
-    nxt_array_t  *externals;
+    return njs_vm_clone_mem(vm, external, vm->options.mem);
+}
+
+
+njs_vm_t *
+njs_vm_clone_mem(njs_vm_t *vm, njs_external_ptr_t external, void *mem)
+{
+    nxt_mp_t   *nmp;
+    njs_vm_t   *nvm;
+    nxt_int_t  ret;
 
     nxt_thread_log_debug("CLONE:");
 
@@ -318,93 +430,395 @@ njs_vm_clone(njs_vm_t *vm, njs_external_ptr_t external)
         return NULL;
     }
 
-    nmp = nxt_mp_create(&njs_vm_mp_proto, NULL, NULL, 2 * nxt_pagesize(),
-                        128, 512, 16);
+    nmp = njs_vm_mp_create(vm->options.mem_proto, mem);
     if (nxt_slow_path(nmp == NULL)) {
         return NULL;
     }
 
-    nvm = nxt_mp_zalign(nmp, sizeof(njs_value_t), sizeof(njs_vm_t));
+    /*
+     * The clone global frame is allocated together with the clone
+     * since the global frame is never freed.  The allocation is larger
+     * than the pool page size, so it is kept by nxt_mp_reset().
+     */
+
+    nvm = nxt_mp_align(nmp, sizeof(njs_value_t),
+                       nxt_align_size(sizeof(njs_vm_t), sizeof(njs_value_t))
+                       + njs_vm_global_frame_size(vm));
 
     if (nxt_fast_path(nvm != NULL)) {
-        nvm->mem_pool = nmp;
+        ret = njs_vm_clone_init(nvm, vm, nmp, external);
+
+        if (nxt_fast_path(ret == NXT_OK)) {
+            return nvm;
+        }
+    }
 
-        nvm->shared = vm->shared;
+    nxt_mp_destroy(nmp);
 
-        nvm->trace = vm->trace;
-        nvm->trace.data = nvm;
+    return NULL;
+}
 
-        nvm->variables_hash = vm->variables_hash;
-        nvm->values_hash = vm->values_hash;
 
-        nvm->modules = vm->modules;
-        nvm->modules_hash = vm->modules_hash;
+nxt_int_t
+njs_vm_reset(njs_vm_t *vm, njs_external_ptr_t external)
+{
+    nxt_mp_t  *mp;
+    njs_vm_t  *parent;
 
-        nvm->externals_hash = vm->externals_hash;
-        nvm->external_prototypes_hash = vm->external_prototypes_hash;
+    nxt_thread_log_debug("RESET:");
 
-        items = vm->external_objects->items;
-        externals = nxt_array_create(items + 4, sizeof(void *),
-                                     &njs_array_mem_proto, nvm->mem_pool);
+    parent = vm->parent;
 
-        if (nxt_slow_path(externals == NULL)) {
-            return NULL;
+    if (parent == NULL) {
+        return NXT_DECLINED;
+    }
+
+    njs_vm_release_events(vm);
+
+    njs_vm_presize_update(vm);
+
+    mp = vm->mem_pool;
+
+    nxt_mp_reset(mp, vm);
+
+    return njs_vm_clone_init(vm, parent, mp, external);
+}
+
+
+static nxt_int_t
+njs_vm_clone_init(njs_vm_t *nvm, njs_vm_t *vm, nxt_mp_t *nmp,
+    njs_external_ptr_t external)
+{
+    u_char     *p;
+    size_t     size;
+    nxt_int_t  ret;
+
+    /*
+     * The prototypes and constructors are not zeroed because
+     * they are overwritten by njs_builtin_objects_clone().
+     */
+
+    nxt_memzero(nvm, offsetof(njs_vm_t, prototypes));
+
+    p = (u_char *) &nvm->constructors[NJS_CONSTRUCTOR_MAX];
+    nxt_memzero(p, (u_char *) nvm + sizeof(njs_vm_t) - p);
+
+    nvm->mem_pool = nmp;
+    nvm->parent = vm;
+
+    nvm->shared = vm->shared;
+
+    nvm->trace = vm->trace;
+    nvm->trace.data = nvm;
+
+    nvm->variables_hash = vm->variables_hash;
+    nvm->values_hash = vm->values_hash;
+    nvm->atoms_hash = vm->atoms_hash;
+
+    nvm->modules = vm->modules;
+    nvm->modules_hash = vm->modules_hash;
+
+    nvm->externals_hash = vm->externals_hash;
+    nvm->external_prototypes_hash = vm->external_prototypes_hash;
+
+    /*
+     * The external objects array is shared with the parent VM
+     * until the first njs_vm_external_create() call in either VM.
+     */
+    nvm->external_objects = vm->external_objects;
+    nvm->externals_shared = 1;
+    vm->externals_shared = 1;
+
+    vm->cloned = 1;
+
+    nvm->options = vm->options;
+
+    nvm->current = vm->current;
+
+    nvm->external = external;
+
+    nvm->global_scope = vm->global_scope;
+    nvm->scope_size = vm->scope_size;
+
+    nvm->debug = vm->debug;
+    nvm->code = vm->code;
+
+    nvm->prop_caches = vm->prop_caches;
+
+    ret = njs_vm_prop_cache_alloc(nvm);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    if (nvm->options.profile || nvm->options.sample_interval != 0) {
+        ret = njs_profile_init(nvm);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
         }
+    }
+
+    size = nxt_align_size(sizeof(njs_vm_t), sizeof(njs_value_t));
 
-        if (items > 0) {
-            memcpy(externals->start, vm->external_objects->start,
-                   items * sizeof(void *));
-            externals->items = items;
+    ret = njs_vm_global_init(nvm, (njs_frame_t *) ((u_char *) nvm + size));
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    if (vm->snapshot) {
+        ret = njs_snapshot_restore(nvm, vm);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
         }
 
-        nvm->external_objects = externals;
+        nvm->snapshot = 1;
+    }
 
-        nvm->options = vm->options;
+    if (nvm->options.gc_threshold != 0) {
+        ret = njs_gc_init(nvm);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
+        }
+    }
 
-        nvm->current = vm->current;
+    nxt_mp_limit(nmp, nvm->options.max_memory);
 
-        nvm->external = external;
+    njs_vm_presize(nvm, vm);
 
-        nvm->global_scope = vm->global_scope;
-        nvm->scope_size = vm->scope_size;
+    return NXT_OK;
+}
 
-        nvm->debug = vm->debug;
 
-        ret = njs_vm_init(nvm);
-        if (nxt_slow_path(ret != NXT_OK)) {
-            goto fail;
+/*
+ * The clones reserve the pool clusters and the stack chunk the previous
+ * clones of the parent needed, so they do not grow during execution.
+ * The reservation failure is not an error.
+ */
+
+static void
+njs_vm_presize(njs_vm_t *nvm, njs_vm_t *vm)
+{
+    size_t              size;
+    njs_presize_t       *presize;
+    njs_native_frame_t  *frame;
+
+    presize = vm->presize;
+
+    if (presize == NULL || vm->options.no_presize) {
+        return;
+    }
+
+    (void) nxt_mp_reserve(nvm->mem_pool, presize->pool_size);
+
+    size = presize->stack_size;
+
+    if (size != 0) {
+        frame = nxt_mp_align(nvm->mem_pool, sizeof(njs_value_t), size);
+
+        if (nxt_fast_path(frame != NULL)) {
+            frame->size = size;
+            nvm->stack_cache = frame;
         }
+    }
+}
 
-        return nvm;
+
+static void
+njs_vm_presize_update(njs_vm_t *vm)
+{
+    size_t         size;
+    uint32_t       i, n;
+    njs_presize_t  *presize;
+
+    presize = vm->parent->presize;
+
+    if (presize == NULL) {
+        return;
     }
 
-fail:
+    i = presize->samples++ % NJS_PRESIZE_SAMPLES;
 
-    nxt_mp_destroy(nmp);
+    presize->pool[i] = nxt_min(nxt_mp_pages_peak(vm->mem_pool), UINT32_MAX);
+    presize->stack[i] = nxt_min(vm->stack_peak, UINT32_MAX);
 
-    return NULL;
+    n = nxt_min(presize->samples, NJS_PRESIZE_SAMPLES);
+
+    presize->pool_size = njs_vm_percentile(presize->pool, n);
+
+    size = nxt_min(njs_vm_percentile(presize->stack, n),
+                   NJS_FRAME_CHUNK_MAX_SIZE);
+    presize->stack_size = nxt_align_size(size, NJS_FRAME_SPARE_SIZE);
+}
+
+
+/* The 90th percentile of the samples. */
+
+static uint32_t
+njs_vm_percentile(const uint32_t *samples, nxt_uint_t n)
+{
+    uint32_t    value, sorted[NJS_PRESIZE_SAMPLES];
+    nxt_uint_t  i, j;
+
+    for (i = 0; i < n; i++) {
+        value = samples[i];
+
+        for (j = i; j != 0 && sorted[j - 1] > value; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+
+        sorted[j] = value;
+    }
+
+    return sorted[n * 9 / 10];
+}
+
+
+void
+njs_vm_presize_stats(njs_vm_t *vm, njs_vm_presize_stats_t *stats)
+{
+    njs_presize_t  *presize;
+
+    presize = (vm->parent != NULL) ? vm->parent->presize : vm->presize;
+
+    if (presize == NULL || vm->options.no_presize) {
+        nxt_memzero(stats, sizeof(njs_vm_presize_stats_t));
+        return;
+    }
+
+    stats->samples = presize->samples;
+    stats->pool_size = presize->pool_size;
+    stats->stack_size = presize->stack_size;
+}
+
+
+void
+njs_vm_memory_limit(njs_vm_t *vm, size_t limit)
+{
+    nxt_mp_limit(vm->mem_pool, limit);
+}
+
+
+void
+njs_vm_memory_stats(njs_vm_t *vm, nxt_mp_stat_t *stats)
+{
+    nxt_mp_stat(vm->mem_pool, stats);
+}
+
+
+/* The pools of the host allocator do not use the cluster cache. */
+
+static nxt_mp_t *
+njs_vm_mp_create(const nxt_mem_proto_t *proto, void *mem)
+{
+    nxt_mp_t  *mp;
+
+    if (proto != NULL) {
+        return nxt_mp_create(proto, mem, NULL, 2 * nxt_pagesize(),
+                             128, 512, 16);
+    }
+
+    mp = nxt_mp_create(&njs_vm_mp_proto, NULL, NULL, 2 * nxt_pagesize(),
+                       128, 512, 16);
+
+    if (nxt_fast_path(mp != NULL) && njs_vm_cache != NULL) {
+        (void) nxt_mp_use_cache(mp, njs_vm_cache);
+    }
+
+    return mp;
+}
+
+
+nxt_int_t
+njs_vm_cache_init(size_t low, size_t high)
+{
+    if (njs_vm_cache == NULL) {
+        if (high == 0) {
+            return NXT_OK;
+        }
+
+        njs_vm_cache = nxt_mp_cache_create(&njs_vm_mp_proto, NULL,
+                                           2 * nxt_pagesize(), 512);
+        if (nxt_slow_path(njs_vm_cache == NULL)) {
+            return NXT_ERROR;
+        }
+    }
+
+    nxt_mp_cache_watermarks(njs_vm_cache, low, high);
+
+    return NXT_OK;
+}
+
+
+void
+njs_vm_cache_stats(nxt_mp_cache_stat_t *stats)
+{
+    if (njs_vm_cache != NULL) {
+        nxt_mp_cache_stat(njs_vm_cache, stats);
+
+    } else {
+        nxt_memzero(stats, sizeof(nxt_mp_cache_stat_t));
+    }
 }
 
 
 static nxt_int_t
-njs_vm_init(njs_vm_t *vm)
+njs_vm_prop_cache_alloc(njs_vm_t *vm)
 {
-    size_t       size, scope_size;
-    u_char       *values;
-    nxt_int_t    ret;
-    njs_frame_t  *frame;
-    nxt_array_t  *backtrace;
+    size_t            size;
+    njs_prop_cache_t  *cache;
 
-    scope_size = vm->scope_size + NJS_INDEX_GLOBAL_OFFSET;
+    if (vm->prop_caches < vm->prop_cache_size) {
+        return NXT_OK;
+    }
+
+    /* The zeroth cache entry is not used. */
 
-    size = NJS_GLOBAL_FRAME_SIZE + scope_size + NJS_FRAME_SPARE_SIZE;
-    size = nxt_align_size(size, NJS_FRAME_SPARE_SIZE);
+    size = vm->prop_caches + 1;
+
+    cache = nxt_mp_zalloc(vm->mem_pool, size * sizeof(njs_prop_cache_t));
+    if (nxt_slow_path(cache == NULL)) {
+        return NXT_ERROR;
+    }
 
-    frame = nxt_mp_align(vm->mem_pool, sizeof(njs_value_t), size);
+    if (vm->prop_cache != NULL) {
+        /* The accumulative mode. */
+        memcpy(cache, vm->prop_cache,
+               vm->prop_cache_size * sizeof(njs_prop_cache_t));
+
+        nxt_mp_free(vm->mem_pool, vm->prop_cache);
+    }
+
+    vm->prop_cache = cache;
+    vm->prop_cache_size = size;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+njs_vm_init(njs_vm_t *vm)
+{
+    njs_frame_t  *frame;
+
+    frame = nxt_mp_align(vm->mem_pool, sizeof(njs_value_t),
+                         njs_vm_global_frame_size(vm));
     if (nxt_slow_path(frame == NULL)) {
         return NXT_ERROR;
     }
 
+    return njs_vm_global_init(vm, frame);
+}
+
+
+static nxt_int_t
+njs_vm_global_init(njs_vm_t *vm, njs_frame_t *frame)
+{
+    size_t     size, scope_size;
+    u_char     *values;
+    nxt_int_t  ret;
+
+    scope_size = vm->scope_size + NJS_INDEX_GLOBAL_OFFSET;
+    size = njs_vm_global_frame_size(vm);
+
     nxt_memzero(frame, NJS_GLOBAL_FRAME_SIZE);
 
     vm->top_frame = &frame->native;
@@ -421,11 +835,6 @@ njs_vm_init(njs_vm_t *vm)
     memcpy(values + NJS_INDEX_GLOBAL_OFFSET, vm->global_scope,
            vm->scope_size);
 
-    ret = njs_regexp_init(vm);
-    if (nxt_slow_path(ret != NXT_OK)) {
-        return NXT_ERROR;
-    }
-
     ret = njs_builtin_objects_clone(vm);
     if (nxt_slow_path(ret != NXT_OK)) {
         return NXT_ERROR;
@@ -434,20 +843,14 @@ njs_vm_init(njs_vm_t *vm)
     nxt_lvlhsh_init(&vm->events_hash);
     nxt_queue_init(&vm->posted_events);
 
-    if (vm->debug != NULL) {
-        backtrace = nxt_array_create(4, sizeof(njs_backtrace_entry_t),
-                                     &njs_array_mem_proto, vm->mem_pool);
-        if (nxt_slow_path(backtrace == NULL)) {
-            return NXT_ERROR;
-        }
-
-        vm->backtrace = backtrace;
-    }
+    /* The backtrace array is created on the first exception. */
 
     if (njs_is_null(&vm->retval)) {
         vm->retval = njs_value_undefined;
     }
 
+    *njs_vmcode_operand(vm, NJS_INDEX_GLOBAL_RETVAL) = njs_value_undefined;
+
     return NXT_OK;
 }
 
@@ -470,6 +873,11 @@ njs_vm_invoke(njs_vm_t *vm, njs_function_t *function, const njs_value_t *args,
 
     this = (njs_value_t *) &njs_value_undefined;
 
+    if (nxt_slow_path(vm->preempted)) {
+        njs_internal_error(vm, "VM is preempted");
+        return NXT_ERROR;
+    }
+
     current = vm->current;
 
     vm->current = (u_char *) njs_continuation_nexus;
@@ -478,15 +886,39 @@ njs_vm_invoke(njs_vm_t *vm, njs_function_t *function, const njs_value_t *args,
                                 sizeof(njs_vmcode_generic_t));
 
     if (nxt_fast_path(ret == NJS_APPLIED)) {
-        ret = njs_vmcode_interpreter(vm);
+        ret = njs_vmcode_run(vm, 1);
 
         if (ret == NJS_STOP) {
             ret = NXT_OK;
+
+        } else if (ret == NXT_AGAIN && vm->preempted) {
+            /* The execution is resumed by njs_vm_run(). */
+            return ret;
         }
     }
 
     vm->current = current;
 
+    njs_gc_check(vm);
+
+    return ret;
+}
+
+
+nxt_int_t
+njs_vm_call_nonpreemptive(njs_vm_t *vm, njs_function_t *function,
+    const njs_value_t *args, nxt_uint_t nargs)
+{
+    uint8_t    preempt;
+    nxt_int_t  ret;
+
+    preempt = vm->options.preempt;
+    vm->options.preempt = 0;
+
+    ret = njs_vm_invoke(vm, function, args, nargs, NJS_INDEX_GLOBAL_RETVAL);
+
+    vm->options.preempt = preempt;
+
     return ret;
 }
 
@@ -539,7 +971,7 @@ njs_vm_waiting(njs_vm_t *vm)
 nxt_int_t
 njs_vm_posted(njs_vm_t *vm)
 {
-    return njs_posted_events(vm);
+    return njs_posted_events(vm) || vm->preempted;
 }
 
 
@@ -573,10 +1005,24 @@ njs_vm_post_event(njs_vm_t *vm, njs_vm_event_t vm_event,
 nxt_int_t
 njs_vm_run(njs_vm_t *vm)
 {
+    nxt_int_t  ret;
+
     if (nxt_slow_path(vm->backtrace != NULL)) {
         nxt_array_reset(vm->backtrace);
     }
 
+    if (vm->preempted) {
+        vm->preempted = 0;
+
+        ret = njs_vmcode_run(vm, 1);
+
+        if (ret != NJS_STOP) {
+            return ret;
+        }
+
+        njs_gc_check(vm);
+    }
+
     return njs_vm_handle_events(vm);
 }
 
@@ -584,23 +1030,79 @@ njs_vm_run(njs_vm_t *vm)
 nxt_int_t
 njs_vm_start(njs_vm_t *vm)
 {
+    uint8_t    preempt;
     njs_ret_t  ret;
 
-    ret = njs_module_load(vm);
-    if (nxt_slow_path(ret != NXT_OK)) {
-        return ret;
+    if (vm->snapshot) {
+        /* The global code has been run by njs_vm_snapshot(). */
+        return NJS_OK;
     }
 
-    ret = njs_vmcode_interpreter(vm);
+    /* The values allocated by the compiler are not collected. */
 
-    if (ret == NJS_STOP) {
-        ret = NJS_OK;
+    if (vm->options.gc_threshold != 0 && vm->gc == NULL
+        && !vm->options.accumulative)
+    {
+        if (nxt_slow_path(njs_gc_init(vm) != NXT_OK)) {
+            return NJS_ERROR;
+        }
+    }
+
+    /* The modules and the global code are not preempted. */
+
+    preempt = vm->options.preempt;
+    vm->options.preempt = 0;
+
+    ret = njs_module_load(vm);
+
+    if (nxt_fast_path(ret == NXT_OK)) {
+        ret = njs_vmcode_run(vm, 0);
+
+        if (ret == NJS_STOP) {
+            ret = NJS_OK;
+        }
     }
 
+    vm->options.preempt = preempt;
+
+    njs_gc_check(vm);
+
     return ret;
 }
 
 
+nxt_int_t
+njs_vm_snapshot(njs_vm_t *vm)
+{
+    nxt_int_t  ret;
+
+    if (vm->options.accumulative || vm->code == NULL || vm->snapshot) {
+        return NJS_DECLINED;
+    }
+
+    if (vm->top_frame == NULL) {
+        ret = njs_vm_init(vm);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NJS_ERROR;
+        }
+    }
+
+    ret = njs_vm_start(vm);
+    if (ret != NJS_OK) {
+        return NJS_ERROR;
+    }
+
+    if (njs_vm_pending(vm)) {
+        /* The events cannot be restored in clones. */
+        return NJS_DECLINED;
+    }
+
+    vm->snapshot = 1;
+
+    return NJS_OK;
+}
+
+
 static nxt_int_t
 njs_vm_handle_events(njs_vm_t *vm)
 {
@@ -630,7 +1132,7 @@ njs_vm_handle_events(njs_vm_t *vm)
 
         ret = njs_vm_call(vm, ev->function, ev->args, ev->nargs);
 
-        if (ret == NJS_ERROR) {
+        if (ret == NJS_ERROR || ret == NJS_AGAIN) {
             return ret;
         }
     }
@@ -786,7 +1288,9 @@ njs_value_t *
 njs_vm_object_prop(njs_vm_t *vm, const njs_value_t *value, const nxt_str_t *key)
 {
     nxt_int_t           ret;
+    njs_object_t        *object;
     njs_object_prop_t   *prop;
+    njs_object_shape_t  *shape;
     nxt_lvlhsh_query_t  lhq;
 
     if (nxt_slow_path(!njs_is_object(value))) {
@@ -797,7 +1301,18 @@ njs_vm_object_prop(njs_vm_t *vm, const njs_value_t *value, const nxt_str_t *key)
     lhq.key_hash = nxt_djb_hash(lhq.key.start, lhq.key.length);
     lhq.proto = &njs_object_hash_proto;
 
-    ret = nxt_lvlhsh_find(&value->data.u.object->hash, &lhq);
+    object = value->data.u.object;
+
+    if (object->shape != NULL) {
+        shape = njs_object_shape_find(object->shape, &lhq);
+        if (shape == NULL) {
+            return NULL;
+        }
+
+        return &object->slots[shape->count - 1];
+    }
+
+    ret = nxt_lvlhsh_find(&object->hash, &lhq);
     if (nxt_slow_path(ret != NXT_OK)) {
         return NULL;
     }
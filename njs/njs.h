@@ -20,6 +20,7 @@
 #include <nxt_stub.h>
 #include <nxt_array.h>
 #include <nxt_lvlhsh.h>
+#include <nxt_mp.h>
 
 
 typedef intptr_t                    njs_ret_t;
@@ -143,14 +144,95 @@ typedef struct {
     njs_vm_ops_t                    *ops;
     nxt_str_t                       file;
 
+    /* The number of instructions between stack samples, 0 disables. */
+    uint32_t                        sample_interval;
+
+    /*
+     * The execution budget of a single njs_vm_start(), njs_vm_call() or
+     * njs_vm_run() call: the number of loop iterations and function calls,
+     * and the time in milliseconds.  0 is unlimited.
+     */
+    uint32_t                        max_steps;
+    uint32_t                        max_time;
+
+    /*
+     * The number of calls and backward jumps of a function before it is
+     * compiled by the baseline JIT, 0 compiles a function on the first call.
+     */
+    uint32_t                        jit_threshold;
+
+    /*
+     * The garbage collector is run when the memory allocated for objects,
+     * strings and closures exceeds gc_threshold bytes, 0 disables it.
+     * After a collection the limit is raised to gc_pause percents of
+     * the memory left in use, the default is 200, the minimum is 100.
+     * gc_pause is a heap growth factor, not a bound on the collection
+     * time.  The values held by the host outside the VM are not roots,
+     * they must be reachable from the global variables.
+     */
+    uint32_t                        gc_threshold;
+    uint32_t                        gc_pause;
+
+    /*
+     * The limit of the VM memory in bytes, 0 is unlimited.  The allocations
+     * exceeding the limit fail and MemoryError is thrown.
+     */
+    size_t                          max_memory;
+
+    /*
+     * The allocator of the VM memory pool clusters and large allocations
+     * and its context, njs_vm_mp_proto if mem_proto is NULL.  The clones
+     * use the same allocator with the context given to njs_vm_clone_mem(),
+     * so the host can allocate the clone memory from its own pools.
+     */
+    const nxt_mem_proto_t           *mem_proto;
+    void                            *mem;
+
     uint8_t                         trailer;         /* 1 bit */
     uint8_t                         init;            /* 1 bit */
     uint8_t                         accumulative;    /* 1 bit */
     uint8_t                         backtrace;       /* 1 bit */
     uint8_t                         sandbox;         /* 1 bit */
+    uint8_t                         profile;         /* 1 bit */
+    uint8_t                         jit;             /* 1 bit */
+
+    /*
+     * Preempt njs_vm_call() and njs_vm_run() with NJS_AGAIN rather than
+     * throw InternalError if the execution budget is exhausted.
+     */
+    uint8_t                         preempt;         /* 1 bit */
+
+    /*
+     * Disables the clone presizing: by default the clones reserve
+     * the pool and stack memory the previous clones needed.
+     */
+    uint8_t                         no_presize;      /* 1 bit */
 } njs_vm_opt_t;
 
 
+typedef struct {
+    uint64_t                        collections;
+
+    /* The memory in use and freed in total, in bytes. */
+    uint64_t                        size;
+    uint64_t                        freed;
+
+    /* The total and the longest collection time in nanoseconds. */
+    uint64_t                        time;
+    uint64_t                        max_time;
+} njs_vm_gc_stats_t;
+
+
+typedef struct {
+    /* The number of destroyed or reset clones the sizes are learned from. */
+    uint32_t                        samples;
+
+    /* The pool and stack memory reserved by the new clones, in bytes. */
+    size_t                          pool_size;
+    size_t                          stack_size;
+} njs_vm_presize_stats_t;
+
+
 #define NJS_OK                      NXT_OK
 #define NJS_ERROR                   NXT_ERROR
 #define NJS_AGAIN                   NXT_AGAIN
@@ -164,6 +246,85 @@ NXT_EXPORT void njs_vm_destroy(njs_vm_t *vm);
 NXT_EXPORT nxt_int_t njs_vm_compile(njs_vm_t *vm, u_char **start, u_char *end);
 NXT_EXPORT njs_vm_t *njs_vm_clone(njs_vm_t *vm, njs_external_ptr_t external);
 
+/*
+ * Clones the VM with the memory pool allocated by the mem_proto allocator
+ * of the VM options with the mem context instead of the VM one.
+ */
+NXT_EXPORT njs_vm_t *njs_vm_clone_mem(njs_vm_t *vm,
+    njs_external_ptr_t external, void *mem);
+
+/*
+ * Releases the pending events of the VM as njs_vm_destroy() does but
+ * leaves the VM memory to the host, the memory is freed when the host
+ * destroys the allocator context of the VM.
+ */
+NXT_EXPORT void njs_vm_release(njs_vm_t *vm);
+
+/*
+ * Returns a clone to the state just after njs_vm_clone() with the new
+ * external, so a clone can be reused instead of destroyed and cloned again.
+ * The clone memory pool is reset but keeps its memory.  The pending events
+ * are released in the same way as by njs_vm_destroy().
+ *   NJS_OK the clone is reset.
+ *   NJS_DECLINED the VM is not a clone.
+ *   NJS_ERROR memory allocation failed, the clone must be destroyed.
+ */
+NXT_EXPORT nxt_int_t njs_vm_reset(njs_vm_t *vm, njs_external_ptr_t external);
+
+/*
+ * Sets the VM memory limit instead of the max_memory option, for example,
+ * for a particular clone.  The limit of a clone is restored to the option
+ * value by njs_vm_reset().
+ */
+NXT_EXPORT void njs_vm_memory_limit(njs_vm_t *vm, size_t limit);
+
+/*
+ * Reports the VM memory pool statistics: the allocated and peak memory,
+ * the memory in use and the pool clusters, pages and chunks.
+ */
+NXT_EXPORT void njs_vm_memory_stats(njs_vm_t *vm, nxt_mp_stat_t *stats);
+
+/*
+ * Sets the low and high watermarks in bytes of the process-wide cache
+ * of free VM memory pool clusters.  The pools of the VMs created after
+ * the call take their clusters from the cache and return them there on
+ * destruction.  The cache exceeding the high watermark is shrunk to the
+ * low watermark, the zero high watermark disables the cache.
+ */
+NXT_EXPORT nxt_int_t njs_vm_cache_init(size_t low, size_t high);
+
+/*
+ * Reports the process-wide cluster cache statistics: the cached clusters,
+ * the cache hits and misses and the clusters returned and freed.
+ */
+NXT_EXPORT void njs_vm_cache_stats(nxt_mp_cache_stat_t *stats);
+
+/*
+ * Reports the pool and stack sizes reserved by the new clones of the VM
+ * or, for a clone, by the new clones of its parent.
+ */
+NXT_EXPORT void njs_vm_presize_stats(njs_vm_t *vm,
+    njs_vm_presize_stats_t *stats);
+
+/*
+ * Serializes the compiled script to an image allocated from the VM memory
+ * pool.  The image should be created before the VM is run.
+ *   NJS_OK the image is in image.
+ *   NJS_DECLINED the script cannot be serialized: the accumulative mode
+ *     or the modules are used.
+ *   NJS_ERROR memory allocation error or the VM has no compiled script.
+ */
+NXT_EXPORT nxt_int_t njs_vm_image(njs_vm_t *vm, nxt_str_t *image);
+
+/*
+ * Loads the compiled script from an image instead of njs_vm_compile().
+ * The externals referred by the script should be bound to the VM before.
+ * The image memory is not referenced after the load.
+ */
+NXT_EXPORT nxt_int_t njs_vm_compile_from_image(njs_vm_t *vm,
+    const u_char *start, const u_char *end);
+NXT_EXPORT nxt_bool_t njs_vm_is_image(const u_char *start, const u_char *end);
+
 NXT_EXPORT njs_vm_event_t njs_vm_add_event(njs_vm_t *vm,
     njs_function_t *function, nxt_uint_t once, njs_host_event_t host_ev,
     njs_event_destructor_t destructor);
@@ -177,7 +338,8 @@ NXT_EXPORT nxt_int_t njs_vm_post_event(njs_vm_t *vm, njs_vm_event_t vm_event,
 NXT_EXPORT nxt_int_t njs_vm_waiting(njs_vm_t *vm);
 
 /*
- * Returns 1 if posted events are ready to be executed.
+ * Returns 1 if posted events are ready to be executed
+ * or the preempted execution should be resumed.
  */
 NXT_EXPORT nxt_int_t njs_vm_posted(njs_vm_t *vm);
 
@@ -187,6 +349,8 @@ NXT_EXPORT nxt_int_t njs_vm_posted(njs_vm_t *vm);
 /*
  * Runs the specified function with provided arguments.
  *  NJS_OK successful run.
+ *  NJS_AGAIN the execution budget is exhausted in the "preempt" mode,
+ *    njs_vm_run() resumes the execution.
  *  NJS_ERROR some exception or internal error happens.
  *
  *  njs_vm_retval(vm) can be used to get the retval or exception value.
@@ -197,17 +361,24 @@ NXT_EXPORT nxt_int_t njs_vm_invoke(njs_vm_t *vm, njs_function_t *function,
     const njs_value_t *args, nxt_uint_t nargs, njs_index_t retval);
 
 /*
- * Runs posted events.
+ * Runs the specified function like njs_vm_call(), but the execution
+ * is not preempted, the exhausted budget throws InternalError.
+ */
+NXT_EXPORT nxt_int_t njs_vm_call_nonpreemptive(njs_vm_t *vm,
+    njs_function_t *function, const njs_value_t *args, nxt_uint_t nargs);
+
+/*
+ * Resumes the preempted execution and runs posted events.
  *  NJS_OK successfully processed all posted events, no more events.
  *  NJS_AGAIN successfully processed all events, some posted events are
- *    still pending.
+ *    still pending, or the execution is preempted again.
  *  NJS_ERROR some exception or internal error happens.
  *    njs_vm_retval(vm) can be used to get the retval or exception value.
  */
 NXT_EXPORT nxt_int_t njs_vm_run(njs_vm_t *vm);
 
 /*
- * Runs the global code.
+ * Runs the global code, the global code is not preempted.
  *   NJS_OK successful run.
  *   NJS_ERROR some exception or internal error happens.
  *
@@ -215,6 +386,37 @@ NXT_EXPORT nxt_int_t njs_vm_run(njs_vm_t *vm);
  */
 NXT_EXPORT nxt_int_t njs_vm_start(njs_vm_t *vm);
 
+/*
+ * Runs the global code once and keeps the resulting state, so
+ * njs_vm_clone() restores the state in clones and njs_vm_start()
+ * does not run the global code again.  The clones get private copies
+ * of the objects, so their modifications are not visible to each other.
+ *   NJS_OK the snapshot is made.
+ *   NJS_DECLINED the accumulative mode, the VM has no compiled script,
+ *     the snapshot is already made, or the global code has added events.
+ *   NJS_ERROR some exception or internal error happens.
+ *     njs_vm_retval(vm) can be used to get the exception value.
+ */
+NXT_EXPORT nxt_int_t njs_vm_snapshot(njs_vm_t *vm);
+
+/*
+ * Runs the garbage collector.  The values held by the host outside of
+ * the VM are not tracked and should not be used after a collection,
+ * except the retval, the global variables and the events arguments.
+ *   NJS_OK the collection is done.
+ *   NJS_DECLINED the collector is not enabled, the VM is running
+ *     or preempted, or the VM has clones sharing its objects.
+ *   NJS_ERROR memory allocation error.
+ */
+NXT_EXPORT nxt_int_t njs_vm_gc(njs_vm_t *vm);
+
+/*
+ * Gets the garbage collector statistics.
+ *   NJS_OK the statistics is in stats.
+ *   NJS_DECLINED the collector is not enabled.
+ */
+NXT_EXPORT nxt_int_t njs_vm_gc_stats(njs_vm_t *vm, njs_vm_gc_stats_t *stats);
+
 NXT_EXPORT nxt_int_t njs_vm_add_path(njs_vm_t *vm, const nxt_str_t *path);
 
 NXT_EXPORT const njs_extern_t *njs_vm_external_prototype(njs_vm_t *vm,
@@ -227,6 +429,24 @@ NXT_EXPORT njs_external_ptr_t njs_vm_external(njs_vm_t *vm,
     const njs_value_t *value);
 
 NXT_EXPORT void njs_disassembler(njs_vm_t *vm);
+
+/*
+ * Prints the profile collected in the "profile" mode.
+ *   NJS_OK the profile is in retval.
+ *   NJS_DECLINED the profiler is not enabled.
+ *   NJS_ERROR memory allocation error.
+ */
+NXT_EXPORT nxt_int_t njs_vm_profile_dump(njs_vm_t *vm, nxt_str_t *retval);
+
+/*
+ * Prints the stacks sampled with the "sample_interval" option in the folded
+ * format: a line per stack with function names separated by semicolons
+ * from the outermost function, followed by the number of samples.
+ *   NJS_OK the stacks are in retval.
+ *   NJS_DECLINED the sampling is not enabled.
+ *   NJS_ERROR memory allocation error.
+ */
+NXT_EXPORT nxt_int_t njs_vm_profile_stacks(njs_vm_t *vm, nxt_str_t *retval);
 NXT_EXPORT nxt_array_t *njs_vm_completions(njs_vm_t *vm, nxt_str_t *expression);
 
 NXT_EXPORT const njs_value_t *njs_vm_value(njs_vm_t *vm, const nxt_str_t *name);
@@ -150,6 +150,7 @@ njs_array_alloc(njs_vm_t *vm, uint32_t length, uint32_t spare)
     array->start = array->data;
     nxt_lvlhsh_init(&array->object.hash);
     nxt_lvlhsh_init(&array->object.shared_hash);
+    array->object.shape = NULL;
     array->object.__proto__ = &vm->prototypes[NJS_PROTOTYPE_ARRAY].object;
     array->object.type = NJS_ARRAY;
     array->object.shared = 0;
@@ -157,6 +158,9 @@ njs_array_alloc(njs_vm_t *vm, uint32_t length, uint32_t spare)
     array->size = size;
     array->length = length;
 
+    njs_gc_register(vm, array, NJS_GC_OBJECT,
+                    sizeof(njs_array_t) + size * sizeof(njs_value_t));
+
     return array;
 
 memory_error:
@@ -899,7 +903,7 @@ static njs_ret_t
 njs_array_prototype_to_string(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
     njs_index_t retval)
 {
-    njs_object_prop_t   *prop;
+    njs_object_prop_t   *prop, scratch;
     njs_continuation_t  *cont;
     nxt_lvlhsh_query_t  lhq;
 
@@ -910,7 +914,8 @@ njs_array_prototype_to_string(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
         lhq.key_hash = NJS_JOIN_HASH;
         lhq.key = nxt_string_value("join");
 
-        prop = njs_object_property(vm, args[0].data.u.object, &lhq);
+        prop = njs_object_property(vm, args[0].data.u.object, &lhq,
+                                   &scratch);
 
         if (nxt_fast_path(prop != NULL && njs_is_function(&prop->value))) {
             return njs_function_apply(vm, prop->value.data.u.function,
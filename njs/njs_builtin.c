@@ -773,7 +773,7 @@ njs_vm_expression_completions(njs_vm_t *vm, nxt_str_t *expression)
     nxt_int_t           ret;
     njs_value_t         *value;
     njs_variable_t      *var;
-    njs_object_prop_t   *prop;
+    njs_object_prop_t   *prop, scratch;
     nxt_lvlhsh_query_t  lhq;
 
     if (nxt_slow_path(vm->parser == NULL)) {
@@ -818,7 +818,7 @@ njs_vm_expression_completions(njs_vm_t *vm, nxt_str_t *expression)
         lhq.key.length = p - lhq.key.start;
         lhq.key_hash = nxt_djb_hash(lhq.key.start, lhq.key.length);
 
-        ret = nxt_lvlhsh_find(&value->data.u.object->hash, &lhq);
+        ret = njs_object_hash_find(value->data.u.object, &lhq, &scratch);
         if (nxt_slow_path(ret != NXT_OK)) {
             return NULL;
         }
@@ -846,15 +846,16 @@ njs_object_completions(njs_vm_t *vm, njs_object_t *object)
     njs_object_t       *o;
     njs_object_prop_t  *prop;
     nxt_lvlhsh_each_t  lhe;
+    njs_object_each_t  each;
 
     size = 0;
     o = object;
 
     do {
-        nxt_lvlhsh_each_init(&lhe, &njs_object_hash_proto);
+        njs_object_each_init(&each);
 
         for ( ;; ) {
-            prop = nxt_lvlhsh_each(&o->hash, &lhe);
+            prop = njs_object_each(o, &each);
             if (prop == NULL) {
                 break;
             }
@@ -889,10 +890,10 @@ njs_object_completions(njs_vm_t *vm, njs_object_t *object)
     compl = completions->start;
 
     do {
-        nxt_lvlhsh_each_init(&lhe, &njs_object_hash_proto);
+        njs_object_each_init(&each);
 
         for ( ;; ) {
-            prop = nxt_lvlhsh_each(&o->hash, &lhe);
+            prop = njs_object_each(o, &each);
             if (prop == NULL) {
                 break;
             }
@@ -1065,6 +1066,212 @@ njs_dump_value(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
 }
 
 
+static njs_ret_t
+njs_memory_usage_prop(njs_vm_t *vm, njs_object_t *object,
+    const njs_value_t *name, const njs_value_t *value)
+{
+    nxt_int_t           ret;
+    njs_object_prop_t   *prop;
+    nxt_lvlhsh_query_t  lhq;
+
+    prop = njs_object_prop_alloc(vm, name, value, 1);
+    if (nxt_slow_path(prop == NULL)) {
+        return NXT_ERROR;
+    }
+
+    njs_string_get(name, &lhq.key);
+    lhq.key_hash = nxt_djb_hash(lhq.key.start, lhq.key.length);
+    lhq.replace = 0;
+    lhq.value = prop;
+    lhq.pool = vm->mem_pool;
+    lhq.proto = &njs_object_hash_proto;
+
+    ret = nxt_lvlhsh_insert(&object->hash, &lhq);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        njs_internal_error(vm, "lvlhsh insert failed");
+        return NXT_ERROR;
+    }
+
+    return NXT_OK;
+}
+
+
+/*
+ * njs.memoryUsage() returns the VM memory pool statistics, the "chunks"
+ * object contains the numbers of allocated chunks by chunk size, the
+ * "cache" object contains the process-wide cluster cache statistics and
+ * the "presize" object contains the memory reserved by the new clones.
+ */
+
+static njs_ret_t
+njs_memory_usage(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
+    njs_index_t unused)
+{
+    u_char                  *p;
+    u_char                  buf[NXT_INT_T_LEN];
+    double                  num[8];
+    njs_ret_t               ret;
+    nxt_uint_t              i;
+    njs_value_t             name, value;
+    njs_object_t            *usage, *chunks, *cache, *presize;
+    nxt_mp_stat_t           stat;
+    nxt_mp_cache_stat_t     cache_stat;
+    njs_vm_presize_stats_t  presize_stat;
+
+    static const njs_value_t  names[] = {
+        njs_string("size"),
+        njs_string("peak"),
+        njs_string("used"),
+        njs_string("clusters"),
+        njs_string("pages"),
+        njs_string("freePages"),
+        njs_string("large"),
+        njs_string("largeSize"),
+    };
+
+    static const njs_value_t  cache_names[] = {
+        njs_string("size"),
+        njs_string("clusters"),
+        njs_string("hits"),
+        njs_string("misses"),
+        njs_string("returns"),
+        njs_string("frees"),
+    };
+
+    static const njs_value_t  presize_names[] = {
+        njs_string("samples"),
+        njs_string("poolSize"),
+        njs_string("stackSize"),
+    };
+
+    static const njs_value_t  chunks_name = njs_string("chunks");
+    static const njs_value_t  cache_name = njs_string("cache");
+    static const njs_value_t  presize_name = njs_string("presize");
+
+    nxt_mp_stat(vm->mem_pool, &stat);
+
+    num[0] = stat.size;
+    num[1] = stat.peak;
+    num[2] = stat.used;
+    num[3] = stat.clusters;
+    num[4] = stat.pages;
+    num[5] = stat.free_pages;
+    num[6] = stat.large;
+    num[7] = stat.large_size;
+
+    usage = njs_object_alloc(vm);
+    if (nxt_slow_path(usage == NULL)) {
+        return NXT_ERROR;
+    }
+
+    for (i = 0; i < nxt_nitems(names); i++) {
+        njs_value_number_set(&value, num[i]);
+
+        ret = njs_memory_usage_prop(vm, usage, &names[i], &value);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
+        }
+    }
+
+    chunks = njs_object_alloc(vm);
+    if (nxt_slow_path(chunks == NULL)) {
+        return NXT_ERROR;
+    }
+
+    for (i = 0; i < NXT_MP_CHUNK_SIZES && stat.chunk_size[i] != 0; i++) {
+        p = nxt_sprintf(buf, buf + sizeof(buf), "%uD", stat.chunk_size[i]);
+
+        ret = njs_string_new(vm, &name, buf, p - buf, p - buf);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
+        }
+
+        njs_value_number_set(&value, stat.chunks[i]);
+
+        ret = njs_memory_usage_prop(vm, chunks, &name, &value);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
+        }
+    }
+
+    value.data.u.object = chunks;
+    value.type = NJS_OBJECT;
+    value.data.truth = 1;
+
+    ret = njs_memory_usage_prop(vm, usage, &chunks_name, &value);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    njs_vm_cache_stats(&cache_stat);
+
+    num[0] = cache_stat.size;
+    num[1] = cache_stat.clusters;
+    num[2] = cache_stat.hits;
+    num[3] = cache_stat.misses;
+    num[4] = cache_stat.returns;
+    num[5] = cache_stat.frees;
+
+    cache = njs_object_alloc(vm);
+    if (nxt_slow_path(cache == NULL)) {
+        return NXT_ERROR;
+    }
+
+    for (i = 0; i < nxt_nitems(cache_names); i++) {
+        njs_value_number_set(&value, num[i]);
+
+        ret = njs_memory_usage_prop(vm, cache, &cache_names[i], &value);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
+        }
+    }
+
+    value.data.u.object = cache;
+    value.type = NJS_OBJECT;
+    value.data.truth = 1;
+
+    ret = njs_memory_usage_prop(vm, usage, &cache_name, &value);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    njs_vm_presize_stats(vm, &presize_stat);
+
+    num[0] = presize_stat.samples;
+    num[1] = presize_stat.pool_size;
+    num[2] = presize_stat.stack_size;
+
+    presize = njs_object_alloc(vm);
+    if (nxt_slow_path(presize == NULL)) {
+        return NXT_ERROR;
+    }
+
+    for (i = 0; i < nxt_nitems(presize_names); i++) {
+        njs_value_number_set(&value, num[i]);
+
+        ret = njs_memory_usage_prop(vm, presize, &presize_names[i], &value);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
+        }
+    }
+
+    value.data.u.object = presize;
+    value.type = NJS_OBJECT;
+    value.data.truth = 1;
+
+    ret = njs_memory_usage_prop(vm, usage, &presize_name, &value);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    vm->retval.data.u.object = usage;
+    vm->retval.type = NJS_OBJECT;
+    vm->retval.data.truth = 1;
+
+    return NXT_OK;
+}
+
+
 static const njs_object_prop_t  njs_njs_object_properties[] =
 {
     {
@@ -1079,6 +1286,12 @@ static const njs_object_prop_t  njs_njs_object_properties[] =
         .value = njs_native_function(njs_dump_value, 0,
                                     NJS_SKIP_ARG, NJS_SKIP_ARG, NJS_NUMBER_ARG),
     },
+
+    {
+        .type = NJS_METHOD,
+        .name = njs_string("memoryUsage"),
+        .value = njs_native_function(njs_memory_usage, 0, 0),
+    },
 };
 
 
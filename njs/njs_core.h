@@ -43,6 +43,12 @@
 #include <njs_string.h>
 #include <njs_object.h>
 #include <njs_object_hash.h>
+#include <njs_shape.h>
+#include <njs_profile.h>
+#include <njs_jit.h>
+#include <njs_image.h>
+#include <njs_snapshot.h>
+#include <njs_gc.h>
 #include <njs_array.h>
 #include <njs_error.h>
 
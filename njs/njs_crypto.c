@@ -136,6 +136,7 @@ njs_crypto_object_value_alloc(njs_vm_t *vm, nxt_uint_t proto)
     if (nxt_fast_path(ov != NULL)) {
         nxt_lvlhsh_init(&ov->object.hash);
         nxt_lvlhsh_init(&ov->object.shared_hash);
+        ov->object.shape = NULL;
         ov->object.type = NJS_OBJECT_VALUE;
         ov->object.shared = 0;
         ov->object.extensible = 1;
@@ -134,6 +134,7 @@ njs_date_constructor(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
 
         nxt_lvlhsh_init(&date->object.hash);
         nxt_lvlhsh_init(&date->object.shared_hash);
+        date->object.shape = NULL;
         date->object.type = NJS_DATE;
         date->object.shared = 0;
         date->object.extensible = 1;
@@ -141,6 +142,8 @@ njs_date_constructor(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
 
         date->time = time;
 
+        njs_gc_register(vm, date, NJS_GC_OBJECT, sizeof(njs_date_t));
+
         vm->retval.data.u.date = date;
         vm->retval.type = NJS_DATE;
         vm->retval.data.truth = 1;
@@ -1877,7 +1880,7 @@ static njs_ret_t
 njs_date_prototype_to_json(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
     njs_index_t retval)
 {
-    njs_object_prop_t   *prop;
+    njs_object_prop_t   *prop, scratch;
     njs_continuation_t  *cont;
     nxt_lvlhsh_query_t  lhq;
 
@@ -1888,7 +1891,8 @@ njs_date_prototype_to_json(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
         lhq.key_hash = NJS_TO_ISO_STRING_HASH;
         lhq.key = nxt_string_value("toISOString");
 
-        prop = njs_object_property(vm, args[0].data.u.object, &lhq);
+        prop = njs_object_property(vm, args[0].data.u.object, &lhq,
+                                   &scratch);
 
         if (nxt_fast_path(prop != NULL && njs_is_function(&prop->value))) {
             return njs_function_apply(vm, prop->value.data.u.function,
@@ -7,7 +7,8 @@
 #include <njs_core.h>
 
 
-static void njs_disassemble(u_char *start, u_char *end);
+static void njs_disassemble(njs_vm_t *vm, u_char *start, u_char *end);
+static void njs_disassemble_prop_cache(njs_vm_t *vm, njs_index_t index);
 
 
 typedef struct {
@@ -30,10 +31,6 @@ static njs_code_name_t  code_names[] = {
     { njs_vmcode_object_copy, sizeof(njs_vmcode_object_copy_t),
           nxt_string("OBJECT COPY     ") },
 
-    { njs_vmcode_property_get, sizeof(njs_vmcode_prop_get_t),
-          nxt_string("PROPERTY GET    ") },
-    { njs_vmcode_property_set, sizeof(njs_vmcode_prop_set_t),
-          nxt_string("PROPERTY SET    ") },
     { njs_vmcode_property_in, sizeof(njs_vmcode_3addr_t),
           nxt_string("PROPERTY IN     ") },
     { njs_vmcode_property_delete, sizeof(njs_vmcode_3addr_t),
@@ -128,6 +125,137 @@ static njs_code_name_t  code_names[] = {
 };
 
 
+static njs_code_name_t  jump_names[] = {
+
+    { njs_vmcode_if_equal_jump, sizeof(njs_vmcode_equal_jump_t),
+          nxt_string("JUMP IF EQUAL     ") },
+    { njs_vmcode_if_not_equal_jump, sizeof(njs_vmcode_equal_jump_t),
+          nxt_string("JUMP IF NOT EQUAL ") },
+    { njs_vmcode_if_less_jump, sizeof(njs_vmcode_equal_jump_t),
+          nxt_string("JUMP IF LT        ") },
+    { njs_vmcode_if_not_less_jump, sizeof(njs_vmcode_equal_jump_t),
+          nxt_string("JUMP IF NOT LT    ") },
+    { njs_vmcode_if_greater_jump, sizeof(njs_vmcode_equal_jump_t),
+          nxt_string("JUMP IF GT        ") },
+    { njs_vmcode_if_not_greater_jump, sizeof(njs_vmcode_equal_jump_t),
+          nxt_string("JUMP IF NOT GT    ") },
+    { njs_vmcode_if_less_or_equal_jump, sizeof(njs_vmcode_equal_jump_t),
+          nxt_string("JUMP IF LE        ") },
+    { njs_vmcode_if_not_less_or_equal_jump, sizeof(njs_vmcode_equal_jump_t),
+          nxt_string("JUMP IF NOT LE    ") },
+    { njs_vmcode_if_greater_or_equal_jump, sizeof(njs_vmcode_equal_jump_t),
+          nxt_string("JUMP IF GE        ") },
+    { njs_vmcode_if_not_greater_or_equal_jump,
+          sizeof(njs_vmcode_equal_jump_t),
+          nxt_string("JUMP IF NOT GE    ") },
+
+};
+
+
+/* The instructions printed without the tables above. */
+
+static njs_code_name_t  other_names[] = {
+
+    { njs_vmcode_array, sizeof(njs_vmcode_array_t),
+          nxt_string("ARRAY           ") },
+    { njs_vmcode_if_true_jump, sizeof(njs_vmcode_cond_jump_t),
+          nxt_string("JUMP IF TRUE    ") },
+    { njs_vmcode_if_false_jump, sizeof(njs_vmcode_cond_jump_t),
+          nxt_string("JUMP IF FALSE   ") },
+    { njs_vmcode_jump, sizeof(njs_vmcode_jump_t),
+          nxt_string("JUMP            ") },
+    { njs_vmcode_typeof_equal, sizeof(njs_vmcode_typeof_equal_t),
+          nxt_string("TYPEOF EQUAL    ") },
+    { njs_vmcode_test_if_true, sizeof(njs_vmcode_test_jump_t),
+          nxt_string("TEST IF TRUE    ") },
+    { njs_vmcode_test_if_false, sizeof(njs_vmcode_test_jump_t),
+          nxt_string("TEST IF FALSE   ") },
+    { njs_vmcode_function_frame, sizeof(njs_vmcode_function_frame_t),
+          nxt_string("FUNCTION FRAME  ") },
+    { njs_vmcode_property_get, sizeof(njs_vmcode_prop_get_t),
+          nxt_string("PROPERTY GET    ") },
+    { njs_vmcode_property_set, sizeof(njs_vmcode_prop_set_t),
+          nxt_string("PROPERTY SET    ") },
+    { njs_vmcode_method_frame, sizeof(njs_vmcode_method_frame_t),
+          nxt_string("METHOD FRAME    ") },
+    { njs_vmcode_property_foreach, sizeof(njs_vmcode_prop_foreach_t),
+          nxt_string("PROPERTY FOREACH") },
+    { njs_vmcode_property_next, sizeof(njs_vmcode_prop_next_t),
+          nxt_string("PROPERTY NEXT   ") },
+    { njs_vmcode_try_start, sizeof(njs_vmcode_try_start_t),
+          nxt_string("TRY START       ") },
+    { njs_vmcode_try_break, sizeof(njs_vmcode_try_trampoline_t),
+          nxt_string("TRY BREAK       ") },
+    { njs_vmcode_try_continue, sizeof(njs_vmcode_try_trampoline_t),
+          nxt_string("TRY CONTINUE    ") },
+    { njs_vmcode_try_return, sizeof(njs_vmcode_try_return_t),
+          nxt_string("TRY RETURN      ") },
+    { njs_vmcode_catch, sizeof(njs_vmcode_catch_t),
+          nxt_string("CATCH           ") },
+    { njs_vmcode_try_end, sizeof(njs_vmcode_try_end_t),
+          nxt_string("TRY END         ") },
+    { njs_vmcode_finally, sizeof(njs_vmcode_finally_t),
+          nxt_string("TRY FINALLY     ") },
+
+};
+
+
+const nxt_str_t *
+njs_vmcode_name(njs_vmcode_operation_t operation)
+{
+    nxt_uint_t  n;
+
+    static const nxt_str_t  unknown = nxt_string("UNKNOWN         ");
+
+    for (n = 0; n < nxt_nitems(code_names); n++) {
+        if (operation == code_names[n].operation) {
+            return &code_names[n].name;
+        }
+    }
+
+    for (n = 0; n < nxt_nitems(jump_names); n++) {
+        if (operation == jump_names[n].operation) {
+            return &jump_names[n].name;
+        }
+    }
+
+    for (n = 0; n < nxt_nitems(other_names); n++) {
+        if (operation == other_names[n].operation) {
+            return &other_names[n].name;
+        }
+    }
+
+    return &unknown;
+}
+
+
+size_t
+njs_vmcode_size(njs_vmcode_operation_t operation)
+{
+    nxt_uint_t  n;
+
+    for (n = 0; n < nxt_nitems(code_names); n++) {
+        if (operation == code_names[n].operation) {
+            return code_names[n].size;
+        }
+    }
+
+    for (n = 0; n < nxt_nitems(jump_names); n++) {
+        if (operation == jump_names[n].operation) {
+            return jump_names[n].size;
+        }
+    }
+
+    for (n = 0; n < nxt_nitems(other_names); n++) {
+        if (operation == other_names[n].operation) {
+            return other_names[n].size;
+        }
+    }
+
+    return 0;
+}
+
+
 void
 njs_disassembler(njs_vm_t *vm)
 {
@@ -139,7 +267,7 @@ njs_disassembler(njs_vm_t *vm)
 
     while (n != 0) {
         nxt_printf("%V:%V\n", &code->file, &code->name);
-        njs_disassemble(code->start, code->end);
+        njs_disassemble(vm, code->start, code->end);
         code++;
         n--;
     }
@@ -147,7 +275,7 @@ njs_disassembler(njs_vm_t *vm)
 
 
 static void
-njs_disassemble(u_char *start, u_char *end)
+njs_disassemble(njs_vm_t *vm, u_char *start, u_char *end)
 {
     u_char                       *p;
     nxt_str_t                    *name;
@@ -160,6 +288,8 @@ njs_disassemble(u_char *start, u_char *end)
     njs_vmcode_3addr_t           *code3;
     njs_vmcode_array_t           *array;
     njs_vmcode_catch_t           *catch;
+    njs_vmcode_prop_get_t        *prop_get;
+    njs_vmcode_prop_set_t        *prop_set;
     njs_vmcode_finally_t         *finally;
     njs_vmcode_try_end_t         *try_end;
     njs_vmcode_try_start_t       *try_start;
@@ -169,6 +299,7 @@ njs_disassemble(u_char *start, u_char *end)
     njs_vmcode_prop_next_t       *prop_next;
     njs_vmcode_try_return_t      *try_return;
     njs_vmcode_equal_jump_t      *equal;
+    njs_vmcode_typeof_equal_t    *typeof_equal;
     njs_vmcode_prop_foreach_t    *prop_foreach;
     njs_vmcode_method_frame_t    *method;
     njs_vmcode_try_trampoline_t  *try_tramp;
@@ -185,6 +316,11 @@ njs_disassemble(u_char *start, u_char *end)
     while (p < end) {
         operation = *(njs_vmcode_operation_t *) p;
 
+        if (vm->profile != NULL) {
+            /* The instruction is prefixed with its execution count. */
+            nxt_printf("%12uL ", njs_profile_code_count(vm, p));
+        }
+
         if (operation == njs_vmcode_array) {
             array = (njs_vmcode_array_t *) p;
 
@@ -201,9 +337,9 @@ njs_disassemble(u_char *start, u_char *end)
             cond_jump = (njs_vmcode_cond_jump_t *) p;
             sign = (cond_jump->offset >= 0) ? "+" : "";
 
-            nxt_printf("%05uz JUMP IF TRUE      %04Xz %s%uz\n",
+            nxt_printf("%05uz JUMP IF TRUE      %04Xz %s%z\n",
                        p - start, (size_t) cond_jump->cond, sign,
-                       (size_t) cond_jump->offset);
+                       (ssize_t) cond_jump->offset);
 
             p += sizeof(njs_vmcode_cond_jump_t);
 
@@ -214,9 +350,9 @@ njs_disassemble(u_char *start, u_char *end)
             cond_jump = (njs_vmcode_cond_jump_t *) p;
             sign = (cond_jump->offset >= 0) ? "+" : "";
 
-            nxt_printf("%05uz JUMP IF FALSE     %04Xz %s%uz\n",
+            nxt_printf("%05uz JUMP IF FALSE     %04Xz %s%z\n",
                        p - start, (size_t) cond_jump->cond, sign,
-                       (size_t) cond_jump->offset);
+                       (ssize_t) cond_jump->offset);
 
             p += sizeof(njs_vmcode_cond_jump_t);
 
@@ -227,20 +363,44 @@ njs_disassemble(u_char *start, u_char *end)
             jump = (njs_vmcode_jump_t *) p;
             sign = (jump->offset >= 0) ? "+" : "";
 
-            nxt_printf("%05uz JUMP              %s%uz\n",
-                       p - start, sign, (size_t) jump->offset);
+            nxt_printf("%05uz JUMP              %s%z\n",
+                       p - start, sign, (ssize_t) jump->offset);
 
             p += sizeof(njs_vmcode_jump_t);
 
             continue;
         }
 
-        if (operation == njs_vmcode_if_equal_jump) {
+        if (operation == njs_vmcode_typeof_equal) {
+            typeof_equal = (njs_vmcode_typeof_equal_t *) p;
+
+            nxt_printf("%05uz %s%04Xz %04Xz %s\n",
+                       p - start, typeof_equal->negative
+                                  ? "TYPEOF NOT EQUAL  "
+                                  : "TYPEOF EQUAL      ",
+                       (size_t) typeof_equal->retval,
+                       (size_t) typeof_equal->value,
+                       njs_type_string(typeof_equal->type));
+
+            p += sizeof(njs_vmcode_typeof_equal_t);
+
+            continue;
+        }
+
+        for (n = 0; n < nxt_nitems(jump_names); n++) {
+            if (operation == jump_names[n].operation) {
+                break;
+            }
+        }
+
+        if (n < nxt_nitems(jump_names)) {
             equal = (njs_vmcode_equal_jump_t *) p;
+            sign = (equal->offset >= 0) ? "+" : "";
 
-            nxt_printf("%05uz JUMP IF EQUAL     %04Xz %04Xz +%uz\n",
-                       p - start, (size_t) equal->value1,
-                       (size_t) equal->value2, (size_t) equal->offset);
+            nxt_printf("%05uz %V%04Xz %04Xz %s%z\n",
+                       p - start, &jump_names[n].name,
+                       (size_t) equal->value1, (size_t) equal->value2,
+                       sign, (ssize_t) equal->offset);
 
             p += sizeof(njs_vmcode_equal_jump_t);
 
@@ -283,14 +443,44 @@ njs_disassemble(u_char *start, u_char *end)
             continue;
         }
 
+        if (operation == njs_vmcode_property_get) {
+            prop_get = (njs_vmcode_prop_get_t *) p;
+
+            nxt_printf("%05uz PROPERTY GET      %04Xz %04Xz %04Xz",
+                       p - start, (size_t) prop_get->value,
+                       (size_t) prop_get->object, (size_t) prop_get->property);
+
+            njs_disassemble_prop_cache(vm, prop_get->cache);
+
+            p += sizeof(njs_vmcode_prop_get_t);
+
+            continue;
+        }
+
+        if (operation == njs_vmcode_property_set) {
+            prop_set = (njs_vmcode_prop_set_t *) p;
+
+            nxt_printf("%05uz PROPERTY SET      %04Xz %04Xz %04Xz",
+                       p - start, (size_t) prop_set->value,
+                       (size_t) prop_set->object, (size_t) prop_set->property);
+
+            njs_disassemble_prop_cache(vm, prop_set->cache);
+
+            p += sizeof(njs_vmcode_prop_set_t);
+
+            continue;
+        }
+
         if (operation == njs_vmcode_method_frame) {
             method = (njs_vmcode_method_frame_t *) p;
 
-            nxt_printf("%05uz METHOD FRAME      %04Xz %04Xz %uz%s\n",
+            nxt_printf("%05uz METHOD FRAME      %04Xz %04Xz %uz%s",
                        p - start, (size_t) method->object,
                        (size_t) method->method, method->nargs,
                        method->code.ctor ? " CTOR" : "");
 
+            njs_disassemble_prop_cache(vm, method->cache);
+
 
             p += sizeof(njs_vmcode_method_frame_t);
             continue;
@@ -459,3 +649,26 @@ njs_disassemble(u_char *start, u_char *end)
         continue;
     }
 }
+
+
+/*
+ * The property cache slot is followed by the number of cache hits
+ * and misses, so the disassembler called after the code has been run
+ * shows effectiveness of the caches.
+ */
+
+static void
+njs_disassemble_prop_cache(njs_vm_t *vm, njs_index_t index)
+{
+    njs_prop_cache_t  *cache;
+
+    if (index == 0 || index >= vm->prop_cache_size) {
+        nxt_printf("\n");
+        return;
+    }
+
+    cache = &vm->prop_cache[index];
+
+    nxt_printf(" CACHE %uz %uD/%uD\n", (size_t) index, cache->hits,
+               cache->misses);
+}
@@ -71,11 +71,14 @@ njs_error_alloc(njs_vm_t *vm, njs_value_type_t type, const njs_value_t *name,
 
     nxt_lvlhsh_init(&error->hash);
     nxt_lvlhsh_init(&error->shared_hash);
+    error->shape = NULL;
     error->type = type;
     error->shared = 0;
     error->extensible = 1;
     error->__proto__ = &vm->prototypes[njs_error_prototype_index(type)].object;
 
+    njs_gc_register(vm, error, NJS_GC_OBJECT, sizeof(njs_object_t));
+
     lhq.replace = 0;
     lhq.pool = vm->mem_pool;
 
@@ -487,6 +490,7 @@ njs_memory_error_set(njs_vm_t *vm, njs_value_t *value)
 
     nxt_lvlhsh_init(&object->hash);
     nxt_lvlhsh_init(&object->shared_hash);
+    object->shape = NULL;
     object->__proto__ = &prototypes[NJS_PROTOTYPE_INTERNAL_ERROR].object;
     object->type = NJS_OBJECT_INTERNAL_ERROR;
     object->shared = 1;
@@ -608,7 +612,7 @@ njs_error_to_string(njs_vm_t *vm, njs_value_t *retval, const njs_value_t *error)
     u_char              *p;
     nxt_str_t           name, message;
     const njs_value_t   *name_value, *message_value;
-    njs_object_prop_t   *prop;
+    njs_object_prop_t   *prop, scratch;
     nxt_lvlhsh_query_t  lhq;
 
     static const njs_value_t  default_name = njs_string("Error");
@@ -617,7 +621,7 @@ njs_error_to_string(njs_vm_t *vm, njs_value_t *retval, const njs_value_t *error)
     lhq.key = nxt_string_value("name");
     lhq.proto = &njs_object_hash_proto;
 
-    prop = njs_object_property(vm, error->data.u.object, &lhq);
+    prop = njs_object_property(vm, error->data.u.object, &lhq, &scratch);
 
     if (prop != NULL) {
         name_value = &prop->value;
@@ -631,7 +635,7 @@ njs_error_to_string(njs_vm_t *vm, njs_value_t *retval, const njs_value_t *error)
     lhq.key_hash = NJS_MESSAGE_HASH;
     lhq.key = nxt_string_value("message");
 
-    prop = njs_object_property(vm, error->data.u.object, &lhq);
+    prop = njs_object_property(vm, error->data.u.object, &lhq, &scratch);
 
     if (prop != NULL) {
         message_value = &prop->value;
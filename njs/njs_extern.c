@@ -173,12 +173,33 @@ nxt_int_t
 njs_vm_external_create(njs_vm_t *vm, njs_value_t *ext_val,
     const njs_extern_t *proto, njs_external_ptr_t object)
 {
-    void  *obj;
+    void         *obj;
+    uint32_t     items;
+    nxt_array_t  *externals;
 
     if (nxt_slow_path(proto == NULL)) {
         return NXT_ERROR;
     }
 
+    if (vm->externals_shared) {
+        items = vm->external_objects->items;
+
+        externals = nxt_array_create(items + 4, sizeof(void *),
+                                     &njs_array_mem_proto, vm->mem_pool);
+        if (nxt_slow_path(externals == NULL)) {
+            return NXT_ERROR;
+        }
+
+        if (items > 0) {
+            memcpy(externals->start, vm->external_objects->start,
+                   items * sizeof(void *));
+            externals->items = items;
+        }
+
+        vm->external_objects = externals;
+        vm->externals_shared = 0;
+    }
+
     obj = nxt_array_add(vm->external_objects, &njs_array_mem_proto,
                         vm->mem_pool);
     if (nxt_slow_path(obj == NULL)) {
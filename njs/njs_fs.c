@@ -94,7 +94,7 @@ njs_fs_read_file(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
     struct stat         sb;
     njs_value_t         *callback, arguments[3];
     njs_fs_cont_t       *cont;
-    njs_object_prop_t   *prop;
+    njs_object_prop_t   *prop, scratch;
     nxt_lvlhsh_query_t  lhq;
 
     if (nxt_slow_path(nargs < 3)) {
@@ -120,7 +120,8 @@ njs_fs_read_file(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
             lhq.key = nxt_string_value("flag");
             lhq.proto = &njs_object_hash_proto;
 
-            ret = nxt_lvlhsh_find(&args[2].data.u.object->hash, &lhq);
+            ret = njs_object_hash_find(args[2].data.u.object, &lhq,
+                                       &scratch);
             if (ret == NXT_OK) {
                 prop = lhq.value;
                 njs_string_get(&prop->value, &flag);
@@ -130,7 +131,8 @@ njs_fs_read_file(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
             lhq.key = nxt_string_value("encoding");
             lhq.proto = &njs_object_hash_proto;
 
-            ret = nxt_lvlhsh_find(&args[2].data.u.object->hash, &lhq);
+            ret = njs_object_hash_find(args[2].data.u.object, &lhq,
+                                       &scratch);
             if (ret == NXT_OK) {
                 prop = lhq.value;
                 njs_string_get(&prop->value, &encoding);
@@ -313,7 +315,7 @@ njs_fs_read_file_sync(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
     njs_ret_t           ret;
     const char          *path, *syscall, *description;
     struct stat         sb;
-    njs_object_prop_t   *prop;
+    njs_object_prop_t   *prop, scratch;
     nxt_lvlhsh_query_t  lhq;
 
     if (nxt_slow_path(nargs < 2)) {
@@ -339,7 +341,8 @@ njs_fs_read_file_sync(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
             lhq.key = nxt_string_value("flag");
             lhq.proto = &njs_object_hash_proto;
 
-            ret = nxt_lvlhsh_find(&args[2].data.u.object->hash, &lhq);
+            ret = njs_object_hash_find(args[2].data.u.object, &lhq,
+                                       &scratch);
             if (ret == NXT_OK) {
                 prop = lhq.value;
                 njs_string_get(&prop->value, &flag);
@@ -349,7 +352,8 @@ njs_fs_read_file_sync(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
             lhq.key = nxt_string_value("encoding");
             lhq.proto = &njs_object_hash_proto;
 
-            ret = nxt_lvlhsh_find(&args[2].data.u.object->hash, &lhq);
+            ret = njs_object_hash_find(args[2].data.u.object, &lhq,
+                                       &scratch);
             if (ret == NXT_OK) {
                 prop = lhq.value;
                 njs_string_get(&prop->value, &encoding);
@@ -539,7 +543,7 @@ static njs_ret_t njs_fs_write_file_internal(njs_vm_t *vm, njs_value_t *args,
     const char          *path, *syscall, *description;
     njs_value_t         *callback, *mode, arguments[2];
     njs_fs_cont_t       *cont;
-    njs_object_prop_t   *prop;
+    njs_object_prop_t   *prop, scratch;
     nxt_lvlhsh_query_t  lhq;
 
     if (nxt_slow_path(nargs < 4)) {
@@ -573,7 +577,8 @@ static njs_ret_t njs_fs_write_file_internal(njs_vm_t *vm, njs_value_t *args,
             lhq.key = nxt_string_value("flag");
             lhq.proto = &njs_object_hash_proto;
 
-            ret = nxt_lvlhsh_find(&args[3].data.u.object->hash, &lhq);
+            ret = njs_object_hash_find(args[3].data.u.object, &lhq,
+                                       &scratch);
             if (ret == NXT_OK) {
                 prop = lhq.value;
                 njs_string_get(&prop->value, &flag);
@@ -583,7 +588,8 @@ static njs_ret_t njs_fs_write_file_internal(njs_vm_t *vm, njs_value_t *args,
             lhq.key = nxt_string_value("encoding");
             lhq.proto = &njs_object_hash_proto;
 
-            ret = nxt_lvlhsh_find(&args[3].data.u.object->hash, &lhq);
+            ret = njs_object_hash_find(args[3].data.u.object, &lhq,
+                                       &scratch);
             if (ret == NXT_OK) {
                 prop = lhq.value;
                 njs_string_get(&prop->value, &encoding);
@@ -593,7 +599,8 @@ static njs_ret_t njs_fs_write_file_internal(njs_vm_t *vm, njs_value_t *args,
             lhq.key = nxt_string_value("mode");
             lhq.proto = &njs_object_hash_proto;
 
-            ret = nxt_lvlhsh_find(&args[3].data.u.object->hash, &lhq);
+            ret = njs_object_hash_find(args[3].data.u.object, &lhq,
+                                       &scratch);
             if (ret == NXT_OK) {
                 prop = lhq.value;
                 mode = &prop->value;
@@ -726,7 +733,7 @@ njs_fs_write_file_sync_internal(njs_vm_t *vm, njs_value_t *args,
     njs_ret_t           ret;
     const char          *path, *syscall, *description;
     njs_value_t         *mode;
-    njs_object_prop_t   *prop;
+    njs_object_prop_t   *prop, scratch;
     nxt_lvlhsh_query_t  lhq;
 
     if (nxt_slow_path(nargs < 3)) {
@@ -760,7 +767,8 @@ njs_fs_write_file_sync_internal(njs_vm_t *vm, njs_value_t *args,
             lhq.key = nxt_string_value("flag");
             lhq.proto = &njs_object_hash_proto;
 
-            ret = nxt_lvlhsh_find(&args[3].data.u.object->hash, &lhq);
+            ret = njs_object_hash_find(args[3].data.u.object, &lhq,
+                                       &scratch);
             if (ret == NXT_OK) {
                 prop = lhq.value;
                 njs_string_get(&prop->value, &flag);
@@ -770,7 +778,8 @@ njs_fs_write_file_sync_internal(njs_vm_t *vm, njs_value_t *args,
             lhq.key = nxt_string_value("encoding");
             lhq.proto = &njs_object_hash_proto;
 
-            ret = nxt_lvlhsh_find(&args[3].data.u.object->hash, &lhq);
+            ret = njs_object_hash_find(args[3].data.u.object, &lhq,
+                                       &scratch);
             if (ret == NXT_OK) {
                 prop = lhq.value;
                 njs_string_get(&prop->value, &encoding);
@@ -780,7 +789,8 @@ njs_fs_write_file_sync_internal(njs_vm_t *vm, njs_value_t *args,
             lhq.key = nxt_string_value("mode");
             lhq.proto = &njs_object_hash_proto;
 
-            ret = nxt_lvlhsh_find(&args[3].data.u.object->hash, &lhq);
+            ret = njs_object_hash_find(args[3].data.u.object, &lhq,
+                                       &scratch);
             if (ret == NXT_OK) {
                 prop = lhq.value;
                 mode = &prop->value;
@@ -60,6 +60,8 @@ njs_function_alloc(njs_vm_t *vm, njs_function_lambda_t *lambda,
         } while (n < nesting);
     }
 
+    njs_gc_register(vm, function, NJS_GC_OBJECT, size);
+
     return function;
 
 fail:
@@ -87,6 +89,8 @@ njs_function_value_copy(njs_vm_t *vm, njs_value_t *value)
         return NULL;
     }
 
+    njs_gc_register(vm, copy, NJS_GC_FUNCTION_COPY, sizeof(njs_function_t));
+
     value->data.u.function = copy;
 
     return copy;
@@ -318,7 +322,8 @@ njs_function_lambda_frame(njs_vm_t *vm, njs_function_t *function,
 
     max_args = nxt_max(nargs, lambda->nargs);
 
-    closures = lambda->nesting + lambda->block_closures;
+    /* The block closure slot is NULL if the function has no closures. */
+    closures = lambda->nesting + 1;
 
     size = njs_frame_size(closures)
            + (function->args_offset + max_args) * sizeof(njs_value_t)
@@ -398,22 +403,45 @@ njs_function_frame_alloc(njs_vm_t *vm, size_t size)
         chunk_size = 0;
 
     } else {
-        spare_size = size + NJS_FRAME_SPARE_SIZE;
-        spare_size = nxt_align_size(spare_size, NJS_FRAME_SPARE_SIZE);
+        frame = vm->stack_cache;
+
+        if (frame != NULL && size <= frame->size) {
+            spare_size = frame->size;
+
+        } else {
+            frame = NULL;
+
+            spare_size = nxt_min(nxt_max(vm->stack_size, NJS_FRAME_CHUNK_SIZE),
+                                 NJS_FRAME_CHUNK_MAX_SIZE);
+            spare_size = nxt_max(spare_size, size + NJS_FRAME_SPARE_SIZE);
+            spare_size = nxt_align_size(spare_size, NJS_FRAME_SPARE_SIZE);
+
+            if (vm->stack_size + spare_size > NJS_MAX_STACK_SIZE) {
+                spare_size = size + NJS_FRAME_SPARE_SIZE;
+                spare_size = nxt_align_size(spare_size, NJS_FRAME_SPARE_SIZE);
+            }
+        }
 
         if (vm->stack_size + spare_size > NJS_MAX_STACK_SIZE) {
             njs_range_error(vm, "Maximum call stack size exceeded");
             return NULL;
         }
 
-        frame = nxt_mp_align(vm->mem_pool, sizeof(njs_value_t), spare_size);
-        if (nxt_slow_path(frame == NULL)) {
-            njs_memory_error(vm);
-            return NULL;
+        if (frame != NULL) {
+            vm->stack_cache = NULL;
+
+        } else {
+            frame = nxt_mp_align(vm->mem_pool, sizeof(njs_value_t),
+                                 spare_size);
+            if (nxt_slow_path(frame == NULL)) {
+                njs_memory_error(vm);
+                return NULL;
+            }
         }
 
         chunk_size = spare_size;
         vm->stack_size += spare_size;
+        vm->stack_peak = nxt_max(vm->stack_peak, vm->stack_size);
     }
 
     nxt_memzero(frame, sizeof(njs_native_frame_t));
@@ -452,6 +480,10 @@ njs_function_lambda_call(njs_vm_t *vm, njs_index_t retval,
     lambda = function->u.lambda;
     vm->current = lambda->start;
 
+    if (vm->profile != NULL) {
+        njs_profile_call(vm, lambda);
+    }
+
 #if (NXT_DEBUG)
     vm->scopes[NJS_SCOPE_CALLEE_ARGUMENTS] = NULL;
 #endif
@@ -496,8 +528,11 @@ njs_function_lambda_call(njs_vm_t *vm, njs_index_t retval,
                 return NXT_ERROR;
             }
 
+            closure->u.size = size;
+
+            njs_gc_register(vm, closure, NJS_GC_CLOSURE, size);
+
             size -= sizeof(njs_value_t);
-            closure->u.count = 0;
             dst = closure->values;
 
             src = lambda->closure_scope;
@@ -510,6 +545,9 @@ njs_function_lambda_call(njs_vm_t *vm, njs_index_t retval,
 
         frame->closures[n] = closure;
         vm->scopes[NJS_SCOPE_CLOSURE + n] = &closure->u.values;
+
+    } else {
+        frame->closures[n] = NULL;
     }
 
     if (lambda->rest_parameters) {
@@ -525,6 +563,67 @@ njs_function_lambda_call(njs_vm_t *vm, njs_index_t retval,
 }
 
 
+/*
+ * A self-recursive call in a tail position reuses the caller frame.
+ * The reused frames are still accounted in the stack size, so an endless
+ * recursion throws "Maximum call stack size exceeded" as before.
+ */
+
+njs_ret_t
+njs_function_lambda_tail_call(njs_vm_t *vm)
+{
+    size_t              size;
+    nxt_uint_t          nargs;
+    njs_frame_t         *frame;
+    njs_function_t      *function;
+    njs_native_frame_t  *callee;
+
+    callee = vm->top_frame;
+    frame = vm->active_frame;
+    function = callee->function;
+
+    if (callee->previous != &frame->native
+        || frame->native.function != function
+        || function->bound != NULL
+        || callee->ctor
+        || frame->native.ctor
+        || frame->native.exception.catch != NULL)
+    {
+        return NXT_DECLINED;
+    }
+
+    nargs = nxt_max(callee->nargs, function->u.lambda->nargs);
+
+    if (nargs > nxt_max(frame->native.nargs, function->u.lambda->nargs)) {
+        return NXT_DECLINED;
+    }
+
+    size = callee->free - (u_char *) callee;
+
+    if (vm->stack_size + size > NJS_MAX_STACK_SIZE) {
+        njs_range_error(vm, "Maximum call stack size exceeded");
+        return NXT_ERROR;
+    }
+
+    /* The "this" value and arguments. */
+
+    memcpy(frame->native.arguments, callee->arguments,
+           (nargs + 1) * sizeof(njs_value_t));
+
+    frame->native.nargs = callee->nargs;
+    frame->native.arguments_object = NULL;
+
+    frame->native.tail_size += size;
+    vm->stack_size += size;
+
+    njs_function_frame_free(vm, callee);
+
+    vm->top_frame = &frame->native;
+
+    return njs_function_lambda_call(vm, frame->retval, frame->return_address);
+}
+
+
 njs_ret_t
 njs_function_native_call(njs_vm_t *vm, njs_function_native_t native,
     njs_value_t *args, uint8_t *args_types, nxt_uint_t nargs,
@@ -732,10 +831,7 @@ njs_function_frame_free(njs_vm_t *vm, njs_native_frame_t *frame)
 
         /* GC: free frame->local, etc. */
 
-        if (frame->size != 0) {
-            vm->stack_size -= frame->size;
-            nxt_mp_free(vm->mem_pool, frame);
-        }
+        njs_function_frame_release(vm, frame);
 
         frame = previous;
 
@@ -743,6 +839,39 @@ njs_function_frame_free(njs_vm_t *vm, njs_native_frame_t *frame)
 }
 
 
+void
+njs_function_frame_release(njs_vm_t *vm, njs_native_frame_t *frame)
+{
+    njs_native_frame_t  *cache;
+
+    if (nxt_slow_path(frame->trap != NULL)) {
+        frame->trap->next = vm->trap_cache;
+        vm->trap_cache = frame->trap;
+    }
+
+    vm->stack_size -= frame->tail_size;
+
+    if (frame->size != 0) {
+        vm->stack_size -= frame->size;
+
+        /* The largest chunk is kept to not thrash the memory pool. */
+
+        cache = vm->stack_cache;
+
+        if (cache != NULL && cache->size >= frame->size) {
+            nxt_mp_free(vm->mem_pool, frame);
+            return;
+        }
+
+        if (cache != NULL) {
+            nxt_mp_free(vm->mem_pool, cache);
+        }
+
+        vm->stack_cache = frame;
+    }
+}
+
+
 /*
  * The "prototype" property of user defined functions is created on
  * demand in private hash of the functions by the "prototype" getter.
@@ -1097,6 +1226,9 @@ njs_function_prototype_bind(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
 
     memcpy(values, args, size);
 
+    njs_gc_register(vm, function, NJS_GC_FUNCTION_COPY,
+                    sizeof(njs_function_t) + size);
+
     vm->retval.data.u.function = function;
     vm->retval.type = NJS_FUNCTION;
     vm->retval.data.truth = 1;
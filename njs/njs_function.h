@@ -37,6 +37,11 @@ struct njs_function_lambda_s {
     njs_value_t                    *closure_scope;
 
     u_char                         *start;
+
+    /* The native code compiled by the baseline JIT. */
+    njs_jit_code_t                 *jit;
+    uint32_t                       jit_hits;
+    uint8_t                        jit_declined;      /* 1 bit */
 };
 
 
@@ -49,12 +54,22 @@ struct njs_function_lambda_s {
     nxt_align_size(sizeof(njs_frame_t) + closures * sizeof(njs_closure_t *),  \
                    sizeof(njs_value_t))
 
-/* The retval field is not used in the global frame. */
-#define NJS_GLOBAL_FRAME_SIZE                                                 \
-    nxt_align_size(offsetof(njs_frame_t, retval), sizeof(njs_value_t))
+/*
+ * The retval field is not used in the global frame.  The global frame
+ * closure is NULL, it is inherited by the global functions.
+ */
+#define NJS_GLOBAL_FRAME_SIZE  njs_frame_size(1)
 
 #define NJS_FRAME_SPARE_SIZE       512
 
+/*
+ * Frames are allocated in stack chunks.  A new chunk is as large as
+ * the current stack size within the limits, so the number of chunks
+ * grows logarithmically with the call depth.
+ */
+#define NJS_FRAME_CHUNK_SIZE       2048
+#define NJS_FRAME_CHUNK_MAX_SIZE   (64 * 1024)
+
 
 typedef struct {
     njs_function_native_t          function;
@@ -77,8 +92,7 @@ typedef struct {
 
 
 #define njs_vm_trap_value(vm, val)                                            \
-    (vm)->top_frame->trap_scratch.data.u.value = val
-
+    (vm)->trap_value = val
 
 
 typedef struct njs_exception_s     njs_exception_t;
@@ -93,11 +107,27 @@ struct njs_exception_s {
 };
 
 
-struct njs_native_frame_s {
-    njs_value_t                    trap_scratch;
-    njs_value_t                    trap_values[2];
-    u_char                         *trap_restart;
+/*
+ * The trap state is rarely used, so it is allocated on demand and
+ * is kept until the frame is freed.  The freed trap states are cached
+ * in vm->trap_cache.
+ */
+
+struct njs_frame_trap_s {
+    njs_value_t                    scratch;
+    njs_value_t                    values[2];
+    u_char                         *restart;
+    njs_frame_trap_t               *next;
+
+    /*
+     * The first operand in trap is reference to original value,
+     * it is used to increment or decrement this value.
+     */
+    uint8_t                        reference;         /* 1 bit */
+};
 
+
+struct njs_native_frame_s {
     u_char                         *free;
 
     njs_function_t                 *function;
@@ -108,10 +138,15 @@ struct njs_native_frame_s {
 
     njs_exception_t                exception;
 
+    njs_frame_trap_t               *trap;
+
     uint32_t                       size;
     uint32_t                       free_size;
     uint32_t                       nargs;
 
+    /* A size of frames reused by self-recursive tail calls. */
+    uint32_t                       tail_size;
+
     /* Function is called as constructor with "new" keyword. */
     uint8_t                        ctor;              /* 1 bit  */
 
@@ -120,12 +155,6 @@ struct njs_native_frame_s {
 
     /* A number of trap tries, it can be no more than three. */
     uint8_t                        trap_tries;        /* 2 bits */
-
-    /*
-     * The first operand in trap is reference to original value,
-     * it is used to increment or decrement this value.
-     */
-    uint8_t                        trap_reference;   /* 1 bit */
 };
 
 
@@ -172,10 +201,12 @@ njs_ret_t njs_function_activate(njs_vm_t *vm, njs_function_t *function,
     njs_index_t retval, size_t advance);
 njs_ret_t njs_function_lambda_call(njs_vm_t *vm, njs_index_t retval,
     u_char *return_address);
+njs_ret_t njs_function_lambda_tail_call(njs_vm_t *vm);
 njs_ret_t njs_function_native_call(njs_vm_t *vm, njs_function_native_t native,
     njs_value_t *args, uint8_t *args_types, nxt_uint_t nargs,
     njs_index_t retval);
 void njs_function_frame_free(njs_vm_t *vm, njs_native_frame_t *frame);
+void njs_function_frame_release(njs_vm_t *vm, njs_native_frame_t *frame);
 
 
 nxt_inline njs_ret_t
@@ -0,0 +1,707 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <njs_core.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define NJS_GC_PAUSE                200
+#define NJS_GC_CELLS_MIN            64
+#define NJS_GC_STACK_MIN            64
+
+
+typedef struct {
+    njs_vm_t                    *vm;
+    njs_gc_t                    *gc;
+    nxt_mp_t                    *pool;
+
+    /* The objects to be traced. */
+    njs_object_t                **stack;
+    uint32_t                    items;
+    uint32_t                    available;
+
+    /* The objects and closures which are not cells but are traced. */
+    nxt_lvlhsh_t                visited;
+
+    nxt_bool_t                  error;
+} njs_gc_mark_t;
+
+
+static nxt_bool_t njs_gc_idle(njs_vm_t *vm);
+static int njs_gc_cell_cmp(const void *one, const void *two);
+static njs_gc_cell_t *njs_gc_cell_find(njs_gc_t *gc, const void *p);
+static nxt_int_t njs_gc_mark(njs_gc_mark_t *mark, void *p);
+static nxt_int_t njs_gc_visited_test(nxt_lvlhsh_query_t *lhq, void *data);
+static void njs_gc_mark_roots(njs_gc_mark_t *mark);
+static void njs_gc_mark_value(njs_gc_mark_t *mark, const njs_value_t *value);
+static void njs_gc_mark_values(njs_gc_mark_t *mark, const njs_value_t *values,
+    nxt_uint_t n);
+static void njs_gc_mark_object(njs_gc_mark_t *mark, njs_object_t *object);
+static void njs_gc_mark_closure(njs_gc_mark_t *mark, njs_closure_t *closure);
+static void njs_gc_trace(njs_gc_mark_t *mark, njs_object_t *object);
+static void njs_gc_sweep(njs_vm_t *vm, njs_gc_t *gc);
+static void njs_gc_cell_free(njs_vm_t *vm, njs_gc_cell_t *cell);
+
+
+static const nxt_lvlhsh_proto_t  njs_gc_visited_hash_proto
+    nxt_aligned(64) =
+{
+    NXT_LVLHSH_DEFAULT,
+    0,
+    njs_gc_visited_test,
+    njs_lvlhsh_alloc,
+    njs_lvlhsh_free,
+};
+
+
+nxt_int_t
+njs_gc_init(njs_vm_t *vm)
+{
+    njs_gc_t  *gc;
+
+    gc = nxt_mp_zalloc(vm->mem_pool, sizeof(njs_gc_t));
+    if (nxt_slow_path(gc == NULL)) {
+        return NXT_ERROR;
+    }
+
+    gc->limit = vm->options.gc_threshold;
+
+    vm->gc = gc;
+
+    return NXT_OK;
+}
+
+
+void
+njs_gc_cell_add(njs_vm_t *vm, void *p, njs_gc_type_t type, size_t size)
+{
+    njs_gc_t       *gc;
+    uint32_t       available;
+    njs_gc_cell_t  *cells, *cell;
+
+    gc = vm->gc;
+
+    if (gc->items == gc->available) {
+        available = nxt_max(gc->available * 2, NJS_GC_CELLS_MIN);
+
+        cells = nxt_mp_alloc(vm->mem_pool, available * sizeof(njs_gc_cell_t));
+        if (nxt_slow_path(cells == NULL)) {
+            /* The memory is not freed till the VM is destroyed. */
+            return;
+        }
+
+        if (gc->cells != NULL) {
+            memcpy(cells, gc->cells, gc->items * sizeof(njs_gc_cell_t));
+            nxt_mp_free(vm->mem_pool, gc->cells);
+        }
+
+        gc->cells = cells;
+        gc->available = available;
+    }
+
+    cell = &gc->cells[gc->items++];
+
+    cell->start = p;
+    cell->size = size;
+    cell->type = type;
+    cell->mark = 0;
+
+    gc->size += size;
+}
+
+
+nxt_int_t
+njs_gc_collect(njs_vm_t *vm)
+{
+    uint64_t       start, time;
+    uint32_t       i, pause;
+    njs_gc_t       *gc;
+    njs_object_t   *object;
+    njs_gc_mark_t  mark;
+
+    if (!njs_gc_idle(vm)) {
+        return NXT_DECLINED;
+    }
+
+    gc = vm->gc;
+
+    start = nxt_time();
+
+    mark.pool = nxt_mp_create(&njs_vm_mp_proto, NULL, NULL, nxt_pagesize(),
+                              128, 512, 16);
+    if (nxt_slow_path(mark.pool == NULL)) {
+        return NXT_ERROR;
+    }
+
+    mark.vm = vm;
+    mark.gc = gc;
+    mark.stack = NULL;
+    mark.items = 0;
+    mark.available = 0;
+    mark.error = 0;
+
+    nxt_lvlhsh_init(&mark.visited);
+
+    /* The cells are sorted by address to find them by value pointers. */
+
+    qsort(gc->cells, gc->items, sizeof(njs_gc_cell_t), njs_gc_cell_cmp);
+
+    njs_gc_mark_roots(&mark);
+
+    while (mark.items != 0) {
+        object = mark.stack[--mark.items];
+        njs_gc_trace(&mark, object);
+    }
+
+    nxt_mp_destroy(mark.pool);
+
+    if (nxt_slow_path(mark.error)) {
+        for (i = 0; i < gc->items; i++) {
+            gc->cells[i].mark = 0;
+        }
+
+        return NXT_ERROR;
+    }
+
+    njs_gc_sweep(vm, gc);
+
+    /*
+     * A new object can be allocated at the address of a freed one,
+     * so the property caches referring to freed objects are invalidated.
+     */
+    njs_prop_cache_invalidate(vm);
+
+    pause = vm->options.gc_pause;
+
+    if (pause == 0) {
+        pause = NJS_GC_PAUSE;
+    }
+
+    pause = nxt_max(pause, 100);
+
+    gc->limit = nxt_max((uint64_t) vm->options.gc_threshold,
+                        gc->size * pause / 100);
+
+    time = nxt_time() - start;
+
+    gc->stats.collections++;
+    gc->stats.size = gc->size;
+    gc->stats.time += time;
+    gc->stats.max_time = nxt_max(gc->stats.max_time, time);
+
+    return NXT_OK;
+}
+
+
+nxt_int_t
+njs_vm_gc(njs_vm_t *vm)
+{
+    if (vm->gc == NULL) {
+        return NJS_DECLINED;
+    }
+
+    return njs_gc_collect(vm);
+}
+
+
+nxt_int_t
+njs_vm_gc_stats(njs_vm_t *vm, njs_vm_gc_stats_t *stats)
+{
+    if (vm->gc == NULL) {
+        return NJS_DECLINED;
+    }
+
+    *stats = vm->gc->stats;
+    stats->size = vm->gc->size;
+
+    return NJS_OK;
+}
+
+
+/*
+ * The values of the running code frames are not tracked, so the collection
+ * is possible only when the VM is idle at the global frame.
+ */
+
+static nxt_bool_t
+njs_gc_idle(njs_vm_t *vm)
+{
+    return vm->nesting == 0
+           && !vm->preempted
+           && !vm->cloned
+           && vm->top_frame != NULL
+           && vm->top_frame->previous == NULL;
+}
+
+
+static int
+njs_gc_cell_cmp(const void *one, const void *two)
+{
+    const njs_gc_cell_t  *cell1, *cell2;
+
+    cell1 = one;
+    cell2 = two;
+
+    if ((uintptr_t) cell1->start < (uintptr_t) cell2->start) {
+        return -1;
+    }
+
+    return ((uintptr_t) cell1->start > (uintptr_t) cell2->start);
+}
+
+
+static njs_gc_cell_t *
+njs_gc_cell_find(njs_gc_t *gc, const void *p)
+{
+    uint32_t       left, right, middle;
+    njs_gc_cell_t  *cell;
+
+    left = 0;
+    right = gc->items;
+
+    while (left < right) {
+        middle = left + (right - left) / 2;
+        cell = &gc->cells[middle];
+
+        if (cell->start == p) {
+            return cell;
+        }
+
+        if ((uintptr_t) cell->start < (uintptr_t) p) {
+            left = middle + 1;
+
+        } else {
+            right = middle;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * njs_gc_mark() marks a cell or remembers a pointer which is not a cell.
+ *   NXT_OK       the pointer is met for the first time and should be traced,
+ *   NXT_DECLINED the pointer has been already traced.
+ */
+
+static nxt_int_t
+njs_gc_mark(njs_gc_mark_t *mark, void *p)
+{
+    nxt_int_t           ret;
+    njs_gc_cell_t       *cell;
+    nxt_lvlhsh_query_t  lhq;
+
+    cell = njs_gc_cell_find(mark->gc, p);
+
+    if (cell != NULL) {
+        if (cell->mark) {
+            return NXT_DECLINED;
+        }
+
+        cell->mark = 1;
+
+        return NXT_OK;
+    }
+
+    lhq.key.length = sizeof(void *);
+    lhq.key.start = (u_char *) &p;
+    lhq.key_hash = nxt_djb_hash(&p, sizeof(void *));
+    lhq.replace = 0;
+    lhq.value = p;
+    lhq.proto = &njs_gc_visited_hash_proto;
+    lhq.pool = mark->pool;
+
+    ret = nxt_lvlhsh_insert(&mark->visited, &lhq);
+
+    if (nxt_slow_path(ret == NXT_ERROR)) {
+        mark->error = 1;
+        return NXT_DECLINED;
+    }
+
+    return ret;
+}
+
+
+static nxt_int_t
+njs_gc_visited_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    if (*(void **) lhq->key.start == data) {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+static void
+njs_gc_mark_roots(njs_gc_mark_t *mark)
+{
+    njs_vm_t            *vm;
+    nxt_uint_t          i;
+    njs_event_t         *event;
+    njs_module_t        **module;
+    njs_variable_t      *var;
+    nxt_queue_link_t    *link;
+    nxt_lvlhsh_each_t   lhe;
+    njs_object_shape_t  *shape;
+
+    vm = mark->vm;
+
+    njs_gc_mark_value(mark, &vm->retval);
+
+    /* The constructors and the global retval. */
+
+    for (i = 0; i <= NJS_CONSTRUCTOR_MAX; i++) {
+        njs_gc_mark_value(mark,
+                          njs_vmcode_operand(vm, njs_global_scope_index(i)));
+    }
+
+    /*
+     * The global temporary values are not roots, they are not used
+     * after the global code is finished and they can hold the for-in
+     * iterators, which are not values.
+     */
+
+    nxt_lvlhsh_each_init(&lhe, &njs_variables_hash_proto);
+
+    for ( ;; ) {
+        var = nxt_lvlhsh_each(&vm->variables_hash, &lhe);
+
+        if (var == NULL) {
+            break;
+        }
+
+        njs_gc_mark_value(mark, njs_vmcode_operand(vm, var->index));
+    }
+
+    njs_gc_mark_values(mark, vm->global_scope,
+                       vm->scope_size / sizeof(njs_value_t));
+
+    for (i = 0; i < NJS_PROTOTYPE_MAX; i++) {
+        njs_gc_mark_object(mark, &vm->prototypes[i].object);
+    }
+
+    for (i = 0; i < NJS_CONSTRUCTOR_MAX; i++) {
+        njs_gc_mark_object(mark, &vm->constructors[i].object);
+    }
+
+    njs_gc_mark_object(mark, &vm->memory_error_object);
+
+    nxt_lvlhsh_each_init(&lhe, &njs_event_hash_proto);
+
+    for ( ;; ) {
+        event = nxt_lvlhsh_each(&vm->events_hash, &lhe);
+
+        if (event == NULL) {
+            break;
+        }
+
+        njs_gc_mark_object(mark, &event->function->object);
+        njs_gc_mark_values(mark, event->args, event->nargs);
+    }
+
+    /* The "once" events are deleted from the hash before they are run. */
+
+    for (link = nxt_queue_first(&vm->posted_events);
+         link != nxt_queue_tail(&vm->posted_events);
+         link = nxt_queue_next(link))
+    {
+        event = nxt_queue_link_data(link, njs_event_t, link);
+
+        njs_gc_mark_object(mark, &event->function->object);
+        njs_gc_mark_values(mark, event->args, event->nargs);
+    }
+
+    if (vm->modules != NULL) {
+        module = vm->modules->start;
+
+        for (i = 0; i < vm->modules->items; i++) {
+            njs_gc_mark_object(mark, &module[i]->object);
+            njs_gc_mark_object(mark, &module[i]->function.object);
+            njs_gc_mark_value(mark, njs_vmcode_operand(vm, module[i]->index));
+        }
+    }
+
+    /* The shapes are never freed, but their names can be long strings. */
+
+    shape = vm->shape_root;
+
+    while (shape != NULL) {
+        njs_gc_mark_value(mark, &shape->name);
+
+        if (shape->child != NULL) {
+            shape = shape->child;
+            continue;
+        }
+
+        while (shape != NULL && shape->next == NULL) {
+            shape = shape->parent;
+        }
+
+        if (shape != NULL) {
+            shape = shape->next;
+        }
+    }
+}
+
+
+static void
+njs_gc_mark_value(njs_gc_mark_t *mark, const njs_value_t *value)
+{
+    njs_gc_cell_t        *cell;
+    njs_string_buffer_t  *buffer;
+
+    if (njs_is_string(value)) {
+        if (value->short_string.size == NJS_STRING_LONG) {
+            cell = njs_gc_cell_find(mark->gc, value->long_string.data);
+
+            if (cell != NULL) {
+                cell->mark = 1;
+            }
+
+            if (value->long_string.external == NJS_STRING_BUFFER) {
+                buffer = njs_string_buffer(value->long_string.data);
+                cell = njs_gc_cell_find(mark->gc, buffer);
+
+                if (cell != NULL) {
+                    cell->mark = 1;
+                }
+            }
+        }
+
+        return;
+    }
+
+    if (value->type >= NJS_OBJECT && value->type <= NJS_OBJECT_VALUE) {
+        njs_gc_mark_object(mark, value->data.u.object);
+    }
+}
+
+
+static void
+njs_gc_mark_values(njs_gc_mark_t *mark, const njs_value_t *values,
+    nxt_uint_t n)
+{
+    while (n != 0) {
+        njs_gc_mark_value(mark, values);
+        values++;
+        n--;
+    }
+}
+
+
+static void
+njs_gc_mark_object(njs_gc_mark_t *mark, njs_object_t *object)
+{
+    uint32_t      available;
+    njs_object_t  **stack;
+
+    if (njs_gc_mark(mark, object) != NXT_OK) {
+        return;
+    }
+
+    if (mark->items == mark->available) {
+        available = nxt_max(mark->available * 2, NJS_GC_STACK_MIN);
+
+        stack = nxt_mp_alloc(mark->pool, available * sizeof(njs_object_t *));
+        if (nxt_slow_path(stack == NULL)) {
+            mark->error = 1;
+            return;
+        }
+
+        if (mark->stack != NULL) {
+            memcpy(stack, mark->stack, mark->items * sizeof(njs_object_t *));
+            nxt_mp_free(mark->pool, mark->stack);
+        }
+
+        mark->stack = stack;
+        mark->available = available;
+    }
+
+    mark->stack[mark->items++] = object;
+}
+
+
+static void
+njs_gc_mark_closure(njs_gc_mark_t *mark, njs_closure_t *closure)
+{
+    if (njs_gc_mark(mark, closure) != NXT_OK) {
+        return;
+    }
+
+    /* The first value is the closure header. */
+
+    njs_gc_mark_values(mark, closure->values,
+                       closure->u.size / sizeof(njs_value_t) - 1);
+}
+
+
+static void
+njs_gc_trace(njs_gc_mark_t *mark, njs_object_t *object)
+{
+    nxt_uint_t          i, nesting;
+    njs_array_t         *array;
+    njs_gc_cell_t       *cell;
+    njs_function_t      *function;
+    njs_object_prop_t   *prop;
+    nxt_lvlhsh_each_t   lhe;
+    njs_object_value_t  *ov;
+
+    if (object->__proto__ != NULL) {
+        njs_gc_mark_object(mark, object->__proto__);
+    }
+
+    /* The shared hash refers to the immutable shared data. */
+
+    nxt_lvlhsh_each_init(&lhe, &njs_object_hash_proto);
+
+    for ( ;; ) {
+        prop = nxt_lvlhsh_each(&object->hash, &lhe);
+
+        if (prop == NULL) {
+            break;
+        }
+
+        cell = njs_gc_cell_find(mark->gc, prop);
+
+        if (cell != NULL) {
+            cell->mark = 1;
+        }
+
+        njs_gc_mark_value(mark, &prop->name);
+        njs_gc_mark_value(mark, &prop->value);
+    }
+
+    if (object->shape != NULL) {
+        njs_gc_mark_values(mark, object->slots, object->shape->count);
+    }
+
+    switch (object->type) {
+
+    case NJS_ARRAY:
+        array = (njs_array_t *) object;
+        njs_gc_mark_values(mark, array->start, array->length);
+        break;
+
+    case NJS_FUNCTION:
+        function = (njs_function_t *) object;
+
+        if (function->bound != NULL) {
+            njs_gc_mark_values(mark, function->bound, function->args_offset);
+        }
+
+        if (function->closure) {
+            nesting = function->u.lambda->nesting;
+
+            for (i = 0; i < nesting; i++) {
+                if (function->closures[i] != NULL) {
+                    njs_gc_mark_closure(mark, function->closures[i]);
+                }
+            }
+        }
+
+        break;
+
+    case NJS_REGEXP:
+        njs_gc_mark_value(mark, &((njs_regexp_t *) object)->string);
+        break;
+
+    case NJS_OBJECT_BOOLEAN:
+    case NJS_OBJECT_NUMBER:
+    case NJS_OBJECT_STRING:
+        ov = (njs_object_value_t *) object;
+        njs_gc_mark_value(mark, &ov->value);
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+static void
+njs_gc_sweep(njs_vm_t *vm, njs_gc_t *gc)
+{
+    uint32_t       i, n;
+    uint64_t       size, freed;
+    njs_array_t    *array;
+    njs_gc_cell_t  *cell;
+
+    n = 0;
+    size = 0;
+    freed = 0;
+
+    for (i = 0; i < gc->items; i++) {
+        cell = &gc->cells[i];
+
+        if (!cell->mark) {
+            freed += cell->size;
+            njs_gc_cell_free(vm, cell);
+            continue;
+        }
+
+        cell->mark = 0;
+
+        if (cell->type == NJS_GC_OBJECT) {
+            array = cell->start;
+
+            if (array->object.type == NJS_ARRAY) {
+                /* The array can be expanded after allocation. */
+                cell->size = sizeof(njs_array_t)
+                             + array->size * sizeof(njs_value_t);
+            }
+        }
+
+        size += cell->size;
+        gc->cells[n++] = *cell;
+    }
+
+    gc->items = n;
+    gc->size = size;
+    gc->stats.freed += freed;
+}
+
+
+static void
+njs_gc_cell_free(njs_vm_t *vm, njs_gc_cell_t *cell)
+{
+    njs_object_t    *object;
+    njs_function_t  *function;
+
+    switch (cell->type) {
+
+    case NJS_GC_OBJECT:
+        object = cell->start;
+
+        nxt_lvlhsh_destroy(&object->hash, &njs_object_hash_proto,
+                           vm->mem_pool);
+
+        if (object->shape != NULL) {
+            nxt_mp_free(vm->mem_pool, object->slots);
+        }
+
+        if (object->type == NJS_ARRAY) {
+            nxt_mp_free(vm->mem_pool, ((njs_array_t *) object)->data);
+        }
+
+        break;
+
+    case NJS_GC_FUNCTION_COPY:
+        function = cell->start;
+
+        if (function->bound != NULL) {
+            nxt_mp_free(vm->mem_pool, function->bound);
+        }
+
+        break;
+
+    default:
+        break;
+    }
+
+    nxt_mp_free(vm->mem_pool, cell->start);
+}
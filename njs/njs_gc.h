@@ -0,0 +1,78 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NJS_GC_H_INCLUDED_
+#define _NJS_GC_H_INCLUDED_
+
+
+/*
+ * The garbage collector is enabled by the "gc_threshold" VM option.
+ * The objects, arrays, functions, properties, closures and long strings
+ * allocated by the running code are registered as cells, the memory
+ * allocated before, such as the compiled code, the shared objects and
+ * the values created by the host, is never freed.
+ *
+ * The collector is mark-and-sweep and it is run only when the VM is idle,
+ * that is, when njs_vm_start(), njs_vm_call() or njs_vm_run() returns,
+ * so the roots are the global variables, the global retval, the built-in
+ * prototypes and constructors, the events and the modules.  The cells
+ * not reachable from the roots are freed.  The collector is not run in
+ * a VM having clones, since the clones refer to the VM objects, and in
+ * the accumulative mode.
+ */
+
+typedef enum {
+    NJS_GC_STRING = 0,
+    NJS_GC_OBJECT,
+    /* The function copy shares the hash with the original function. */
+    NJS_GC_FUNCTION_COPY,
+    NJS_GC_PROP,
+    NJS_GC_CLOSURE,
+} njs_gc_type_t;
+
+
+typedef struct {
+    void                        *start;
+    uint32_t                    size;
+    uint8_t                     type;  /* njs_gc_type_t */
+    uint8_t                     mark;  /* 1 bit */
+} njs_gc_cell_t;
+
+
+struct njs_gc_s {
+    njs_gc_cell_t               *cells;
+    uint32_t                    items;
+    uint32_t                    available;
+
+    /* The size of cells, the collection is run if it exceeds the limit. */
+    uint64_t                    size;
+    uint64_t                    limit;
+
+    njs_vm_gc_stats_t           stats;
+};
+
+
+#define njs_gc_register(vm, p, type, size)                                    \
+    do {                                                                      \
+        if (nxt_slow_path((vm)->gc != NULL)) {                                \
+            njs_gc_cell_add(vm, p, type, size);                               \
+        }                                                                     \
+    } while (0)
+
+
+#define njs_gc_check(vm)                                                      \
+    do {                                                                      \
+        if ((vm)->gc != NULL && (vm)->gc->size >= (vm)->gc->limit) {          \
+            (void) njs_gc_collect(vm);                                        \
+        }                                                                     \
+    } while (0)
+
+
+nxt_int_t njs_gc_init(njs_vm_t *vm);
+void njs_gc_cell_add(njs_vm_t *vm, void *p, njs_gc_type_t type, size_t size);
+nxt_int_t njs_gc_collect(njs_vm_t *vm);
+
+
+#endif /* _NJS_GC_H_INCLUDED_ */
@@ -57,6 +57,8 @@ static nxt_int_t njs_generator(njs_vm_t *vm, njs_generator_t *generator,
     njs_parser_node_t *node);
 static u_char *njs_generate_reserve(njs_vm_t *vm, njs_generator_t *generator,
     size_t size);
+static nxt_noinline njs_vmcode_opcode_t njs_generate_opcode(
+    njs_vmcode_operation_t operation);
 static nxt_int_t njs_generate_name(njs_vm_t *vm, njs_generator_t *generator,
     njs_parser_node_t *node);
 static nxt_int_t njs_generate_builtin_object(njs_vm_t *vm,
@@ -67,6 +69,9 @@ static nxt_int_t njs_generate_var_statement(njs_vm_t *vm,
     njs_generator_t *generator, njs_parser_node_t *node);
 static nxt_int_t njs_generate_if_statement(njs_vm_t *vm,
     njs_generator_t *generator, njs_parser_node_t *node);
+static nxt_int_t njs_generate_cond_jump(njs_vm_t *vm,
+    njs_generator_t *generator, njs_parser_node_t *cond, nxt_bool_t if_true,
+    njs_ret_t *jump_offset);
 static nxt_int_t njs_generate_cond_expression(njs_vm_t *vm,
     njs_generator_t *generator, njs_parser_node_t *node);
 static nxt_int_t njs_generate_switch_statement(njs_vm_t *vm,
@@ -125,8 +130,16 @@ static nxt_int_t njs_generate_regexp(njs_vm_t *vm, njs_generator_t *generator,
     njs_parser_node_t *node);
 static nxt_int_t njs_generate_test_jump_expression(njs_vm_t *vm,
     njs_generator_t *generator, njs_parser_node_t *node);
+static nxt_int_t njs_generate_binary_operands(njs_vm_t *vm,
+    njs_generator_t *generator, njs_parser_node_t *node);
 static nxt_int_t njs_generate_3addr_operation(njs_vm_t *vm,
     njs_generator_t *generator, njs_parser_node_t *node, nxt_bool_t swap);
+static nxt_int_t njs_generate_property_get(njs_vm_t *vm,
+    njs_generator_t *generator, njs_parser_node_t *node);
+static njs_index_t njs_generate_prop_cache(njs_vm_t *vm,
+    njs_generator_t *generator, njs_parser_node_t *property);
+static nxt_int_t njs_generate_typeof_equal(njs_vm_t *vm,
+    njs_generator_t *generator, njs_parser_node_t *node);
 static nxt_int_t njs_generate_2addr_operation(njs_vm_t *vm,
     njs_generator_t *generator, njs_parser_node_t *node);
 static nxt_int_t njs_generate_typeof_operation(njs_vm_t *vm,
@@ -190,6 +203,7 @@ static nxt_int_t njs_generate_function_debug(njs_vm_t *vm,
         _code->code.operation = _operation;                                   \
         _code->code.operands = 3 - nargs;                                     \
         _code->code.retval = _retval;                                         \
+        _code->code.opcode = njs_generate_opcode(_operation);                 \
     } while (0)
 
 
@@ -251,9 +265,84 @@ static const nxt_str_t  return_label = nxt_string("@return");
 static const nxt_str_t  undef_label  = { 0xffffffff, (u_char *) "" };
 
 
+typedef struct {
+    njs_vmcode_operation_t          operation;
+    njs_vmcode_opcode_t             opcode;
+} njs_generator_opcode_t;
+
+
+/*
+ * A comparison which is used only as a condition of a statement
+ * is generated as a compare-and-jump superinstruction.
+ */
+
+typedef struct {
+    njs_token_t                     token;
+    njs_vmcode_operation_t          if_true;
+    njs_vmcode_operation_t          if_false;
+} njs_generator_cond_jump_t;
+
+
+static const njs_generator_cond_jump_t  njs_generator_cond_jumps[] = {
+    { NJS_TOKEN_LESS,
+      njs_vmcode_if_less_jump, njs_vmcode_if_not_less_jump },
+    { NJS_TOKEN_GREATER,
+      njs_vmcode_if_greater_jump, njs_vmcode_if_not_greater_jump },
+    { NJS_TOKEN_LESS_OR_EQUAL,
+      njs_vmcode_if_less_or_equal_jump,
+      njs_vmcode_if_not_less_or_equal_jump },
+    { NJS_TOKEN_GREATER_OR_EQUAL,
+      njs_vmcode_if_greater_or_equal_jump,
+      njs_vmcode_if_not_greater_or_equal_jump },
+    { NJS_TOKEN_STRICT_EQUAL,
+      njs_vmcode_if_equal_jump, njs_vmcode_if_not_equal_jump },
+    { NJS_TOKEN_STRICT_NOT_EQUAL,
+      njs_vmcode_if_not_equal_jump, njs_vmcode_if_equal_jump },
+};
+
+
+static const njs_generator_opcode_t  njs_generator_opcodes[] = {
+    { njs_vmcode_move,              NJS_OPCODE_MOVE },
+    { njs_vmcode_jump,              NJS_OPCODE_JUMP },
+    { njs_vmcode_if_true_jump,      NJS_OPCODE_IF_TRUE_JUMP },
+    { njs_vmcode_if_false_jump,     NJS_OPCODE_IF_FALSE_JUMP },
+    { njs_vmcode_addition,          NJS_OPCODE_ADDITION },
+    { njs_vmcode_substraction,      NJS_OPCODE_SUBSTRACTION },
+    { njs_vmcode_less,              NJS_OPCODE_LESS },
+    { njs_vmcode_greater,           NJS_OPCODE_GREATER },
+    { njs_vmcode_less_or_equal,     NJS_OPCODE_LESS_OR_EQUAL },
+    { njs_vmcode_greater_or_equal,  NJS_OPCODE_GREATER_OR_EQUAL },
+    { njs_vmcode_if_less_jump,      NJS_OPCODE_IF_LESS_JUMP },
+    { njs_vmcode_if_not_less_jump,  NJS_OPCODE_IF_NOT_LESS_JUMP },
+    { njs_vmcode_if_greater_jump,   NJS_OPCODE_IF_GREATER_JUMP },
+    { njs_vmcode_if_not_greater_jump,
+                                    NJS_OPCODE_IF_NOT_GREATER_JUMP },
+    { njs_vmcode_if_less_or_equal_jump,
+                                    NJS_OPCODE_IF_LESS_OR_EQUAL_JUMP },
+    { njs_vmcode_if_not_less_or_equal_jump,
+                                    NJS_OPCODE_IF_NOT_LESS_OR_EQUAL_JUMP },
+    { njs_vmcode_if_greater_or_equal_jump,
+                                    NJS_OPCODE_IF_GREATER_OR_EQUAL_JUMP },
+    { njs_vmcode_if_not_greater_or_equal_jump,
+                                    NJS_OPCODE_IF_NOT_GREATER_OR_EQUAL_JUMP },
+    { njs_vmcode_increment,         NJS_OPCODE_INCREMENT },
+    { njs_vmcode_decrement,         NJS_OPCODE_DECREMENT },
+    { njs_vmcode_post_increment,    NJS_OPCODE_POST_INCREMENT },
+    { njs_vmcode_post_decrement,    NJS_OPCODE_POST_DECREMENT },
+    { njs_vmcode_property_get,      NJS_OPCODE_PROPERTY_GET },
+    { njs_vmcode_property_set,      NJS_OPCODE_PROPERTY_SET },
+    { njs_vmcode_function_frame,    NJS_OPCODE_FUNCTION_FRAME },
+    { njs_vmcode_method_frame,      NJS_OPCODE_METHOD_FRAME },
+    { njs_vmcode_function_call,     NJS_OPCODE_FUNCTION_CALL },
+    { njs_vmcode_return,            NJS_OPCODE_RETURN },
+};
+
+
 static nxt_int_t
 njs_generator(njs_vm_t *vm, njs_generator_t *generator, njs_parser_node_t *node)
 {
+    nxt_int_t  ret;
+
     if (node == NULL) {
         return NXT_OK;
     }
@@ -319,13 +408,20 @@ njs_generator(njs_vm_t *vm, njs_generator_t *generator, njs_parser_node_t *node)
     case NJS_TOKEN_REMAINDER_ASSIGNMENT:
         return njs_generate_operation_assignment(vm, generator, node);
 
-    case NJS_TOKEN_BITWISE_OR:
-    case NJS_TOKEN_BITWISE_XOR:
-    case NJS_TOKEN_BITWISE_AND:
     case NJS_TOKEN_EQUAL:
     case NJS_TOKEN_NOT_EQUAL:
     case NJS_TOKEN_STRICT_EQUAL:
     case NJS_TOKEN_STRICT_NOT_EQUAL:
+        ret = njs_generate_typeof_equal(vm, generator, node);
+        if (ret != NXT_DECLINED) {
+            return ret;
+        }
+
+        return njs_generate_3addr_operation(vm, generator, node, 0);
+
+    case NJS_TOKEN_BITWISE_OR:
+    case NJS_TOKEN_BITWISE_XOR:
+    case NJS_TOKEN_BITWISE_AND:
     case NJS_TOKEN_INSTANCEOF:
     case NJS_TOKEN_LESS:
     case NJS_TOKEN_LESS_OR_EQUAL:
@@ -341,9 +437,11 @@ njs_generator(njs_vm_t *vm, njs_generator_t *generator, njs_parser_node_t *node)
     case NJS_TOKEN_DIVISION:
     case NJS_TOKEN_REMAINDER:
     case NJS_TOKEN_PROPERTY_DELETE:
-    case NJS_TOKEN_PROPERTY:
         return njs_generate_3addr_operation(vm, generator, node, 0);
 
+    case NJS_TOKEN_PROPERTY:
+        return njs_generate_property_get(vm, generator, node);
+
     case NJS_TOKEN_IN:
         /*
          * An "in" operation is parsed as standard binary expression
@@ -524,6 +622,21 @@ njs_generate_reserve(njs_vm_t *vm, njs_generator_t *generator, size_t size)
 }
 
 
+static nxt_noinline njs_vmcode_opcode_t
+njs_generate_opcode(njs_vmcode_operation_t operation)
+{
+    nxt_uint_t  i;
+
+    for (i = 0; i < nxt_nitems(njs_generator_opcodes); i++) {
+        if (njs_generator_opcodes[i].operation == operation) {
+            return njs_generator_opcodes[i].opcode;
+        }
+    }
+
+    return NJS_OPCODE_GENERIC;
+}
+
+
 static nxt_int_t
 njs_generate_name(njs_vm_t *vm, njs_generator_t *generator,
     njs_parser_node_t *node)
@@ -652,25 +765,19 @@ njs_generate_if_statement(njs_vm_t *vm, njs_generator_t *generator,
     njs_ret_t               jump_offset, label_offset;
     nxt_int_t               ret;
     njs_vmcode_jump_t       *jump;
-    njs_vmcode_cond_jump_t  *cond_jump;
 
     /* The condition expression. */
 
-    ret = njs_generator(vm, generator, node->left);
+    ret = njs_generate_cond_jump(vm, generator, node->left, 0, &jump_offset);
     if (nxt_slow_path(ret != NXT_OK)) {
         return ret;
     }
 
-    njs_generate_code(generator, njs_vmcode_cond_jump_t, cond_jump,
-                      njs_vmcode_if_false_jump, 2, 0);
-    cond_jump->cond = node->left->index;
-
     ret = njs_generate_node_index_release(vm, generator, node->left);
     if (nxt_slow_path(ret != NXT_OK)) {
         return ret;
     }
 
-    jump_offset = njs_code_offset(generator, cond_jump);
     label_offset = jump_offset + offsetof(njs_vmcode_cond_jump_t, offset);
 
     if (node->right != NULL && node->right->token == NJS_TOKEN_BRANCHING) {
@@ -718,6 +825,62 @@ njs_generate_if_statement(njs_vm_t *vm, njs_generator_t *generator,
 }
 
 
+/*
+ * njs_generate_cond_jump() generates a condition expression and a jump
+ * which is taken if the condition is equal to if_true.  The returned
+ * offset of the jump should be patched using njs_vmcode_cond_jump_t.
+ */
+
+static nxt_int_t
+njs_generate_cond_jump(njs_vm_t *vm, njs_generator_t *generator,
+    njs_parser_node_t *cond, nxt_bool_t if_true, njs_ret_t *jump_offset)
+{
+    nxt_int_t                        ret;
+    nxt_uint_t                       i;
+    njs_vmcode_cond_jump_t           *cond_jump;
+    njs_vmcode_equal_jump_t          *cmp_jump;
+    const njs_generator_cond_jump_t  *cj;
+
+    for (i = 0; i < nxt_nitems(njs_generator_cond_jumps); i++) {
+        cj = &njs_generator_cond_jumps[i];
+
+        if (cond->token != cj->token) {
+            continue;
+        }
+
+        ret = njs_generate_binary_operands(vm, generator, cond);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        njs_generate_code(generator, njs_vmcode_equal_jump_t, cmp_jump,
+                          if_true ? cj->if_true : cj->if_false, 3, 0);
+        cmp_jump->offset = sizeof(njs_vmcode_equal_jump_t);
+        cmp_jump->value1 = cond->left->index;
+        cmp_jump->value2 = cond->right->index;
+
+        *jump_offset = njs_code_offset(generator, cmp_jump);
+
+        return njs_generate_children_indexes_release(vm, generator, cond);
+    }
+
+    ret = njs_generator(vm, generator, cond);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    njs_generate_code(generator, njs_vmcode_cond_jump_t, cond_jump,
+                      if_true ? njs_vmcode_if_true_jump
+                              : njs_vmcode_if_false_jump, 2, 0);
+    cond_jump->offset = sizeof(njs_vmcode_cond_jump_t);
+    cond_jump->cond = cond->index;
+
+    *jump_offset = njs_code_offset(generator, cond_jump);
+
+    return NXT_OK;
+}
+
+
 static nxt_int_t
 njs_generate_cond_expression(njs_vm_t *vm, njs_generator_t *generator,
     njs_parser_node_t *node)
@@ -727,21 +890,15 @@ njs_generate_cond_expression(njs_vm_t *vm, njs_generator_t *generator,
     njs_parser_node_t       *branch;
     njs_vmcode_move_t       *move;
     njs_vmcode_jump_t       *jump;
-    njs_vmcode_cond_jump_t  *cond_jump;
 
     /* The condition expression. */
 
-    ret = njs_generator(vm, generator, node->left);
+    ret = njs_generate_cond_jump(vm, generator, node->left, 0,
+                                 &cond_jump_offset);
     if (nxt_slow_path(ret != NXT_OK)) {
         return ret;
     }
 
-    njs_generate_code(generator, njs_vmcode_cond_jump_t, cond_jump,
-                      njs_vmcode_if_false_jump, 2, 0);
-
-    cond_jump_offset = njs_code_offset(generator, cond_jump);
-    cond_jump->cond = node->left->index;
-
     node->index = njs_generate_dest_index(vm, generator, node);
     if (nxt_slow_path(node->index == NJS_INDEX_ERROR)) {
         return node->index;
@@ -974,15 +1131,13 @@ njs_generate_while_statement(njs_vm_t *vm, njs_generator_t *generator,
 
     condition = node->right;
 
-    ret = njs_generator(vm, generator, condition);
+    ret = njs_generate_cond_jump(vm, generator, condition, 1, &jump_offset);
     if (nxt_slow_path(ret != NXT_OK)) {
         return ret;
     }
 
-    njs_generate_code(generator, njs_vmcode_cond_jump_t, cond_jump,
-                      njs_vmcode_if_true_jump, 2, 0);
-    cond_jump->offset = loop_offset - njs_code_offset(generator, cond_jump);
-    cond_jump->cond = condition->index;
+    cond_jump = njs_code_ptr(generator, njs_vmcode_cond_jump_t, jump_offset);
+    cond_jump->offset = loop_offset - jump_offset;
 
     njs_generate_patch_block_exit(vm, generator);
 
@@ -994,7 +1149,7 @@ static nxt_int_t
 njs_generate_do_while_statement(njs_vm_t *vm, njs_generator_t *generator,
     njs_parser_node_t *node)
 {
-    njs_ret_t               loop_offset;
+    njs_ret_t               jump_offset, loop_offset;
     nxt_int_t               ret;
     njs_parser_node_t       *condition;
     njs_vmcode_cond_jump_t  *cond_jump;
@@ -1020,15 +1175,13 @@ njs_generate_do_while_statement(njs_vm_t *vm, njs_generator_t *generator,
 
     condition = node->right;
 
-    ret = njs_generator(vm, generator, condition);
+    ret = njs_generate_cond_jump(vm, generator, condition, 1, &jump_offset);
     if (nxt_slow_path(ret != NXT_OK)) {
         return ret;
     }
 
-    njs_generate_code(generator, njs_vmcode_cond_jump_t, cond_jump,
-                      njs_vmcode_if_true_jump, 2, 0);
-    cond_jump->offset = loop_offset - njs_code_offset(generator, cond_jump);
-    cond_jump->cond = condition->index;
+    cond_jump = njs_code_ptr(generator, njs_vmcode_cond_jump_t, jump_offset);
+    cond_jump->offset = loop_offset - jump_offset;
 
     njs_generate_patch_block_exit(vm, generator);
 
@@ -1114,15 +1267,15 @@ njs_generate_for_statement(njs_vm_t *vm, njs_generator_t *generator,
     if (condition != NULL) {
         njs_code_set_jump_offset(generator, njs_vmcode_jump_t, jump_offset);
 
-        ret = njs_generator(vm, generator, condition);
+        ret = njs_generate_cond_jump(vm, generator, condition, 1,
+                                     &jump_offset);
         if (nxt_slow_path(ret != NXT_OK)) {
             return ret;
         }
 
-        njs_generate_code(generator, njs_vmcode_cond_jump_t, cond_jump,
-                          njs_vmcode_if_true_jump, 2, 0);
-        cond_jump->offset = loop_offset - njs_code_offset(generator, cond_jump);
-        cond_jump->cond = condition->index;
+        cond_jump = njs_code_ptr(generator, njs_vmcode_cond_jump_t,
+                                 jump_offset);
+        cond_jump->offset = loop_offset - jump_offset;
 
         njs_generate_patch_block_exit(vm, generator);
 
@@ -1721,6 +1874,7 @@ njs_generate_assignment(njs_vm_t *vm, njs_generator_t *generator,
                       njs_vmcode_property_set, 3, 0);
     prop_set->value = expr->index;
     prop_set->object = object->index;
+    prop_set->cache = njs_generate_prop_cache(vm, generator, property);
     prop_set->property = property->index;
 
     node->index = expr->index;
@@ -1820,6 +1974,7 @@ njs_generate_operation_assignment(njs_vm_t *vm, njs_generator_t *generator,
                       njs_vmcode_property_get, 3, 1);
     prop_get->value = index;
     prop_get->object = object->index;
+    prop_get->cache = njs_generate_prop_cache(vm, generator, property);
     prop_get->property = property->index;
 
     expr = node->right;
@@ -1839,6 +1994,7 @@ njs_generate_operation_assignment(njs_vm_t *vm, njs_generator_t *generator,
                       njs_vmcode_property_set, 3, 0);
     prop_set->value = node->index;
     prop_set->object = object->index;
+    prop_set->cache = njs_generate_prop_cache(vm, generator, property);
     prop_set->property = property->index;
 
     ret = njs_generate_children_indexes_release(vm, generator, lvalue);
@@ -2005,14 +2161,13 @@ njs_generate_test_jump_expression(njs_vm_t *vm, njs_generator_t *generator,
 
 
 static nxt_int_t
-njs_generate_3addr_operation(njs_vm_t *vm, njs_generator_t *generator,
-    njs_parser_node_t *node, nxt_bool_t swap)
+njs_generate_binary_operands(njs_vm_t *vm, njs_generator_t *generator,
+    njs_parser_node_t *node)
 {
-    nxt_int_t           ret;
-    njs_index_t         index;
-    njs_parser_node_t   *left, *right;
-    njs_vmcode_move_t   *move;
-    njs_vmcode_3addr_t  *code;
+    nxt_int_t          ret;
+    njs_index_t        index;
+    njs_parser_node_t  *left, *right;
+    njs_vmcode_move_t  *move;
 
     left = node->left;
 
@@ -2039,11 +2194,26 @@ njs_generate_3addr_operation(njs_vm_t *vm, njs_generator_t *generator,
         }
     }
 
-    ret = njs_generator(vm, generator, right);
+    return njs_generator(vm, generator, right);
+}
+
+
+static nxt_int_t
+njs_generate_3addr_operation(njs_vm_t *vm, njs_generator_t *generator,
+    njs_parser_node_t *node, nxt_bool_t swap)
+{
+    nxt_int_t           ret;
+    njs_parser_node_t   *left, *right;
+    njs_vmcode_3addr_t  *code;
+
+    ret = njs_generate_binary_operands(vm, generator, node);
     if (nxt_slow_path(ret != NXT_OK)) {
         return ret;
     }
 
+    left = node->left;
+    right = node->right;
+
     njs_generate_code(generator, njs_vmcode_3addr_t, code,
                       node->u.operation, 3, 1);
 
@@ -2074,6 +2244,63 @@ njs_generate_3addr_operation(njs_vm_t *vm, njs_generator_t *generator,
 }
 
 
+static nxt_int_t
+njs_generate_property_get(njs_vm_t *vm, njs_generator_t *generator,
+    njs_parser_node_t *node)
+{
+    nxt_int_t              ret;
+    njs_vmcode_prop_get_t  *prop_get;
+
+    ret = njs_generate_binary_operands(vm, generator, node);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    njs_generate_code(generator, njs_vmcode_prop_get_t, prop_get,
+                      njs_vmcode_property_get, 3, 1);
+    prop_get->object = node->left->index;
+    prop_get->cache = njs_generate_prop_cache(vm, generator, node->right);
+    prop_get->property = node->right->index;
+
+    node->index = njs_generate_dest_index(vm, generator, node);
+    if (nxt_slow_path(node->index == NJS_INDEX_ERROR)) {
+        return node->index;
+    }
+
+    prop_get->value = node->index;
+
+    return NXT_OK;
+}
+
+
+/*
+ * Instructions accessing a property by a constant name which is not
+ * an array index get a property cache slot number, zero means no cache.
+ * The caches are allocated per VM because the code is shared by clones.
+ * The property name operand of such instructions is an atom.
+ */
+
+static njs_index_t
+njs_generate_prop_cache(njs_vm_t *vm, njs_generator_t *generator,
+    njs_parser_node_t *property)
+{
+    njs_index_t  index;
+
+    if (property->token == NJS_TOKEN_STRING
+        && njs_value_to_index(&property->u.value) == NJS_ARRAY_INVALID_INDEX)
+    {
+        index = njs_atom_index(vm, &property->u.value, generator->runtime);
+
+        if (nxt_fast_path(index != NJS_INDEX_NONE)) {
+            property->index = index;
+            return ++vm->prop_caches;
+        }
+    }
+
+    return 0;
+}
+
+
 static nxt_int_t
 njs_generate_2addr_operation(njs_vm_t *vm, njs_generator_t *generator,
     njs_parser_node_t *node)
@@ -2140,6 +2367,73 @@ njs_generate_typeof_operation(njs_vm_t *vm, njs_generator_t *generator,
 }
 
 
+/*
+ * The "typeof value == 'type'" and similar expressions are generated
+ * as a single instruction if the string is a result of "typeof".
+ */
+
+static nxt_int_t
+njs_generate_typeof_equal(njs_vm_t *vm, njs_generator_t *generator,
+    njs_parser_node_t *node)
+{
+    nxt_int_t                  ret, type;
+    njs_parser_node_t          *expr, *name;
+    njs_vmcode_typeof_equal_t  *code;
+
+    if (node->left->token == NJS_TOKEN_TYPEOF
+        && node->right->token == NJS_TOKEN_STRING)
+    {
+        expr = node->left->left;
+        name = node->right;
+
+    } else if (node->right->token == NJS_TOKEN_TYPEOF
+               && node->left->token == NJS_TOKEN_STRING)
+    {
+        expr = node->right->left;
+        name = node->left;
+
+    } else {
+        return NXT_DECLINED;
+    }
+
+    type = njs_typeof_type(&name->u.value);
+    if (type == NXT_DECLINED) {
+        return NXT_DECLINED;
+    }
+
+    if (expr->token == NJS_TOKEN_NAME) {
+        expr->index = njs_variable_typeof(vm, expr);
+
+    } else {
+        ret = njs_generator(vm, generator, expr);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+    }
+
+    njs_generate_code(generator, njs_vmcode_typeof_equal_t, code,
+                      njs_vmcode_typeof_equal, 2, 1);
+    code->value = expr->index;
+    code->type = type;
+    code->negative = (node->token == NJS_TOKEN_NOT_EQUAL
+                      || node->token == NJS_TOKEN_STRICT_NOT_EQUAL);
+
+    ret = njs_generate_node_index_release(vm, generator, expr);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    node->index = njs_generate_dest_index(vm, generator, node);
+    if (nxt_slow_path(node->index == NJS_INDEX_ERROR)) {
+        return node->index;
+    }
+
+    code->retval = node->index;
+
+    return NXT_OK;
+}
+
+
 static nxt_int_t
 njs_generate_inc_dec_operation(njs_vm_t *vm, njs_generator_t *generator,
     njs_parser_node_t *node, nxt_bool_t post)
@@ -2219,6 +2513,7 @@ found:
                       njs_vmcode_property_get, 3, 1);
     prop_get->value = index;
     prop_get->object = lvalue->left->index;
+    prop_get->cache = njs_generate_prop_cache(vm, generator, lvalue->right);
     prop_get->property = lvalue->right->index;
 
     njs_generate_code(generator, njs_vmcode_3addr_t, code,
@@ -2231,6 +2526,7 @@ found:
                       njs_vmcode_property_set, 3, 0);
     prop_set->value = index;
     prop_set->object = lvalue->left->index;
+    prop_set->cache = njs_generate_prop_cache(vm, generator, lvalue->right);
     prop_set->property = lvalue->right->index;
 
     if (post) {
@@ -2582,6 +2878,7 @@ njs_generate_method_call(njs_vm_t *vm, njs_generator_t *generator,
     method_offset = njs_code_offset(generator, method);
     method->code.ctor = node->ctor;
     method->object = prop->left->index;
+    method->cache = njs_generate_prop_cache(vm, generator, prop->right);
     method->method = prop->right->index;
 
     ret = njs_generate_children_indexes_release(vm, generator, prop);
@@ -0,0 +1,1986 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <njs_core.h>
+#include <njs_regexp.h>
+#include <njs_regexp_pattern.h>
+#include <string.h>
+
+
+/*
+ * The magic is "NJSC" on little-endian platforms, an image built on
+ * a platform with another byte order is rejected by the magic check.
+ */
+#define NJS_IMAGE_MAGIC            0x43534a4e
+
+#define NJS_IMAGE_NONE             ((uint32_t) -1)
+
+/* The maximum instruction size. */
+#define NJS_IMAGE_CODE_MAX         64
+
+
+typedef struct {
+    uint32_t                       magic;
+    uint32_t                       version;
+    uint32_t                       layout;
+
+    /* The hash of the image starting from the "size" field. */
+    uint32_t                       hash;
+    uint32_t                       size;
+
+    uint32_t                       codes;
+    uint32_t                       lambdas;
+    uint32_t                       constants;
+    uint32_t                       patterns;
+    uint32_t                       scope_size;
+    uint32_t                       prop_caches;
+} njs_image_header_t;
+
+
+/*
+ * The operands string describes the instruction fields following
+ * the njs_vmcode_t header:
+ *   "i"  an index, the absolute indexes are replaced by constant numbers,
+ *   "l"  a lambda,
+ *   "p"  a regexp pattern,
+ *   "n"  a number or a jump offset stored as is.
+ * The trailing fields of an instruction not described by the string
+ * are also stored as is.
+ */
+
+typedef struct {
+    njs_vmcode_operation_t         operation;
+    size_t                         size;
+    const char                     *operands;
+} njs_image_operation_t;
+
+
+typedef enum {
+    NJS_IMAGE_CODE = 0,
+    NJS_IMAGE_CONSTANT,
+    NJS_IMAGE_ATOM,
+    NJS_IMAGE_EXTERNAL,
+    NJS_IMAGE_LAMBDA,
+    NJS_IMAGE_PATTERN,
+} njs_image_ref_type_t;
+
+
+typedef enum {
+    NJS_IMAGE_PRIMITIVE = 0,
+    NJS_IMAGE_LONG_STRING,
+    NJS_IMAGE_FUNCTION,
+    NJS_IMAGE_SHARED_OBJECT,
+    NJS_IMAGE_SHARED_FUNCTION,
+} njs_image_value_type_t;
+
+
+/* A pointer to the compiled state and its number in the image. */
+
+typedef struct {
+    void                           *pointer;
+    const nxt_str_t                *name;
+    uint32_t                       id;
+    njs_image_ref_type_t           type:8;
+} njs_image_ref_t;
+
+
+typedef struct {
+    u_char                         *start;
+    u_char                         *pos;
+    u_char                         *end;
+} njs_image_buf_t;
+
+
+typedef struct {
+    njs_vm_t                       *vm;
+    nxt_mp_t                       *pool;
+    nxt_lvlhsh_t                   refs;
+
+    /* The referenced objects in the order of their numbers. */
+    njs_image_buf_t                constants;
+    njs_image_buf_t                lambdas;
+    njs_image_buf_t                patterns;
+
+    njs_image_buf_t                tables;
+    njs_image_buf_t                body;
+} njs_image_writer_t;
+
+
+typedef struct {
+    njs_vm_t                       *vm;
+    const u_char                   *pos;
+    const u_char                   *end;
+
+    njs_image_header_t             header;
+
+    njs_index_t                    *constants;
+    njs_regexp_pattern_t           **patterns;
+    njs_function_lambda_t          *lambdas;
+    u_char                         **codes;
+} njs_image_loader_t;
+
+
+static nxt_int_t njs_image_refs_init(njs_image_writer_t *writer);
+static njs_image_ref_t *njs_image_ref_add(njs_image_writer_t *writer,
+    void *pointer, njs_image_ref_type_t type);
+static njs_image_ref_t *njs_image_ref_find(njs_image_writer_t *writer,
+    void *pointer);
+static nxt_int_t njs_image_ref_use(njs_image_writer_t *writer,
+    njs_image_ref_t *ref);
+static nxt_int_t njs_image_ref_test(nxt_lvlhsh_query_t *lhq, void *data);
+static nxt_int_t njs_image_write_code(njs_image_writer_t *writer,
+    njs_vm_code_t *code);
+static nxt_int_t njs_image_write_lambda(njs_image_writer_t *writer,
+    njs_function_lambda_t *lambda);
+static nxt_int_t njs_image_write_values(njs_image_writer_t *writer,
+    const njs_value_t *values, size_t n);
+static nxt_int_t njs_image_write_value(njs_image_writer_t *writer,
+    njs_image_buf_t *buf, const njs_value_t *value);
+static nxt_int_t njs_image_write_debug(njs_image_writer_t *writer);
+static nxt_int_t njs_image_write_variables(njs_image_writer_t *writer);
+static nxt_int_t njs_image_write_tables(njs_image_writer_t *writer);
+static nxt_int_t njs_image_write_str(njs_image_writer_t *writer,
+    njs_image_buf_t *buf, const nxt_str_t *str);
+static nxt_int_t njs_image_write_u32(njs_image_writer_t *writer,
+    njs_image_buf_t *buf, uint32_t n);
+static nxt_int_t njs_image_write(njs_image_writer_t *writer,
+    njs_image_buf_t *buf, const void *data, size_t size);
+static nxt_int_t njs_image_load_code(njs_image_loader_t *loader,
+    nxt_uint_t n);
+static nxt_int_t njs_image_relocate(njs_image_loader_t *loader,
+    u_char *start, u_char *end);
+static nxt_int_t njs_image_load_lambda(njs_image_loader_t *loader,
+    njs_function_lambda_t *lambda);
+static njs_value_t *njs_image_load_values(njs_image_loader_t *loader,
+    size_t n);
+static nxt_int_t njs_image_load_value(njs_image_loader_t *loader,
+    njs_value_t *value);
+static nxt_int_t njs_image_load_debug(njs_image_loader_t *loader);
+static nxt_int_t njs_image_load_variables(njs_image_loader_t *loader);
+static nxt_int_t njs_image_load_tables(njs_image_loader_t *loader);
+static nxt_int_t njs_image_read_str(njs_image_loader_t *loader,
+    nxt_str_t *str);
+static nxt_int_t njs_image_read_u32(njs_image_loader_t *loader,
+    uint32_t *n);
+static nxt_int_t njs_image_read(njs_image_loader_t *loader, void *data,
+    size_t size);
+static uint32_t njs_image_layout(void);
+
+
+/* The order is a part of the image format. */
+
+static const njs_image_operation_t  njs_image_operations[] = {
+
+    { njs_vmcode_object, sizeof(njs_vmcode_object_t), "i" },
+    { njs_vmcode_array, sizeof(njs_vmcode_array_t), "in" },
+    { njs_vmcode_function, sizeof(njs_vmcode_function_t), "il" },
+    { njs_vmcode_arguments, sizeof(njs_vmcode_arguments_t), "i" },
+    { njs_vmcode_regexp, sizeof(njs_vmcode_regexp_t), "ip" },
+    { njs_vmcode_object_copy, sizeof(njs_vmcode_object_copy_t), "ii" },
+
+    { njs_vmcode_property_get, sizeof(njs_vmcode_prop_get_t), "iiin" },
+    { njs_vmcode_property_set, sizeof(njs_vmcode_prop_set_t), "iiin" },
+    { njs_vmcode_property_in, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_property_delete, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_property_foreach, sizeof(njs_vmcode_prop_foreach_t),
+      "iin" },
+    { njs_vmcode_property_next, sizeof(njs_vmcode_prop_next_t), "iiin" },
+    { njs_vmcode_instance_of, sizeof(njs_vmcode_instance_of_t), "iii" },
+
+    { njs_vmcode_increment, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_decrement, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_post_increment, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_post_decrement, sizeof(njs_vmcode_3addr_t), "iii" },
+
+    { njs_vmcode_delete, sizeof(njs_vmcode_2addr_t), "ii" },
+    { njs_vmcode_void, sizeof(njs_vmcode_2addr_t), "ii" },
+    { njs_vmcode_typeof, sizeof(njs_vmcode_2addr_t), "ii" },
+    { njs_vmcode_unary_plus, sizeof(njs_vmcode_2addr_t), "ii" },
+    { njs_vmcode_unary_negation, sizeof(njs_vmcode_2addr_t), "ii" },
+    { njs_vmcode_logical_not, sizeof(njs_vmcode_2addr_t), "ii" },
+    { njs_vmcode_bitwise_not, sizeof(njs_vmcode_2addr_t), "ii" },
+
+    { njs_vmcode_addition, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_substraction, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_multiplication, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_exponentiation, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_division, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_remainder, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_left_shift, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_right_shift, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_unsigned_right_shift, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_bitwise_and, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_bitwise_xor, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_bitwise_or, sizeof(njs_vmcode_3addr_t), "iii" },
+
+    { njs_vmcode_equal, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_not_equal, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_less, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_less_or_equal, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_greater, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_greater_or_equal, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_strict_equal, sizeof(njs_vmcode_3addr_t), "iii" },
+    { njs_vmcode_strict_not_equal, sizeof(njs_vmcode_3addr_t), "iii" },
+
+    { njs_vmcode_move, sizeof(njs_vmcode_move_t), "ii" },
+    { njs_vmcode_typeof_equal, sizeof(njs_vmcode_typeof_equal_t), "ii" },
+
+    { njs_vmcode_jump, sizeof(njs_vmcode_jump_t), "n" },
+    { njs_vmcode_if_true_jump, sizeof(njs_vmcode_cond_jump_t), "ni" },
+    { njs_vmcode_if_false_jump, sizeof(njs_vmcode_cond_jump_t), "ni" },
+    { njs_vmcode_test_if_true, sizeof(njs_vmcode_test_jump_t), "iin" },
+    { njs_vmcode_test_if_false, sizeof(njs_vmcode_test_jump_t), "iin" },
+
+    { njs_vmcode_if_equal_jump, sizeof(njs_vmcode_equal_jump_t), "nii" },
+    { njs_vmcode_if_not_equal_jump, sizeof(njs_vmcode_equal_jump_t),
+      "nii" },
+    { njs_vmcode_if_less_jump, sizeof(njs_vmcode_equal_jump_t), "nii" },
+    { njs_vmcode_if_not_less_jump, sizeof(njs_vmcode_equal_jump_t), "nii" },
+    { njs_vmcode_if_greater_jump, sizeof(njs_vmcode_equal_jump_t), "nii" },
+    { njs_vmcode_if_not_greater_jump, sizeof(njs_vmcode_equal_jump_t),
+      "nii" },
+    { njs_vmcode_if_less_or_equal_jump, sizeof(njs_vmcode_equal_jump_t),
+      "nii" },
+    { njs_vmcode_if_not_less_or_equal_jump, sizeof(njs_vmcode_equal_jump_t),
+      "nii" },
+    { njs_vmcode_if_greater_or_equal_jump, sizeof(njs_vmcode_equal_jump_t),
+      "nii" },
+    { njs_vmcode_if_not_greater_or_equal_jump,
+      sizeof(njs_vmcode_equal_jump_t), "nii" },
+
+    { njs_vmcode_function_frame, sizeof(njs_vmcode_function_frame_t),
+      "ni" },
+    { njs_vmcode_method_frame, sizeof(njs_vmcode_method_frame_t), "niin" },
+    { njs_vmcode_function_call, sizeof(njs_vmcode_function_call_t), "i" },
+    { njs_vmcode_return, sizeof(njs_vmcode_return_t), "i" },
+    { njs_vmcode_stop, sizeof(njs_vmcode_stop_t), "i" },
+
+    { njs_vmcode_try_start, sizeof(njs_vmcode_try_start_t), "nii" },
+    { njs_vmcode_try_break, sizeof(njs_vmcode_try_trampoline_t), "ni" },
+    { njs_vmcode_try_continue, sizeof(njs_vmcode_try_trampoline_t), "ni" },
+    { njs_vmcode_try_return, sizeof(njs_vmcode_try_return_t), "iin" },
+    { njs_vmcode_catch, sizeof(njs_vmcode_catch_t), "ni" },
+    { njs_vmcode_try_end, sizeof(njs_vmcode_try_end_t), "n" },
+    { njs_vmcode_finally, sizeof(njs_vmcode_finally_t), "iinn" },
+    { njs_vmcode_throw, sizeof(njs_vmcode_throw_t), "i" },
+};
+
+
+static const nxt_lvlhsh_proto_t  njs_image_ref_hash_proto
+    nxt_aligned(64) =
+{
+    NXT_LVLHSH_DEFAULT,
+    0,
+    njs_image_ref_test,
+    njs_lvlhsh_alloc,
+    njs_lvlhsh_free,
+};
+
+
+/* The references are keyed by pointers. */
+
+#define njs_image_query_init(lhq, pointer)                                    \
+    do {                                                                      \
+        (lhq)->key.length = sizeof(void *);                                   \
+        (lhq)->key.start = (u_char *) &(pointer);                             \
+        (lhq)->key_hash = nxt_djb_hash(&(pointer), sizeof(void *));           \
+    } while (0)
+
+
+#define njs_image_refs(buf)                                                   \
+    (((buf)->pos - (buf)->start) / sizeof(njs_image_ref_t *))
+
+
+#define njs_image_constant_index(id)                                          \
+    ((njs_index_t) (((uintptr_t) (id) + 1) << NJS_SCOPE_SHIFT))
+
+
+/*
+ * njs_vm_image() serializes the compiled state of a VM.  The code uses
+ * the global scope and the externals of the VM, so the image is created
+ * before the VM is run.  The state which cannot be serialized, namely
+ * the code of the accumulative mode and modules, is declined.
+ */
+
+nxt_int_t
+njs_vm_image(njs_vm_t *vm, nxt_str_t *image)
+{
+    u_char              *p;
+    size_t              size;
+    nxt_int_t           ret;
+    nxt_uint_t          n;
+    njs_vm_code_t       *code;
+    njs_image_header_t  *header;
+    njs_image_writer_t  writer;
+
+    if (vm->code == NULL || vm->code->items == 0) {
+        return NXT_ERROR;
+    }
+
+    if (vm->options.accumulative
+        || (vm->modules != NULL && vm->modules->items != 0))
+    {
+        return NXT_DECLINED;
+    }
+
+    nxt_memzero(&writer, sizeof(njs_image_writer_t));
+
+    writer.vm = vm;
+
+    writer.pool = nxt_mp_create(&njs_vm_mp_proto, NULL, NULL,
+                                2 * nxt_pagesize(), 128, 512, 16);
+    if (nxt_slow_path(writer.pool == NULL)) {
+        return NXT_ERROR;
+    }
+
+    nxt_lvlhsh_init(&writer.refs);
+
+    ret = njs_image_refs_init(&writer);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        goto done;
+    }
+
+    /* The global code is the last one. */
+
+    code = vm->code->start;
+
+    for (n = 0; n < vm->code->items; n++) {
+        ret = njs_image_write_code(&writer, &code[n]);
+        if (ret != NXT_OK) {
+            goto done;
+        }
+    }
+
+    ret = njs_image_write_values(&writer, vm->global_scope,
+                                 vm->scope_size / sizeof(njs_value_t));
+    if (ret != NXT_OK) {
+        goto done;
+    }
+
+    ret = njs_image_write_debug(&writer);
+    if (ret != NXT_OK) {
+        goto done;
+    }
+
+    /* The lambda scopes may refer to the lambdas not written yet. */
+
+    for (n = 0; n < njs_image_refs(&writer.lambdas); n++) {
+        ret = njs_image_write_lambda(&writer,
+                       ((njs_image_ref_t **) writer.lambdas.start)[n]->pointer);
+        if (ret != NXT_OK) {
+            goto done;
+        }
+    }
+
+    ret = njs_image_write_variables(&writer);
+    if (ret != NXT_OK) {
+        goto done;
+    }
+
+    ret = njs_image_write_tables(&writer);
+    if (ret != NXT_OK) {
+        goto done;
+    }
+
+    size = sizeof(njs_image_header_t)
+           + (writer.tables.pos - writer.tables.start)
+           + (writer.body.pos - writer.body.start);
+
+    p = nxt_mp_alloc(vm->mem_pool, size);
+    if (nxt_slow_path(p == NULL)) {
+        ret = NXT_ERROR;
+        goto done;
+    }
+
+    image->start = p;
+    image->length = size;
+
+    header = (njs_image_header_t *) p;
+
+    header->magic = NJS_IMAGE_MAGIC;
+    header->version = NJS_IMAGE_VERSION;
+    header->layout = njs_image_layout();
+    header->size = size;
+    header->codes = vm->code->items;
+    header->lambdas = njs_image_refs(&writer.lambdas);
+    header->constants = njs_image_refs(&writer.constants);
+    header->patterns = njs_image_refs(&writer.patterns);
+    header->scope_size = vm->scope_size;
+    header->prop_caches = vm->prop_caches;
+
+    p += sizeof(njs_image_header_t);
+
+    /* The buffers are not allocated if nothing was written. */
+
+    if (writer.tables.pos != writer.tables.start) {
+        p = nxt_cpymem(p, writer.tables.start,
+                       writer.tables.pos - writer.tables.start);
+    }
+
+    if (writer.body.pos != writer.body.start) {
+        p = nxt_cpymem(p, writer.body.start,
+                       writer.body.pos - writer.body.start);
+    }
+
+    p = (u_char *) &header->size;
+    header->hash = nxt_djb_hash(p, image->start + size - p);
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_mp_destroy(writer.pool);
+
+    return ret;
+}
+
+
+nxt_bool_t
+njs_vm_is_image(const u_char *start, const u_char *end)
+{
+    uint32_t  magic;
+
+    if ((size_t) (end - start) < sizeof(njs_image_header_t)) {
+        return 0;
+    }
+
+    memcpy(&magic, start, sizeof(uint32_t));
+
+    return (magic == NJS_IMAGE_MAGIC);
+}
+
+
+/*
+ * The absolute operands may refer to the constant values, the property
+ * name atoms and the externals.  All of them are added to the references
+ * in advance, an absolute operand which is not found is declined.
+ */
+
+static nxt_int_t
+njs_image_refs_init(njs_image_writer_t *writer)
+{
+    njs_vm_t            *vm;
+    nxt_uint_t          n, i;
+    njs_atom_t          *atom;
+    njs_value_t         *value;
+    njs_vm_code_t       *code;
+    njs_image_ref_t     *ref;
+    nxt_lvlhsh_t        *hash;
+    nxt_lvlhsh_each_t   lhe;
+    njs_extern_value_t  *ev;
+
+    vm = writer->vm;
+
+    for (i = 0; i < 2; i++) {
+        hash = (i == 0) ? &vm->shared->values_hash : &vm->values_hash;
+
+        nxt_lvlhsh_each_init(&lhe, &njs_values_hash_proto);
+
+        for ( ;; ) {
+            value = nxt_lvlhsh_each(hash, &lhe);
+            if (value == NULL) {
+                break;
+            }
+
+            if (njs_image_ref_add(writer, value, NJS_IMAGE_CONSTANT) == NULL) {
+                return NXT_ERROR;
+            }
+        }
+
+        hash = (i == 0) ? &vm->shared->atoms_hash : &vm->atoms_hash;
+
+        nxt_lvlhsh_each_init(&lhe, &njs_atoms_hash_proto);
+
+        for ( ;; ) {
+            atom = nxt_lvlhsh_each(hash, &lhe);
+            if (atom == NULL) {
+                break;
+            }
+
+            if (njs_image_ref_add(writer, atom, NJS_IMAGE_ATOM) == NULL) {
+                return NXT_ERROR;
+            }
+        }
+    }
+
+    nxt_lvlhsh_each_init(&lhe, &njs_extern_value_hash_proto);
+
+    for ( ;; ) {
+        ev = nxt_lvlhsh_each(&vm->externals_hash, &lhe);
+        if (ev == NULL) {
+            break;
+        }
+
+        ref = njs_image_ref_add(writer, &ev->value, NJS_IMAGE_EXTERNAL);
+        if (nxt_slow_path(ref == NULL)) {
+            return NXT_ERROR;
+        }
+
+        ref->name = &ev->name;
+    }
+
+    code = vm->code->start;
+
+    for (n = 0; n < vm->code->items; n++) {
+        ref = njs_image_ref_add(writer, code[n].start, NJS_IMAGE_CODE);
+        if (nxt_slow_path(ref == NULL)) {
+            return NXT_ERROR;
+        }
+
+        ref->id = n;
+    }
+
+    return NXT_OK;
+}
+
+
+static njs_image_ref_t *
+njs_image_ref_add(njs_image_writer_t *writer, void *pointer,
+    njs_image_ref_type_t type)
+{
+    nxt_int_t           ret;
+    njs_image_ref_t     *ref;
+    nxt_lvlhsh_query_t  lhq;
+
+    ref = nxt_mp_zalloc(writer->pool, sizeof(njs_image_ref_t));
+    if (nxt_slow_path(ref == NULL)) {
+        return NULL;
+    }
+
+    ref->pointer = pointer;
+    ref->type = type;
+    ref->id = NJS_IMAGE_NONE;
+
+    njs_image_query_init(&lhq, pointer);
+    lhq.proto = &njs_image_ref_hash_proto;
+    lhq.replace = 0;
+    lhq.value = ref;
+    lhq.pool = writer->pool;
+
+    ret = nxt_lvlhsh_insert(&writer->refs, &lhq);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NULL;
+    }
+
+    return ref;
+}
+
+
+static njs_image_ref_t *
+njs_image_ref_find(njs_image_writer_t *writer, void *pointer)
+{
+    nxt_lvlhsh_query_t  lhq;
+
+    njs_image_query_init(&lhq, pointer);
+    lhq.proto = &njs_image_ref_hash_proto;
+
+    if (nxt_lvlhsh_find(&writer->refs, &lhq) == NXT_OK) {
+        return lhq.value;
+    }
+
+    return NULL;
+}
+
+
+/* The objects are numbered in the order of the first reference. */
+
+static nxt_int_t
+njs_image_ref_use(njs_image_writer_t *writer, njs_image_ref_t *ref)
+{
+    njs_image_buf_t  *refs;
+
+    if (ref->id != NJS_IMAGE_NONE) {
+        return NXT_OK;
+    }
+
+    switch (ref->type) {
+
+    case NJS_IMAGE_LAMBDA:
+        refs = &writer->lambdas;
+        break;
+
+    case NJS_IMAGE_PATTERN:
+        refs = &writer->patterns;
+        break;
+
+    default:
+        refs = &writer->constants;
+        break;
+    }
+
+    ref->id = njs_image_refs(refs);
+
+    return njs_image_write(writer, refs, &ref, sizeof(njs_image_ref_t *));
+}
+
+
+static nxt_int_t
+njs_image_ref_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    njs_image_ref_t  *ref;
+
+    ref = data;
+
+    if (*(void **) lhq->key.start == ref->pointer) {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+static njs_image_ref_t *
+njs_image_object(njs_image_writer_t *writer, void *pointer,
+    njs_image_ref_type_t type)
+{
+    njs_image_ref_t  *ref;
+
+    ref = njs_image_ref_find(writer, pointer);
+
+    if (ref == NULL) {
+        ref = njs_image_ref_add(writer, pointer, type);
+        if (nxt_slow_path(ref == NULL)) {
+            return NULL;
+        }
+    }
+
+    if (nxt_slow_path(njs_image_ref_use(writer, ref) != NXT_OK)) {
+        return NULL;
+    }
+
+    return ref;
+}
+
+
+static const njs_image_operation_t *
+njs_image_operation(njs_vmcode_operation_t operation)
+{
+    nxt_uint_t  n;
+
+    for (n = 0; n < nxt_nitems(njs_image_operations); n++) {
+        if (operation == njs_image_operations[n].operation) {
+            return &njs_image_operations[n];
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * A code is stored as the file and function names, the code size and
+ * the instructions.  The operation of an instruction is replaced by
+ * its number in the operations table.
+ */
+
+static nxt_int_t
+njs_image_write_code(njs_image_writer_t *writer, njs_vm_code_t *code)
+{
+    u_char                       *p;
+    uintptr_t                    *field;
+    nxt_int_t                    ret;
+    const char                   *operand;
+    njs_image_ref_t              *ref;
+    njs_image_buf_t              *buf;
+    njs_vmcode_generic_t         *vmcode;
+    const njs_image_operation_t  *op;
+    uintptr_t                    insn[NJS_IMAGE_CODE_MAX / sizeof(uintptr_t)];
+
+    buf = &writer->body;
+
+    ret = njs_image_write_str(writer, buf, &code->file);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    ret = njs_image_write_str(writer, buf, &code->name);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    ret = njs_image_write_u32(writer, buf, code->end - code->start);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    for (p = code->start; p < code->end; p += op->size) {
+        vmcode = (njs_vmcode_generic_t *) p;
+
+        op = njs_image_operation(vmcode->code.operation);
+        if (op == NULL) {
+            return NXT_DECLINED;
+        }
+
+        memcpy(insn, p, op->size);
+
+        /* The operation is the first field of an instruction. */
+        insn[0] = op - njs_image_operations;
+
+        field = (uintptr_t *) ((u_char *) insn + sizeof(njs_vmcode_t));
+
+        for (operand = op->operands; *operand != '\0'; operand++, field++) {
+
+            switch (*operand) {
+
+            case 'i':
+                if (*field == NJS_INDEX_NONE
+                    || njs_scope_type(*field) != NJS_SCOPE_ABSOLUTE)
+                {
+                    continue;
+                }
+
+                ref = njs_image_ref_find(writer, (void *) *field);
+
+                if (ref == NULL
+                    || ref->type == NJS_IMAGE_CODE
+                    || ref->type == NJS_IMAGE_LAMBDA
+                    || ref->type == NJS_IMAGE_PATTERN)
+                {
+                    return NXT_DECLINED;
+                }
+
+                ret = njs_image_ref_use(writer, ref);
+                if (nxt_slow_path(ret != NXT_OK)) {
+                    return ret;
+                }
+
+                *field = njs_image_constant_index(ref->id);
+                break;
+
+            case 'l':
+                ref = njs_image_object(writer, (void *) *field,
+                                       NJS_IMAGE_LAMBDA);
+                if (nxt_slow_path(ref == NULL)) {
+                    return NXT_ERROR;
+                }
+
+                *field = ref->id;
+                break;
+
+            case 'p':
+                ref = njs_image_object(writer, (void *) *field,
+                                       NJS_IMAGE_PATTERN);
+                if (nxt_slow_path(ref == NULL)) {
+                    return NXT_ERROR;
+                }
+
+                *field = ref->id;
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        ret = njs_image_write(writer, buf, insn, op->size);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+njs_image_write_lambda(njs_image_writer_t *writer,
+    njs_function_lambda_t *lambda)
+{
+    size_t           n;
+    nxt_int_t        ret;
+    njs_image_ref_t  *ref;
+    njs_image_buf_t  *buf;
+    uint8_t          flags[3];
+
+    buf = &writer->body;
+
+    ref = njs_image_ref_find(writer, lambda->start);
+    if (ref == NULL || ref->type != NJS_IMAGE_CODE) {
+        return NXT_DECLINED;
+    }
+
+    ret = njs_image_write_u32(writer, buf, ref->id);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    ret = njs_image_write_u32(writer, buf, lambda->nargs);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    ret = njs_image_write_u32(writer, buf, lambda->local_size);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    ret = njs_image_write_u32(writer, buf, lambda->closure_size);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    flags[0] = lambda->nesting;
+    flags[1] = lambda->block_closures;
+    flags[2] = lambda->rest_parameters;
+
+    ret = njs_image_write(writer, buf, flags, sizeof(flags));
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    ret = njs_image_write_values(writer, lambda->local_scope,
+                                 lambda->local_size / sizeof(njs_value_t));
+    if (ret != NXT_OK) {
+        return ret;
+    }
+
+    /* The first closure value is not stored in the closure scope. */
+
+    n = 0;
+
+    if (lambda->closure_size != 0) {
+        n = lambda->closure_size / sizeof(njs_value_t) - 1;
+    }
+
+    return njs_image_write_values(writer, lambda->closure_scope, n);
+}
+
+
+static nxt_int_t
+njs_image_write_values(njs_image_writer_t *writer, const njs_value_t *values,
+    size_t n)
+{
+    nxt_int_t  ret;
+
+    while (n != 0) {
+        ret = njs_image_write_value(writer, &writer->body, values);
+        if (ret != NXT_OK) {
+            return ret;
+        }
+
+        values++;
+        n--;
+    }
+
+    return NXT_OK;
+}
+
+
+/*
+ * The primitive values are stored as is, the long strings are stored
+ * by the content, the functions are stored by the lambda numbers and
+ * the built-in objects and functions are stored by the numbers in the
+ * shared VM state.  Other values cannot be created by the compiler.
+ */
+
+static nxt_int_t
+njs_image_write_value(njs_image_writer_t *writer, njs_image_buf_t *buf,
+    const njs_value_t *value)
+{
+    u_char                  type;
+    uint32_t                id;
+    nxt_int_t               ret;
+    nxt_str_t               str;
+    njs_object_t            *object;
+    njs_function_t          *function;
+    njs_image_ref_t         *ref;
+    njs_vm_shared_t         *shared;
+
+    shared = writer->vm->shared;
+
+    if (njs_is_function(value)) {
+        function = value->data.u.function;
+
+        if (function->native) {
+            if (function < &shared->functions[0]
+                || function >= &shared->functions[NJS_FUNCTION_MAX])
+            {
+                return NXT_DECLINED;
+            }
+
+            type = NJS_IMAGE_SHARED_FUNCTION;
+            id = function - &shared->functions[0];
+
+        } else {
+            ref = njs_image_object(writer, function->u.lambda,
+                                   NJS_IMAGE_LAMBDA);
+            if (nxt_slow_path(ref == NULL)) {
+                return NXT_ERROR;
+            }
+
+            type = NJS_IMAGE_FUNCTION;
+            id = ref->id;
+        }
+
+        goto id;
+    }
+
+    if (value->type == NJS_OBJECT) {
+        object = value->data.u.object;
+
+        if (object < &shared->objects[0]
+            || object >= &shared->objects[NJS_OBJECT_MAX])
+        {
+            return NXT_DECLINED;
+        }
+
+        type = NJS_IMAGE_SHARED_OBJECT;
+        id = object - &shared->objects[0];
+
+        goto id;
+    }
+
+    if (njs_is_string(value) && value->short_string.size == NJS_STRING_LONG) {
+        type = NJS_IMAGE_LONG_STRING;
+
+        ret = njs_image_write(writer, buf, &type, sizeof(u_char));
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        ret = njs_image_write_u32(writer, buf,
+                                  value->long_string.data->length);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        str.length = value->long_string.size;
+        str.start = value->long_string.data->start;
+
+        return njs_image_write_str(writer, buf, &str);
+    }
+
+    if (njs_is_primitive(value) || value->type == NJS_INVALID) {
+        type = NJS_IMAGE_PRIMITIVE;
+
+        ret = njs_image_write(writer, buf, &type, sizeof(u_char));
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        return njs_image_write(writer, buf, value, sizeof(njs_value_t));
+    }
+
+    return NXT_DECLINED;
+
+id:
+
+    ret = njs_image_write(writer, buf, &type, sizeof(u_char));
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    return njs_image_write_u32(writer, buf, id);
+}
+
+
+static nxt_int_t
+njs_image_write_debug(njs_image_writer_t *writer)
+{
+    uint32_t              lambda;
+    njs_vm_t              *vm;
+    nxt_int_t             ret;
+    nxt_uint_t            n, items;
+    njs_image_ref_t       *ref;
+    njs_image_buf_t       *buf;
+    njs_function_debug_t  *debug;
+
+    vm = writer->vm;
+    buf = &writer->body;
+
+    items = (vm->debug != NULL) ? vm->debug->items : 0;
+
+    ret = njs_image_write_u32(writer, buf, items);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    for (n = 0; n < items; n++) {
+        debug = nxt_array_item(vm->debug, n);
+
+        lambda = NJS_IMAGE_NONE;
+
+        if (debug->lambda != NULL) {
+            ref = njs_image_object(writer, debug->lambda, NJS_IMAGE_LAMBDA);
+            if (nxt_slow_path(ref == NULL)) {
+                return NXT_ERROR;
+            }
+
+            lambda = ref->id;
+        }
+
+        ret = njs_image_write_u32(writer, buf, lambda);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        ret = njs_image_write_u32(writer, buf, debug->line);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        ret = njs_image_write_str(writer, buf, &debug->file);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        ret = njs_image_write_str(writer, buf, &debug->name);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+njs_image_write_variables(njs_image_writer_t *writer)
+{
+    size_t             offset;
+    uint32_t           items;
+    nxt_int_t          ret;
+    njs_variable_t     *var;
+    njs_image_buf_t    *buf;
+    nxt_lvlhsh_each_t  lhe;
+
+    buf = &writer->body;
+
+    offset = buf->pos - buf->start;
+    items = 0;
+
+    ret = njs_image_write_u32(writer, buf, items);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    nxt_lvlhsh_each_init(&lhe, &njs_variables_hash_proto);
+
+    for ( ;; ) {
+        var = nxt_lvlhsh_each(&writer->vm->variables_hash, &lhe);
+        if (var == NULL) {
+            break;
+        }
+
+        ret = njs_image_write_str(writer, buf, &var->name);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        ret = njs_image_write_u32(writer, buf, var->type);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        ret = njs_image_write(writer, buf, &var->index, sizeof(njs_index_t));
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        items++;
+    }
+
+    memcpy(buf->start + offset, &items, sizeof(uint32_t));
+
+    return NXT_OK;
+}
+
+
+/* The constants and the patterns are loaded before the code. */
+
+static nxt_int_t
+njs_image_write_tables(njs_image_writer_t *writer)
+{
+    u_char                *source;
+    nxt_int_t             ret;
+    nxt_str_t             str;
+    nxt_uint_t            n;
+    njs_image_ref_t       **refs;
+    njs_image_buf_t       *buf;
+    njs_regexp_pattern_t  *pattern;
+    u_char                flags;
+
+    buf = &writer->tables;
+
+    refs = (njs_image_ref_t **) writer->constants.start;
+
+    for (n = 0; n < njs_image_refs(&writer->constants); n++) {
+        flags = refs[n]->type;
+
+        ret = njs_image_write(writer, buf, &flags, sizeof(u_char));
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        if (refs[n]->type == NJS_IMAGE_EXTERNAL) {
+            ret = njs_image_write_str(writer, buf, refs[n]->name);
+
+        } else {
+            /* The atom name is the first field of the atom. */
+            ret = njs_image_write_value(writer, buf, refs[n]->pointer);
+        }
+
+        if (ret != NXT_OK) {
+            return ret;
+        }
+    }
+
+    refs = (njs_image_ref_t **) writer->patterns.start;
+
+    for (n = 0; n < njs_image_refs(&writer->patterns); n++) {
+        pattern = refs[n]->pointer;
+
+        /* The source is stored as "/pattern/flags". */
+        source = &pattern->source[1];
+
+        str.start = source;
+        str.length = (u_char *) strrchr((char *) source, '/') - source;
+
+        ret = njs_image_write_str(writer, buf, &str);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+
+        flags = 0;
+
+        if (pattern->global) {
+            flags |= NJS_REGEXP_GLOBAL;
+        }
+
+        if (pattern->ignore_case) {
+            flags |= NJS_REGEXP_IGNORE_CASE;
+        }
+
+        if (pattern->multiline) {
+            flags |= NJS_REGEXP_MULTILINE;
+        }
+
+        ret = njs_image_write(writer, buf, &flags, sizeof(u_char));
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+njs_image_write_str(njs_image_writer_t *writer, njs_image_buf_t *buf,
+    const nxt_str_t *str)
+{
+    nxt_int_t  ret;
+
+    ret = njs_image_write_u32(writer, buf, str->length);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
+    return njs_image_write(writer, buf, str->start, str->length);
+}
+
+
+static nxt_int_t
+njs_image_write_u32(njs_image_writer_t *writer, njs_image_buf_t *buf,
+    uint32_t n)
+{
+    return njs_image_write(writer, buf, &n, sizeof(uint32_t));
+}
+
+
+static nxt_int_t
+njs_image_write(njs_image_writer_t *writer, njs_image_buf_t *buf,
+    const void *data, size_t size)
+{
+    u_char  *p;
+    size_t  length, capacity;
+
+    if ((size_t) (buf->end - buf->pos) < size) {
+        length = buf->pos - buf->start;
+        capacity = nxt_max(2 * (size_t) (buf->end - buf->start), 256);
+
+        while (capacity < length + size) {
+            capacity *= 2;
+        }
+
+        p = nxt_mp_alloc(writer->pool, capacity);
+        if (nxt_slow_path(p == NULL)) {
+            return NXT_ERROR;
+        }
+
+        if (buf->start != NULL) {
+            memcpy(p, buf->start, length);
+            nxt_mp_free(writer->pool, buf->start);
+        }
+
+        buf->start = p;
+        buf->pos = p + length;
+        buf->end = p + capacity;
+    }
+
+    if (size != 0) {
+        buf->pos = nxt_cpymem(buf->pos, data, size);
+    }
+
+    return NXT_OK;
+}
+
+
+/*
+ * njs_image_load() creates the compiled state in the VM memory pool,
+ * so the image memory can be unmapped or freed after the load.
+ */
+
+nxt_int_t
+njs_image_load(njs_vm_t *vm, const u_char *start, const u_char *end)
+{
+    uint32_t              hash;
+    nxt_int_t             ret;
+    nxt_uint_t            n;
+    njs_image_header_t    *header;
+    njs_image_loader_t    loader;
+
+    nxt_memzero(&loader, sizeof(njs_image_loader_t));
+
+    loader.vm = vm;
+    loader.pos = start;
+    loader.end = end;
+
+    header = &loader.header;
+
+    if (njs_image_read(&loader, header, sizeof(njs_image_header_t)) != NXT_OK
+        || header->magic != NJS_IMAGE_MAGIC)
+    {
+        njs_internal_error(vm, "invalid script image");
+        return NXT_ERROR;
+    }
+
+    if (header->version != NJS_IMAGE_VERSION
+        || header->layout != njs_image_layout())
+    {
+        njs_internal_error(vm, "incompatible script image version");
+        return NXT_ERROR;
+    }
+
+    if (header->size != (size_t) (end - start) || header->codes == 0) {
+        goto invalid;
+    }
+
+    hash = nxt_djb_hash(&((njs_image_header_t *) start)->size,
+                        end - (u_char *) &((njs_image_header_t *) start)->size);
+
+    if (hash != header->hash) {
+        goto invalid;
+    }
+
+    ret = njs_image_load_tables(&loader);
+    if (ret != NXT_OK) {
+        return ret;
+    }
+
+    if (header->lambdas != 0) {
+        loader.lambdas = nxt_mp_zalloc(vm->mem_pool, header->lambdas
+                                             * sizeof(njs_function_lambda_t));
+        if (nxt_slow_path(loader.lambdas == NULL)) {
+            goto memory_error;
+        }
+    }
+
+    loader.codes = nxt_mp_alloc(vm->mem_pool, header->codes * sizeof(u_char *));
+    if (nxt_slow_path(loader.codes == NULL)) {
+        goto memory_error;
+    }
+
+    vm->code = nxt_array_create(header->codes, sizeof(njs_vm_code_t),
+                                &njs_array_mem_proto, vm->mem_pool);
+    if (nxt_slow_path(vm->code == NULL)) {
+        goto memory_error;
+    }
+
+    for (n = 0; n < header->codes; n++) {
+        ret = njs_image_load_code(&loader, n);
+        if (ret != NXT_OK) {
+            return ret;
+        }
+    }
+
+    if (header->scope_size % sizeof(njs_value_t) != 0) {
+        goto invalid;
+    }
+
+    vm->global_scope = njs_image_load_values(&loader,
+                                     header->scope_size / sizeof(njs_value_t));
+    if (vm->global_scope == NULL) {
+        return NXT_ERROR;
+    }
+
+    vm->scope_size = header->scope_size;
+
+    ret = njs_image_load_debug(&loader);
+    if (ret != NXT_OK) {
+        return ret;
+    }
+
+    for (n = 0; n < header->lambdas; n++) {
+        ret = njs_image_load_lambda(&loader, &loader.lambdas[n]);
+        if (ret != NXT_OK) {
+            return ret;
+        }
+    }
+
+    ret = njs_image_load_variables(&loader);
+    if (ret != NXT_OK) {
+        return ret;
+    }
+
+    if (loader.pos != loader.end) {
+        goto invalid;
+    }
+
+    vm->current = loader.codes[header->codes - 1];
+    vm->prop_caches = header->prop_caches;
+
+    return NXT_OK;
+
+memory_error:
+
+    njs_memory_error(vm);
+
+    return NXT_ERROR;
+
+invalid:
+
+    njs_internal_error(vm, "invalid script image");
+
+    return NXT_ERROR;
+}
+
+
+static nxt_int_t
+njs_image_load_code(njs_image_loader_t *loader, nxt_uint_t n)
+{
+    u_char         *start;
+    uint32_t       size;
+    nxt_int_t      ret;
+    nxt_str_t      file, name;
+    njs_vm_code_t  *code;
+
+    if (njs_image_read_str(loader, &file) != NXT_OK
+        || njs_image_read_str(loader, &name) != NXT_OK
+        || njs_image_read_u32(loader, &size) != NXT_OK
+        || (size_t) (loader->end - loader->pos) < size)
+    {
+        return NXT_ERROR;
+    }
+
+    start = nxt_mp_alloc(loader->vm->mem_pool, size);
+    if (nxt_slow_path(start == NULL)) {
+        njs_memory_error(loader->vm);
+        return NXT_ERROR;
+    }
+
+    (void) njs_image_read(loader, start, size);
+
+    ret = njs_image_relocate(loader, start, start + size);
+    if (ret != NXT_OK) {
+        return ret;
+    }
+
+    code = nxt_array_add(loader->vm->code, &njs_array_mem_proto,
+                         loader->vm->mem_pool);
+    if (nxt_slow_path(code == NULL)) {
+        njs_memory_error(loader->vm);
+        return NXT_ERROR;
+    }
+
+    code->start = start;
+    code->end = start + size;
+    code->file = file;
+    code->name = name;
+
+    loader->codes[n] = start;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+njs_image_relocate(njs_image_loader_t *loader, u_char *start, u_char *end)
+{
+    u_char                       *p;
+    uintptr_t                    n, *field;
+    const char                   *operand;
+    njs_vmcode_t                 *vmcode;
+    njs_image_header_t           *header;
+    const njs_image_operation_t  *op;
+
+    header = &loader->header;
+
+    for (p = start; p < end; p += op->size) {
+        if ((size_t) (end - p) < sizeof(njs_vmcode_t)) {
+            goto invalid;
+        }
+
+        vmcode = (njs_vmcode_t *) p;
+
+        n = *(uintptr_t *) p;
+
+        if (n >= nxt_nitems(njs_image_operations)
+            || vmcode->opcode > NJS_OPCODE_RETURN)
+        {
+            goto invalid;
+        }
+
+        op = &njs_image_operations[n];
+
+        if ((size_t) (end - p) < op->size) {
+            goto invalid;
+        }
+
+        vmcode->operation = op->operation;
+
+        field = (uintptr_t *) (p + sizeof(njs_vmcode_t));
+
+        for (operand = op->operands; *operand != '\0'; operand++, field++) {
+
+            switch (*operand) {
+
+            case 'i':
+                if (*field == NJS_INDEX_NONE
+                    || njs_scope_type(*field) != NJS_SCOPE_ABSOLUTE)
+                {
+                    continue;
+                }
+
+                n = (*field >> NJS_SCOPE_SHIFT) - 1;
+
+                if (n >= header->constants) {
+                    goto invalid;
+                }
+
+                *field = loader->constants[n];
+                break;
+
+            case 'l':
+                if (*field >= header->lambdas) {
+                    goto invalid;
+                }
+
+                *field = (uintptr_t) &loader->lambdas[*field];
+                break;
+
+            case 'p':
+                if (*field >= header->patterns) {
+                    goto invalid;
+                }
+
+                *field = (uintptr_t) loader->patterns[*field];
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    return NXT_OK;
+
+invalid:
+
+    njs_internal_error(loader->vm, "invalid script image");
+
+    return NXT_ERROR;
+}
+
+
+static nxt_int_t
+njs_image_load_lambda(njs_image_loader_t *loader,
+    njs_function_lambda_t *lambda)
+{
+    size_t      n;
+    uint32_t    code, nargs, local_size, closure_size;
+    uint8_t     flags[3];
+
+    if (njs_image_read_u32(loader, &code) != NXT_OK
+        || njs_image_read_u32(loader, &nargs) != NXT_OK
+        || njs_image_read_u32(loader, &local_size) != NXT_OK
+        || njs_image_read_u32(loader, &closure_size) != NXT_OK
+        || njs_image_read(loader, flags, sizeof(flags)) != NXT_OK
+        || code >= loader->header.codes
+        || local_size % sizeof(njs_value_t) != 0
+        || closure_size % sizeof(njs_value_t) != 0
+        || flags[0] > NJS_MAX_NESTING)
+    {
+        njs_internal_error(loader->vm, "invalid script image");
+        return NXT_ERROR;
+    }
+
+    lambda->start = loader->codes[code];
+    lambda->nargs = nargs;
+    lambda->local_size = local_size;
+    lambda->closure_size = closure_size;
+    lambda->nesting = flags[0];
+    lambda->block_closures = flags[1];
+    lambda->rest_parameters = flags[2];
+
+    lambda->local_scope = njs_image_load_values(loader,
+                                              local_size / sizeof(njs_value_t));
+    if (lambda->local_scope == NULL) {
+        return NXT_ERROR;
+    }
+
+    if (closure_size != 0) {
+        n = closure_size / sizeof(njs_value_t) - 1;
+
+        lambda->closure_scope = njs_image_load_values(loader, n);
+        if (lambda->closure_scope == NULL) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static njs_value_t *
+njs_image_load_values(njs_image_loader_t *loader, size_t n)
+{
+    size_t       i;
+    njs_value_t  *values;
+
+    /* At least one value is allocated for an empty scope. */
+
+    values = nxt_mp_align(loader->vm->mem_pool, sizeof(njs_value_t),
+                          nxt_max(n, 1) * sizeof(njs_value_t));
+    if (nxt_slow_path(values == NULL)) {
+        njs_memory_error(loader->vm);
+        return NULL;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (njs_image_load_value(loader, &values[i]) != NXT_OK) {
+            return NULL;
+        }
+    }
+
+    return values;
+}
+
+
+static nxt_int_t
+njs_image_load_value(njs_image_loader_t *loader, njs_value_t *value)
+{
+    u_char          type;
+    uint32_t        id, length, size;
+    njs_vm_t        *vm;
+    nxt_int_t       ret;
+    njs_index_t     index;
+    njs_function_t  *function;
+
+    vm = loader->vm;
+
+    if (njs_image_read(loader, &type, sizeof(u_char)) != NXT_OK) {
+        goto invalid;
+    }
+
+    switch (type) {
+
+    case NJS_IMAGE_PRIMITIVE:
+        if (njs_image_read(loader, value, sizeof(njs_value_t)) != NXT_OK
+            || !(njs_is_primitive(value) || value->type == NJS_INVALID)
+            || (njs_is_string(value)
+                && value->short_string.size == NJS_STRING_LONG))
+        {
+            goto invalid;
+        }
+
+        return NXT_OK;
+
+    case NJS_IMAGE_LONG_STRING:
+        if (njs_image_read_u32(loader, &length) != NXT_OK
+            || njs_image_read_u32(loader, &size) != NXT_OK
+            || (size_t) (loader->end - loader->pos) < size
+            || length > size)
+        {
+            goto invalid;
+        }
+
+        ret = njs_string_new(vm, value, loader->pos, size, length);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
+        }
+
+        loader->pos += size;
+
+        /* The long strings are shared with the constants. */
+
+        index = njs_value_index(vm, value, 0);
+        if (nxt_slow_path(index == NJS_INDEX_NONE)) {
+            njs_memory_error(vm);
+            return NXT_ERROR;
+        }
+
+        *value = *(njs_value_t *) index;
+
+        return NXT_OK;
+
+    case NJS_IMAGE_FUNCTION:
+        if (njs_image_read_u32(loader, &id) != NXT_OK
+            || id >= loader->header.lambdas)
+        {
+            goto invalid;
+        }
+
+        function = njs_function_alloc(vm, &loader->lambdas[id], NULL, 1);
+        if (nxt_slow_path(function == NULL)) {
+            return NXT_ERROR;
+        }
+
+        value->data.u.function = function;
+        value->type = NJS_FUNCTION;
+        value->data.truth = 1;
+
+        return NXT_OK;
+
+    case NJS_IMAGE_SHARED_OBJECT:
+        if (njs_image_read_u32(loader, &id) != NXT_OK
+            || id >= NJS_OBJECT_MAX)
+        {
+            goto invalid;
+        }
+
+        value->data.u.object = &vm->shared->objects[id];
+        value->type = NJS_OBJECT;
+        value->data.truth = 1;
+
+        return NXT_OK;
+
+    case NJS_IMAGE_SHARED_FUNCTION:
+        if (njs_image_read_u32(loader, &id) != NXT_OK
+            || id >= NJS_FUNCTION_MAX)
+        {
+            goto invalid;
+        }
+
+        value->data.u.function = &vm->shared->functions[id];
+        value->type = NJS_FUNCTION;
+        value->data.truth = 1;
+
+        return NXT_OK;
+
+    default:
+        break;
+    }
+
+invalid:
+
+    njs_internal_error(vm, "invalid script image");
+
+    return NXT_ERROR;
+}
+
+
+static nxt_int_t
+njs_image_load_debug(njs_image_loader_t *loader)
+{
+    uint32_t              items, lambda, line;
+    nxt_str_t             file, name;
+    nxt_uint_t            n;
+    njs_function_debug_t  *debug;
+
+    if (njs_image_read_u32(loader, &items) != NXT_OK) {
+        goto invalid;
+    }
+
+    for (n = 0; n < items; n++) {
+        if (njs_image_read_u32(loader, &lambda) != NXT_OK
+            || njs_image_read_u32(loader, &line) != NXT_OK
+            || njs_image_read_str(loader, &file) != NXT_OK
+            || njs_image_read_str(loader, &name) != NXT_OK
+            || (lambda != NJS_IMAGE_NONE && lambda >= loader->header.lambdas))
+        {
+            goto invalid;
+        }
+
+        /* The debug entries are used only if backtraces are enabled. */
+
+        if (loader->vm->debug == NULL) {
+            continue;
+        }
+
+        debug = nxt_array_add(loader->vm->debug, &njs_array_mem_proto,
+                              loader->vm->mem_pool);
+        if (nxt_slow_path(debug == NULL)) {
+            njs_memory_error(loader->vm);
+            return NXT_ERROR;
+        }
+
+        debug->lambda = (lambda != NJS_IMAGE_NONE) ? &loader->lambdas[lambda]
+                                                   : NULL;
+        debug->line = line;
+        debug->file = file;
+        debug->name = name;
+    }
+
+    return NXT_OK;
+
+invalid:
+
+    njs_internal_error(loader->vm, "invalid script image");
+
+    return NXT_ERROR;
+}
+
+
+static nxt_int_t
+njs_image_load_variables(njs_image_loader_t *loader)
+{
+    uint32_t            items, type;
+    njs_vm_t            *vm;
+    nxt_int_t           ret;
+    nxt_uint_t          n;
+    njs_index_t         index;
+    njs_variable_t      *var;
+    nxt_lvlhsh_query_t  lhq;
+
+    vm = loader->vm;
+
+    if (njs_image_read_u32(loader, &items) != NXT_OK) {
+        goto invalid;
+    }
+
+    nxt_lvlhsh_init(&vm->variables_hash);
+
+    for (n = 0; n < items; n++) {
+        var = nxt_mp_zalloc(vm->mem_pool, sizeof(njs_variable_t));
+        if (nxt_slow_path(var == NULL)) {
+            njs_memory_error(vm);
+            return NXT_ERROR;
+        }
+
+        if (njs_image_read_str(loader, &var->name) != NXT_OK
+            || njs_image_read_u32(loader, &type) != NXT_OK
+            || njs_image_read(loader, &index, sizeof(njs_index_t)) != NXT_OK
+            || type > NJS_VARIABLE_FUNCTION
+            || (index != NJS_INDEX_NONE
+                && njs_scope_type(index) != NJS_SCOPE_GLOBAL))
+        {
+            goto invalid;
+        }
+
+        var->type = type;
+        var->index = index;
+        var->value = njs_value_undefined;
+
+        lhq.key = var->name;
+        lhq.key_hash = nxt_djb_hash(lhq.key.start, lhq.key.length);
+        lhq.proto = &njs_variables_hash_proto;
+        lhq.replace = 0;
+        lhq.value = var;
+        lhq.pool = vm->mem_pool;
+
+        ret = nxt_lvlhsh_insert(&vm->variables_hash, &lhq);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            goto invalid;
+        }
+    }
+
+    return NXT_OK;
+
+invalid:
+
+    njs_internal_error(vm, "invalid script image");
+
+    return NXT_ERROR;
+}
+
+
+static nxt_int_t
+njs_image_load_tables(njs_image_loader_t *loader)
+{
+    u_char                flags;
+    njs_vm_t              *vm;
+    nxt_int_t             ret;
+    nxt_str_t             name;
+    nxt_uint_t            n;
+    njs_value_t           value, *ext;
+    njs_image_header_t    *header;
+
+    vm = loader->vm;
+    header = &loader->header;
+
+    if (header->constants != 0) {
+        loader->constants = nxt_mp_alloc(vm->mem_pool,
+                                     header->constants * sizeof(njs_index_t));
+        if (nxt_slow_path(loader->constants == NULL)) {
+            goto memory_error;
+        }
+    }
+
+    for (n = 0; n < header->constants; n++) {
+        if (njs_image_read(loader, &flags, sizeof(u_char)) != NXT_OK) {
+            goto invalid;
+        }
+
+        switch (flags) {
+
+        case NJS_IMAGE_CONSTANT:
+        case NJS_IMAGE_ATOM:
+            ret = njs_image_load_value(loader, &value);
+            if (ret != NXT_OK) {
+                return ret;
+            }
+
+            if (flags == NJS_IMAGE_ATOM) {
+                if (!njs_is_string(&value)) {
+                    goto invalid;
+                }
+
+                loader->constants[n] = njs_atom_index(vm, &value, 0);
+
+            } else {
+                loader->constants[n] = njs_value_index(vm, &value, 0);
+            }
+
+            if (nxt_slow_path(loader->constants[n] == NJS_INDEX_NONE)) {
+                goto memory_error;
+            }
+
+            break;
+
+        case NJS_IMAGE_EXTERNAL:
+            if (njs_image_read_str(loader, &name) != NXT_OK) {
+                goto invalid;
+            }
+
+            ext = njs_external_lookup(vm, &name,
+                                      nxt_djb_hash(name.start, name.length));
+            if (ext == NULL) {
+                njs_internal_error(vm, "external \"%V\" is not found in "
+                                   "script image", &name);
+                return NXT_ERROR;
+            }
+
+            loader->constants[n] = (njs_index_t) ext;
+            break;
+
+        default:
+            goto invalid;
+        }
+    }
+
+    if (header->patterns != 0) {
+        loader->patterns = nxt_mp_alloc(vm->mem_pool, header->patterns
+                                             * sizeof(njs_regexp_pattern_t *));
+        if (nxt_slow_path(loader->patterns == NULL)) {
+            goto memory_error;
+        }
+    }
+
+    for (n = 0; n < header->patterns; n++) {
+        if (njs_image_read_str(loader, &name) != NXT_OK
+            || njs_image_read(loader, &flags, sizeof(u_char)) != NXT_OK)
+        {
+            goto invalid;
+        }
+
+        loader->patterns[n] = njs_regexp_pattern_create(vm, name.start,
+                                                        name.length, flags);
+        if (nxt_slow_path(loader->patterns[n] == NULL)) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+
+memory_error:
+
+    njs_memory_error(vm);
+
+    return NXT_ERROR;
+
+invalid:
+
+    njs_internal_error(vm, "invalid script image");
+
+    return NXT_ERROR;
+}
+
+
+/* The strings are copied because the image memory can be freed. */
+
+static nxt_int_t
+njs_image_read_str(njs_image_loader_t *loader, nxt_str_t *str)
+{
+    uint32_t  length;
+
+    if (njs_image_read_u32(loader, &length) != NXT_OK
+        || (size_t) (loader->end - loader->pos) < length)
+    {
+        return NXT_ERROR;
+    }
+
+    str->length = length;
+    str->start = NULL;
+
+    if (length != 0) {
+        str->start = nxt_mp_alloc(loader->vm->mem_pool, length);
+        if (nxt_slow_path(str->start == NULL)) {
+            return NXT_ERROR;
+        }
+
+        (void) njs_image_read(loader, str->start, length);
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+njs_image_read_u32(njs_image_loader_t *loader, uint32_t *n)
+{
+    return njs_image_read(loader, n, sizeof(uint32_t));
+}
+
+
+static nxt_int_t
+njs_image_read(njs_image_loader_t *loader, void *data, size_t size)
+{
+    if ((size_t) (loader->end - loader->pos) < size) {
+        return NXT_ERROR;
+    }
+
+    memcpy(data, loader->pos, size);
+    loader->pos += size;
+
+    return NXT_OK;
+}
+
+
+/*
+ * The layout fingerprint covers the njs version, the sizes of the values
+ * and the instructions, and the global scope layout.
+ */
+
+static uint32_t
+njs_image_layout(void)
+{
+    uint32_t    hash;
+    nxt_uint_t  n;
+
+    hash = nxt_djb_hash(NJS_VERSION, nxt_length(NJS_VERSION));
+
+    hash = nxt_djb_hash_add(hash, sizeof(njs_value_t));
+    hash = nxt_djb_hash_add(hash, sizeof(njs_index_t));
+    hash = nxt_djb_hash_add(hash, sizeof(njs_vmcode_t));
+    hash = nxt_djb_hash_add(hash, NJS_INDEX_GLOBAL_OFFSET);
+
+    for (n = 0; n < nxt_nitems(njs_image_operations); n++) {
+        hash = nxt_djb_hash_add(hash, njs_image_operations[n].size);
+        hash = nxt_djb_hash_add(hash, n);
+    }
+
+    return hash;
+}
@@ -0,0 +1,35 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NJS_IMAGE_H_INCLUDED_
+#define _NJS_IMAGE_H_INCLUDED_
+
+
+/*
+ * A script image is the compiled state of a VM: the code, the lambdas,
+ * the constants, the regexp patterns, the global scope and variables.
+ * njs_vm_image() serializes the state and njs_vm_compile_from_image()
+ * loads it instead of parsing the script.
+ *
+ * The image does not contain pointers.  The instruction operations are
+ * stored as numbers in the operations table, the absolute operands,
+ * the lambdas and the patterns are stored as numbers in the image tables.
+ * Externals are referred to by name, so the externals should be bound
+ * to a VM before the image is loaded in the same way as before
+ * the script compilation.
+ *
+ * The image header contains the image version, a fingerprint of the njs
+ * version and the value and instruction layouts, and a hash of the image
+ * content, so an image built by another njs version, for another platform
+ * or a damaged one is rejected.
+ */
+
+#define NJS_IMAGE_VERSION          1
+
+
+nxt_int_t njs_image_load(njs_vm_t *vm, const u_char *start, const u_char *end);
+
+
+#endif /* _NJS_IMAGE_H_INCLUDED_ */
@@ -0,0 +1,990 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <njs_core.h>
+#include <string.h>
+
+#if (NJS_HAVE_JIT)
+
+#include <sys/mman.h>
+
+
+/* The maximum size of the native code of an instruction. */
+#define NJS_JIT_CODE_MAX           512
+
+/* The value type bit-field is the first byte of njs_value_t. */
+#define NJS_JIT_VALUE_TYPE         0
+
+/* The prologue and the epilogue sizes. */
+#define NJS_JIT_PROLOGUE           6
+#define NJS_JIT_EPILOGUE           2
+
+
+/*
+ * The native code returns the result of the instruction which it does not
+ * complete and the instruction itself in the rax and rdx registers.
+ */
+
+typedef struct {
+    njs_ret_t                      ret;
+    njs_vmcode_generic_t           *vmcode;
+} njs_jit_result_t;
+
+
+typedef njs_jit_result_t (*njs_jit_entry_t)(njs_vm_t *vm, u_char *native);
+
+
+typedef struct {
+    /* The native code position of a rel32 field. */
+    uint32_t                       position;
+    /* The bytecode offset of the jump target. */
+    uint32_t                       target;
+} njs_jit_fixup_t;
+
+
+typedef struct {
+    u_char                         *start;
+    u_char                         *p;
+
+    njs_jit_code_t                 *code;
+
+    njs_jit_fixup_t                *fixups;
+    nxt_uint_t                     nfixups;
+} njs_jit_t;
+
+
+/* The x86-64 registers. */
+
+enum {
+    NJS_JIT_RAX = 0,
+    NJS_JIT_RCX,
+    NJS_JIT_RDX,
+    NJS_JIT_RBX,
+    NJS_JIT_RSP,
+    NJS_JIT_RBP,
+    NJS_JIT_RSI,
+    NJS_JIT_RDI,
+};
+
+
+/* The x86-64 condition codes. */
+
+enum {
+    NJS_JIT_B = 0x2,
+    NJS_JIT_AE = 0x3,
+    NJS_JIT_E = 0x4,
+    NJS_JIT_NE = 0x5,
+    NJS_JIT_BE = 0x6,
+    NJS_JIT_A = 0x7,
+
+    NJS_JIT_ALWAYS = 0x10,
+};
+
+
+/*
+ * A numeric comparison: whether the ucomisd operands are swapped,
+ * the condition code and whether the instruction is a conditional jump.
+ */
+
+typedef struct {
+    njs_vmcode_operation_t         operation;
+    uint8_t                        swap;
+    uint8_t                        cond;
+    uint8_t                        jump;
+} njs_jit_compare_t;
+
+
+static njs_jit_code_t *njs_jit_compile(njs_vm_t *vm,
+    njs_function_lambda_t *lambda);
+static nxt_int_t njs_jit_instruction(njs_jit_t *jit, u_char *p, size_t size);
+static void njs_jit_numeric(njs_jit_t *jit, njs_vmcode_generic_t *vmcode,
+    u_char *slow[2]);
+static void njs_jit_number_set(njs_jit_t *jit, nxt_uint_t reg, nxt_uint_t xmm);
+static void njs_jit_call(njs_jit_t *jit, njs_vmcode_generic_t *vmcode,
+    size_t size);
+static void njs_jit_operation(njs_jit_t *jit, njs_vmcode_generic_t *vmcode,
+    size_t size);
+static void njs_jit_exit(njs_jit_t *jit, njs_vmcode_generic_t *vmcode,
+    nxt_uint_t cond);
+static void njs_jit_taken(njs_jit_t *jit, njs_vmcode_generic_t *vmcode,
+    njs_ret_t offset);
+static void njs_jit_operand(njs_jit_t *jit, nxt_uint_t reg, njs_index_t index);
+static void njs_jit_imm64(njs_jit_t *jit, nxt_uint_t reg, uint64_t imm);
+static void njs_jit_sse(njs_jit_t *jit, u_char prefix, u_char op,
+    nxt_uint_t xmm, nxt_uint_t reg, int disp);
+static void njs_jit_sse_regs(njs_jit_t *jit, u_char prefix, u_char op,
+    nxt_uint_t xmm1, nxt_uint_t xmm2);
+static u_char *njs_jit_jcc(njs_jit_t *jit, nxt_uint_t cond);
+static u_char *njs_jit_jmp(njs_jit_t *jit);
+static void njs_jit_patch(u_char *rel, u_char *target);
+
+
+static const njs_jit_compare_t  njs_jit_compares[] = {
+    { njs_vmcode_less, 1, NJS_JIT_A, 0 },
+    { njs_vmcode_greater, 0, NJS_JIT_A, 0 },
+    { njs_vmcode_less_or_equal, 1, NJS_JIT_AE, 0 },
+    { njs_vmcode_greater_or_equal, 0, NJS_JIT_AE, 0 },
+
+    { njs_vmcode_if_less_jump, 1, NJS_JIT_A, 1 },
+    { njs_vmcode_if_not_less_jump, 1, NJS_JIT_BE, 1 },
+    { njs_vmcode_if_greater_jump, 0, NJS_JIT_A, 1 },
+    { njs_vmcode_if_not_greater_jump, 0, NJS_JIT_BE, 1 },
+    { njs_vmcode_if_less_or_equal_jump, 1, NJS_JIT_AE, 1 },
+    { njs_vmcode_if_not_less_or_equal_jump, 1, NJS_JIT_B, 1 },
+    { njs_vmcode_if_greater_or_equal_jump, 0, NJS_JIT_AE, 1 },
+    { njs_vmcode_if_not_greater_or_equal_jump, 0, NJS_JIT_B, 1 },
+};
+
+
+#define njs_jit_byte(jit, c)                                                  \
+    *(jit)->p++ = (u_char) (c)
+
+
+#define njs_jit_int32(jit, n)                                                 \
+    do {                                                                      \
+        int32_t  _n = (int32_t) (n);                                          \
+                                                                              \
+        memcpy((jit)->p, &_n, sizeof(int32_t));                               \
+        (jit)->p += sizeof(int32_t);                                          \
+    } while (0)
+
+
+/* mov reg, [rbx + disp32] and mov [rbx + disp32], reg. */
+
+#define njs_jit_load(jit, reg, disp)                                          \
+    do {                                                                      \
+        njs_jit_byte(jit, 0x48);                                              \
+        njs_jit_byte(jit, 0x8b);                                              \
+        njs_jit_byte(jit, 0x80 | ((reg) << 3) | NJS_JIT_RBX);                 \
+        njs_jit_int32(jit, disp);                                             \
+    } while (0)
+
+
+#define njs_jit_store(jit, reg, disp)                                         \
+    do {                                                                      \
+        njs_jit_byte(jit, 0x48);                                              \
+        njs_jit_byte(jit, 0x89);                                              \
+        njs_jit_byte(jit, 0x80 | ((reg) << 3) | NJS_JIT_RBX);                 \
+        njs_jit_int32(jit, disp);                                             \
+    } while (0)
+
+
+/* cmp byte [reg + disp8], imm8. */
+
+#define njs_jit_cmp_byte(jit, reg, disp, imm)                                 \
+    do {                                                                      \
+        njs_jit_byte(jit, 0x80);                                              \
+        njs_jit_byte(jit, 0x40 | (7 << 3) | (reg));                           \
+        njs_jit_byte(jit, disp);                                              \
+        njs_jit_byte(jit, imm);                                               \
+    } while (0)
+
+
+#define njs_jit_vm_offset(field)                                              \
+    ((int32_t) offsetof(njs_vm_t, field))
+
+
+/*
+ * The native code of a lambda starts with the prologue which saves
+ * the callee-saved rbx register, keeps the VM pointer in it and jumps
+ * to the instruction.  The epilogue follows the prologue, the native
+ * code jumps there to return to the interpreter with rax and rdx values.
+ */
+
+njs_ret_t
+njs_jit_run(njs_vm_t *vm, njs_vmcode_generic_t **vmcode)
+{
+    size_t                 offset;
+    uint32_t               native;
+    njs_jit_code_t         *code;
+    njs_function_t         *function;
+    njs_jit_entry_t        entry;
+    njs_jit_result_t       result;
+    njs_function_lambda_t  *lambda;
+
+    function = vm->active_frame->native.function;
+
+    if (function == NULL || function->native || vm->profile != NULL) {
+        return NXT_DECLINED;
+    }
+
+    lambda = function->u.lambda;
+    code = lambda->jit;
+
+    if (code == NULL) {
+        if (lambda->jit_declined
+            || lambda->jit_hits++ < vm->options.jit_threshold)
+        {
+            return NXT_DECLINED;
+        }
+
+        code = njs_jit_compile(vm, lambda);
+
+        if (code == NULL) {
+            lambda->jit_declined = 1;
+            return NXT_DECLINED;
+        }
+
+        lambda->jit = code;
+    }
+
+    /* The trap code and the continuation nexus are out of the lambda. */
+
+    offset = vm->current - code->start;
+
+    if (offset >= code->size) {
+        return NXT_DECLINED;
+    }
+
+    native = code->map[offset / sizeof(njs_vmcode_operation_t)];
+
+    if (nxt_slow_path(native == 0)) {
+        return NXT_DECLINED;
+    }
+
+    entry = (njs_jit_entry_t) code->native;
+
+    result = entry(vm, code->native + native);
+
+    *vmcode = result.vmcode;
+
+    return result.ret;
+}
+
+
+void
+njs_jit_destroy(njs_vm_shared_t *shared)
+{
+    njs_jit_code_t  *code, *next;
+
+    for (code = shared->jit; code != NULL; code = next) {
+        next = code->next;
+
+        (void) munmap(code->native, code->native_size);
+        nxt_free(code);
+    }
+
+    shared->jit = NULL;
+}
+
+
+static njs_jit_code_t *
+njs_jit_compile(njs_vm_t *vm, njs_function_lambda_t *lambda)
+{
+    u_char          *p, *start, *end, *native;
+    size_t          size, native_size;
+    uint32_t        offset;
+    nxt_int_t       ret;
+    nxt_uint_t      n, ninstructions;
+    njs_jit_t       jit;
+    njs_vm_code_t   *vm_code;
+    njs_jit_code_t  *code;
+    njs_jit_fixup_t *fixup;
+
+    if (vm->code == NULL) {
+        return NULL;
+    }
+
+    start = lambda->start;
+    end = NULL;
+
+    vm_code = vm->code->start;
+
+    for (n = 0; n < vm->code->items; n++) {
+        if (vm_code[n].start == start) {
+            end = vm_code[n].end;
+            break;
+        }
+    }
+
+    if (end == NULL) {
+        return NULL;
+    }
+
+    ninstructions = 0;
+
+    for (p = start; p < end; p += size) {
+        size = njs_vmcode_size(((njs_vmcode_t *) p)->operation);
+
+        if (size == 0) {
+            return NULL;
+        }
+
+        ninstructions++;
+    }
+
+    size = end - start;
+
+    code = nxt_malloc(sizeof(njs_jit_code_t)
+                      + (size / sizeof(njs_vmcode_operation_t) + 1)
+                        * sizeof(uint32_t));
+    if (nxt_slow_path(code == NULL)) {
+        return NULL;
+    }
+
+    nxt_memzero(code->map, (size / sizeof(njs_vmcode_operation_t) + 1)
+                           * sizeof(uint32_t));
+
+    native_size = NJS_JIT_PROLOGUE + NJS_JIT_EPILOGUE
+                  + ninstructions * NJS_JIT_CODE_MAX;
+    native_size = nxt_align_size(native_size, nxt_pagesize());
+
+    native = mmap(NULL, native_size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (native == MAP_FAILED) {
+        nxt_free(code);
+        return NULL;
+    }
+
+    jit.fixups = nxt_malloc(2 * ninstructions * sizeof(njs_jit_fixup_t));
+    if (nxt_slow_path(jit.fixups == NULL)) {
+        goto fail;
+    }
+
+    jit.start = native;
+    jit.p = native;
+    jit.code = code;
+    jit.nfixups = 0;
+
+    code->start = start;
+    code->size = size;
+    code->native = native;
+    code->native_size = native_size;
+
+    /* push rbx; mov rbx, rdi; jmp rsi. */
+
+    njs_jit_byte(&jit, 0x53);
+    njs_jit_byte(&jit, 0x48);
+    njs_jit_byte(&jit, 0x89);
+    njs_jit_byte(&jit, 0xfb);
+    njs_jit_byte(&jit, 0xff);
+    njs_jit_byte(&jit, 0xe6);
+
+    /* pop rbx; ret. */
+
+    njs_jit_byte(&jit, 0x5b);
+    njs_jit_byte(&jit, 0xc3);
+
+    for (p = start; p < end; p += size) {
+        size = njs_vmcode_size(((njs_vmcode_t *) p)->operation);
+
+        if ((size_t) (jit.p - jit.start) > native_size - NJS_JIT_CODE_MAX) {
+            goto fail;
+        }
+
+        code->map[(p - start) / sizeof(njs_vmcode_operation_t)] =
+                                                           jit.p - jit.start;
+
+        ret = njs_jit_instruction(&jit, p, size);
+        if (ret != NXT_OK) {
+            goto fail;
+        }
+    }
+
+    for (n = 0; n < jit.nfixups; n++) {
+        fixup = &jit.fixups[n];
+
+        if (fixup->target >= code->size) {
+            goto fail;
+        }
+
+        offset = code->map[fixup->target / sizeof(njs_vmcode_operation_t)];
+
+        if (offset == 0) {
+            goto fail;
+        }
+
+        njs_jit_patch(jit.start + fixup->position, jit.start + offset);
+    }
+
+    nxt_free(jit.fixups);
+
+    if (mprotect(native, native_size, PROT_READ | PROT_EXEC) != 0) {
+        (void) munmap(native, native_size);
+        nxt_free(code);
+        return NULL;
+    }
+
+    code->next = vm->shared->jit;
+    vm->shared->jit = code;
+
+    nxt_thread_log_debug("JIT %uz bytes of bytecode, %uz bytes of code",
+                         code->size, (size_t) (jit.p - jit.start));
+
+    return code;
+
+fail:
+
+    if (jit.fixups != NULL) {
+        nxt_free(jit.fixups);
+    }
+
+    (void) munmap(native, native_size);
+    nxt_free(code);
+
+    return NULL;
+}
+
+
+static nxt_int_t
+njs_jit_instruction(njs_jit_t *jit, u_char *p, size_t size)
+{
+    u_char                  *slow[2], *done, *taken, *next;
+    njs_ret_t               offset;
+    nxt_uint_t              n, reg1, reg2;
+    njs_vmcode_generic_t    *vmcode;
+    njs_vmcode_operation_t  operation;
+
+    vmcode = (njs_vmcode_generic_t *) p;
+    operation = vmcode->code.operation;
+    offset = (njs_ret_t) vmcode->operand1;
+
+    if (operation == njs_vmcode_move) {
+        njs_jit_operand(jit, NJS_JIT_RSI, vmcode->operand2);
+        njs_jit_cmp_byte(jit, NJS_JIT_RSI, offsetof(njs_value_t, data.truth),
+                         NJS_STRING_LONG);
+        slow[0] = njs_jit_jcc(jit, NJS_JIT_E);
+
+        njs_jit_operand(jit, NJS_JIT_RAX, vmcode->operand1);
+
+        /* movups xmm0, [rsi]; movups [rax], xmm0. */
+        njs_jit_sse(jit, 0, 0x10, 0, NJS_JIT_RSI, 0);
+        njs_jit_sse(jit, 0, 0x11, 0, NJS_JIT_RAX, 0);
+
+        done = njs_jit_jmp(jit);
+
+        njs_jit_patch(slow[0], jit->p);
+        njs_jit_call(jit, vmcode, size);
+        njs_jit_patch(done, jit->p);
+
+        return NXT_OK;
+    }
+
+    if (operation == njs_vmcode_jump) {
+        njs_jit_taken(jit, vmcode, offset);
+        return NXT_OK;
+    }
+
+    if (operation == njs_vmcode_if_true_jump
+        || operation == njs_vmcode_if_false_jump)
+    {
+        njs_jit_operand(jit, NJS_JIT_RAX, vmcode->operand2);
+        njs_jit_cmp_byte(jit, NJS_JIT_RAX, offsetof(njs_value_t, data.truth),
+                         0);
+
+        taken = njs_jit_jcc(jit, (operation == njs_vmcode_if_true_jump)
+                                 ? NJS_JIT_NE : NJS_JIT_E);
+        done = njs_jit_jmp(jit);
+
+        njs_jit_patch(taken, jit->p);
+        njs_jit_taken(jit, vmcode, offset);
+        njs_jit_patch(done, jit->p);
+
+        return NXT_OK;
+    }
+
+    if (operation == njs_vmcode_addition
+        || operation == njs_vmcode_substraction
+        || operation == njs_vmcode_multiplication
+        || operation == njs_vmcode_division)
+    {
+        njs_jit_numeric(jit, vmcode, slow);
+
+        /* movsd xmm0, [rsi + 8]; op xmm0, [rdx + 8]. */
+
+        njs_jit_sse(jit, 0xf2, 0x10, 0, NJS_JIT_RSI,
+                    offsetof(njs_value_t, data.u.number));
+
+        njs_jit_sse(jit, 0xf2,
+                    (operation == njs_vmcode_addition) ? 0x58 :
+                    (operation == njs_vmcode_substraction) ? 0x5c :
+                    (operation == njs_vmcode_multiplication) ? 0x59 : 0x5e,
+                    0, NJS_JIT_RDX, offsetof(njs_value_t, data.u.number));
+
+        njs_jit_operand(jit, NJS_JIT_RAX, vmcode->operand1);
+        njs_jit_number_set(jit, NJS_JIT_RAX, 0);
+
+        done = njs_jit_jmp(jit);
+
+        njs_jit_patch(slow[0], jit->p);
+        njs_jit_patch(slow[1], jit->p);
+        njs_jit_call(jit, vmcode, size);
+        njs_jit_patch(done, jit->p);
+
+        return NXT_OK;
+    }
+
+    for (n = 0; n < nxt_nitems(njs_jit_compares); n++) {
+        if (operation != njs_jit_compares[n].operation) {
+            continue;
+        }
+
+        njs_jit_numeric(jit, vmcode, slow);
+
+        /* movsd xmm0, [rsi + 8]; movsd xmm1, [rdx + 8]. */
+
+        njs_jit_sse(jit, 0xf2, 0x10, 0, NJS_JIT_RSI,
+                    offsetof(njs_value_t, data.u.number));
+        njs_jit_sse(jit, 0xf2, 0x10, 1, NJS_JIT_RDX,
+                    offsetof(njs_value_t, data.u.number));
+
+        reg1 = njs_jit_compares[n].swap ? 1 : 0;
+        reg2 = njs_jit_compares[n].swap ? 0 : 1;
+
+        if (!njs_jit_compares[n].jump) {
+
+            /* The result is a boolean value. */
+
+            njs_jit_operand(jit, NJS_JIT_RAX, vmcode->operand1);
+            njs_jit_imm64(jit, NJS_JIT_RCX, (uintptr_t) &njs_value_false);
+            njs_jit_imm64(jit, NJS_JIT_RDX, (uintptr_t) &njs_value_true);
+
+            /* ucomisd; cmovcc rcx, rdx. */
+
+            njs_jit_sse_regs(jit, 0x66, 0x2e, reg1, reg2);
+
+            njs_jit_byte(jit, 0x48);
+            njs_jit_byte(jit, 0x0f);
+            njs_jit_byte(jit, 0x40 | njs_jit_compares[n].cond);
+            njs_jit_byte(jit, 0xc0 | (NJS_JIT_RCX << 3) | NJS_JIT_RDX);
+
+            /* movups xmm0, [rcx]; movups [rax], xmm0. */
+
+            njs_jit_sse(jit, 0, 0x10, 0, NJS_JIT_RCX, 0);
+            njs_jit_sse(jit, 0, 0x11, 0, NJS_JIT_RAX, 0);
+
+            done = njs_jit_jmp(jit);
+
+            njs_jit_patch(slow[0], jit->p);
+            njs_jit_patch(slow[1], jit->p);
+            njs_jit_call(jit, vmcode, size);
+            njs_jit_patch(done, jit->p);
+
+            return NXT_OK;
+        }
+
+        njs_jit_sse_regs(jit, 0x66, 0x2e, reg1, reg2);
+
+        taken = njs_jit_jcc(jit, njs_jit_compares[n].cond);
+        done = njs_jit_jmp(jit);
+
+        njs_jit_patch(slow[0], jit->p);
+        njs_jit_patch(slow[1], jit->p);
+        njs_jit_operation(jit, vmcode, size);
+
+        /* cmp rax, size; je next; cmp rax, offset; jne exit. */
+
+        njs_jit_byte(jit, 0x48);
+        njs_jit_byte(jit, 0x3d);
+        njs_jit_int32(jit, size);
+
+        next = njs_jit_jcc(jit, NJS_JIT_E);
+
+        njs_jit_byte(jit, 0x48);
+        njs_jit_byte(jit, 0x3d);
+        njs_jit_int32(jit, offset);
+
+        njs_jit_exit(jit, vmcode, NJS_JIT_NE);
+
+        njs_jit_patch(taken, jit->p);
+        njs_jit_taken(jit, vmcode, offset);
+
+        njs_jit_patch(done, jit->p);
+        njs_jit_patch(next, jit->p);
+
+        return NXT_OK;
+    }
+
+    if (operation == njs_vmcode_increment
+        || operation == njs_vmcode_decrement
+        || operation == njs_vmcode_post_increment
+        || operation == njs_vmcode_post_decrement)
+    {
+        njs_jit_operand(jit, NJS_JIT_RSI, vmcode->operand2);
+        njs_jit_operand(jit, NJS_JIT_RDX, vmcode->operand3);
+
+        njs_jit_cmp_byte(jit, NJS_JIT_RDX, NJS_JIT_VALUE_TYPE,
+                         NJS_NUMBER);
+        slow[0] = njs_jit_jcc(jit, NJS_JIT_A);
+
+        njs_jit_cmp_byte(jit, NJS_JIT_RSI, offsetof(njs_value_t, data.truth),
+                         NJS_STRING_LONG);
+        slow[1] = njs_jit_jcc(jit, NJS_JIT_E);
+
+        /* movsd xmm0, [rdx + 8]; mov rax, step; movq xmm1, rax. */
+
+        njs_jit_sse(jit, 0xf2, 0x10, 0, NJS_JIT_RDX,
+                    offsetof(njs_value_t, data.u.number));
+
+        njs_jit_imm64(jit, NJS_JIT_RAX,
+                      (operation == njs_vmcode_increment
+                       || operation == njs_vmcode_post_increment)
+                      ? 0x3ff0000000000000 : 0xbff0000000000000);
+
+        njs_jit_byte(jit, 0x66);
+        njs_jit_byte(jit, 0x48);
+        njs_jit_byte(jit, 0x0f);
+        njs_jit_byte(jit, 0x6e);
+        njs_jit_byte(jit, 0xc8);
+
+        /* addsd xmm1, xmm0. */
+        njs_jit_sse_regs(jit, 0xf2, 0x58, 1, 0);
+
+        njs_jit_number_set(jit, NJS_JIT_RSI, 1);
+        njs_jit_operand(jit, NJS_JIT_RAX, vmcode->operand1);
+
+        if (operation == njs_vmcode_increment
+            || operation == njs_vmcode_decrement)
+        {
+            /* movups xmm0, [rsi]; movups [rax], xmm0. */
+            njs_jit_sse(jit, 0, 0x10, 0, NJS_JIT_RSI, 0);
+            njs_jit_sse(jit, 0, 0x11, 0, NJS_JIT_RAX, 0);
+
+        } else {
+            njs_jit_number_set(jit, NJS_JIT_RAX, 0);
+        }
+
+        done = njs_jit_jmp(jit);
+
+        njs_jit_patch(slow[0], jit->p);
+        njs_jit_patch(slow[1], jit->p);
+        njs_jit_call(jit, vmcode, size);
+        njs_jit_patch(done, jit->p);
+
+        return NXT_OK;
+    }
+
+    njs_jit_call(jit, vmcode, size);
+
+    return NXT_OK;
+}
+
+
+/*
+ * Loads the first and the second operands to rsi and rdx
+ * and checks that they are numeric.
+ */
+
+static void
+njs_jit_numeric(njs_jit_t *jit, njs_vmcode_generic_t *vmcode, u_char *slow[2])
+{
+    njs_jit_operand(jit, NJS_JIT_RSI, vmcode->operand2);
+    njs_jit_operand(jit, NJS_JIT_RDX, vmcode->operand3);
+
+    njs_jit_cmp_byte(jit, NJS_JIT_RSI, NJS_JIT_VALUE_TYPE,
+                     NJS_NUMBER);
+    slow[0] = njs_jit_jcc(jit, NJS_JIT_A);
+
+    njs_jit_cmp_byte(jit, NJS_JIT_RDX, NJS_JIT_VALUE_TYPE,
+                     NJS_NUMBER);
+    slow[1] = njs_jit_jcc(jit, NJS_JIT_A);
+}
+
+
+/* Stores the number from the xmm register to the value pointed by reg. */
+
+static void
+njs_jit_number_set(njs_jit_t *jit, nxt_uint_t reg, nxt_uint_t xmm)
+{
+    /* movsd [reg + 8], xmm. */
+    njs_jit_sse(jit, 0xf2, 0x11, xmm, reg,
+                offsetof(njs_value_t, data.u.number));
+
+    /* mov byte [reg], NJS_NUMBER. */
+    njs_jit_byte(jit, 0xc6);
+    njs_jit_byte(jit, 0x40 | reg);
+    njs_jit_byte(jit, NJS_JIT_VALUE_TYPE);
+    njs_jit_byte(jit, NJS_NUMBER);
+
+    /* xorpd xmm3, xmm3; ucomisd xmm, xmm3; setne cl. */
+    njs_jit_sse_regs(jit, 0x66, 0x57, 3, 3);
+    njs_jit_sse_regs(jit, 0x66, 0x2e, xmm, 3);
+
+    njs_jit_byte(jit, 0x0f);
+    njs_jit_byte(jit, 0x90 | NJS_JIT_NE);
+    njs_jit_byte(jit, 0xc0 | NJS_JIT_RCX);
+
+    /* mov [reg + 1], cl. */
+    njs_jit_byte(jit, 0x88);
+    njs_jit_byte(jit, 0x40 | (NJS_JIT_RCX << 3) | reg);
+    njs_jit_byte(jit, offsetof(njs_value_t, data.truth));
+}
+
+
+/*
+ * Calls the instruction operation and returns to the interpreter
+ * if the operation result is not the instruction size.
+ */
+
+static void
+njs_jit_call(njs_jit_t *jit, njs_vmcode_generic_t *vmcode, size_t size)
+{
+    njs_jit_operation(jit, vmcode, size);
+
+    /* cmp rax, size; jne exit. */
+
+    njs_jit_byte(jit, 0x48);
+    njs_jit_byte(jit, 0x3d);
+    njs_jit_int32(jit, size);
+
+    njs_jit_exit(jit, vmcode, NJS_JIT_NE);
+
+    if (vmcode->code.retval) {
+        njs_jit_operand(jit, NJS_JIT_RSI, vmcode->operand1);
+
+        /* movups xmm0, [rbx + retval]; movups [rsi], xmm0. */
+
+        njs_jit_byte(jit, 0x0f);
+        njs_jit_byte(jit, 0x10);
+        njs_jit_byte(jit, 0x80 | NJS_JIT_RBX);
+        njs_jit_int32(jit, njs_jit_vm_offset(retval));
+
+        njs_jit_sse(jit, 0, 0x11, 0, NJS_JIT_RSI, 0);
+    }
+}
+
+
+/* Calls the instruction operation with operands as the interpreter does. */
+
+static void
+njs_jit_operation(njs_jit_t *jit, njs_vmcode_generic_t *vmcode, size_t size)
+{
+    njs_jit_imm64(jit, NJS_JIT_RAX, (uintptr_t) vmcode);
+    njs_jit_store(jit, NJS_JIT_RAX, njs_jit_vm_offset(current));
+
+    njs_jit_imm64(jit, NJS_JIT_RDX, (size > sizeof(njs_vmcode_t))
+                                    ? (uintptr_t) vmcode->operand1 : 0);
+
+    /* xor esi, esi. */
+    njs_jit_byte(jit, 0x31);
+    njs_jit_byte(jit, 0xf6);
+
+    switch (vmcode->code.operands) {
+
+    case NJS_VMCODE_3OPERANDS:
+        njs_jit_operand(jit, NJS_JIT_RDX, vmcode->operand3);
+
+        /* Fall through. */
+
+    case NJS_VMCODE_2OPERANDS:
+        njs_jit_operand(jit, NJS_JIT_RSI, vmcode->operand2);
+    }
+
+    /* mov rdi, rbx; mov rax, operation; call rax. */
+
+    njs_jit_byte(jit, 0x48);
+    njs_jit_byte(jit, 0x89);
+    njs_jit_byte(jit, 0xdf);
+
+    njs_jit_imm64(jit, NJS_JIT_RAX, (uintptr_t) vmcode->code.operation);
+
+    njs_jit_byte(jit, 0xff);
+    njs_jit_byte(jit, 0xd0);
+}
+
+
+/*
+ * Returns to the interpreter with the instruction in rdx
+ * if the condition is true.
+ */
+
+static void
+njs_jit_exit(njs_jit_t *jit, njs_vmcode_generic_t *vmcode, nxt_uint_t cond)
+{
+    u_char  *rel;
+
+    rel = NULL;
+
+    if (cond != NJS_JIT_ALWAYS) {
+        /* The inverse condition code. */
+        rel = njs_jit_jcc(jit, cond ^ 1);
+    }
+
+    njs_jit_imm64(jit, NJS_JIT_RDX, (uintptr_t) vmcode);
+
+    njs_jit_patch(njs_jit_jmp(jit), jit->start + NJS_JIT_PROLOGUE);
+
+    if (rel != NULL) {
+        njs_jit_patch(rel, jit->p);
+    }
+}
+
+
+/*
+ * A taken jump.  Backward jumps spend the execution budget, the native
+ * code returns to the interpreter when the budget countdown expires.
+ */
+
+static void
+njs_jit_taken(njs_jit_t *jit, njs_vmcode_generic_t *vmcode, njs_ret_t offset)
+{
+    u_char           *rel, *target;
+    njs_jit_fixup_t  *fixup;
+
+    target = (u_char *) vmcode + offset;
+
+    if (offset <= 0) {
+
+        if (target >= jit->code->start) {
+            /* sub dword [rbx + countdown], 1; jnz target. */
+
+            njs_jit_byte(jit, 0x83);
+            njs_jit_byte(jit, 0x80 | (5 << 3) | NJS_JIT_RBX);
+            njs_jit_int32(jit, njs_jit_vm_offset(countdown));
+            njs_jit_byte(jit, 1);
+
+            rel = njs_jit_jcc(jit, NJS_JIT_NE);
+            njs_jit_patch(rel, jit->start
+                               + jit->code->map[(target - jit->code->start)
+                                             / sizeof(njs_vmcode_operation_t)]);
+
+            /* The interpreter decrements the countdown once more. */
+
+            njs_jit_byte(jit, 0xc7);
+            njs_jit_byte(jit, 0x80 | NJS_JIT_RBX);
+            njs_jit_int32(jit, njs_jit_vm_offset(countdown));
+            njs_jit_int32(jit, 1);
+        }
+
+        njs_jit_imm64(jit, NJS_JIT_RAX, (uintptr_t) vmcode);
+        njs_jit_store(jit, NJS_JIT_RAX, njs_jit_vm_offset(current));
+        njs_jit_imm64(jit, NJS_JIT_RAX, (uint64_t) offset);
+
+        njs_jit_exit(jit, vmcode, NJS_JIT_ALWAYS);
+
+        return;
+    }
+
+    rel = njs_jit_jmp(jit);
+
+    fixup = &jit->fixups[jit->nfixups++];
+    fixup->position = rel - jit->start;
+    fixup->target = target - jit->code->start;
+}
+
+
+static void
+njs_jit_operand(njs_jit_t *jit, nxt_uint_t reg, njs_index_t index)
+{
+    uintptr_t  offset;
+
+    njs_jit_load(jit, reg, njs_jit_vm_offset(scopes)
+                           + (index & NJS_SCOPE_MASK) * sizeof(njs_value_t *));
+
+    offset = njs_scope_offset(index);
+
+    if (offset == 0) {
+        return;
+    }
+
+    if (offset <= 0x7fffffff) {
+        /* add reg, imm32. */
+        njs_jit_byte(jit, 0x48);
+        njs_jit_byte(jit, 0x81);
+        njs_jit_byte(jit, 0xc0 | reg);
+        njs_jit_int32(jit, offset);
+        return;
+    }
+
+    /* mov rcx, imm64; add reg, rcx. */
+
+    njs_jit_imm64(jit, NJS_JIT_RCX, offset);
+
+    njs_jit_byte(jit, 0x48);
+    njs_jit_byte(jit, 0x01);
+    njs_jit_byte(jit, 0xc0 | (NJS_JIT_RCX << 3) | reg);
+}
+
+
+static void
+njs_jit_imm64(njs_jit_t *jit, nxt_uint_t reg, uint64_t imm)
+{
+    njs_jit_byte(jit, 0x48);
+    njs_jit_byte(jit, 0xb8 | reg);
+
+    memcpy(jit->p, &imm, sizeof(uint64_t));
+    jit->p += sizeof(uint64_t);
+}
+
+
+/* An SSE instruction with the [reg + disp8] memory operand. */
+
+static void
+njs_jit_sse(njs_jit_t *jit, u_char prefix, u_char op, nxt_uint_t xmm,
+    nxt_uint_t reg, int disp)
+{
+    if (prefix != 0) {
+        njs_jit_byte(jit, prefix);
+    }
+
+    njs_jit_byte(jit, 0x0f);
+    njs_jit_byte(jit, op);
+    njs_jit_byte(jit, 0x40 | (xmm << 3) | reg);
+    njs_jit_byte(jit, disp);
+}
+
+
+static void
+njs_jit_sse_regs(njs_jit_t *jit, u_char prefix, u_char op, nxt_uint_t xmm1,
+    nxt_uint_t xmm2)
+{
+    njs_jit_byte(jit, prefix);
+    njs_jit_byte(jit, 0x0f);
+    njs_jit_byte(jit, op);
+    njs_jit_byte(jit, 0xc0 | (xmm1 << 3) | xmm2);
+}
+
+
+/* Returns the position of rel32 field to patch. */
+
+static u_char *
+njs_jit_jcc(njs_jit_t *jit, nxt_uint_t cond)
+{
+    njs_jit_byte(jit, 0x0f);
+    njs_jit_byte(jit, 0x80 | cond);
+    njs_jit_int32(jit, 0);
+
+    return jit->p - sizeof(int32_t);
+}
+
+
+static u_char *
+njs_jit_jmp(njs_jit_t *jit)
+{
+    njs_jit_byte(jit, 0xe9);
+    njs_jit_int32(jit, 0);
+
+    return jit->p - sizeof(int32_t);
+}
+
+
+static void
+njs_jit_patch(u_char *rel, u_char *target)
+{
+    int32_t  n;
+
+    n = (int32_t) (target - (rel + sizeof(int32_t)));
+
+    memcpy(rel, &n, sizeof(int32_t));
+}
+
+
+#else
+
+
+njs_ret_t
+njs_jit_run(njs_vm_t *vm, njs_vmcode_generic_t **vmcode)
+{
+    return NXT_DECLINED;
+}
+
+
+void
+njs_jit_destroy(njs_vm_shared_t *shared)
+{
+}
+
+
+#endif
@@ -0,0 +1,64 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NJS_JIT_H_INCLUDED_
+#define _NJS_JIT_H_INCLUDED_
+
+
+/*
+ * The baseline JIT is enabled by the "jit" VM option.  It compiles
+ * the bytecode of a lambda into x86-64 code after "jit_threshold" calls
+ * and backward jumps.  The native code of an instruction either executes
+ * it inline (moves, jumps, numeric arithmetic and comparisons) or calls
+ * the instruction operation in the same way as the interpreter does.
+ * The native code returns to the interpreter if an operation returns
+ * anything but the instruction size: on calls, returns, exceptions,
+ * traps, etc.  The interpreter enters the native code again after calls,
+ * returns and backward jumps.
+ *
+ * The native code does not depend on a VM, so it is stored in the shared
+ * lambda and is used by all VM clones.  It is freed with the VM owning
+ * the shared data.
+ */
+
+#ifndef NJS_HAVE_JIT
+
+#if (__amd64__ && !_WIN32)
+#define NJS_HAVE_JIT               1
+#else
+#define NJS_HAVE_JIT               0
+#endif
+
+#endif
+
+
+struct njs_jit_code_s {
+    njs_jit_code_t                 *next;
+
+    /* The bytecode. */
+    u_char                         *start;
+    size_t                         size;
+
+    /* The mapped native code. */
+    u_char                         *native;
+    size_t                         native_size;
+
+    /*
+     * The native code offsets of the instructions indexed by
+     * the bytecode offset divided by sizeof(njs_vmcode_operation_t).
+     */
+#if (NXT_SUNC)
+    uint32_t                       map[1];
+#else
+    uint32_t                       map[];
+#endif
+};
+
+
+njs_ret_t njs_jit_run(njs_vm_t *vm, njs_vmcode_generic_t **vmcode);
+void njs_jit_destroy(njs_vm_shared_t *shared);
+
+
+#endif /* _NJS_JIT_H_INCLUDED_ */
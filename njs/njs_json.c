@@ -422,6 +422,7 @@ njs_json_parse_object(njs_json_parse_ctx_t *ctx, njs_value_t *value,
     njs_object_t        *object;
     njs_value_t         *prop_name, *prop_value;
     njs_object_prop_t   *prop;
+    njs_object_shape_t  *shape;
     nxt_lvlhsh_query_t  lhq;
 
     if (nxt_slow_path(--ctx->depth == 0)) {
@@ -434,8 +435,6 @@ njs_json_parse_object(njs_json_parse_ctx_t *ctx, njs_value_t *value,
         goto memory_error;
     }
 
-    prop = NULL;
-
     for ( ;; ) {
         p = njs_json_skip_space(p + 1, ctx->end);
         if (nxt_slow_path(p == ctx->end)) {
@@ -444,7 +443,7 @@ njs_json_parse_object(njs_json_parse_ctx_t *ctx, njs_value_t *value,
 
         if (*p != '"') {
             if (nxt_fast_path(*p == '}')) {
-                if (nxt_slow_path(prop != NULL)) {
+                if (nxt_slow_path(!njs_object_is_empty(object))) {
                     njs_json_parse_exception(ctx, "Trailing comma", p - 1);
                     return NULL;
                 }
@@ -487,22 +486,43 @@ njs_json_parse_object(njs_json_parse_ctx_t *ctx, njs_value_t *value,
             return NULL;
         }
 
-        prop = njs_object_prop_alloc(ctx->vm, prop_name, prop_value, 1);
-        if (nxt_slow_path(prop == NULL)) {
-            goto memory_error;
-        }
-
         njs_string_get(prop_name, &lhq.key);
         lhq.key_hash = nxt_djb_hash(lhq.key.start, lhq.key.length);
-        lhq.value = prop;
         lhq.replace = 1;
         lhq.pool = ctx->pool;
         lhq.proto = &njs_object_hash_proto;
 
-        ret = nxt_lvlhsh_insert(&object->hash, &lhq);
-        if (nxt_slow_path(ret != NXT_OK)) {
-            njs_internal_error(ctx->vm, "lvlhsh insert/replace failed");
-            return NULL;
+        shape = NULL;
+
+        if (object->shape != NULL) {
+            shape = njs_object_shape_find(object->shape, &lhq);
+        }
+
+        if (shape != NULL) {
+            /* A duplicate property. */
+            object->slots[shape->count - 1] = *prop_value;
+
+        } else {
+            ret = njs_object_shape_add(ctx->vm, object, &lhq, prop_name,
+                                       prop_value);
+
+            if (ret == NXT_DECLINED) {
+                prop = njs_object_prop_alloc(ctx->vm, prop_name, prop_value, 1);
+                if (nxt_slow_path(prop == NULL)) {
+                    goto memory_error;
+                }
+
+                lhq.value = prop;
+
+                ret = nxt_lvlhsh_insert(&object->hash, &lhq);
+                if (nxt_slow_path(ret != NXT_OK)) {
+                    njs_internal_error(ctx->vm, "lvlhsh insert/replace failed");
+                    return NULL;
+                }
+
+            } else if (nxt_slow_path(ret != NXT_OK)) {
+                return NULL;
+            }
         }
 
         p = njs_json_skip_space(p, ctx->end);
@@ -933,7 +953,7 @@ njs_json_skip_space(const u_char *start, const u_char *end)
 
 #define njs_json_is_non_empty(_value)                                         \
     (((_value)->type == NJS_OBJECT)                                           \
-      && !nxt_lvlhsh_is_empty(&(_value)->data.u.object->hash))                \
+      && !njs_object_is_empty((_value)->data.u.object))                       \
      || (((_value)->type == NJS_ARRAY) && (_value)->data.u.array->length != 0)
 
 
@@ -960,6 +980,13 @@ njs_json_parse_continuation(njs_vm_t *vm, njs_value_t *args, nxt_uint_t unused,
                 lhq.key_hash = nxt_djb_hash(lhq.key.start, lhq.key.length);
                 lhq.proto = &njs_object_hash_proto;
 
+                /* The reviver keeps references to the property values. */
+
+                ret = njs_object_dictionary(vm, state->value.data.u.object);
+                if (nxt_slow_path(ret != NXT_OK)) {
+                    return NXT_ERROR;
+                }
+
                 ret = nxt_lvlhsh_find(&state->value.data.u.object->hash, &lhq);
                 if (nxt_slow_path(ret == NXT_DECLINED)) {
                     state->index++;
@@ -1023,6 +1050,8 @@ njs_json_parse_continuation(njs_vm_t *vm, njs_value_t *args, nxt_uint_t unused,
                 return NXT_ERROR;
             }
 
+            njs_object_prop_cache_invalidate(vm, state->value.data.u.object);
+
             state->index++;
             state->type = NJS_JSON_OBJECT_START;
 
@@ -1230,7 +1259,7 @@ njs_json_stringify_continuation(njs_vm_t *vm, njs_value_t *args,
     njs_value_t           *key, *value;
     njs_function_t        *to_json;
     njs_json_state_t      *state;
-    njs_object_prop_t     *prop;
+    njs_object_prop_t     *prop, scratch;
     nxt_lvlhsh_query_t    lhq;
     njs_json_stringify_t  *stringify;
 
@@ -1264,7 +1293,8 @@ njs_json_stringify_continuation(njs_vm_t *vm, njs_value_t *args,
             lhq.key_hash = nxt_djb_hash(lhq.key.start, lhq.key.length);
             lhq.proto = &njs_object_hash_proto;
 
-            ret = nxt_lvlhsh_find(&state->value.data.u.object->hash, &lhq);
+            ret = njs_object_hash_find(state->value.data.u.object, &lhq,
+                                       &scratch);
             if (nxt_slow_path(ret == NXT_DECLINED)) {
                 break;
             }
@@ -1484,13 +1514,13 @@ memory_error:
 static njs_function_t *
 njs_object_to_json_function(njs_vm_t *vm, njs_value_t *value)
 {
-    njs_object_prop_t   *prop;
+    njs_object_prop_t   *prop, scratch;
     nxt_lvlhsh_query_t  lhq;
 
     lhq.key_hash = NJS_TO_JSON_HASH;
     lhq.key = nxt_string_value("toJSON");
 
-    prop = njs_object_property(vm, value->data.u.object, &lhq);
+    prop = njs_object_property(vm, value->data.u.object, &lhq, &scratch);
 
     if (prop != NULL && njs_is_function(&prop->value)) {
         return prop->value.data.u.function;
@@ -2333,7 +2363,7 @@ njs_vm_value_dump(njs_vm_t *vm, nxt_str_t *retval, const njs_value_t *value,
     nxt_str_t             str;
     njs_value_t           *key, *val, ext_val;
     njs_json_state_t      *state;
-    njs_object_prop_t     *prop;
+    njs_object_prop_t     *prop, scratch;
     nxt_lvlhsh_query_t    lhq;
     njs_json_stringify_t  *stringify;
 
@@ -2425,7 +2455,8 @@ njs_vm_value_dump(njs_vm_t *vm, nxt_str_t *retval, const njs_value_t *value,
             } else {
                 lhq.proto = &njs_object_hash_proto;
 
-                ret = nxt_lvlhsh_find(&state->value.data.u.object->hash, &lhq);
+                ret = njs_object_hash_find(state->value.data.u.object, &lhq,
+                                           &scratch);
                 if (nxt_slow_path(ret == NXT_DECLINED)) {
                     break;
                 }
@@ -35,6 +35,23 @@ njs_ret_t njs_number_parse_float(njs_vm_t *vm, njs_value_t *args,
 nxt_noinline uint32_t njs_number_to_integer(double num);
 
 
+/*
+ * ES5.1 ToInt32() with a fast path for numbers in the int32 range,
+ * other numbers including NaN and Infinity are handled by
+ * njs_number_to_integer().
+ */
+
+nxt_inline int32_t
+njs_number_to_int32(double num)
+{
+    if (nxt_fast_path(num > -2147483649.0 && num < 2147483648.0)) {
+        return (int32_t) num;
+    }
+
+    return njs_number_to_integer(num);
+}
+
+
 nxt_inline nxt_int_t
 njs_char_to_hex(u_char c)
 {
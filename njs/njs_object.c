@@ -12,6 +12,8 @@ static nxt_int_t njs_object_hash_test(nxt_lvlhsh_query_t *lhq, void *data);
 static njs_ret_t njs_object_property_query(njs_vm_t *vm,
     njs_property_query_t *pq, njs_object_t *object,
     const njs_value_t *property);
+static njs_ret_t njs_object_shape_property_query(njs_vm_t *vm,
+    njs_property_query_t *pq, njs_object_t *object);
 static njs_ret_t njs_array_property_query(njs_vm_t *vm,
     njs_property_query_t *pq, njs_array_t *array, uint32_t index);
 static njs_ret_t njs_string_property_query(njs_vm_t *vm,
@@ -38,10 +40,14 @@ njs_object_alloc(njs_vm_t *vm)
     if (nxt_fast_path(object != NULL)) {
         nxt_lvlhsh_init(&object->hash);
         nxt_lvlhsh_init(&object->shared_hash);
+        object->shape = NULL;
         object->__proto__ = &vm->prototypes[NJS_PROTOTYPE_OBJECT].object;
         object->type = NJS_OBJECT;
         object->shared = 0;
         object->extensible = 1;
+
+        njs_gc_register(vm, object, NJS_GC_OBJECT, sizeof(njs_object_t));
+
         return object;
     }
 
@@ -89,6 +95,7 @@ njs_object_value_alloc(njs_vm_t *vm, const njs_value_t *value, nxt_uint_t type)
     if (nxt_fast_path(ov != NULL)) {
         nxt_lvlhsh_init(&ov->object.hash);
         nxt_lvlhsh_init(&ov->object.shared_hash);
+        ov->object.shape = NULL;
         ov->object.type = njs_object_value_type(type);
         ov->object.shared = 0;
         ov->object.extensible = 1;
@@ -98,6 +105,8 @@ njs_object_value_alloc(njs_vm_t *vm, const njs_value_t *value, nxt_uint_t type)
 
         ov->value = *value;
 
+        njs_gc_register(vm, ov, NJS_GC_OBJECT, sizeof(njs_object_value_t));
+
         return &ov->object;
     }
 
@@ -174,7 +183,9 @@ njs_object_hash_test(nxt_lvlhsh_query_t *lhq, void *data)
         start = prop->name.long_string.data->start;
     }
 
-    if (memcmp(start, lhq->key.start, lhq->key.length) == 0) {
+    if (start == lhq->key.start
+        || memcmp(start, lhq->key.start, lhq->key.length) == 0)
+    {
         return NXT_OK;
     }
 
@@ -202,6 +213,9 @@ njs_object_prop_alloc(njs_vm_t *vm, const njs_value_t *name,
         prop->enumerable = attributes;
         prop->writable = attributes;
         prop->configurable = attributes;
+
+        njs_gc_register(vm, prop, NJS_GC_PROP, sizeof(njs_object_prop_t));
+
         return prop;
     }
 
@@ -211,16 +225,21 @@ njs_object_prop_alloc(njs_vm_t *vm, const njs_value_t *name,
 }
 
 
+/*
+ * njs_object_property() returns a property stored in the object slots
+ * as a copy in the scratch.
+ */
+
 nxt_noinline njs_object_prop_t *
 njs_object_property(njs_vm_t *vm, const njs_object_t *object,
-    nxt_lvlhsh_query_t *lhq)
+    nxt_lvlhsh_query_t *lhq, njs_object_prop_t *scratch)
 {
     nxt_int_t  ret;
 
     lhq->proto = &njs_object_hash_proto;
 
     do {
-        ret = nxt_lvlhsh_find(&object->hash, lhq);
+        ret = njs_object_hash_find(object, lhq, scratch);
 
         if (nxt_fast_path(ret == NXT_OK)) {
             return lhq->value;
@@ -374,12 +393,23 @@ njs_property_query(njs_vm_t *vm, njs_property_query_t *pq, njs_value_t *object,
         return NXT_ERROR;
     }
 
-    ret = njs_primitive_value_to_string(vm, &pq->value, property);
+    if (pq->atom != NULL) {
+        pq->value = pq->atom->name;
+        njs_string_get(&pq->value, &pq->lhq.key);
+        pq->lhq.key_hash = pq->atom->key_hash;
 
-    if (nxt_fast_path(ret == NXT_OK)) {
+        ret = NXT_OK;
 
-        njs_string_get(&pq->value, &pq->lhq.key);
-        pq->lhq.key_hash = hash(pq->lhq.key.start, pq->lhq.key.length);
+    } else {
+        ret = njs_primitive_value_to_string(vm, &pq->value, property);
+
+        if (nxt_fast_path(ret == NXT_OK)) {
+            njs_string_get(&pq->value, &pq->lhq.key);
+            pq->lhq.key_hash = hash(pq->lhq.key.start, pq->lhq.key.length);
+        }
+    }
+
+    if (nxt_fast_path(ret == NXT_OK)) {
 
         if (obj == NULL) {
             return njs_external_property_query(vm, pq, object);
@@ -420,6 +450,15 @@ njs_object_property_query(njs_vm_t *vm, njs_property_query_t *pq,
         /* TODO: length should be Own property */
 
         if (nxt_fast_path(!pq->own || proto == object)) {
+
+            if (proto->shape != NULL) {
+                ret = njs_object_shape_property_query(vm, pq, proto);
+
+                if (ret != NXT_DECLINED) {
+                    return ret;
+                }
+            }
+
             ret = nxt_lvlhsh_find(&proto->hash, &pq->lhq);
 
             if (ret == NXT_OK) {
@@ -483,6 +522,54 @@ next:
 }
 
 
+static njs_ret_t
+njs_object_shape_property_query(njs_vm_t *vm, njs_property_query_t *pq,
+    njs_object_t *object)
+{
+    njs_value_t         *slot;
+    njs_object_prop_t   *prop;
+    njs_object_shape_t  *shape;
+
+    if (pq->query == NJS_PROPERTY_QUERY_DELETE) {
+        if (nxt_slow_path(njs_object_dictionary(vm, object) != NXT_OK)) {
+            return NXT_ERROR;
+        }
+
+        /* The property is looked up in the object hash. */
+        return NXT_DECLINED;
+    }
+
+    shape = njs_object_shape_find(object->shape, &pq->lhq);
+
+    if (shape == NULL) {
+        return NXT_DECLINED;
+    }
+
+    slot = &object->slots[shape->count - 1];
+
+    prop = &pq->scratch;
+
+    if (pq->query == NJS_PROPERTY_QUERY_GET) {
+        prop->value = *slot;
+        prop->type = NJS_PROPERTY;
+
+    } else {
+        prop->value.data.u.value = slot;
+        prop->type = NJS_PROPERTY_REF;
+    }
+
+    prop->name = shape->name;
+    prop->configurable = 1;
+    prop->enumerable = 1;
+    prop->writable = 1;
+
+    pq->lhq.value = prop;
+    pq->shared = 0;
+
+    return NXT_OK;
+}
+
+
 static njs_ret_t
 njs_array_property_query(njs_vm_t *vm, njs_property_query_t *pq,
     njs_array_t *array, uint32_t index)
@@ -759,6 +846,8 @@ njs_method_private_copy(njs_vm_t *vm, njs_property_query_t *pq)
     shared = pq->lhq.value;
     *prop = *shared;
 
+    njs_gc_register(vm, prop, NJS_GC_PROP, sizeof(njs_object_prop_t));
+
     function = njs_function_value_copy(vm, &prop->value);
     if (nxt_slow_path(function == NULL)) {
         return NXT_ERROR;
@@ -768,6 +857,8 @@ njs_method_private_copy(njs_vm_t *vm, njs_property_query_t *pq)
     pq->lhq.value = prop;
     pq->lhq.pool = vm->mem_pool;
 
+    njs_object_prop_cache_invalidate(vm, pq->prototype);
+
     return nxt_lvlhsh_insert(&pq->prototype->hash, &pq->lhq);
 }
 
@@ -964,6 +1055,7 @@ njs_object_enumerate(njs_vm_t *vm, const njs_value_t *value,
     njs_object_prop_t  *prop;
     njs_string_prop_t  string_prop;
     nxt_lvlhsh_each_t  lhe;
+    njs_object_each_t  each;
 
     static const njs_value_t  njs_string_length = njs_string("length");
 
@@ -1019,11 +1111,10 @@ njs_object_enumerate(njs_vm_t *vm, const njs_value_t *value,
     properties = 0;
 
     if (nxt_fast_path(njs_is_object(value))) {
-        nxt_lvlhsh_each_init(&lhe, &njs_object_hash_proto);
-        hash = &value->data.u.object->hash;
+        njs_object_each_init(&each);
 
         for ( ;; ) {
-            prop = nxt_lvlhsh_each(hash, &lhe);
+            prop = njs_object_each(value->data.u.object, &each);
 
             if (prop == NULL) {
                 break;
@@ -1215,15 +1306,13 @@ njs_object_enumerate(njs_vm_t *vm, const njs_value_t *value,
     }
 
     if (nxt_fast_path(properties != 0)) {
-        nxt_lvlhsh_each_init(&lhe, &njs_object_hash_proto);
-
-        hash = &value->data.u.object->hash;
+        njs_object_each_init(&each);
 
         switch (kind) {
 
         case NJS_ENUM_KEYS:
             for ( ;; ) {
-                prop = nxt_lvlhsh_each(hash, &lhe);
+                prop = njs_object_each(value->data.u.object, &each);
 
                 if (prop == NULL) {
                     break;
@@ -1253,7 +1342,7 @@ njs_object_enumerate(njs_vm_t *vm, const njs_value_t *value,
 
         case NJS_ENUM_VALUES:
             for ( ;; ) {
-                prop = nxt_lvlhsh_each(hash, &lhe);
+                prop = njs_object_each(value->data.u.object, &each);
 
                 if (prop == NULL) {
                     break;
@@ -1269,7 +1358,7 @@ njs_object_enumerate(njs_vm_t *vm, const njs_value_t *value,
 
         case NJS_ENUM_BOTH:
             for ( ;; ) {
-                prop = nxt_lvlhsh_each(hash, &lhe);
+                prop = njs_object_each(value->data.u.object, &each);
 
                 if (prop == NULL) {
                     break;
@@ -1349,9 +1438,8 @@ njs_object_define_properties(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
 {
     nxt_int_t          ret;
     njs_value_t        *value;
-    nxt_lvlhsh_t       *hash;
-    nxt_lvlhsh_each_t  lhe;
     njs_object_prop_t  *prop;
+    njs_object_each_t  each;
     const njs_value_t  *descriptor;
 
     value = &args[1];
@@ -1375,12 +1463,10 @@ njs_object_define_properties(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
         return NXT_ERROR;
     }
 
-    nxt_lvlhsh_each_init(&lhe, &njs_object_hash_proto);
-
-    hash = &descriptor->data.u.object->hash;
+    njs_object_each_init(&each);
 
     for ( ;; ) {
-        prop = nxt_lvlhsh_each(hash, &lhe);
+        prop = njs_object_each(descriptor->data.u.object, &each);
 
         if (prop == NULL) {
             break;
@@ -1406,9 +1492,9 @@ static uint8_t
 njs_descriptor_attribute(njs_vm_t *vm, const njs_object_t *descriptor,
     nxt_lvlhsh_query_t *pq, nxt_bool_t unset)
 {
-    njs_object_prop_t  *prop;
+    njs_object_prop_t  *prop, scratch;
 
-    prop = njs_object_property(vm, descriptor, pq);
+    prop = njs_object_property(vm, descriptor, pq, &scratch);
     if (prop != NULL) {
         return prop->value.data.truth;
     }
@@ -1422,7 +1508,7 @@ njs_descriptor_prop(njs_vm_t *vm, const njs_value_t *name,
     const njs_object_t *descriptor, nxt_bool_t unset)
 {
     const njs_value_t   *value;
-    njs_object_prop_t   *prop, *pr;
+    njs_object_prop_t   *prop, *pr, scratch;
     nxt_lvlhsh_query_t  pq;
 
     value = unset ? &njs_value_invalid : &njs_value_undefined;
@@ -1447,7 +1533,7 @@ njs_descriptor_prop(njs_vm_t *vm, const njs_value_t *name,
     pq.key_hash = NJS_VALUE_HASH;
     pq.proto = &njs_object_hash_proto;
 
-    pr = njs_object_property(vm, descriptor, &pq);
+    pr = njs_object_property(vm, descriptor, &pq, &scratch);
     if (pr != NULL) {
         prop->value = pr->value;
     }
@@ -1470,6 +1556,13 @@ njs_define_property(njs_vm_t *vm, njs_value_t *object, const njs_value_t *name,
     njs_object_prop_t     *desc, *current;
     njs_property_query_t  pq;
 
+    /* Properties with non-default attributes are kept in the object hash. */
+
+    ret = njs_object_dictionary(vm, object->data.u.object);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return ret;
+    }
+
     njs_string_get(name, &pq.lhq.key);
     pq.lhq.key_hash = nxt_djb_hash(pq.lhq.key.start, pq.lhq.key.length);
     pq.lhq.proto = &njs_object_hash_proto;
@@ -1509,6 +1602,8 @@ njs_define_property(njs_vm_t *vm, njs_value_t *object, const njs_value_t *name,
             }
         }
 
+        njs_object_prop_cache_invalidate(vm, object->data.u.object);
+
         return NXT_OK;
     }
 
@@ -1584,6 +1679,7 @@ njs_define_property(njs_vm_t *vm, njs_value_t *object, const njs_value_t *name,
 
     if (desc->writable != NJS_ATTRIBUTE_UNSET) {
         current->writable = desc->writable;
+        njs_object_prop_cache_invalidate(vm, object->data.u.object);
     }
 
     if (njs_is_valid(&desc->value)) {
@@ -1921,6 +2017,10 @@ njs_object_freeze(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
     object = value->data.u.object;
     object->extensible = 0;
 
+    if (nxt_slow_path(njs_object_dictionary(vm, object) != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
     nxt_lvlhsh_each_init(&lhe, &njs_object_hash_proto);
 
     hash = &object->hash;
@@ -1936,6 +2036,8 @@ njs_object_freeze(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
         prop->configurable = 0;
     }
 
+    njs_object_prop_cache_invalidate(vm, object);
+
     vm->retval = *value;
 
     return NXT_OK;
@@ -1946,10 +2048,9 @@ static njs_ret_t
 njs_object_is_frozen(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
     njs_index_t unused)
 {
-    nxt_lvlhsh_t       *hash;
     njs_object_t       *object;
     njs_object_prop_t  *prop;
-    nxt_lvlhsh_each_t  lhe;
+    njs_object_each_t  each;
     const njs_value_t  *value, *retval;
 
     value = njs_arg(args, nargs, 1);
@@ -1962,16 +2063,14 @@ njs_object_is_frozen(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
     retval = &njs_value_false;
 
     object = value->data.u.object;
-    nxt_lvlhsh_each_init(&lhe, &njs_object_hash_proto);
-
-    hash = &object->hash;
+    njs_object_each_init(&each);
 
     if (object->extensible) {
         goto done;
     }
 
     for ( ;; ) {
-        prop = nxt_lvlhsh_each(hash, &lhe);
+        prop = njs_object_each(object, &each);
 
         if (prop == NULL) {
             break;
@@ -2012,6 +2111,10 @@ njs_object_seal(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
     object = value->data.u.object;
     object->extensible = 0;
 
+    if (nxt_slow_path(njs_object_dictionary(vm, object) != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
     nxt_lvlhsh_each_init(&lhe, &njs_object_hash_proto);
 
     hash = &object->hash;
@@ -2036,10 +2139,9 @@ static njs_ret_t
 njs_object_is_sealed(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
     njs_index_t unused)
 {
-    nxt_lvlhsh_t       *hash;
     njs_object_t       *object;
     njs_object_prop_t  *prop;
-    nxt_lvlhsh_each_t  lhe;
+    njs_object_each_t  each;
     const njs_value_t  *value, *retval;
 
     value = njs_arg(args, nargs, 1);
@@ -2052,16 +2154,14 @@ njs_object_is_sealed(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
     retval = &njs_value_false;
 
     object = value->data.u.object;
-    nxt_lvlhsh_each_init(&lhe, &njs_object_hash_proto);
-
-    hash = &object->hash;
+    njs_object_each_init(&each);
 
     if (object->extensible) {
         goto done;
     }
 
     for ( ;; ) {
-        prop = nxt_lvlhsh_each(hash, &lhe);
+        prop = njs_object_each(object, &each);
 
         if (prop == NULL) {
             break;
@@ -2222,6 +2322,7 @@ njs_property_prototype_create(njs_vm_t *vm, nxt_lvlhsh_t *hash,
     ret = nxt_lvlhsh_insert(hash, &lhq);
 
     if (nxt_fast_path(ret == NXT_OK)) {
+        njs_prop_cache_invalidate(vm);
         return &prop->value;
     }
 
@@ -2409,6 +2510,8 @@ njs_object_set_prototype_of(njs_vm_t *vm, njs_object_t *object,
         return 1;
     }
 
+    njs_prop_cache_invalidate(vm);
+
     if (nxt_slow_path(proto == NULL)) {
         object->__proto__ = NULL;
         return 1;
@@ -2554,6 +2657,7 @@ njs_property_constructor_create(njs_vm_t *vm, nxt_lvlhsh_t *hash,
     ret = nxt_lvlhsh_insert(hash, &lhq);
 
     if (nxt_fast_path(ret == NXT_OK)) {
+        njs_prop_cache_invalidate(vm);
         return &prop->value;
     }
 
@@ -60,6 +60,10 @@ typedef struct {
 
     njs_value_t                 value;
     njs_object_t                *prototype;
+
+    /* The property name atom, the name hash is not calculated if set. */
+    const njs_atom_t            *atom;
+
     uint8_t                     query;
     uint8_t                     shared;
     uint8_t                     own;
@@ -70,11 +74,60 @@ typedef struct {
     do {                                                                      \
         (pq)->lhq.key.length = 0;                                             \
         (pq)->lhq.value = NULL;                                               \
+        (pq)->atom = NULL;                                                    \
         (pq)->query = _query;                                                 \
         (pq)->own = _own;                                                     \
     } while (0)
 
 
+/*
+ * A property cache of an instruction accessing a property by constant name.
+ * Each way remembers either an object shape or an object in the dictionary
+ * mode and the property value found in the object or in its prototype
+ * chain.  A property stored in the slots of an object with a shape is
+ * remembered by the slot number, such ways remain valid while the object
+ * has the same shape.  Otherwise the objects up to the property holder
+ * are marked as watched, adding or deleting their properties or changing
+ * any prototype invalidates all such ways of all the caches at once by
+ * incrementing vm->prop_cache_epoch.
+ */
+
+#define NJS_PROP_CACHE_WAYS         4
+
+typedef struct {
+    /* An object shape or an object. */
+    void                        *key;
+
+    njs_object_t                *proto;
+
+    /* The property value or NULL if the property is in the object slot. */
+    njs_value_t                 *value;
+
+    uint32_t                    slot;
+    uint32_t                    epoch;
+} njs_prop_cache_way_t;
+
+
+struct njs_prop_cache_s {
+    njs_prop_cache_way_t        way[NJS_PROP_CACHE_WAYS];
+    uint32_t                    next;
+    uint32_t                    hits;
+    uint32_t                    misses;
+};
+
+
+#define njs_prop_cache_invalidate(vm)                                         \
+    (vm)->prop_cache_epoch++
+
+
+#define njs_object_prop_cache_invalidate(vm, object)                          \
+    do {                                                                      \
+        if ((object)->watched) {                                              \
+            njs_prop_cache_invalidate(vm);                                    \
+        }                                                                     \
+    } while (0)
+
+
 struct njs_object_init_s {
     nxt_str_t                   name;
     const njs_object_prop_t     *properties;
@@ -91,7 +144,7 @@ njs_array_t *njs_object_enumerate(njs_vm_t *vm, const njs_value_t *value,
 njs_ret_t njs_value_property(njs_vm_t *vm, const njs_value_t *value,
     const njs_value_t *property, njs_value_t *retval);
 njs_object_prop_t *njs_object_property(njs_vm_t *vm, const njs_object_t *obj,
-    nxt_lvlhsh_query_t *lhq);
+    nxt_lvlhsh_query_t *lhq, njs_object_prop_t *scratch);
 njs_ret_t njs_property_query(njs_vm_t *vm, njs_property_query_t *pq,
     njs_value_t *object, const njs_value_t *property);
 nxt_int_t njs_object_hash_create(njs_vm_t *vm, nxt_lvlhsh_t *hash,
@@ -40,6 +40,8 @@ static njs_token_t njs_parser_return_statement(njs_vm_t *vm,
 static njs_token_t njs_parser_var_statement(njs_vm_t *vm, njs_parser_t *parser,
     nxt_bool_t var_in);
 static njs_token_t njs_parser_if_statement(njs_vm_t *vm, njs_parser_t *parser);
+static void njs_parser_branch_eliminate(njs_parser_t *parser);
+static nxt_bool_t njs_parser_has_function(njs_parser_node_t *node);
 static njs_token_t njs_parser_switch_statement(njs_vm_t *vm,
     njs_parser_t *parser);
 static njs_token_t njs_parser_while_statement(njs_vm_t *vm,
@@ -1145,10 +1147,61 @@ njs_parser_if_statement(njs_vm_t *vm, njs_parser_t *parser)
     node->right = parser->node;
     parser->node = node;
 
+    if (njs_parser_is_literal(cond)) {
+        njs_parser_branch_eliminate(parser);
+    }
+
     return token;
 }
 
 
+/*
+ * A branch which is never executed is not generated unless it declares
+ * a function, because the function is hoisted to the enclosing scope.
+ */
+
+static void
+njs_parser_branch_eliminate(njs_parser_t *parser)
+{
+    nxt_bool_t         truth;
+    njs_parser_node_t  *node, *live, *dead;
+
+    node = parser->node;
+    truth = njs_is_true(&node->left->u.value);
+
+    if (node->right != NULL && node->right->token == NJS_TOKEN_BRANCHING) {
+        live = truth ? node->right->left : node->right->right;
+        dead = truth ? node->right->right : node->right->left;
+
+    } else {
+        live = truth ? node->right : NULL;
+        dead = truth ? NULL : node->right;
+    }
+
+    if (njs_parser_has_function(dead)) {
+        return;
+    }
+
+    parser->node = live;
+}
+
+
+static nxt_bool_t
+njs_parser_has_function(njs_parser_node_t *node)
+{
+    if (node == NULL) {
+        return 0;
+    }
+
+    if (node->token == NJS_TOKEN_FUNCTION) {
+        return 1;
+    }
+
+    return njs_parser_has_function(node->left)
+           || njs_parser_has_function(node->right);
+}
+
+
 static njs_token_t
 njs_parser_switch_statement(njs_vm_t *vm, njs_parser_t *parser)
 {
@@ -1280,6 +1333,15 @@ njs_parser_while_statement(njs_vm_t *vm, njs_parser_t *parser)
         return token;
     }
 
+    if (njs_parser_is_literal(cond)
+        && !njs_is_true(&cond->u.value)
+        && !njs_parser_has_function(parser->node))
+    {
+        /* The loop body is never executed. */
+        parser->node = NULL;
+        return token;
+    }
+
     node = njs_parser_node_new(vm, parser, NJS_TOKEN_WHILE);
     if (nxt_slow_path(node == NULL)) {
         return NJS_TOKEN_ERROR;
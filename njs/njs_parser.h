@@ -108,6 +108,14 @@ void njs_parser_node_error(njs_vm_t *vm, njs_parser_node_t *node,
     ((node)->token == NJS_TOKEN_NAME || (node)->token == NJS_TOKEN_PROPERTY)
 
 
+#define njs_parser_is_literal(node)                                           \
+    ((node)->token == NJS_TOKEN_NUMBER                                        \
+     || (node)->token == NJS_TOKEN_STRING                                     \
+     || (node)->token == NJS_TOKEN_BOOLEAN                                    \
+     || (node)->token == NJS_TOKEN_NULL                                       \
+     || (node)->token == NJS_TOKEN_UNDEFINED)
+
+
 #define njs_scope_accumulative(vm, scope)                                     \
     ((vm)->options.accumulative && (scope)->type == NJS_SCOPE_GLOBAL)
 
@@ -66,6 +66,7 @@ static njs_token_t njs_parser_call(njs_vm_t *vm, njs_parser_t *parser,
     njs_token_t token, uint8_t ctor);
 static njs_token_t njs_parser_arguments(njs_vm_t *vm, njs_parser_t *parser,
     njs_parser_node_t *parent);
+static void njs_parser_fold(njs_vm_t *vm, njs_parser_t *parser);
 
 
 static const njs_parser_expression_t
@@ -202,6 +203,38 @@ static const njs_parser_expression_t
 };
 
 
+/* The operations which have no side effects on primitive values. */
+
+static const njs_vmcode_operation_t  njs_parser_fold_operations[] = {
+    njs_vmcode_addition,
+    njs_vmcode_substraction,
+    njs_vmcode_multiplication,
+    njs_vmcode_exponentiation,
+    njs_vmcode_division,
+    njs_vmcode_remainder,
+    njs_vmcode_left_shift,
+    njs_vmcode_right_shift,
+    njs_vmcode_unsigned_right_shift,
+    njs_vmcode_bitwise_and,
+    njs_vmcode_bitwise_xor,
+    njs_vmcode_bitwise_or,
+    njs_vmcode_less,
+    njs_vmcode_less_or_equal,
+    njs_vmcode_greater,
+    njs_vmcode_greater_or_equal,
+    njs_vmcode_equal,
+    njs_vmcode_not_equal,
+    njs_vmcode_strict_equal,
+    njs_vmcode_strict_not_equal,
+    njs_vmcode_unary_plus,
+    njs_vmcode_unary_negation,
+    njs_vmcode_logical_not,
+    njs_vmcode_bitwise_not,
+    njs_vmcode_typeof,
+    njs_vmcode_void,
+};
+
+
 njs_token_t
 njs_parser_expression(njs_vm_t *vm, njs_parser_t *parser, njs_token_t token)
 {
@@ -406,6 +439,8 @@ njs_parser_conditional_expression(njs_vm_t *vm, njs_parser_t *parser,
         node->right->dest = cond;
 
         parser->node = cond;
+
+        njs_parser_fold(vm, parser);
     }
 }
 
@@ -463,6 +498,8 @@ njs_parser_binary_expression(njs_vm_t *vm, njs_parser_t *parser,
         node->right = parser->node;
         node->right->dest = node;
         parser->node = node;
+
+        njs_parser_fold(vm, parser);
     }
 }
 
@@ -502,6 +539,8 @@ njs_parser_exponential_expression(njs_vm_t *vm, njs_parser_t *parser,
         node->right = parser->node;
         node->right->dest = node;
         parser->node = node;
+
+        njs_parser_fold(vm, parser);
     }
 
     return token;
@@ -623,6 +662,8 @@ njs_parser_unary_expression(njs_vm_t *vm, njs_parser_t *parser,
     node->left->dest = node;
     parser->node = node;
 
+    njs_parser_fold(vm, parser);
+
     return next;
 }
 
@@ -1000,3 +1041,125 @@ njs_parser_argument(njs_vm_t *vm, njs_parser_t *parser,
 
     return node;
 }
+
+
+/*
+ * An operation on literals is evaluated at compile time by the same
+ * function which the interpreter calls.  The function returns a trap
+ * if an operand has to be converted, such operations are not folded.
+ * The logical and conditional operations with a literal condition are
+ * replaced by the operand which is evaluated.
+ */
+
+static void
+njs_parser_fold(njs_vm_t *vm, njs_parser_t *parser)
+{
+    njs_ret_t          ret;
+    nxt_uint_t         n;
+    njs_token_t        token;
+    njs_value_t        retval, *value;
+    njs_parser_node_t  *node, *expr;
+
+    node = parser->node;
+
+    if (!njs_parser_is_literal(node->left)) {
+        return;
+    }
+
+    switch (node->token) {
+
+    case NJS_TOKEN_LOGICAL_AND:
+    case NJS_TOKEN_LOGICAL_OR:
+        if (njs_is_true(&node->left->u.value)
+            == (node->token == NJS_TOKEN_LOGICAL_OR))
+        {
+            expr = node->left;
+
+        } else {
+            expr = node->right;
+        }
+
+        expr->dest = NULL;
+        parser->node = expr;
+
+        return;
+
+    case NJS_TOKEN_CONDITIONAL:
+        if (njs_is_true(&node->left->u.value)) {
+            expr = node->right->left;
+
+        } else {
+            expr = node->right->right;
+        }
+
+        expr->dest = NULL;
+        parser->node = expr;
+
+        return;
+
+    default:
+        break;
+    }
+
+    for (n = 0; n < nxt_nitems(njs_parser_fold_operations); n++) {
+        if (node->u.operation == njs_parser_fold_operations[n]) {
+            goto found;
+        }
+    }
+
+    return;
+
+found:
+
+    value = NULL;
+
+    if (node->right != NULL) {
+        if (!njs_parser_is_literal(node->right)) {
+            return;
+        }
+
+        value = &node->right->u.value;
+    }
+
+    retval = vm->retval;
+
+    ret = node->u.operation(vm, &node->left->u.value, value);
+
+    if (ret > 0) {
+        switch (vm->retval.type) {
+
+        case NJS_NULL:
+            token = NJS_TOKEN_NULL;
+            break;
+
+        case NJS_UNDEFINED:
+            token = NJS_TOKEN_UNDEFINED;
+            break;
+
+        case NJS_BOOLEAN:
+            token = NJS_TOKEN_BOOLEAN;
+            break;
+
+        case NJS_NUMBER:
+            token = NJS_TOKEN_NUMBER;
+            break;
+
+        case NJS_STRING:
+            token = NJS_TOKEN_STRING;
+            break;
+
+        default:
+            token = NJS_TOKEN_ILLEGAL;
+            break;
+        }
+
+        if (token != NJS_TOKEN_ILLEGAL) {
+            node->token = token;
+            node->u.value = vm->retval;
+            node->left = NULL;
+            node->right = NULL;
+        }
+    }
+
+    vm->retval = retval;
+}
@@ -0,0 +1,799 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <njs_core.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+typedef struct {
+    njs_function_lambda_t       *lambda;
+
+    uint64_t                    calls;
+    uint64_t                    count;
+    uint64_t                    time;
+} njs_profile_function_t;
+
+
+typedef struct {
+    njs_vmcode_operation_t      operation;
+
+    uint64_t                    count;
+    uint64_t                    time;
+} njs_profile_operation_t;
+
+
+static nxt_int_t njs_profile_code_test(nxt_lvlhsh_query_t *lhq, void *data);
+static nxt_int_t njs_profile_function_test(nxt_lvlhsh_query_t *lhq,
+    void *data);
+static njs_profile_code_t *njs_profile_code_add(njs_vm_t *vm, u_char *code);
+static njs_profile_function_t *njs_profile_function_add(njs_vm_t *vm,
+    njs_function_lambda_t *lambda);
+static nxt_int_t njs_profile_summary(njs_vm_t *vm, nxt_array_t *operations,
+    nxt_array_t *functions, uint64_t *total);
+static int njs_profile_operation_cmp(const void *one, const void *two);
+static int njs_profile_function_cmp(const void *one, const void *two);
+static njs_function_debug_t *njs_profile_function_debug(njs_vm_t *vm,
+    njs_function_lambda_t *lambda);
+static void njs_profile_sample(njs_vm_t *vm);
+static nxt_int_t njs_profile_stack_test(nxt_lvlhsh_query_t *lhq, void *data);
+static void njs_profile_frame_name(njs_vm_t *vm, njs_profile_frame_t *frame,
+    nxt_str_t *name, njs_function_debug_t **debug);
+
+
+static const nxt_lvlhsh_proto_t  njs_profile_code_hash_proto
+    nxt_aligned(64) =
+{
+    NXT_LVLHSH_DEFAULT,
+    0,
+    njs_profile_code_test,
+    njs_lvlhsh_alloc,
+    njs_lvlhsh_free,
+};
+
+
+static const nxt_lvlhsh_proto_t  njs_profile_function_hash_proto
+    nxt_aligned(64) =
+{
+    NXT_LVLHSH_DEFAULT,
+    0,
+    njs_profile_function_test,
+    njs_lvlhsh_alloc,
+    njs_lvlhsh_free,
+};
+
+
+static const nxt_lvlhsh_proto_t  njs_profile_stack_hash_proto
+    nxt_aligned(64) =
+{
+    NXT_LVLHSH_DEFAULT,
+    0,
+    njs_profile_stack_test,
+    njs_lvlhsh_alloc,
+    njs_lvlhsh_free,
+};
+
+
+/* The code and function hashes are keyed by pointers. */
+
+#define njs_profile_query_init(lhq, pointer)                                  \
+    do {                                                                      \
+        (lhq)->key.length = sizeof(void *);                                   \
+        (lhq)->key.start = (u_char *) &(pointer);                             \
+        (lhq)->key_hash = nxt_djb_hash(&(pointer), sizeof(void *));           \
+    } while (0)
+
+
+nxt_int_t
+njs_profile_init(njs_vm_t *vm)
+{
+    njs_profile_t  *profile;
+
+    profile = nxt_mp_zalloc(vm->mem_pool, sizeof(njs_profile_t));
+    if (nxt_slow_path(profile == NULL)) {
+        return NXT_ERROR;
+    }
+
+    nxt_lvlhsh_init(&profile->codes);
+    nxt_lvlhsh_init(&profile->functions);
+    nxt_lvlhsh_init(&profile->stacks);
+
+    profile->counters = vm->options.profile;
+    profile->interval = vm->options.sample_interval;
+    profile->countdown = profile->interval;
+
+    vm->profile = profile;
+
+    return NXT_OK;
+}
+
+
+/*
+ * njs_profile_code() is called by the interpreter before execution
+ * of the instruction at vm->current.
+ */
+
+void
+njs_profile_code(njs_vm_t *vm)
+{
+    njs_profile_t       *profile;
+    njs_profile_code_t  *code;
+
+    profile = vm->profile;
+
+    if (profile->interval != 0 && --profile->countdown == 0) {
+        profile->countdown = profile->interval;
+        njs_profile_sample(vm);
+    }
+
+    if (!profile->counters) {
+        return;
+    }
+
+    njs_profile_stop(vm);
+
+    code = njs_profile_code_add(vm, vm->current);
+
+    if (nxt_fast_path(code != NULL)) {
+        code->count++;
+
+        profile->current = code;
+        profile->start = nxt_time();
+    }
+}
+
+
+void
+njs_profile_call(njs_vm_t *vm, njs_function_lambda_t *lambda)
+{
+    njs_profile_function_t  *function;
+
+    if (!vm->profile->counters) {
+        return;
+    }
+
+    function = njs_profile_function_add(vm, lambda);
+
+    if (nxt_fast_path(function != NULL)) {
+        function->calls++;
+    }
+}
+
+
+uint64_t
+njs_profile_code_count(njs_vm_t *vm, u_char *code)
+{
+    nxt_lvlhsh_query_t  lhq;
+
+    njs_profile_query_init(&lhq, code);
+    lhq.proto = &njs_profile_code_hash_proto;
+
+    if (nxt_lvlhsh_find(&vm->profile->codes, &lhq) == NXT_OK) {
+        return ((njs_profile_code_t *) lhq.value)->count;
+    }
+
+    return 0;
+}
+
+
+static nxt_int_t
+njs_profile_code_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    njs_profile_code_t  *code;
+
+    code = data;
+
+    if (*(u_char **) lhq->key.start == code->code) {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+static nxt_int_t
+njs_profile_function_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    njs_profile_function_t  *function;
+
+    function = data;
+
+    if (*(njs_function_lambda_t **) lhq->key.start == function->lambda) {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+static njs_profile_code_t *
+njs_profile_code_add(njs_vm_t *vm, u_char *start)
+{
+    nxt_int_t           ret;
+    njs_function_t      *function;
+    njs_profile_code_t  *code;
+    nxt_lvlhsh_query_t  lhq;
+
+    njs_profile_query_init(&lhq, start);
+    lhq.proto = &njs_profile_code_hash_proto;
+
+    if (nxt_lvlhsh_find(&vm->profile->codes, &lhq) == NXT_OK) {
+        return lhq.value;
+    }
+
+    code = nxt_mp_zalloc(vm->mem_pool, sizeof(njs_profile_code_t));
+    if (nxt_slow_path(code == NULL)) {
+        return NULL;
+    }
+
+    code->code = start;
+    code->operation = ((njs_vmcode_generic_t *) start)->code.operation;
+
+    function = vm->active_frame->native.function;
+    code->lambda = (function != NULL) ? function->u.lambda : NULL;
+
+    lhq.replace = 0;
+    lhq.value = code;
+    lhq.pool = vm->mem_pool;
+
+    ret = nxt_lvlhsh_insert(&vm->profile->codes, &lhq);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NULL;
+    }
+
+    return code;
+}
+
+
+static njs_profile_function_t *
+njs_profile_function_add(njs_vm_t *vm, njs_function_lambda_t *lambda)
+{
+    nxt_int_t               ret;
+    nxt_lvlhsh_query_t      lhq;
+    njs_profile_function_t  *function;
+
+    njs_profile_query_init(&lhq, lambda);
+    lhq.proto = &njs_profile_function_hash_proto;
+
+    if (nxt_lvlhsh_find(&vm->profile->functions, &lhq) == NXT_OK) {
+        return lhq.value;
+    }
+
+    function = nxt_mp_zalloc(vm->mem_pool, sizeof(njs_profile_function_t));
+    if (nxt_slow_path(function == NULL)) {
+        return NULL;
+    }
+
+    function->lambda = lambda;
+
+    lhq.replace = 0;
+    lhq.value = function;
+    lhq.pool = vm->mem_pool;
+
+    ret = nxt_lvlhsh_insert(&vm->profile->functions, &lhq);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NULL;
+    }
+
+    return function;
+}
+
+
+/*
+ * njs_vm_profile_dump() prints the operations and the functions sorted
+ * by time they took.  The time of a function does not include the time
+ * of functions it called.
+ */
+
+nxt_int_t
+njs_vm_profile_dump(njs_vm_t *vm, nxt_str_t *retval)
+{
+    u_char                   *p, *end;
+    size_t                   size;
+    double                   percent;
+    uint64_t                 total;
+    nxt_int_t                ret;
+    nxt_uint_t               n;
+    nxt_str_t                name;
+    nxt_array_t              *operations, *functions;
+    njs_function_debug_t     *debug;
+    njs_profile_function_t   **function;
+    njs_profile_operation_t  *operation;
+
+    static const nxt_str_t  main_name = nxt_string("main");
+
+    if (vm->profile == NULL || !vm->profile->counters) {
+        retval->length = 0;
+        retval->start = NULL;
+        return NXT_DECLINED;
+    }
+
+    ret = NXT_ERROR;
+
+    operations = nxt_array_create(32, sizeof(njs_profile_operation_t),
+                                  &njs_array_mem_proto, vm->mem_pool);
+    if (nxt_slow_path(operations == NULL)) {
+        return NXT_ERROR;
+    }
+
+    functions = nxt_array_create(8, sizeof(njs_profile_function_t *),
+                                 &njs_array_mem_proto, vm->mem_pool);
+    if (nxt_slow_path(functions == NULL)) {
+        goto fail;
+    }
+
+    if (njs_profile_summary(vm, operations, functions, &total) != NXT_OK) {
+        goto fail;
+    }
+
+    qsort(operations->start, operations->items,
+          sizeof(njs_profile_operation_t), njs_profile_operation_cmp);
+
+    qsort(functions->start, functions->items,
+          sizeof(njs_profile_function_t *), njs_profile_function_cmp);
+
+    size = 256 + operations->items * 80;
+
+    function = functions->start;
+
+    for (n = 0; n < functions->items; n++) {
+        size += 96;
+
+        debug = njs_profile_function_debug(vm, function[n]->lambda);
+
+        if (debug != NULL) {
+            size += debug->name.length + debug->file.length;
+        }
+    }
+
+    p = nxt_mp_alloc(vm->mem_pool, size);
+    if (nxt_slow_path(p == NULL)) {
+        goto fail;
+    }
+
+    retval->start = p;
+    end = p + size;
+
+    if (total == 0) {
+        total = 1;
+    }
+
+    p = nxt_sprintf(p, end, "operations:\n"
+                    "       count       time(ns)       %%  name\n");
+
+    operation = operations->start;
+
+    for (n = 0; n < operations->items; n++) {
+        percent = 100.0 * operation[n].time / total;
+
+        p = nxt_sprintf(p, end, "%12uL %14uL %7.2f  %V\n",
+                        operation[n].count, operation[n].time, percent,
+                        njs_vmcode_name(operation[n].operation));
+    }
+
+    p = nxt_sprintf(p, end, "\nfunctions:\n"
+                    "       calls        count       time(ns)       %%  name\n");
+
+    for (n = 0; n < functions->items; n++) {
+        percent = 100.0 * function[n]->time / total;
+
+        p = nxt_sprintf(p, end, "%12uL %12uL %14uL %7.2f  ",
+                        function[n]->calls, function[n]->count,
+                        function[n]->time, percent);
+
+        if (function[n]->lambda == NULL) {
+            p = nxt_sprintf(p, end, "%V\n", &main_name);
+            continue;
+        }
+
+        debug = njs_profile_function_debug(vm, function[n]->lambda);
+
+        if (debug == NULL) {
+            p = nxt_sprintf(p, end, "%V\n", &njs_entry_unknown);
+            continue;
+        }
+
+        name = (debug->name.length != 0) ? debug->name : njs_entry_anonymous;
+
+        p = nxt_sprintf(p, end, "%V at %V:%uD\n", &name, &debug->file,
+                        debug->line);
+    }
+
+    retval->length = p - retval->start;
+
+    ret = NXT_OK;
+
+fail:
+
+    nxt_array_destroy(operations, &njs_array_mem_proto, vm->mem_pool);
+
+    if (functions != NULL) {
+        nxt_array_destroy(functions, &njs_array_mem_proto, vm->mem_pool);
+    }
+
+    return ret;
+}
+
+
+static nxt_int_t
+njs_profile_summary(njs_vm_t *vm, nxt_array_t *operations,
+    nxt_array_t *functions, uint64_t *total)
+{
+    nxt_uint_t               n;
+    nxt_lvlhsh_each_t        lhe;
+    njs_profile_code_t       *code;
+    njs_profile_function_t   *function, **f;
+    njs_profile_operation_t  *operation;
+
+    njs_profile_stop(vm);
+
+    *total = 0;
+
+    nxt_lvlhsh_each_init(&lhe, &njs_profile_function_hash_proto);
+
+    for ( ;; ) {
+        function = nxt_lvlhsh_each(&vm->profile->functions, &lhe);
+        if (function == NULL) {
+            break;
+        }
+
+        function->count = 0;
+        function->time = 0;
+    }
+
+    nxt_lvlhsh_each_init(&lhe, &njs_profile_code_hash_proto);
+
+    for ( ;; ) {
+        code = nxt_lvlhsh_each(&vm->profile->codes, &lhe);
+        if (code == NULL) {
+            break;
+        }
+
+        *total += code->time;
+
+        function = njs_profile_function_add(vm, code->lambda);
+        if (nxt_slow_path(function == NULL)) {
+            return NXT_ERROR;
+        }
+
+        function->count += code->count;
+        function->time += code->time;
+
+        operation = operations->start;
+
+        for (n = 0; n < operations->items; n++) {
+            if (operation[n].operation == code->operation) {
+                break;
+            }
+        }
+
+        if (n == operations->items) {
+            operation = nxt_array_zero_add(operations, &njs_array_mem_proto,
+                                           vm->mem_pool);
+            if (nxt_slow_path(operation == NULL)) {
+                return NXT_ERROR;
+            }
+
+            operation->operation = code->operation;
+
+        } else {
+            operation = &operation[n];
+        }
+
+        operation->count += code->count;
+        operation->time += code->time;
+    }
+
+    nxt_lvlhsh_each_init(&lhe, &njs_profile_function_hash_proto);
+
+    for ( ;; ) {
+        function = nxt_lvlhsh_each(&vm->profile->functions, &lhe);
+        if (function == NULL) {
+            break;
+        }
+
+        f = nxt_array_add(functions, &njs_array_mem_proto, vm->mem_pool);
+        if (nxt_slow_path(f == NULL)) {
+            return NXT_ERROR;
+        }
+
+        *f = function;
+    }
+
+    return NXT_OK;
+}
+
+
+static int
+njs_profile_operation_cmp(const void *one, const void *two)
+{
+    const njs_profile_operation_t  *op1, *op2;
+
+    op1 = one;
+    op2 = two;
+
+    if (op1->time != op2->time) {
+        return (op1->time < op2->time) ? 1 : -1;
+    }
+
+    if (op1->count != op2->count) {
+        return (op1->count < op2->count) ? 1 : -1;
+    }
+
+    return 0;
+}
+
+
+static int
+njs_profile_function_cmp(const void *one, const void *two)
+{
+    const njs_profile_function_t  *f1, *f2;
+
+    f1 = *(njs_profile_function_t **) one;
+    f2 = *(njs_profile_function_t **) two;
+
+    if (f1->time != f2->time) {
+        return (f1->time < f2->time) ? 1 : -1;
+    }
+
+    if (f1->count != f2->count) {
+        return (f1->count < f2->count) ? 1 : -1;
+    }
+
+    return 0;
+}
+
+
+static njs_function_debug_t *
+njs_profile_function_debug(njs_vm_t *vm, njs_function_lambda_t *lambda)
+{
+    nxt_uint_t            n;
+    njs_function_debug_t  *debug;
+
+    if (vm->debug == NULL || lambda == NULL) {
+        return NULL;
+    }
+
+    debug = vm->debug->start;
+
+    for (n = 0; n < vm->debug->items; n++) {
+        if (debug[n].lambda == lambda) {
+            return &debug[n];
+        }
+    }
+
+    return NULL;
+}
+
+
+static void
+njs_profile_sample(njs_vm_t *vm)
+{
+    size_t               size;
+    nxt_int_t            ret;
+    nxt_uint_t           depth;
+    njs_function_t       *function;
+    njs_native_frame_t   *frame;
+    njs_profile_stack_t  *stack;
+    nxt_lvlhsh_query_t   lhq;
+    njs_profile_frame_t  frames[NJS_PROFILE_STACK_DEPTH];
+
+    if (vm->current == (u_char *) njs_continuation_nexus) {
+        /* A native function continuation. */
+        frame = vm->top_frame;
+
+    } else {
+        frame = &vm->active_frame->native;
+    }
+
+    depth = 0;
+
+    while (frame != NULL && depth < NJS_PROFILE_STACK_DEPTH) {
+        function = frame->function;
+
+        /* The padding is a part of the hash key. */
+        nxt_memzero(&frames[depth], sizeof(njs_profile_frame_t));
+
+        if (function == NULL) {
+            frames[depth].code = NULL;
+            frames[depth].native = 0;
+
+        } else if (function->native) {
+            frames[depth].code = function;
+            frames[depth].native = 1;
+
+        } else {
+            frames[depth].code = function->u.lambda;
+            frames[depth].native = 0;
+        }
+
+        depth++;
+
+        do {
+            frame = frame->previous;
+        } while (frame != NULL && frame->skip);
+    }
+
+    size = depth * sizeof(njs_profile_frame_t);
+
+    lhq.key.length = size;
+    lhq.key.start = (u_char *) frames;
+    lhq.key_hash = nxt_djb_hash(frames, size);
+    lhq.proto = &njs_profile_stack_hash_proto;
+
+    if (nxt_lvlhsh_find(&vm->profile->stacks, &lhq) == NXT_OK) {
+        stack = lhq.value;
+        stack->count++;
+        return;
+    }
+
+    stack = nxt_mp_alloc(vm->mem_pool, sizeof(njs_profile_stack_t) + size);
+    if (nxt_slow_path(stack == NULL)) {
+        return;
+    }
+
+    stack->count = 1;
+    stack->depth = depth;
+    stack->truncated = (frame != NULL);
+    memcpy(stack->frames, frames, size);
+
+    lhq.replace = 0;
+    lhq.value = stack;
+    lhq.pool = vm->mem_pool;
+
+    ret = nxt_lvlhsh_insert(&vm->profile->stacks, &lhq);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        nxt_mp_free(vm->mem_pool, stack);
+    }
+}
+
+
+static nxt_int_t
+njs_profile_stack_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    njs_profile_stack_t  *stack;
+
+    stack = data;
+
+    if (lhq->key.length == stack->depth * sizeof(njs_profile_frame_t)
+        && memcmp(lhq->key.start, stack->frames, lhq->key.length) == 0)
+    {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+nxt_int_t
+njs_vm_profile_stacks(njs_vm_t *vm, nxt_str_t *retval)
+{
+    u_char                *p, *end, *start;
+    size_t                size;
+    nxt_str_t             name;
+    nxt_uint_t            n;
+    nxt_lvlhsh_each_t     lhe;
+    njs_profile_stack_t   *stack;
+    njs_function_debug_t  *debug;
+
+    retval->length = 0;
+    retval->start = NULL;
+
+    if (vm->profile == NULL || vm->profile->interval == 0) {
+        return NXT_DECLINED;
+    }
+
+    size = 0;
+    nxt_lvlhsh_each_init(&lhe, &njs_profile_stack_hash_proto);
+
+    for ( ;; ) {
+        stack = nxt_lvlhsh_each(&vm->profile->stacks, &lhe);
+        if (stack == NULL) {
+            break;
+        }
+
+        size += NXT_INT64_T_LEN + 16;
+
+        for (n = 0; n < stack->depth; n++) {
+            njs_profile_frame_name(vm, &stack->frames[n], &name, &debug);
+
+            size += name.length + 1;
+
+            if (debug != NULL) {
+                size += debug->file.length + NXT_INT32_T_LEN + 4;
+            }
+        }
+    }
+
+    if (size == 0) {
+        return NXT_OK;
+    }
+
+    start = nxt_mp_alloc(vm->mem_pool, size);
+    if (nxt_slow_path(start == NULL)) {
+        return NXT_ERROR;
+    }
+
+    p = start;
+    end = start + size;
+
+    nxt_lvlhsh_each_init(&lhe, &njs_profile_stack_hash_proto);
+
+    for ( ;; ) {
+        stack = nxt_lvlhsh_each(&vm->profile->stacks, &lhe);
+        if (stack == NULL) {
+            break;
+        }
+
+        if (stack->truncated) {
+            p = nxt_cpymem(p, "[truncated];", nxt_length("[truncated];"));
+        }
+
+        for (n = stack->depth; n != 0; n--) {
+            njs_profile_frame_name(vm, &stack->frames[n - 1], &name, &debug);
+
+            if (debug != NULL) {
+                p = nxt_sprintf(p, end, "%V (%V:%uD)", &name, &debug->file,
+                                debug->line);
+
+            } else {
+                p = nxt_cpymem(p, name.start, name.length);
+            }
+
+            if (n != 1) {
+                *p++ = ';';
+            }
+        }
+
+        p = nxt_sprintf(p, end, " %uL\n", stack->count);
+    }
+
+    retval->start = start;
+    retval->length = p - start;
+
+    return NXT_OK;
+}
+
+
+static void
+njs_profile_frame_name(njs_vm_t *vm, njs_profile_frame_t *frame,
+    nxt_str_t *name, njs_function_debug_t **debug)
+{
+    nxt_int_t       ret;
+    njs_function_t  *function;
+
+    *debug = NULL;
+
+    if (frame->code == NULL) {
+        *name = njs_entry_main;
+        return;
+    }
+
+    if (frame->native) {
+        function = frame->code;
+
+        ret = njs_builtin_match_native_function(vm, function, name);
+        if (ret == NXT_OK) {
+            return;
+        }
+
+        ret = njs_external_match_native_function(vm, function->u.native, name);
+        if (ret != NXT_OK) {
+            *name = njs_entry_native;
+        }
+
+        return;
+    }
+
+    *debug = njs_profile_function_debug(vm, frame->code);
+
+    if (*debug == NULL) {
+        *name = njs_entry_unknown;
+        return;
+    }
+
+    *name = ((*debug)->name.length != 0) ? (*debug)->name
+                                         : njs_entry_anonymous;
+}
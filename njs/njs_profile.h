@@ -0,0 +1,96 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NJS_PROFILE_H_INCLUDED_
+#define _NJS_PROFILE_H_INCLUDED_
+
+
+/*
+ * The profiler is enabled by the "profile" VM option.  It counts executions
+ * and time of each instruction, the counters are summed up per operation
+ * and per function by njs_vm_profile_dump().  The time is measured with
+ * nxt_time() in nanoseconds, the time of an instruction lasts till the start
+ * of the next instruction, so it includes the time of native functions
+ * called by the instruction.
+ *
+ * The sampling profiler is enabled by the "sample_interval" VM option.
+ * It records the call stack every sample_interval instructions, the stacks
+ * are printed by njs_vm_profile_stacks().
+ */
+
+#define NJS_PROFILE_STACK_DEPTH     64
+
+
+typedef struct {
+    u_char                      *code;
+    njs_vmcode_operation_t      operation;
+
+    /* NULL for the global code. */
+    njs_function_lambda_t       *lambda;
+
+    uint64_t                    count;
+    uint64_t                    time;
+} njs_profile_code_t;
+
+
+typedef struct {
+    /* A lambda or a native njs_function_t, NULL for the global code. */
+    void                        *code;
+    nxt_bool_t                  native;
+} njs_profile_frame_t;
+
+
+typedef struct {
+    uint64_t                    count;
+    uint32_t                    depth;
+    nxt_bool_t                  truncated;
+
+    /* The innermost function first. */
+#if (NXT_SUNC)
+    njs_profile_frame_t         frames[1];
+#else
+    njs_profile_frame_t         frames[];
+#endif
+} njs_profile_stack_t;
+
+
+struct njs_profile_s {
+    /* A hash of njs_profile_code_t. */
+    nxt_lvlhsh_t                codes;
+
+    /* A hash of njs_profile_function_t. */
+    nxt_lvlhsh_t                functions;
+
+    /* The instruction being executed and its start time. */
+    njs_profile_code_t          *current;
+    uint64_t                    start;
+
+    /* A hash of njs_profile_stack_t. */
+    nxt_lvlhsh_t                stacks;
+
+    uint32_t                    interval;
+    uint32_t                    countdown;
+
+    uint8_t                     counters;   /* 1 bit */
+};
+
+
+nxt_int_t njs_profile_init(njs_vm_t *vm);
+void njs_profile_code(njs_vm_t *vm);
+void njs_profile_call(njs_vm_t *vm, njs_function_lambda_t *lambda);
+uint64_t njs_profile_code_count(njs_vm_t *vm, u_char *code);
+
+
+#define njs_profile_stop(vm)                                                  \
+    do {                                                                      \
+        if ((vm)->profile != NULL && (vm)->profile->current != NULL) {        \
+            (vm)->profile->current->time += nxt_time()                        \
+                                            - (vm)->profile->start;           \
+            (vm)->profile->current = NULL;                                    \
+        }                                                                     \
+    } while (0)
+
+
+#endif /* _NJS_PROFILE_H_INCLUDED_ */
@@ -349,6 +349,10 @@ njs_regexp_pattern_compile(njs_vm_t *vm, nxt_regex_t *regex, u_char *source,
     nxt_int_t            ret;
     nxt_trace_handler_t  handler;
 
+    if (nxt_slow_path(njs_regexp_context(vm) != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
     handler = vm->trace.handler;
     vm->trace.handler = njs_regexp_compile_trace_handler;
 
@@ -435,12 +439,17 @@ njs_regexp_alloc(njs_vm_t *vm, njs_regexp_pattern_t *pattern)
     if (nxt_fast_path(regexp != NULL)) {
         nxt_lvlhsh_init(&regexp->object.hash);
         nxt_lvlhsh_init(&regexp->object.shared_hash);
+        regexp->object.shape = NULL;
         regexp->object.__proto__ = &vm->prototypes[NJS_PROTOTYPE_REGEXP].object;
         regexp->object.type = NJS_REGEXP;
         regexp->object.shared = 0;
         regexp->object.extensible = 1;
         regexp->last_index = 0;
         regexp->pattern = pattern;
+        regexp->string = njs_string_empty;
+
+        njs_gc_register(vm, regexp, NJS_GC_OBJECT, sizeof(njs_regexp_t));
+
         return regexp;
     }
 
@@ -598,6 +607,10 @@ njs_regexp_prototype_test(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
     pattern = args[0].data.u.regexp->pattern;
 
     if (nxt_regex_is_valid(&pattern->regex[n])) {
+        if (nxt_slow_path(njs_regexp_context(vm) != NXT_OK)) {
+            return NXT_ERROR;
+        }
+
         ret = njs_regexp_match(vm, &pattern->regex[n], string.start,
                                string.size, vm->single_match_data);
         if (ret >= 0) {
@@ -663,6 +676,10 @@ njs_regexp_prototype_exec(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
             string.start += regexp->last_index;
             string.size -= regexp->last_index;
 
+            if (nxt_slow_path(njs_regexp_context(vm) != NXT_OK)) {
+                return NXT_ERROR;
+            }
+
             match_data = nxt_regex_match_data(&pattern->regex[type],
                                               vm->regex_context);
             if (nxt_slow_path(match_data == NULL)) {
@@ -16,6 +16,17 @@ typedef enum {
 } njs_regexp_flags_t;
 
 
+/*
+ * The regex context and the single match data are created on the first
+ * regexp use, so VMs and clones which do not use regexps do not pay for
+ * them.  njs_regexp_context() must precede any use of vm->regex_context
+ * or vm->single_match_data.
+ */
+#define njs_regexp_context(vm)                                                \
+    (nxt_fast_path((vm)->single_match_data != NULL) ? NXT_OK                  \
+                                                    : njs_regexp_init(vm))
+
+
 njs_ret_t njs_regexp_init(njs_vm_t *vm);
 njs_ret_t njs_regexp_constructor(njs_vm_t *vm, njs_value_t *args,
     nxt_uint_t nargs, njs_index_t unused);
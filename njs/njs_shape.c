@@ -0,0 +1,367 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <njs_core.h>
+#include <string.h>
+
+
+static njs_object_shape_t *njs_object_shape_transition(njs_vm_t *vm,
+    njs_object_shape_t *shape, nxt_lvlhsh_query_t *lhq,
+    const njs_value_t *name);
+static nxt_bool_t njs_object_shape_test(const njs_object_shape_t *shape,
+    const nxt_lvlhsh_query_t *lhq);
+static njs_object_shape_t *njs_object_shape_at(njs_object_shape_t *shape,
+    uint32_t index);
+static void njs_object_shape_prop(njs_object_prop_t *prop,
+    const njs_object_t *object, const njs_object_shape_t *shape);
+
+
+/*
+ * njs_object_shape_add() adds a property with default attributes
+ * to a plain object which is either empty or has a shape.
+ *   NXT_OK          the property has been added to the object slots,
+ *   NXT_DECLINED    the object is in the dictionary mode and the property
+ *                   should be added to the object hash,
+ *   NXT_ERROR       memory allocation error.
+ * The caller should ensure that the object has no such property.
+ */
+
+nxt_int_t
+njs_object_shape_add(njs_vm_t *vm, njs_object_t *object,
+    nxt_lvlhsh_query_t *lhq, const njs_value_t *name,
+    const njs_value_t *value)
+{
+    uint32_t            count, size;
+    njs_value_t         *slots;
+    njs_object_shape_t  *shape;
+
+    shape = object->shape;
+
+    if (shape == NULL) {
+        if (object->type != NJS_OBJECT
+            || object->shared
+            || !nxt_lvlhsh_is_empty(&object->hash)
+            || !nxt_lvlhsh_is_empty(&object->shared_hash))
+        {
+            return NXT_DECLINED;
+        }
+
+        shape = vm->shape_root;
+
+        if (shape == NULL) {
+            shape = nxt_mp_zalign(vm->mem_pool, sizeof(njs_value_t),
+                                  sizeof(njs_object_shape_t));
+            if (nxt_slow_path(shape == NULL)) {
+                njs_memory_error(vm);
+                return NXT_ERROR;
+            }
+
+            vm->shape_root = shape;
+        }
+    }
+
+    count = shape->count;
+
+    if (count == NJS_SHAPE_MAX_SLOTS) {
+        goto dictionary;
+    }
+
+    shape = njs_object_shape_transition(vm, shape, lhq, name);
+
+    if (nxt_slow_path(shape == NULL)) {
+        goto dictionary;
+    }
+
+    if (count == 0
+        || (count >= NJS_SHAPE_MIN_SLOTS && (count & (count - 1)) == 0))
+    {
+        size = (count == 0) ? NJS_SHAPE_MIN_SLOTS : 2 * count;
+
+        slots = nxt_mp_align(vm->mem_pool, sizeof(njs_value_t),
+                             size * sizeof(njs_value_t));
+        if (nxt_slow_path(slots == NULL)) {
+            njs_memory_error(vm);
+            return NXT_ERROR;
+        }
+
+        if (count != 0) {
+            memcpy(slots, object->slots, count * sizeof(njs_value_t));
+            nxt_mp_free(vm->mem_pool, object->slots);
+        }
+
+        object->slots = slots;
+    }
+
+    /* GC: retain. */
+    object->slots[count] = *value;
+    object->shape = shape;
+
+    return NXT_OK;
+
+dictionary:
+
+    if (object->shape != NULL) {
+        if (nxt_slow_path(njs_object_dictionary(vm, object) != NXT_OK)) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_DECLINED;
+}
+
+
+static njs_object_shape_t *
+njs_object_shape_transition(njs_vm_t *vm, njs_object_shape_t *shape,
+    nxt_lvlhsh_query_t *lhq, const njs_value_t *name)
+{
+    nxt_uint_t          n;
+    njs_object_shape_t  *child;
+
+    n = 0;
+
+    for (child = shape->child; child != NULL; child = child->next) {
+
+        if (njs_object_shape_test(child, lhq)) {
+            return child;
+        }
+
+        n++;
+    }
+
+    if (n == NJS_SHAPE_MAX_TRANSITIONS) {
+        /* Objects used as dictionaries. */
+        return NULL;
+    }
+
+    child = nxt_mp_align(vm->mem_pool, sizeof(njs_value_t),
+                         sizeof(njs_object_shape_t));
+    if (nxt_slow_path(child == NULL)) {
+        return NULL;
+    }
+
+    /* GC: retain. */
+    child->name = *name;
+
+    child->parent = shape;
+    child->child = NULL;
+    child->next = shape->child;
+    child->key_hash = lhq->key_hash;
+    child->count = shape->count + 1;
+
+    shape->child = child;
+
+    return child;
+}
+
+
+static nxt_bool_t
+njs_object_shape_test(const njs_object_shape_t *shape,
+    const nxt_lvlhsh_query_t *lhq)
+{
+    nxt_str_t  name;
+
+    if (shape->key_hash != lhq->key_hash) {
+        return 0;
+    }
+
+    njs_string_get(&shape->name, &name);
+
+    return (lhq->key.length == name.length
+            && memcmp(lhq->key.start, name.start, name.length) == 0);
+}
+
+
+/*
+ * njs_object_shape_find() returns the shape which added the property,
+ * the property slot is shape->count - 1.
+ */
+
+njs_object_shape_t *
+njs_object_shape_find(njs_object_shape_t *shape, const nxt_lvlhsh_query_t *lhq)
+{
+    while (shape->count != 0) {
+
+        if (njs_object_shape_test(shape, lhq)) {
+            return shape;
+        }
+
+        shape = shape->parent;
+    }
+
+    return NULL;
+}
+
+
+static njs_object_shape_t *
+njs_object_shape_at(njs_object_shape_t *shape, uint32_t index)
+{
+    uint32_t  n;
+
+    for (n = shape->count - 1; n != index; n--) {
+        shape = shape->parent;
+    }
+
+    return shape;
+}
+
+
+/*
+ * njs_object_dictionary() moves the slots of an object with a shape
+ * to the object hash.
+ */
+
+nxt_int_t
+njs_object_dictionary(njs_vm_t *vm, njs_object_t *object)
+{
+    nxt_int_t           ret;
+    uint32_t            n;
+    njs_value_t         *slots;
+    njs_object_prop_t   *prop;
+    njs_object_shape_t  *shape, *shapes[NJS_SHAPE_MAX_SLOTS];
+    nxt_lvlhsh_query_t  lhq;
+
+    shape = object->shape;
+
+    if (shape == NULL) {
+        return NXT_OK;
+    }
+
+    /* The properties are added in the original order. */
+
+    for (n = shape->count; n != 0; n--) {
+        shapes[n - 1] = shape;
+        shape = shape->parent;
+    }
+
+    slots = object->slots;
+
+    lhq.replace = 0;
+    lhq.proto = &njs_object_hash_proto;
+    lhq.pool = vm->mem_pool;
+
+    for (n = 0; n < object->shape->count; n++) {
+        shape = shapes[n];
+
+        prop = njs_object_prop_alloc(vm, &shape->name, &slots[n], 1);
+        if (nxt_slow_path(prop == NULL)) {
+            return NXT_ERROR;
+        }
+
+        njs_string_get(&shape->name, &lhq.key);
+        lhq.key_hash = shape->key_hash;
+        lhq.value = prop;
+
+        ret = nxt_lvlhsh_insert(&object->hash, &lhq);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            njs_internal_error(vm, "lvlhsh insert failed");
+            return NXT_ERROR;
+        }
+    }
+
+    object->shape = NULL;
+    object->slots = NULL;
+
+    nxt_mp_free(vm->mem_pool, slots);
+
+    njs_object_prop_cache_invalidate(vm, object);
+
+    return NXT_OK;
+}
+
+
+/*
+ * njs_object_hash_find() looks up an own object property either in
+ * the object slots or in the object hash like nxt_lvlhsh_find() does.
+ * A property stored in a slot is returned as a copy in the scratch.
+ */
+
+nxt_int_t
+njs_object_hash_find(const njs_object_t *object, nxt_lvlhsh_query_t *lhq,
+    njs_object_prop_t *scratch)
+{
+    njs_object_shape_t  *shape;
+
+    if (object->shape == NULL) {
+        lhq->proto = &njs_object_hash_proto;
+
+        return nxt_lvlhsh_find(&object->hash, lhq);
+    }
+
+    shape = njs_object_shape_find(object->shape, lhq);
+
+    if (shape == NULL) {
+        return NXT_DECLINED;
+    }
+
+    njs_object_shape_prop(scratch, object, shape);
+
+    lhq->value = scratch;
+
+    return NXT_OK;
+}
+
+
+/*
+ * njs_object_each() iterates over own object properties like
+ * nxt_lvlhsh_each() does.  The properties of an object with a shape
+ * are iterated in the order they were added and are returned as copies
+ * in each->scratch.  If the object is switched to the dictionary mode
+ * during iteration the remaining properties are looked up in the hash.
+ */
+
+njs_object_prop_t *
+njs_object_each(const njs_object_t *object, njs_object_each_t *each)
+{
+    nxt_int_t           ret;
+    njs_object_prop_t   *prop;
+    njs_object_shape_t  *shape;
+    nxt_lvlhsh_query_t  lhq;
+
+    if (each->index == 0 && each->shape == NULL) {
+        each->shape = object->shape;
+
+        if (each->shape == NULL) {
+            return nxt_lvlhsh_each(&object->hash, &each->lhe);
+        }
+    }
+
+    while (each->index < each->shape->count) {
+
+        shape = njs_object_shape_at(each->shape, each->index++);
+
+        if (object->shape == each->shape) {
+            njs_object_shape_prop(&each->scratch, object, shape);
+            return &each->scratch;
+        }
+
+        njs_string_get(&shape->name, &lhq.key);
+        lhq.key_hash = shape->key_hash;
+
+        ret = njs_object_hash_find(object, &lhq, &each->scratch);
+
+        if (ret == NXT_OK) {
+            prop = lhq.value;
+
+            if (prop->type != NJS_WHITEOUT) {
+                return prop;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+static void
+njs_object_shape_prop(njs_object_prop_t *prop, const njs_object_t *object,
+    const njs_object_shape_t *shape)
+{
+    prop->value = object->slots[shape->count - 1];
+    prop->name = shape->name;
+    prop->type = NJS_PROPERTY;
+    prop->enumerable = 1;
+    prop->writable = 1;
+    prop->configurable = 1;
+}
@@ -0,0 +1,77 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NJS_SHAPE_H_INCLUDED_
+#define _NJS_SHAPE_H_INCLUDED_
+
+
+/*
+ * Plain objects with a few properties having default attributes store
+ * property values in a slot array, while property names are kept in
+ * a shape shared by all objects created with the same property sequence.
+ * Shapes form a transition tree rooted at vm->shape_root, a shape stores
+ * the name of the last added property and refers to the previous shape.
+ *
+ * An object is switched to the dictionary mode, that is, its properties
+ * are moved to the object hash, if it gets too many properties, if its
+ * property is deleted or its property attributes are changed.  An object
+ * never returns from the dictionary mode.
+ */
+
+#define NJS_SHAPE_MAX_SLOTS           16
+#define NJS_SHAPE_MIN_SLOTS           4
+#define NJS_SHAPE_MAX_TRANSITIONS     64
+
+
+struct njs_object_shape_s {
+    /* Must be aligned to njs_value_t. */
+    njs_value_t                 name;
+
+    njs_object_shape_t          *parent;
+
+    /* The first transition and the next transition of the parent. */
+    njs_object_shape_t          *child;
+    njs_object_shape_t          *next;
+
+    uint32_t                    key_hash;
+
+    /* The number of properties, the property slot is count - 1. */
+    uint32_t                    count;
+};
+
+
+typedef struct {
+    nxt_lvlhsh_each_t           lhe;
+    njs_object_prop_t           scratch;
+    njs_object_shape_t          *shape;
+    uint32_t                    index;
+} njs_object_each_t;
+
+
+#define njs_object_each_init(each)                                            \
+    do {                                                                      \
+        nxt_lvlhsh_each_init(&(each)->lhe, &njs_object_hash_proto);           \
+        (each)->shape = NULL;                                                 \
+        (each)->index = 0;                                                    \
+    } while (0)
+
+
+#define njs_object_is_empty(object)                                           \
+    ((object)->shape == NULL && nxt_lvlhsh_is_empty(&(object)->hash))
+
+
+nxt_int_t njs_object_shape_add(njs_vm_t *vm, njs_object_t *object,
+    nxt_lvlhsh_query_t *lhq, const njs_value_t *name,
+    const njs_value_t *value);
+njs_object_shape_t *njs_object_shape_find(njs_object_shape_t *shape,
+    const nxt_lvlhsh_query_t *lhq);
+nxt_int_t njs_object_dictionary(njs_vm_t *vm, njs_object_t *object);
+nxt_int_t njs_object_hash_find(const njs_object_t *object,
+    nxt_lvlhsh_query_t *lhq, njs_object_prop_t *scratch);
+njs_object_prop_t *njs_object_each(const njs_object_t *object,
+    njs_object_each_t *each);
+
+
+#endif /* _NJS_SHAPE_H_INCLUDED_ */
@@ -26,12 +26,20 @@
 #endif
 
 
+#define NJS_SHELL_SAMPLE_INTERVAL  1000
+#define NJS_SHELL_GC_THRESHOLD     (1024 * 1024)
+
+
 typedef struct {
     char                    *file;
     size_t                  n_paths;
     char                    **paths;
     nxt_int_t               version;
     nxt_int_t               disassemble;
+    nxt_int_t               profile;
+    nxt_int_t               memory;
+    char                    *stacks;
+    char                    *image;
     nxt_int_t               interactive;
     nxt_int_t               sandbox;
     nxt_int_t               quiet;
@@ -80,6 +88,10 @@ static njs_vm_t *njs_create_vm(njs_opts_t *opts, njs_vm_opt_t *vm_options);
 static nxt_int_t njs_process_file(njs_opts_t *opts, njs_vm_opt_t *vm_options);
 static nxt_int_t njs_process_script(njs_console_t *console, njs_opts_t *opts,
     const nxt_str_t *script);
+static void njs_profile_output(njs_vm_t *vm);
+static void njs_memory_output(njs_vm_t *vm);
+static void njs_profile_stacks_output(njs_vm_t *vm, const char *file);
+static nxt_int_t njs_image_output(njs_vm_t *vm, const char *file);
 static nxt_int_t njs_editline_init(void);
 static char **njs_completion_handler(const char *text, int start, int end);
 static char *njs_completion_generator(const char *text, int state);
@@ -225,6 +237,12 @@ main(int argc, char **argv)
         goto done;
     }
 
+    if (opts.image != NULL && opts.interactive) {
+        nxt_error("option \"-c\" requires script file\n");
+        ret = NXT_ERROR;
+        goto done;
+    }
+
     nxt_memzero(&vm_options, sizeof(njs_vm_opt_t));
 
     if (!opts.quiet) {
@@ -248,6 +266,15 @@ main(int argc, char **argv)
     vm_options.accumulative = opts.interactive;
     vm_options.backtrace = 1;
     vm_options.sandbox = opts.sandbox;
+    vm_options.profile = opts.profile;
+
+    /* The scripts with timers may run for a long time. */
+    vm_options.gc_threshold = NJS_SHELL_GC_THRESHOLD;
+
+    if (opts.stacks != NULL) {
+        vm_options.sample_interval = NJS_SHELL_SAMPLE_INTERVAL;
+    }
+
     vm_options.ops = &njs_console_ops;
     vm_options.external = &njs_console;
 
@@ -278,12 +305,20 @@ njs_get_options(njs_opts_t *opts, int argc, char** argv)
         "Interactive njs shell.\n"
         "\n"
         "Options:\n"
+        "  -c <file>       compile the script to the image file\n"
+        "                  without running it.\n"
         "  -d              print disassembled code.\n"
+        "  -F <file>       write sampled call stacks in the folded\n"
+        "                  format to the file on exit.\n"
+        "  -m              print the peak memory usage on exit.\n"
+        "  -P              print profile and code annotated with\n"
+        "                  execution counts on exit.\n"
         "  -q              disable interactive introduction prompt.\n"
         "  -s              sandbox mode.\n"
         "  -p              set path prefix for modules.\n"
         "  -v              print njs version and exit.\n"
-        "  <filename> | -  run code from a file or stdin.\n";
+        "  <filename> | -  run code or a compiled image from a file\n"
+        "                  or stdin.\n";
 
     ret = NXT_DONE;
 
@@ -305,10 +340,36 @@ njs_get_options(njs_opts_t *opts, int argc, char** argv)
             (void) write(STDIN_FILENO, help, nxt_length(help));
             return ret;
 
+        case 'c':
+            if (argv[++i] != NULL) {
+                opts->image = argv[i];
+                break;
+            }
+
+            nxt_error("option \"-c\" requires file name\n");
+            return NXT_ERROR;
+
         case 'd':
             opts->disassemble = 1;
             break;
 
+        case 'F':
+            if (argv[++i] != NULL) {
+                opts->stacks = argv[i];
+                break;
+            }
+
+            nxt_error("option \"-F\" requires file name\n");
+            return NXT_ERROR;
+
+        case 'm':
+            opts->memory = 1;
+            break;
+
+        case 'P':
+            opts->profile = 1;
+            break;
+
         case 'q':
             opts->quiet = 1;
             break;
@@ -549,6 +610,19 @@ njs_process_file(njs_opts_t *opts, njs_vm_opt_t *vm_options)
     }
 
     ret = njs_process_script(vm_options->external, opts, &script);
+
+    if (opts->profile) {
+        njs_profile_output(vm);
+    }
+
+    if (opts->stacks != NULL) {
+        njs_profile_stacks_output(vm, opts->stacks);
+    }
+
+    if (opts->memory) {
+        njs_memory_output(vm);
+    }
+
     if (ret != NXT_OK) {
         ret = NXT_ERROR;
         goto done;
@@ -650,6 +724,110 @@ njs_output(njs_vm_t *vm, njs_opts_t *opts, njs_ret_t ret)
 }
 
 
+static void
+njs_profile_output(njs_vm_t *vm)
+{
+    nxt_str_t  out;
+
+    if (njs_vm_profile_dump(vm, &out) != NXT_OK) {
+        nxt_error("failed to get profile from VM\n");
+        return;
+    }
+
+    nxt_printf("\n%V\n", &out);
+
+    njs_disassembler(vm);
+}
+
+
+static void
+njs_memory_output(njs_vm_t *vm)
+{
+    nxt_uint_t     i;
+    nxt_mp_stat_t  stat;
+
+    njs_vm_memory_stats(vm, &stat);
+
+    nxt_printf("\nmemory peak: %uz, size: %uz, used: %uz bytes\n"
+               "clusters: %uz, pages: %uz, free pages: %uz\n"
+               "large: %uz, %uz bytes\n",
+               stat.peak, stat.size, stat.used, stat.clusters, stat.pages,
+               stat.free_pages, stat.large, stat.large_size);
+
+    for (i = 0; i < NXT_MP_CHUNK_SIZES && stat.chunk_size[i] != 0; i++) {
+        nxt_printf("chunks %uD: %uz\n", stat.chunk_size[i], stat.chunks[i]);
+    }
+}
+
+
+static void
+njs_profile_stacks_output(njs_vm_t *vm, const char *file)
+{
+    int        fd;
+    ssize_t    n;
+    nxt_str_t  out;
+
+    if (njs_vm_profile_stacks(vm, &out) != NXT_OK) {
+        nxt_error("failed to get sampled stacks from VM\n");
+        return;
+    }
+
+    fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        nxt_error("failed to open file: '%s' (%s)\n", file, strerror(errno));
+        return;
+    }
+
+    n = write(fd, out.start, out.length);
+    if (n != (ssize_t) out.length) {
+        nxt_error("failed to write file: '%s' (%s)\n", file, strerror(errno));
+    }
+
+    close(fd);
+}
+
+
+static nxt_int_t
+njs_image_output(njs_vm_t *vm, const char *file)
+{
+    int        fd;
+    ssize_t    n;
+    nxt_int_t  ret;
+    nxt_str_t  out;
+
+    ret = njs_vm_image(vm, &out);
+
+    if (ret != NXT_OK) {
+        if (ret == NXT_DECLINED) {
+            nxt_error("the script cannot be compiled to image\n");
+
+        } else {
+            nxt_error("failed to get image from VM\n");
+        }
+
+        return NXT_ERROR;
+    }
+
+    fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        nxt_error("failed to open file: '%s' (%s)\n", file, strerror(errno));
+        return NXT_ERROR;
+    }
+
+    ret = NXT_OK;
+
+    n = write(fd, out.start, out.length);
+    if (n != (ssize_t) out.length) {
+        nxt_error("failed to write file: '%s' (%s)\n", file, strerror(errno));
+        ret = NXT_ERROR;
+    }
+
+    close(fd);
+
+    return ret;
+}
+
+
 static nxt_int_t
 njs_process_events(njs_console_t *console, njs_opts_t *opts)
 {
@@ -683,14 +861,20 @@ static nxt_int_t
 njs_process_script(njs_console_t *console, njs_opts_t *opts,
     const nxt_str_t *script)
 {
-    u_char     *start;
+    u_char     *start, *end;
     njs_vm_t   *vm;
     nxt_int_t  ret;
 
     vm = console->vm;
     start = script->start;
+    end = start + script->length;
+
+    if (!opts->interactive && njs_vm_is_image(start, end)) {
+        ret = njs_vm_compile_from_image(vm, start, end);
 
-    ret = njs_vm_compile(vm, &start, start + script->length);
+    } else {
+        ret = njs_vm_compile(vm, &start, end);
+    }
 
     if (ret == NXT_OK) {
         if (opts->disassemble) {
@@ -698,6 +882,10 @@ njs_process_script(njs_console_t *console, njs_opts_t *opts,
             nxt_printf("\n");
         }
 
+        if (opts->image != NULL) {
+            return njs_image_output(vm, opts->image);
+        }
+
         ret = njs_vm_start(vm);
     }
 
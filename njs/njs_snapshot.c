@@ -0,0 +1,639 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <njs_core.h>
+#include <njs_regexp.h>
+#include <string.h>
+
+
+typedef struct njs_snapshot_ref_s  njs_snapshot_ref_t;
+
+/* A parent object or closure and its copy in the clone. */
+
+struct njs_snapshot_ref_s {
+    void                           *pointer;
+    void                           *copy;
+
+    /* The next copy which references should be copied. */
+    njs_snapshot_ref_t             *next;
+
+    uint8_t                        closure;   /* 1 bit */
+};
+
+
+typedef struct {
+    njs_vm_t                       *vm;
+    njs_vm_t                       *parent;
+    nxt_mp_t                       *pool;
+    nxt_lvlhsh_t                   refs;
+
+    njs_snapshot_ref_t             *first;
+    njs_snapshot_ref_t             **last;
+} njs_snapshot_t;
+
+
+static nxt_int_t njs_snapshot_value(njs_snapshot_t *snap, njs_value_t *value);
+static njs_object_t *njs_snapshot_object(njs_snapshot_t *snap,
+    njs_object_t *object);
+static njs_closure_t *njs_snapshot_closure(njs_snapshot_t *snap,
+    njs_closure_t *closure);
+static njs_snapshot_ref_t *njs_snapshot_ref_add(njs_snapshot_t *snap,
+    void *pointer, void *copy);
+static void *njs_snapshot_ref_find(njs_snapshot_t *snap, void *pointer);
+static nxt_int_t njs_snapshot_ref_test(nxt_lvlhsh_query_t *lhq, void *data);
+static nxt_int_t njs_snapshot_copy(njs_snapshot_t *snap,
+    njs_snapshot_ref_t *ref);
+static nxt_int_t njs_snapshot_props(njs_snapshot_t *snap,
+    njs_object_t *object, njs_object_t *copy);
+
+
+static const nxt_lvlhsh_proto_t  njs_snapshot_ref_hash_proto
+    nxt_aligned(64) =
+{
+    NXT_LVLHSH_DEFAULT,
+    0,
+    njs_snapshot_ref_test,
+    njs_lvlhsh_alloc,
+    njs_lvlhsh_free,
+};
+
+
+/* The references are keyed by pointers. */
+
+#define njs_snapshot_query_init(lhq, pointer)                                 \
+    do {                                                                      \
+        (lhq)->key.length = sizeof(void *);                                   \
+        (lhq)->key.start = (u_char *) &(pointer);                             \
+        (lhq)->key_hash = nxt_djb_hash(&(pointer), sizeof(void *));           \
+    } while (0)
+
+
+/*
+ * The parent built-in prototypes and constructors are stored together
+ * in njs_vm_t, so a pointer to them is mapped to the clone by the offset.
+ */
+
+#define njs_snapshot_builtin(parent, p)                                       \
+    ((u_char *) (p) >= (u_char *) (parent)->prototypes                        \
+     && (u_char *) (p)                                                        \
+        < (u_char *) &(parent)->constructors[NJS_CONSTRUCTOR_MAX])
+
+
+nxt_int_t
+njs_snapshot_restore(njs_vm_t *vm, njs_vm_t *parent)
+{
+    nxt_int_t           ret;
+    nxt_uint_t          i;
+    njs_value_t         *values, *parent_values, *value;
+    njs_variable_t      *var;
+    njs_snapshot_t      snap;
+    nxt_lvlhsh_each_t   lhe;
+    njs_snapshot_ref_t  *ref;
+
+    snap.pool = nxt_mp_create(&njs_vm_mp_proto, NULL, NULL, nxt_pagesize(),
+                              128, 512, 16);
+    if (nxt_slow_path(snap.pool == NULL)) {
+        return NXT_ERROR;
+    }
+
+    snap.vm = vm;
+    snap.parent = parent;
+    nxt_lvlhsh_init(&snap.refs);
+
+    snap.first = NULL;
+    snap.last = &snap.first;
+
+    ret = NXT_ERROR;
+
+    /*
+     * The global scope starts with the built-in constructors followed by
+     * the global retval and the global variables.  The global retval and
+     * the temporary values are not copied, they are not used after the
+     * global code run and may contain the for-in iterators which are not
+     * JavaScript values.
+     */
+
+    values = vm->scopes[NJS_SCOPE_GLOBAL];
+    parent_values = parent->scopes[NJS_SCOPE_GLOBAL];
+
+    for (i = 0; i < NJS_CONSTRUCTOR_MAX; i++) {
+        values[i] = parent_values[i];
+
+        if (nxt_slow_path(njs_snapshot_value(&snap, &values[i]) != NXT_OK)) {
+            goto done;
+        }
+    }
+
+    nxt_lvlhsh_each_init(&lhe, &njs_variables_hash_proto);
+
+    for ( ;; ) {
+        var = nxt_lvlhsh_each(&vm->variables_hash, &lhe);
+
+        if (var == NULL) {
+            break;
+        }
+
+        if (var->index == NJS_INDEX_NONE
+            || njs_scope_type(var->index) != NJS_SCOPE_GLOBAL)
+        {
+            continue;
+        }
+
+        value = njs_vmcode_operand(vm, var->index);
+        *value = *njs_vmcode_operand(parent, var->index);
+
+        if (nxt_slow_path(njs_snapshot_value(&snap, value) != NXT_OK)) {
+            goto done;
+        }
+    }
+
+    vm->retval = parent->retval;
+
+    if (nxt_slow_path(njs_snapshot_value(&snap, &vm->retval) != NXT_OK)) {
+        goto done;
+    }
+
+    /* The properties added to the built-in objects. */
+
+    for (i = 0; i < NJS_PROTOTYPE_MAX; i++) {
+        vm->prototypes[i].object.extensible =
+                                 parent->prototypes[i].object.extensible;
+
+        if (njs_snapshot_props(&snap, &parent->prototypes[i].object,
+                               &vm->prototypes[i].object)
+            != NXT_OK)
+        {
+            goto done;
+        }
+    }
+
+    for (i = 0; i < NJS_CONSTRUCTOR_MAX; i++) {
+        vm->constructors[i].object.extensible =
+                                 parent->constructors[i].object.extensible;
+
+        if (njs_snapshot_props(&snap, &parent->constructors[i].object,
+                               &vm->constructors[i].object)
+            != NXT_OK)
+        {
+            goto done;
+        }
+    }
+
+    /* The references of the copies are copied without recursion. */
+
+    while (snap.first != NULL) {
+        ref = snap.first;
+
+        snap.first = ref->next;
+
+        if (snap.first == NULL) {
+            snap.last = &snap.first;
+        }
+
+        if (nxt_slow_path(njs_snapshot_copy(&snap, ref) != NXT_OK)) {
+            goto done;
+        }
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_mp_destroy(snap.pool);
+
+    return ret;
+}
+
+
+static nxt_int_t
+njs_snapshot_value(njs_snapshot_t *snap, njs_value_t *value)
+{
+    njs_object_t  *object;
+
+    if (!njs_is_object(value)) {
+        /* Primitive values, strings, externals and data are shared. */
+        return NXT_OK;
+    }
+
+    object = njs_snapshot_object(snap, value->data.u.object);
+    if (nxt_slow_path(object == NULL)) {
+        return NXT_ERROR;
+    }
+
+    value->data.u.object = object;
+
+    return NXT_OK;
+}
+
+
+static njs_object_t *
+njs_snapshot_object(njs_snapshot_t *snap, njs_object_t *object)
+{
+    size_t              size;
+    nxt_uint_t          nesting;
+    njs_vm_t            *parent;
+    njs_object_t        *copy;
+    njs_function_t      *function;
+    njs_snapshot_ref_t  *ref;
+
+    if (object == NULL || object->shared) {
+        return object;
+    }
+
+    parent = snap->parent;
+
+    if (njs_snapshot_builtin(parent, object)) {
+        return (njs_object_t *) ((u_char *) snap->vm->prototypes
+                                 + ((u_char *) object
+                                    - (u_char *) parent->prototypes));
+    }
+
+    if (object == &parent->memory_error_object) {
+        return &snap->vm->memory_error_object;
+    }
+
+    copy = njs_snapshot_ref_find(snap, object);
+    if (copy != NULL) {
+        return copy;
+    }
+
+    switch (object->type) {
+
+    case NJS_ARRAY:
+        size = sizeof(njs_array_t);
+        break;
+
+    case NJS_OBJECT_BOOLEAN:
+    case NJS_OBJECT_NUMBER:
+    case NJS_OBJECT_STRING:
+    case NJS_OBJECT_VALUE:
+        size = sizeof(njs_object_value_t);
+        break;
+
+    case NJS_FUNCTION:
+        function = (njs_function_t *) object;
+        nesting = (function->native) ? 0 : function->u.lambda->nesting;
+        size = sizeof(njs_function_t) + nesting * sizeof(njs_closure_t *);
+        break;
+
+    case NJS_REGEXP:
+        size = sizeof(njs_regexp_t);
+        break;
+
+    case NJS_DATE:
+        size = sizeof(njs_date_t);
+        break;
+
+    default:
+        /* Plain objects and error objects. */
+        size = sizeof(njs_object_t);
+        break;
+    }
+
+    copy = nxt_mp_align(snap->vm->mem_pool, sizeof(njs_value_t), size);
+    if (nxt_slow_path(copy == NULL)) {
+        return NULL;
+    }
+
+    memcpy(copy, object, size);
+
+    nxt_lvlhsh_init(&copy->hash);
+    copy->shape = NULL;
+    copy->slots = NULL;
+    copy->watched = 0;
+
+    ref = njs_snapshot_ref_add(snap, object, copy);
+    if (nxt_slow_path(ref == NULL)) {
+        return NULL;
+    }
+
+    return copy;
+}
+
+
+static njs_closure_t *
+njs_snapshot_closure(njs_snapshot_t *snap, njs_closure_t *closure)
+{
+    njs_closure_t       *copy;
+    njs_snapshot_ref_t  *ref;
+
+    if (closure == NULL) {
+        return NULL;
+    }
+
+    copy = njs_snapshot_ref_find(snap, closure);
+    if (copy != NULL) {
+        return copy;
+    }
+
+    copy = nxt_mp_align(snap->vm->mem_pool, sizeof(njs_value_t),
+                        closure->u.size);
+    if (nxt_slow_path(copy == NULL)) {
+        return NULL;
+    }
+
+    memcpy(copy, closure, closure->u.size);
+
+    ref = njs_snapshot_ref_add(snap, closure, copy);
+    if (nxt_slow_path(ref == NULL)) {
+        return NULL;
+    }
+
+    ref->closure = 1;
+
+    return copy;
+}
+
+
+static njs_snapshot_ref_t *
+njs_snapshot_ref_add(njs_snapshot_t *snap, void *pointer, void *copy)
+{
+    nxt_int_t           ret;
+    njs_snapshot_ref_t  *ref;
+    nxt_lvlhsh_query_t  lhq;
+
+    ref = nxt_mp_zalloc(snap->pool, sizeof(njs_snapshot_ref_t));
+    if (nxt_slow_path(ref == NULL)) {
+        return NULL;
+    }
+
+    ref->pointer = pointer;
+    ref->copy = copy;
+
+    njs_snapshot_query_init(&lhq, pointer);
+    lhq.proto = &njs_snapshot_ref_hash_proto;
+    lhq.replace = 0;
+    lhq.value = ref;
+    lhq.pool = snap->pool;
+
+    ret = nxt_lvlhsh_insert(&snap->refs, &lhq);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NULL;
+    }
+
+    *snap->last = ref;
+    snap->last = &ref->next;
+
+    return ref;
+}
+
+
+static void *
+njs_snapshot_ref_find(njs_snapshot_t *snap, void *pointer)
+{
+    njs_snapshot_ref_t  *ref;
+    nxt_lvlhsh_query_t  lhq;
+
+    njs_snapshot_query_init(&lhq, pointer);
+    lhq.proto = &njs_snapshot_ref_hash_proto;
+
+    if (nxt_lvlhsh_find(&snap->refs, &lhq) == NXT_OK) {
+        ref = lhq.value;
+        return ref->copy;
+    }
+
+    return NULL;
+}
+
+
+static nxt_int_t
+njs_snapshot_ref_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    njs_snapshot_ref_t  *ref;
+
+    ref = data;
+
+    if (*(void **) lhq->key.start == ref->pointer) {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+static nxt_int_t
+njs_snapshot_copy(njs_snapshot_t *snap, njs_snapshot_ref_t *ref)
+{
+    size_t          size;
+    uint32_t        n;
+    nxt_uint_t      i, nesting;
+    njs_value_t     *values;
+    njs_array_t     *array;
+    njs_object_t    *object, *copy;
+    njs_closure_t   *closure;
+    njs_function_t  *function;
+
+    if (ref->closure) {
+        closure = ref->copy;
+        n = closure->u.size / sizeof(njs_value_t) - 1;
+
+        for (i = 0; i < n; i++) {
+            if (njs_snapshot_value(snap, &closure->values[i]) != NXT_OK) {
+                return NXT_ERROR;
+            }
+        }
+
+        return NXT_OK;
+    }
+
+    object = ref->pointer;
+    copy = ref->copy;
+
+    copy->__proto__ = njs_snapshot_object(snap, object->__proto__);
+
+    if (nxt_slow_path(object->__proto__ != NULL && copy->__proto__ == NULL)) {
+        return NXT_ERROR;
+    }
+
+    if (njs_snapshot_props(snap, object, copy) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    switch (copy->type) {
+
+    case NJS_ARRAY:
+        array = (njs_array_t *) copy;
+
+        size = array->size * sizeof(njs_value_t);
+
+        values = nxt_mp_align(snap->vm->mem_pool, sizeof(njs_value_t),
+                              nxt_max(size, sizeof(njs_value_t)));
+        if (nxt_slow_path(values == NULL)) {
+            return NXT_ERROR;
+        }
+
+        memcpy(values, array->start, array->length * sizeof(njs_value_t));
+
+        array->data = values;
+        array->start = values;
+
+        for (n = 0; n < array->length; n++) {
+            if (njs_snapshot_value(snap, &values[n]) != NXT_OK) {
+                return NXT_ERROR;
+            }
+        }
+
+        break;
+
+    case NJS_FUNCTION:
+        function = (njs_function_t *) copy;
+
+        if (function->bound != NULL) {
+            size = function->args_offset * sizeof(njs_value_t);
+
+            values = nxt_mp_align(snap->vm->mem_pool, sizeof(njs_value_t),
+                                  nxt_max(size, sizeof(njs_value_t)));
+            if (nxt_slow_path(values == NULL)) {
+                return NXT_ERROR;
+            }
+
+            memcpy(values, function->bound, size);
+
+            function->bound = values;
+
+            for (i = 0; i < function->args_offset; i++) {
+                if (njs_snapshot_value(snap, &values[i]) != NXT_OK) {
+                    return NXT_ERROR;
+                }
+            }
+        }
+
+        if (function->closure) {
+            nesting = function->u.lambda->nesting;
+
+            for (i = 0; i < nesting; i++) {
+                closure = function->closures[i];
+
+                function->closures[i] = njs_snapshot_closure(snap, closure);
+
+                if (nxt_slow_path(closure != NULL
+                                  && function->closures[i] == NULL))
+                {
+                    return NXT_ERROR;
+                }
+            }
+        }
+
+        break;
+
+    default:
+        /*
+         * The regexp patterns and the object values, that are primitive
+         * values or external data, are shared.
+         */
+        break;
+    }
+
+    return NXT_OK;
+}
+
+
+/*
+ * The object properties are added to the copy in the original order,
+ * so a plain object in the slot mode gets the same shape in the clone.
+ */
+
+static nxt_int_t
+njs_snapshot_props(njs_snapshot_t *snap, njs_object_t *object,
+    njs_object_t *copy)
+{
+    uint32_t            n, count;
+    nxt_int_t           ret;
+    njs_vm_t            *vm;
+    njs_value_t         value;
+    njs_object_prop_t   *prop, *prop_copy;
+    njs_object_shape_t  *shape, *shapes[NJS_SHAPE_MAX_SLOTS];
+    nxt_lvlhsh_each_t   lhe;
+    nxt_lvlhsh_query_t  lhq;
+
+    vm = snap->vm;
+
+    lhq.replace = 0;
+    lhq.proto = &njs_object_hash_proto;
+    lhq.pool = vm->mem_pool;
+
+    shape = object->shape;
+
+    if (shape != NULL) {
+        count = shape->count;
+
+        for (n = count; n != 0; n--) {
+            shapes[n - 1] = shape;
+            shape = shape->parent;
+        }
+
+        for (n = 0; n < count; n++) {
+            shape = shapes[n];
+
+            value = object->slots[n];
+
+            if (njs_snapshot_value(snap, &value) != NXT_OK) {
+                return NXT_ERROR;
+            }
+
+            njs_string_get(&shape->name, &lhq.key);
+            lhq.key_hash = shape->key_hash;
+
+            ret = njs_object_shape_add(vm, copy, &lhq, &shape->name, &value);
+
+            if (ret == NXT_OK) {
+                continue;
+            }
+
+            if (nxt_slow_path(ret != NXT_DECLINED)) {
+                return NXT_ERROR;
+            }
+
+            prop = njs_object_prop_alloc(vm, &shape->name, &value, 1);
+            if (nxt_slow_path(prop == NULL)) {
+                return NXT_ERROR;
+            }
+
+            lhq.value = prop;
+
+            ret = nxt_lvlhsh_insert(&copy->hash, &lhq);
+            if (nxt_slow_path(ret != NXT_OK)) {
+                return NXT_ERROR;
+            }
+        }
+
+        return NXT_OK;
+    }
+
+    nxt_lvlhsh_each_init(&lhe, &njs_object_hash_proto);
+
+    for ( ;; ) {
+        prop = nxt_lvlhsh_each(&object->hash, &lhe);
+
+        if (prop == NULL) {
+            break;
+        }
+
+        prop_copy = nxt_mp_align(vm->mem_pool, sizeof(njs_value_t),
+                                 sizeof(njs_object_prop_t));
+        if (nxt_slow_path(prop_copy == NULL)) {
+            return NXT_ERROR;
+        }
+
+        *prop_copy = *prop;
+
+        if (prop->type == NJS_PROPERTY || prop->type == NJS_METHOD) {
+            if (njs_snapshot_value(snap, &prop_copy->value) != NXT_OK) {
+                return NXT_ERROR;
+            }
+        }
+
+        njs_string_get(&prop->name, &lhq.key);
+        lhq.key_hash = nxt_djb_hash(lhq.key.start, lhq.key.length);
+        lhq.value = prop_copy;
+
+        ret = nxt_lvlhsh_insert(&copy->hash, &lhq);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
@@ -0,0 +1,28 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NJS_SNAPSHOT_H_INCLUDED_
+#define _NJS_SNAPSHOT_H_INCLUDED_
+
+
+/*
+ * A snapshot is the state of a VM after the global code has been run
+ * by njs_vm_snapshot().  njs_vm_clone() restores the state in a clone
+ * instead of running the global code again.
+ *
+ * The clone gets private copies of the objects, arrays, functions and
+ * closures reachable from the global scope, the global retval and the
+ * properties added to the built-in prototypes and constructors, so
+ * the clone modifications are not visible to the parent and to other
+ * clones.  The immutable data are not copied but are shared with
+ * the parent: strings, function lambdas, regexp patterns and the shared
+ * objects.  So the parent VM must not be destroyed while its clones are
+ * alive, in the same way as for the ordinary clones.
+ */
+
+nxt_int_t njs_snapshot_restore(njs_vm_t *vm, njs_vm_t *parent);
+
+
+#endif /* _NJS_SNAPSHOT_H_INCLUDED_ */
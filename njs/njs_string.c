@@ -157,6 +157,8 @@ njs_string_set(njs_vm_t *vm, njs_value_t *value, const u_char *start,
         string->start = (u_char *) start;
         string->length = 0;
         string->retain = 1;
+
+        njs_gc_register(vm, string, NJS_GC_STRING, sizeof(njs_string_t));
     }
 
     return NXT_OK;
@@ -229,6 +231,9 @@ njs_string_alloc(njs_vm_t *vm, njs_value_t *value, uint32_t size,
             map[0] = 0;
         }
 
+        njs_gc_register(vm, string, NJS_GC_STRING,
+                        sizeof(njs_string_t) + total);
+
         return string->start;
     }
 
@@ -238,6 +243,93 @@ njs_string_alloc(njs_vm_t *vm, njs_value_t *value, uint32_t size,
 }
 
 
+/*
+ * njs_string_buffer_concat() concatenates two ASCII strings into a string
+ * buffer.  The first string is extended in place if it is the last string
+ * of its buffer and the buffer has enough space, otherwise a new buffer
+ * twice as large as the result is allocated.  NXT_DECLINED is returned
+ * if the new buffer cannot be allocated, so the caller can allocate
+ * the string of the exact size.
+ */
+
+njs_ret_t
+njs_string_buffer_concat(njs_vm_t *vm, njs_value_t *value,
+    const njs_value_t *val1, const njs_string_prop_t *string1,
+    const njs_string_prop_t *string2)
+{
+    u_char               *start;
+    size_t               size, capacity;
+    njs_string_t         *string;
+    njs_string_buffer_t  *buffer;
+
+    size = string1->size + string2->size;
+
+    buffer = NULL;
+
+    if (val1->short_string.size == NJS_STRING_LONG
+        && val1->long_string.external == NJS_STRING_BUFFER)
+    {
+        buffer = njs_string_buffer(val1->long_string.data);
+
+        if (buffer->mem_pool != vm->mem_pool
+            || buffer->size != string1->size
+            || buffer->capacity < size)
+        {
+            buffer = NULL;
+        }
+    }
+
+    if (buffer == NULL) {
+        capacity = nxt_min(2 * size, UINT32_MAX);
+
+        buffer = nxt_mp_alloc(vm->mem_pool,
+                              sizeof(njs_string_buffer_t) + capacity);
+        if (nxt_slow_path(buffer == NULL)) {
+            return NXT_DECLINED;
+        }
+
+        buffer->mem_pool = vm->mem_pool;
+        buffer->size = 0;
+        buffer->capacity = capacity;
+
+        njs_gc_register(vm, buffer, NJS_GC_STRING,
+                        sizeof(njs_string_buffer_t) + capacity);
+    }
+
+    string = nxt_mp_alloc(vm->mem_pool, sizeof(njs_string_t));
+    if (nxt_slow_path(string == NULL)) {
+        njs_memory_error(vm);
+        return NXT_ERROR;
+    }
+
+    njs_gc_register(vm, string, NJS_GC_STRING, sizeof(njs_string_t));
+
+    start = (u_char *) buffer + sizeof(njs_string_buffer_t);
+
+    if (buffer->size == 0) {
+        memcpy(start, string1->start, string1->size);
+    }
+
+    memcpy(start + string1->size, string2->start, string2->size);
+
+    buffer->size = size;
+
+    string->start = start;
+    string->length = size;
+    string->retain = 1;
+
+    value->type = NJS_STRING;
+    njs_string_truth(value, size);
+    value->short_string.size = NJS_STRING_LONG;
+    value->short_string.length = 0;
+    value->long_string.external = NJS_STRING_BUFFER;
+    value->long_string.size = size;
+    value->long_string.data = string;
+
+    return NXT_OK;
+}
+
+
 void
 njs_string_truncate(njs_value_t *value, uint32_t size)
 {
@@ -2129,38 +2221,55 @@ static njs_ret_t
 njs_string_prototype_to_lower_case(njs_vm_t *vm, njs_value_t *args,
     nxt_uint_t nargs, njs_index_t unused)
 {
-    size_t             size;
-    u_char             *p, *start;
+    size_t             size, length;
+    u_char             *p;
+    uint32_t           u;
     const u_char       *s, *end;
     njs_string_prop_t  string;
 
     (void) njs_string_prop(&string, &args[0]);
 
-    start = njs_string_alloc(vm, &vm->retval, string.size, string.length);
-    if (nxt_slow_path(start == NULL)) {
-        return NXT_ERROR;
-    }
-
-    p = start;
     s = string.start;
     size = string.size;
 
     if (string.length == 0 || string.length == size) {
         /* Byte or ASCII string. */
 
+        p = njs_string_alloc(vm, &vm->retval, size, string.length);
+        if (nxt_slow_path(p == NULL)) {
+            return NXT_ERROR;
+        }
+
         while (size != 0) {
             *p++ = nxt_lower_case(*s++);
             size--;
         }
 
-    } else {
-        /* UTF-8 string. */
-        end = s + size;
+        return NXT_OK;
+    }
 
-        while (size != 0) {
-            p = nxt_utf8_encode(p, nxt_utf8_lower_case(&s, end));
-            size--;
-        }
+    /*
+     * UTF-8 string.  A converted character may have a different
+     * UTF-8 size, so the result size is calculated beforehand.
+     */
+
+    end = s + size;
+    size = 0;
+
+    for (length = string.length; length != 0; length--) {
+        u = nxt_utf8_lower_case(&s, end);
+        size += nxt_utf8_size(u);
+    }
+
+    p = njs_string_alloc(vm, &vm->retval, size, string.length);
+    if (nxt_slow_path(p == NULL)) {
+        return NXT_ERROR;
+    }
+
+    s = string.start;
+
+    for (length = string.length; length != 0; length--) {
+        p = nxt_utf8_encode(p, nxt_utf8_lower_case(&s, end));
     }
 
     return NXT_OK;
@@ -2177,38 +2286,55 @@ static njs_ret_t
 njs_string_prototype_to_upper_case(njs_vm_t *vm, njs_value_t *args,
     nxt_uint_t nargs, njs_index_t unused)
 {
-    size_t             size;
-    u_char             *p, *start;
+    size_t             size, length;
+    u_char             *p;
+    uint32_t           u;
     const u_char       *s, *end;
     njs_string_prop_t  string;
 
     (void) njs_string_prop(&string, &args[0]);
 
-    start = njs_string_alloc(vm, &vm->retval, string.size, string.length);
-    if (nxt_slow_path(start == NULL)) {
-        return NXT_ERROR;
-    }
-
-    p = start;
     s = string.start;
     size = string.size;
 
     if (string.length == 0 || string.length == size) {
         /* Byte or ASCII string. */
 
+        p = njs_string_alloc(vm, &vm->retval, size, string.length);
+        if (nxt_slow_path(p == NULL)) {
+            return NXT_ERROR;
+        }
+
         while (size != 0) {
             *p++ = nxt_upper_case(*s++);
             size--;
         }
 
-    } else {
-        /* UTF-8 string. */
-        end = s + size;
+        return NXT_OK;
+    }
 
-        while (size != 0) {
-            p = nxt_utf8_encode(p, nxt_utf8_upper_case(&s, end));
-            size--;
-        }
+    /*
+     * UTF-8 string.  A converted character may have a different
+     * UTF-8 size, so the result size is calculated beforehand.
+     */
+
+    end = s + size;
+    size = 0;
+
+    for (length = string.length; length != 0; length--) {
+        u = nxt_utf8_upper_case(&s, end);
+        size += nxt_utf8_size(u);
+    }
+
+    p = njs_string_alloc(vm, &vm->retval, size, string.length);
+    if (nxt_slow_path(p == NULL)) {
+        return NXT_ERROR;
+    }
+
+    s = string.start;
+
+    for (length = string.length; length != 0; length--) {
+        p = nxt_utf8_encode(p, nxt_utf8_upper_case(&s, end));
     }
 
     return NXT_OK;
@@ -2552,6 +2678,10 @@ njs_string_prototype_search(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
         n = (string.length != 0);
 
         if (nxt_regex_is_valid(&pattern->regex[n])) {
+            if (nxt_slow_path(njs_regexp_context(vm) != NXT_OK)) {
+                return NXT_ERROR;
+            }
+
             ret = njs_regexp_match(vm, &pattern->regex[n], string.start,
                                    string.size, vm->single_match_data);
             if (ret >= 0) {
@@ -2658,6 +2788,10 @@ njs_string_match_multiple(njs_vm_t *vm, njs_value_t *args,
     }
 
     if (nxt_regex_is_valid(&pattern->regex[type])) {
+        if (nxt_slow_path(njs_regexp_context(vm) != NXT_OK)) {
+            return NXT_ERROR;
+        }
+
         array = NULL;
 
         do {
@@ -2820,6 +2954,10 @@ found:
                 goto single;
             }
 
+            if (nxt_slow_path(njs_regexp_context(vm) != NXT_OK)) {
+                return NXT_ERROR;
+            }
+
             start = string.start;
             end = string.start + string.size;
 
@@ -2995,8 +3133,13 @@ njs_string_prototype_replace(njs_vm_t *vm, njs_value_t *args, nxt_uint_t nargs,
     njs_set_invalid(&r->part[0].value);
 
     if (regex != NULL) {
+        if (nxt_slow_path(njs_regexp_context(vm) != NXT_OK)) {
+            return NXT_ERROR;
+        }
+
         r->match_data = nxt_regex_match_data(regex, vm->regex_context);
         if (nxt_slow_path(r->match_data == NULL)) {
+            njs_memory_error(vm);
             return NXT_ERROR;
         }
 
@@ -3047,12 +3190,14 @@ njs_string_replace_regexp(njs_vm_t *vm, njs_value_t *args,
                     r->part = nxt_array_add(&r->parts, &njs_array_mem_proto,
                                             vm->mem_pool);
                     if (nxt_slow_path(r->part == NULL)) {
+                        njs_memory_error(vm);
                         return NXT_ERROR;
                     }
 
                     r->part = nxt_array_add(&r->parts, &njs_array_mem_proto,
                                             vm->mem_pool);
                     if (nxt_slow_path(r->part == NULL)) {
+                        njs_memory_error(vm);
                         return NXT_ERROR;
                     }
 
@@ -3312,6 +3457,7 @@ njs_string_replace_parse(njs_vm_t *vm, njs_string_replace_t *r, u_char *p,
                                      &njs_array_mem_proto, vm->mem_pool);
 
     if (nxt_slow_path(r->substitutions == NULL)) {
+        njs_memory_error(vm);
         return NXT_ERROR;
     }
 
@@ -3326,6 +3472,7 @@ copy:
     if (s == NULL) {
         s = nxt_array_add(r->substitutions, &njs_array_mem_proto, vm->mem_pool);
         if (nxt_slow_path(s == NULL)) {
+            njs_memory_error(vm);
             return NXT_ERROR;
         }
 
@@ -3390,6 +3537,7 @@ skip:
 
         s = nxt_array_add(r->substitutions, &njs_array_mem_proto, vm->mem_pool);
         if (nxt_slow_path(s == NULL)) {
+            njs_memory_error(vm);
             return NXT_ERROR;
         }
 
@@ -3414,6 +3562,7 @@ njs_string_replace_substitute(njs_vm_t *vm, njs_string_replace_t *r,
     part = nxt_array_add_multiple(&r->parts, &njs_array_mem_proto, vm->mem_pool,
                                   last + 1);
     if (nxt_slow_path(part == NULL)) {
+        njs_memory_error(vm);
         return NXT_ERROR;
     }
 
@@ -4337,7 +4486,7 @@ njs_values_hash_test(nxt_lvlhsh_query_t *lhq, void *data)
 }
 
 
-static const nxt_lvlhsh_proto_t  njs_values_hash_proto
+const nxt_lvlhsh_proto_t  njs_values_hash_proto
     nxt_aligned(64) =
 {
     NXT_LVLHSH_DEFAULT,
@@ -4419,6 +4568,10 @@ njs_value_index(njs_vm_t *vm, const njs_value_t *src, nxt_uint_t runtime)
             string->length = src->long_string.data->length;
             string->retain = 0xffff;
 
+            if (value->long_string.external == NJS_STRING_BUFFER) {
+                value->long_string.external = 0;
+            }
+
             memcpy(string->start, start, size);
         }
 
@@ -4448,6 +4601,98 @@ njs_value_index(njs_vm_t *vm, const njs_value_t *src, nxt_uint_t runtime)
 }
 
 
+static nxt_int_t
+njs_atoms_hash_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    nxt_str_t   name;
+    njs_atom_t  *atom;
+
+    atom = data;
+
+    njs_string_get(&atom->name, &name);
+
+    if (lhq->key.length == name.length
+        && memcmp(lhq->key.start, name.start, name.length) == 0)
+    {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+const nxt_lvlhsh_proto_t  njs_atoms_hash_proto
+    nxt_aligned(64) =
+{
+    NXT_LVLHSH_DEFAULT,
+    0,
+    njs_atoms_hash_test,
+    njs_lvlhsh_alloc,
+    njs_lvlhsh_free,
+};
+
+
+/*
+ * njs_atom_index() interns a string constant used as a property name.
+ * The property name hash is calculated once during code generation and
+ * the property instructions use the atom instead of hashing the name
+ * on each access.
+ */
+
+njs_index_t
+njs_atom_index(njs_vm_t *vm, const njs_value_t *src, nxt_uint_t runtime)
+{
+    nxt_int_t           ret;
+    njs_atom_t          *atom;
+    njs_index_t         index;
+    nxt_lvlhsh_t        *atoms_hash;
+    nxt_lvlhsh_query_t  lhq;
+
+    njs_string_get(src, &lhq.key);
+    lhq.key_hash = nxt_djb_hash(lhq.key.start, lhq.key.length);
+    lhq.proto = &njs_atoms_hash_proto;
+
+    if (nxt_lvlhsh_find(&vm->shared->atoms_hash, &lhq) == NXT_OK) {
+        return (njs_index_t) lhq.value;
+    }
+
+    if (runtime && nxt_lvlhsh_find(&vm->atoms_hash, &lhq) == NXT_OK) {
+        return (njs_index_t) lhq.value;
+    }
+
+    /* The long string data is shared with the constant value. */
+
+    index = njs_value_index(vm, src, runtime);
+    if (nxt_slow_path(index == NJS_INDEX_NONE)) {
+        return NJS_INDEX_NONE;
+    }
+
+    atom = nxt_mp_align(vm->mem_pool, sizeof(njs_value_t), sizeof(njs_atom_t));
+    if (nxt_slow_path(atom == NULL)) {
+        return NJS_INDEX_NONE;
+    }
+
+    atom->name = *(njs_value_t *) index;
+    atom->key_hash = lhq.key_hash;
+
+    njs_string_get(&atom->name, &lhq.key);
+
+    lhq.replace = 0;
+    lhq.value = atom;
+    lhq.pool = vm->mem_pool;
+
+    atoms_hash = runtime ? &vm->atoms_hash : &vm->shared->atoms_hash;
+
+    ret = nxt_lvlhsh_insert(atoms_hash, &lhq);
+
+    if (nxt_slow_path(ret != NXT_OK)) {
+        return NJS_INDEX_NONE;
+    }
+
+    return (njs_index_t) atom;
+}
+
+
 const njs_object_init_t  njs_to_string_function_init = {
     nxt_string("toString"),
     NULL,
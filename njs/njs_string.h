@@ -85,6 +85,52 @@ typedef struct {
 } njs_string_prop_t;
 
 
+/*
+ * The long ASCII strings produced by concatenation are stored in a string
+ * buffer having spare capacity, the long_string.external field of such
+ * a string value is NJS_STRING_BUFFER.  The string whose end is the end
+ * of the used part of the buffer is extended in place by concatenation,
+ * so a loop appending to a string copies each byte only a few times.
+ * The strings are immutable: a string extended in place is still shorter
+ * than the used part of the buffer, and the strings sharing the buffer
+ * have their own njs_string_t structures.
+ *
+ * The UTF-8 strings are not stored in buffers because the offset map is
+ * stored after the string.  The byte strings are not stored either since
+ * njs_string_validate() can move them to add the map.  The buffer is
+ * extended only by the VM owning the buffer memory, the clones copy
+ * the parent strings.
+ */
+
+#define NJS_STRING_BUFFER      1
+
+/* The minimum size of a string stored in a string buffer. */
+#define NJS_STRING_BUFFER_MIN  256
+
+typedef struct {
+    nxt_mp_t  *mem_pool;
+    uint32_t  size;
+    uint32_t  capacity;
+} njs_string_buffer_t;
+
+
+#define njs_string_buffer(string)                                             \
+    ((njs_string_buffer_t *) (string)->start - 1)
+
+
+/*
+ * An atom is a constant property name interned together with its hash.
+ * The atom index refers to the atom name, so the index can be used as
+ * an ordinary constant value operand.
+ */
+
+typedef struct {
+    /* Must be the first field. */
+    njs_value_t         name;
+    uint32_t            key_hash;
+} njs_atom_t;
+
+
 typedef struct {
     size_t    start;
     size_t    length;
@@ -125,6 +171,9 @@ njs_ret_t njs_string_set(njs_vm_t *vm, njs_value_t *value, const u_char *start,
     uint32_t size);
 u_char *njs_string_alloc(njs_vm_t *vm, njs_value_t *value, uint32_t size,
     uint32_t length);
+njs_ret_t njs_string_buffer_concat(njs_vm_t *vm, njs_value_t *value,
+    const njs_value_t *val1, const njs_string_prop_t *string1,
+    const njs_string_prop_t *string2);
 njs_ret_t njs_string_new(njs_vm_t *vm, njs_value_t *value, const u_char *start,
     uint32_t size, uint32_t length);
 njs_ret_t njs_string_hex(njs_vm_t *vm, njs_value_t *value,
@@ -174,6 +223,8 @@ njs_ret_t njs_string_decode_uri_component(njs_vm_t *vm, njs_value_t *args,
 
 njs_index_t njs_value_index(njs_vm_t *vm, const njs_value_t *src,
     nxt_uint_t runtime);
+njs_index_t njs_atom_index(njs_vm_t *vm, const njs_value_t *src,
+    nxt_uint_t runtime);
 
 extern const njs_object_init_t  njs_string_constructor_init;
 extern const njs_object_init_t  njs_string_prototype_init;
@@ -184,5 +235,8 @@ extern const njs_object_init_t  njs_encode_uri_component_function_init;
 extern const njs_object_init_t  njs_decode_uri_function_init;
 extern const njs_object_init_t  njs_decode_uri_component_function_init;
 
+extern const nxt_lvlhsh_proto_t  njs_values_hash_proto;
+extern const nxt_lvlhsh_proto_t  njs_atoms_hash_proto;
+
 
 #endif /* _NJS_STRING_H_INCLUDED_ */
@@ -11,7 +11,7 @@
 
 struct njs_property_next_s {
     int32_t                        index;
-    nxt_lvlhsh_each_t              lhe;
+    njs_object_each_t              each;
 };
 
 
@@ -27,6 +27,9 @@ static nxt_noinline njs_ret_t njs_values_equal(njs_vm_t *vm,
     const njs_value_t *val1, const njs_value_t *val2);
 static nxt_noinline njs_ret_t njs_values_compare(njs_vm_t *vm,
     const njs_value_t *val1, const njs_value_t *val2);
+static nxt_noinline njs_ret_t njs_vmcode_compare_jump(njs_vm_t *vm,
+    const njs_value_t *val1, const njs_value_t *val2, njs_ret_t expected,
+    nxt_bool_t negative);
 static njs_ret_t njs_function_frame_create(njs_vm_t *vm, njs_value_t *value,
     const njs_value_t *this, uintptr_t nargs, nxt_bool_t ctor);
 static njs_object_t *njs_function_new_object(njs_vm_t *vm, njs_value_t *value);
@@ -35,9 +38,10 @@ static void njs_vm_scopes_restore(njs_vm_t *vm, njs_frame_t *frame,
 static njs_ret_t njs_vmcode_continuation(njs_vm_t *vm, njs_value_t *invld1,
     njs_value_t *invld2);
 
-static void njs_vm_trap(njs_vm_t *vm, njs_trap_t trap, njs_value_t *value1,
+static njs_frame_trap_t *njs_vm_frame_trap(njs_vm_t *vm);
+static njs_ret_t njs_vm_trap(njs_vm_t *vm, njs_trap_t trap, njs_value_t *value1,
     njs_value_t *value2);
-static void njs_vm_trap_argument(njs_vm_t *vm, njs_trap_t trap);
+static njs_ret_t njs_vm_trap_argument(njs_vm_t *vm, njs_trap_t trap);
 static njs_ret_t njs_vmcode_number_primitive(njs_vm_t *vm, njs_value_t *invld,
     njs_value_t *narg);
 static njs_ret_t njs_vmcode_string_primitive(njs_vm_t *vm, njs_value_t *invld,
@@ -59,6 +63,19 @@ static njs_ret_t njs_vmcode_value_to_string(njs_vm_t *vm, njs_value_t *invld1,
     njs_value_t *invld2);
 
 static njs_ret_t njs_vm_add_backtrace_entry(njs_vm_t *vm, njs_frame_t *frame);
+static void njs_vm_budget_countdown(njs_vm_t *vm);
+static nxt_noinline njs_ret_t njs_vm_budget(njs_vm_t *vm);
+static njs_ret_t njs_value_property_query(njs_vm_t *vm,
+    njs_property_query_t *pq, const njs_value_t *value,
+    const njs_value_t *property, njs_value_t *retval);
+nxt_inline njs_value_t *njs_array_element(const njs_value_t *object,
+    const njs_value_t *property);
+nxt_inline njs_object_t *njs_prop_cache_object(njs_vm_t *vm,
+    const njs_value_t *value);
+nxt_inline njs_value_t *njs_prop_cache_find(njs_vm_t *vm,
+    njs_prop_cache_t *cache, njs_object_t *object);
+static void njs_prop_cache_update(njs_vm_t *vm, njs_prop_cache_t *cache,
+    njs_object_t *object, njs_property_query_t *pq);
 
 void njs_debug(njs_index_t index, njs_value_t *value);
 
@@ -100,12 +117,85 @@ const nxt_str_t  njs_entry_unknown =        nxt_string("unknown");
 const nxt_str_t  njs_entry_anonymous =      nxt_string("anonymous");
 
 
+/* The number of steps between the time checks of the execution budget. */
+#define NJS_BUDGET_CLOCK_STEPS   1024
+
+
 /*
  * The nJSVM is optimized for an ABIs where the first several arguments
  * are passed in registers (AMD64, ARM32/64): two pointers to the operand
  * values is passed as arguments although they are not always used.
  */
 
+#if (NJS_THREADED_CODE)
+
+/*
+ * The threaded code: each inline handler jumps directly to the handler
+ * of the next instruction, so the indirect branches are spread over
+ * the handlers and are predicted better than the single switch branch.
+ */
+
+#define njs_vmcode_dispatch(size)                                             \
+    do {                                                                      \
+        vm->current += (size);                                                \
+        vmcode = (njs_vmcode_generic_t *) vm->current;                        \
+        goto *labels[vmcode->code.opcode];                                    \
+    } while (0)
+
+
+/*
+ * Backward jumps including a jump to itself return to the loop
+ * to check the execution budget.
+ */
+
+#define njs_vmcode_jump_dispatch(offset)                                      \
+    do {                                                                      \
+        ret = (njs_ret_t) (offset);                                           \
+                                                                              \
+        if (nxt_slow_path(ret <= 0)) {                                        \
+            goto backward;                                                    \
+        }                                                                     \
+                                                                              \
+        njs_vmcode_dispatch(ret);                                             \
+    } while (0)
+
+
+/* The slow path of an inline handler calls the instruction operation. */
+
+#define njs_vmcode_numeric_operands(vmcode)                                   \
+    do {                                                                      \
+        value1 = njs_vmcode_operand(vm, (vmcode)->operand2);                  \
+        value2 = njs_vmcode_operand(vm, (vmcode)->operand3);                  \
+                                                                              \
+        if (nxt_slow_path(!njs_is_numeric(value1)                             \
+                          || !njs_is_numeric(value2)))                        \
+        {                                                                     \
+            goto call;                                                        \
+        }                                                                     \
+    } while (0)
+
+
+#define njs_vmcode_jump_if(vmcode, cond)                                      \
+    do {                                                                      \
+        if (cond) {                                                           \
+            njs_vmcode_jump_dispatch(                                         \
+                               ((njs_vmcode_equal_jump_t *) vmcode)->offset); \
+        }                                                                     \
+                                                                              \
+        njs_vmcode_dispatch(sizeof(njs_vmcode_equal_jump_t));                 \
+    } while (0)
+
+
+#define njs_vmcode_set_boolean(vmcode, cond)                                  \
+    do {                                                                      \
+        retval = njs_vmcode_operand(vm, (vmcode)->operand1);                  \
+        *retval = (cond) ? njs_value_true : njs_value_false;                  \
+        njs_vmcode_dispatch(sizeof(njs_vmcode_3addr_t));                      \
+    } while (0)
+
+#endif
+
+
 nxt_noinline nxt_int_t
 njs_vmcode_interpreter(njs_vm_t *vm)
 {
@@ -117,12 +207,308 @@ njs_vmcode_interpreter(njs_vm_t *vm)
     njs_native_frame_t    *previous;
     njs_vmcode_generic_t  *vmcode;
 
+#if (NJS_THREADED_CODE)
+    double                num, step;
+
+    /* The order must match njs_vmcode_opcode_t. */
+
+    static const void     *const labels[] = {
+        &&generic,
+        &&move,
+        &&jump,
+        &&if_true_jump,
+        &&if_false_jump,
+        &&addition,
+        &&substraction,
+        &&less,
+        &&greater,
+        &&less_or_equal,
+        &&greater_or_equal,
+        &&if_less_jump,
+        &&if_not_less_jump,
+        &&if_greater_jump,
+        &&if_not_greater_jump,
+        &&if_less_or_equal_jump,
+        &&if_not_less_or_equal_jump,
+        &&if_greater_or_equal_jump,
+        &&if_not_greater_or_equal_jump,
+        &&increment,
+        &&decrement,
+        &&post_increment,
+        &&post_decrement,
+        &&property_get,
+        &&property_set,
+        &&function_frame,
+        &&method_frame,
+        &&function_call,
+        &&return_,
+    };
+#endif
+
 start:
 
     for ( ;; ) {
 
         vmcode = (njs_vmcode_generic_t *) vm->current;
 
+        if (nxt_slow_path(vm->profile != NULL)) {
+            njs_profile_code(vm);
+
+#if (NJS_THREADED_CODE)
+            /* Profiled instructions are not inlined. */
+            goto generic;
+#endif
+        }
+
+#if (NJS_THREADED_CODE)
+
+        goto *labels[vmcode->code.opcode];
+
+    move:
+
+        value1 = njs_vmcode_operand(vm, vmcode->operand2);
+        njs_retain(value1);
+
+        retval = njs_vmcode_operand(vm, vmcode->operand1);
+        *retval = *value1;
+
+        njs_vmcode_dispatch(sizeof(njs_vmcode_move_t));
+
+    jump:
+
+        njs_vmcode_jump_dispatch(vmcode->operand1);
+
+    if_true_jump:
+
+        value1 = njs_vmcode_operand(vm, vmcode->operand2);
+
+        ret = njs_is_true(value1) ? (njs_ret_t) vmcode->operand1
+                                  : (njs_ret_t) sizeof(njs_vmcode_cond_jump_t);
+
+        njs_vmcode_jump_dispatch(ret);
+
+    if_false_jump:
+
+        value1 = njs_vmcode_operand(vm, vmcode->operand2);
+
+        ret = njs_is_true(value1) ? (njs_ret_t) sizeof(njs_vmcode_cond_jump_t)
+                                  : (njs_ret_t) vmcode->operand1;
+
+        njs_vmcode_jump_dispatch(ret);
+
+    addition:
+
+        njs_vmcode_numeric_operands(vmcode);
+        num = value1->data.u.number + value2->data.u.number;
+        goto number;
+
+    substraction:
+
+        njs_vmcode_numeric_operands(vmcode);
+        num = value1->data.u.number - value2->data.u.number;
+
+    number:
+
+        retval = njs_vmcode_operand(vm, vmcode->operand1);
+        retval->data.u.number = num;
+        retval->type = NJS_NUMBER;
+        retval->data.truth = njs_is_number_true(num);
+
+        njs_vmcode_dispatch(sizeof(njs_vmcode_3addr_t));
+
+    less:
+
+        njs_vmcode_numeric_operands(vmcode);
+        njs_vmcode_set_boolean(vmcode,
+                    value1->data.u.number < value2->data.u.number);
+
+    greater:
+
+        njs_vmcode_numeric_operands(vmcode);
+        njs_vmcode_set_boolean(vmcode,
+                    value1->data.u.number > value2->data.u.number);
+
+    less_or_equal:
+
+        njs_vmcode_numeric_operands(vmcode);
+        njs_vmcode_set_boolean(vmcode,
+                    value1->data.u.number <= value2->data.u.number);
+
+    greater_or_equal:
+
+        njs_vmcode_numeric_operands(vmcode);
+        njs_vmcode_set_boolean(vmcode,
+                    value1->data.u.number >= value2->data.u.number);
+
+    if_less_jump:
+
+        njs_vmcode_numeric_operands(vmcode);
+        njs_vmcode_jump_if(vmcode,
+                    value1->data.u.number < value2->data.u.number);
+
+    if_not_less_jump:
+
+        njs_vmcode_numeric_operands(vmcode);
+        njs_vmcode_jump_if(vmcode,
+                    !(value1->data.u.number < value2->data.u.number));
+
+    if_greater_jump:
+
+        njs_vmcode_numeric_operands(vmcode);
+        njs_vmcode_jump_if(vmcode,
+                    value1->data.u.number > value2->data.u.number);
+
+    if_not_greater_jump:
+
+        njs_vmcode_numeric_operands(vmcode);
+        njs_vmcode_jump_if(vmcode,
+                    !(value1->data.u.number > value2->data.u.number));
+
+    if_less_or_equal_jump:
+
+        njs_vmcode_numeric_operands(vmcode);
+        njs_vmcode_jump_if(vmcode,
+                    value1->data.u.number <= value2->data.u.number);
+
+    if_not_less_or_equal_jump:
+
+        njs_vmcode_numeric_operands(vmcode);
+        njs_vmcode_jump_if(vmcode,
+                    !(value1->data.u.number <= value2->data.u.number));
+
+    if_greater_or_equal_jump:
+
+        njs_vmcode_numeric_operands(vmcode);
+        njs_vmcode_jump_if(vmcode,
+                    value1->data.u.number >= value2->data.u.number);
+
+    if_not_greater_or_equal_jump:
+
+        njs_vmcode_numeric_operands(vmcode);
+        njs_vmcode_jump_if(vmcode,
+                    !(value1->data.u.number >= value2->data.u.number));
+
+    increment:
+
+        num = 1.0;
+        goto inc_dec;
+
+    decrement:
+
+        num = -1.0;
+
+    inc_dec:
+
+        value1 = njs_vmcode_operand(vm, vmcode->operand2);
+        value2 = njs_vmcode_operand(vm, vmcode->operand3);
+
+        if (nxt_slow_path(!njs_is_numeric(value2))) {
+            goto call;
+        }
+
+        num += value2->data.u.number;
+
+        njs_release(vm, value1);
+
+        value1->data.u.number = num;
+        value1->type = NJS_NUMBER;
+        value1->data.truth = njs_is_number_true(num);
+
+        retval = njs_vmcode_operand(vm, vmcode->operand1);
+        *retval = *value1;
+
+        njs_vmcode_dispatch(sizeof(njs_vmcode_3addr_t));
+
+    post_increment:
+
+        step = 1.0;
+        goto post_inc_dec;
+
+    post_decrement:
+
+        step = -1.0;
+
+    post_inc_dec:
+
+        value1 = njs_vmcode_operand(vm, vmcode->operand2);
+        value2 = njs_vmcode_operand(vm, vmcode->operand3);
+
+        if (nxt_slow_path(!njs_is_numeric(value2))) {
+            goto call;
+        }
+
+        num = value2->data.u.number;
+
+        njs_release(vm, value1);
+
+        value1->data.u.number = num + step;
+        value1->type = NJS_NUMBER;
+        value1->data.truth = njs_is_number_true(num + step);
+
+        retval = njs_vmcode_operand(vm, vmcode->operand1);
+        retval->data.u.number = num;
+        retval->type = NJS_NUMBER;
+        retval->data.truth = njs_is_number_true(num);
+
+        njs_vmcode_dispatch(sizeof(njs_vmcode_3addr_t));
+
+    /*
+     * The following instructions are too complex to be inlined,
+     * however, they are called directly rather than via pointer.
+     */
+
+    property_get:
+
+        value1 = njs_vmcode_operand(vm, vmcode->operand2);
+        value2 = njs_vmcode_operand(vm, vmcode->operand3);
+
+        ret = njs_vmcode_property_get(vm, value1, value2);
+        goto done;
+
+    property_set:
+
+        value1 = njs_vmcode_operand(vm, vmcode->operand2);
+        value2 = njs_vmcode_operand(vm, vmcode->operand3);
+
+        ret = njs_vmcode_property_set(vm, value1, value2);
+        goto done;
+
+    function_frame:
+
+        value1 = njs_vmcode_operand(vm, vmcode->operand2);
+        value2 = (njs_value_t *) vmcode->operand1;
+
+        ret = njs_vmcode_function_frame(vm, value1, value2);
+        goto done;
+
+    method_frame:
+
+        value1 = njs_vmcode_operand(vm, vmcode->operand2);
+        value2 = njs_vmcode_operand(vm, vmcode->operand3);
+
+        ret = njs_vmcode_method_frame(vm, value1, value2);
+        goto done;
+
+    function_call:
+
+        value1 = NULL;
+        value2 = (njs_value_t *) vmcode->operand1;
+
+        ret = njs_vmcode_function_call(vm, value1, value2);
+        goto done;
+
+    return_:
+
+        value1 = NULL;
+        value2 = (njs_value_t *) vmcode->operand1;
+
+        ret = njs_vmcode_return(vm, value1, value2);
+        goto done;
+
+    generic:
+
+#endif
+
         /*
          * The first operand is passed as is in value2 to
          *   njs_vmcode_jump(),
@@ -154,8 +540,16 @@ start:
             value1 = njs_vmcode_operand(vm, vmcode->operand2);
         }
 
+#if (NJS_THREADED_CODE)
+    call:
+#endif
+
         ret = vmcode->code.operation(vm, value1, value2);
 
+#if (NJS_THREADED_CODE || NJS_HAVE_JIT)
+    done:
+#endif
+
         /*
          * On success an operation returns size of the bytecode,
          * a jump offset or zero after the call or return operations.
@@ -168,6 +562,10 @@ start:
             break;
         }
 
+#if (NJS_THREADED_CODE)
+    backward:
+#endif
+
         vm->current += ret;
 
         if (vmcode->code.retval) {
@@ -175,6 +573,49 @@ start:
             //njs_release(vm, retval);
             *retval = vm->retval;
         }
+
+        /* Backward jumps, calls and returns spend the execution budget. */
+
+        if (ret <= 0) {
+
+            if (nxt_slow_path(--vm->countdown == 0)) {
+                ret = njs_vm_budget(vm);
+                if (ret != NXT_OK) {
+                    goto exhausted;
+                }
+            }
+
+#if (NJS_HAVE_JIT)
+
+            /*
+             * The native code returns at an instruction which it does not
+             * complete, the result is handled as the instruction result.
+             */
+
+            if (vm->options.jit) {
+                ret = njs_jit_run(vm, &vmcode);
+
+                if (ret != NXT_DECLINED) {
+                    value2 = (njs_value_t *) vmcode->operand1;
+                    value1 = NULL;
+
+                    switch (vmcode->code.operands) {
+
+                    case NJS_VMCODE_3OPERANDS:
+                        value2 = njs_vmcode_operand(vm, vmcode->operand3);
+
+                        /* Fall through. */
+
+                    case NJS_VMCODE_2OPERANDS:
+                        value1 = njs_vmcode_operand(vm, vmcode->operand2);
+                    }
+
+                    goto done;
+                }
+            }
+
+#endif
+        }
     }
 
     if (ret == NJS_TRAP) {
@@ -193,14 +634,20 @@ start:
         case NJS_TRAP_INCDEC:
         case NJS_TRAP_PROPERTY:
 
-            njs_vm_trap(vm, trap, value1, value2);
+            ret = njs_vm_trap(vm, trap, value1, value2);
+            if (nxt_slow_path(ret != NXT_OK)) {
+                break;
+            }
 
             goto start;
 
         case NJS_TRAP_NUMBER_ARG:
         case NJS_TRAP_STRING_ARG:
 
-            njs_vm_trap_argument(vm, trap);
+            ret = njs_vm_trap_argument(vm, trap);
+            if (nxt_slow_path(ret != NXT_OK)) {
+                break;
+            }
 
             goto start;
 
@@ -210,6 +657,8 @@ start:
         }
     }
 
+exhausted:
+
     if (ret == NXT_ERROR) {
 
         for ( ;; ) {
@@ -219,7 +668,7 @@ start:
             if (catch != NULL) {
                 vm->current = catch;
 
-                if (vm->debug != NULL) {
+                if (vm->backtrace != NULL) {
                     nxt_array_reset(vm->backtrace);
                 }
 
@@ -229,29 +678,113 @@ start:
             if (vm->debug != NULL
                 && njs_vm_add_backtrace_entry(vm, frame) != NXT_OK)
             {
+                njs_profile_stop(vm);
                 return NXT_ERROR;
             }
 
             previous = frame->native.previous;
             if (previous == NULL) {
+                njs_profile_stop(vm);
                 return NXT_ERROR;
             }
 
             njs_vm_scopes_restore(vm, frame, previous);
 
-            if (frame->native.size != 0) {
-                vm->stack_size -= frame->native.size;
-                nxt_mp_free(vm->mem_pool, frame);
-            }
+            njs_function_frame_release(vm, &frame->native);
         }
     }
 
     /* NXT_AGAIN, NJS_STOP. */
 
+    njs_profile_stop(vm);
+
     return ret;
 }
 
 
+/*
+ * njs_vmcode_run() runs the interpreter within the execution budget.
+ * Only the outermost call renews the budget and can be preempted,
+ * because the nested calls are not resumable.
+ */
+
+nxt_int_t
+njs_vmcode_run(njs_vm_t *vm, nxt_bool_t preemptible)
+{
+    uint8_t    previous;
+    nxt_int_t  ret;
+
+    previous = vm->preemptible;
+
+    if (vm->nesting == 0) {
+        vm->steps = vm->options.max_steps;
+        vm->deadline = 0;
+
+        if (vm->options.max_time != 0) {
+            vm->deadline = nxt_time()
+                           + (uint64_t) vm->options.max_time * 1000000;
+        }
+
+        njs_vm_budget_countdown(vm);
+
+        vm->preemptible = preemptible && vm->options.preempt;
+
+    } else {
+        vm->preemptible = 0;
+    }
+
+    vm->nesting++;
+
+    ret = njs_vmcode_interpreter(vm);
+
+    vm->nesting--;
+    vm->preemptible = previous;
+
+    return ret;
+}
+
+
+static void
+njs_vm_budget_countdown(njs_vm_t *vm)
+{
+    uint32_t  n;
+
+    n = (vm->deadline != 0) ? NJS_BUDGET_CLOCK_STEPS : UINT32_MAX;
+
+    if (vm->options.max_steps != 0) {
+        n = nxt_min(n, vm->steps);
+        vm->steps -= n;
+    }
+
+    vm->countdown = n;
+}
+
+
+static nxt_noinline njs_ret_t
+njs_vm_budget(njs_vm_t *vm)
+{
+    if ((vm->options.max_steps != 0 && vm->steps == 0)
+        || (vm->deadline != 0 && nxt_time() >= vm->deadline))
+    {
+        /* The budget remains exhausted till the next njs_vmcode_run(). */
+        vm->countdown = 1;
+
+        if (vm->preemptible) {
+            vm->preempted = 1;
+            return NXT_AGAIN;
+        }
+
+        njs_internal_error(vm, "execution budget exceeded");
+
+        return NXT_ERROR;
+    }
+
+    njs_vm_budget_countdown(vm);
+
+    return NXT_OK;
+}
+
+
 nxt_noinline void
 njs_value_retain(njs_value_t *value)
 {
@@ -468,21 +1001,242 @@ njs_vmcode_object_copy(njs_vm_t *vm, njs_value_t *value, njs_value_t *invld)
         break;
     }
 
-    vm->retval = *value;
+    vm->retval = *value;
+
+    njs_retain(value);
+
+    return sizeof(njs_vmcode_object_copy_t);
+}
+
+
+/*
+ * njs_array_element() is the fast path for an array element accessed
+ * by a number index which is less than the array length.
+ */
+
+nxt_inline njs_value_t *
+njs_array_element(const njs_value_t *object, const njs_value_t *property)
+{
+    double       num;
+    uint32_t     index;
+    njs_array_t  *array;
+
+    if (njs_is_array(object) && njs_is_number(property)) {
+        array = object->data.u.array;
+        num = property->data.u.number;
+
+        if (num >= 0 && num < array->length) {
+            index = (uint32_t) num;
+
+            if (nxt_fast_path(index == num)) {
+                return &array->start[index];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+nxt_inline njs_object_t *
+njs_prop_cache_object(njs_vm_t *vm, const njs_value_t *value)
+{
+    nxt_uint_t  index;
+
+    switch (value->type) {
+
+    case NJS_BOOLEAN:
+    case NJS_NUMBER:
+        index = njs_primitive_prototype_index(value->type);
+        return &vm->prototypes[index].object;
+
+    case NJS_STRING:
+        return &vm->prototypes[NJS_PROTOTYPE_STRING].object;
+
+    default:
+        if (njs_is_object(value)) {
+            return value->data.u.object;
+        }
+
+        return NULL;
+    }
+}
+
+
+nxt_inline njs_value_t *
+njs_prop_cache_find(njs_vm_t *vm, njs_prop_cache_t *cache,
+    njs_object_t *object)
+{
+    void                  *key;
+    nxt_uint_t            n;
+    njs_prop_cache_way_t  *way;
+
+    if (nxt_slow_path(object == NULL)) {
+        return NULL;
+    }
+
+    key = (object->shape != NULL) ? (void *) object->shape : object;
+
+    way = cache->way;
+
+    for (n = 0; n < NJS_PROP_CACHE_WAYS; n++) {
+
+        if (way[n].key != key) {
+            continue;
+        }
+
+        if (way[n].value == NULL) {
+            cache->hits++;
+            return &object->slots[way[n].slot];
+        }
+
+        if (way[n].epoch == vm->prop_cache_epoch
+            && way[n].proto == object->__proto__)
+        {
+            cache->hits++;
+            return way[n].value;
+        }
+    }
+
+    cache->misses++;
+
+    return NULL;
+}
+
+
+static void
+njs_prop_cache_update(njs_vm_t *vm, njs_prop_cache_t *cache,
+    njs_object_t *object, njs_property_query_t *pq)
+{
+    njs_value_t           *value;
+    njs_object_t          *proto, *holder;
+    njs_object_prop_t     *prop;
+    njs_object_shape_t    *shape;
+    njs_prop_cache_way_t  *way;
+
+    prop = pq->lhq.value;
+    holder = pq->prototype;
+
+    if (object == NULL || holder == NULL) {
+        return;
+    }
+
+    shape = NULL;
+
+    if (holder->shape != NULL) {
+        shape = njs_object_shape_find(holder->shape, &pq->lhq);
+        if (shape == NULL) {
+            return;
+        }
+
+        value = &holder->slots[shape->count - 1];
+
+    } else {
+        if (prop == &pq->scratch
+            || (prop->type != NJS_PROPERTY && prop->type != NJS_METHOD))
+        {
+            return;
+        }
+
+        value = &prop->value;
+    }
+
+    if (holder == object && shape != NULL) {
+        way = &cache->way[cache->next++ % NJS_PROP_CACHE_WAYS];
+
+        way->key = object->shape;
+        way->value = NULL;
+        way->slot = shape->count - 1;
+
+        return;
+    }
+
+    /*
+     * An object with a shape does not need to be watched, its own
+     * properties are described by the shape.  Shared objects are never
+     * watched, so properties found through them are not cached.
+     */
+
+    proto = (object->shape != NULL) ? object->__proto__ : object;
+
+    for ( ;; ) {
+        if (proto == NULL || proto->shared) {
+            return;
+        }
+
+        if (proto == holder) {
+            break;
+        }
+
+        proto = proto->__proto__;
+    }
+
+    proto = (object->shape != NULL) ? object->__proto__ : object;
+
+    for ( ;; ) {
+        proto->watched = 1;
+
+        if (proto == holder) {
+            break;
+        }
+
+        proto = proto->__proto__;
+    }
+
+    way = &cache->way[cache->next++ % NJS_PROP_CACHE_WAYS];
+
+    way->key = (object->shape != NULL) ? (void *) object->shape : object;
+    way->proto = object->__proto__;
+    way->value = value;
+    way->epoch = vm->prop_cache_epoch;
+}
+
+
+njs_ret_t
+njs_vmcode_property_get(njs_vm_t *vm, njs_value_t *object,
+    njs_value_t *property)
+{
+    njs_ret_t              ret;
+    njs_value_t            *value;
+    njs_object_t           *obj;
+    njs_prop_cache_t       *cache;
+    njs_property_query_t   pq;
+    njs_vmcode_prop_get_t  *code;
+
+    code = (njs_vmcode_prop_get_t *) vm->current;
+
+    if (code->cache == 0) {
+        value = njs_array_element(object, property);
+
+        if (value != NULL && njs_is_valid(value)) {
+            vm->retval = *value;
+            return sizeof(njs_vmcode_prop_get_t);
+        }
+
+        ret = njs_value_property(vm, object, property, &vm->retval);
+
+    } else {
+        cache = &vm->prop_cache[code->cache];
+        obj = njs_prop_cache_object(vm, object);
 
-    njs_retain(value);
+        value = njs_prop_cache_find(vm, cache, obj);
 
-    return sizeof(njs_vmcode_object_copy_t);
-}
+        if (value != NULL) {
+            vm->retval = *value;
+            return sizeof(njs_vmcode_prop_get_t);
+        }
 
+        njs_property_query_init(&pq, NJS_PROPERTY_QUERY_GET, 0);
+        pq.prototype = NULL;
+        pq.atom = (njs_atom_t *) property;
 
-njs_ret_t
-njs_vmcode_property_get(njs_vm_t *vm, njs_value_t *object,
-    njs_value_t *property)
-{
-    njs_ret_t  ret;
+        ret = njs_value_property_query(vm, &pq, object, property, &vm->retval);
+
+        if (ret == NXT_OK) {
+            njs_prop_cache_update(vm, cache, obj, &pq);
+        }
+    }
 
-    ret = njs_value_property(vm, object, property, &vm->retval);
     if (ret == NXT_OK || ret == NXT_DECLINED) {
         return sizeof(njs_vmcode_prop_get_t);
     }
@@ -496,7 +1250,9 @@ njs_vmcode_property_set(njs_vm_t *vm, njs_value_t *object,
     njs_value_t *property)
 {
     njs_ret_t              ret;
-    njs_value_t            *value;
+    njs_value_t            *value, *slot;
+    njs_object_t           *obj;
+    njs_prop_cache_t       *cache;
     njs_object_prop_t      *prop;
     njs_property_query_t   pq;
     njs_vmcode_prop_set_t  *code;
@@ -510,7 +1266,33 @@ njs_vmcode_property_set(njs_vm_t *vm, njs_value_t *object,
     code = (njs_vmcode_prop_set_t *) vm->current;
     value = njs_vmcode_operand(vm, code->value);
 
+    slot = njs_array_element(object, property);
+
+    if (slot != NULL) {
+        *slot = *value;
+        return sizeof(njs_vmcode_prop_set_t);
+    }
+
+    cache = NULL;
+
+    if (code->cache != 0) {
+        cache = &vm->prop_cache[code->cache];
+        obj = njs_prop_cache_object(vm, object);
+
+        slot = njs_prop_cache_find(vm, cache, obj);
+
+        if (slot != NULL) {
+            *slot = *value;
+            return sizeof(njs_vmcode_prop_set_t);
+        }
+    }
+
     njs_property_query_init(&pq, NJS_PROPERTY_QUERY_SET, 0);
+    pq.prototype = NULL;
+
+    if (cache != NULL) {
+        pq.atom = (njs_atom_t *) property;
+    }
 
     ret = njs_property_query(vm, &pq, object, property);
 
@@ -525,6 +1307,11 @@ njs_vmcode_property_set(njs_vm_t *vm, njs_value_t *object,
 
         case NJS_PROPERTY_REF:
             *prop->value.data.u.value = *value;
+
+            if (cache != NULL && pq.prototype->shape != NULL) {
+                njs_prop_cache_update(vm, cache, pq.prototype, &pq);
+            }
+
             return sizeof(njs_vmcode_prop_set_t);
 
         case NJS_PROPERTY_HANDLER:
@@ -566,10 +1353,31 @@ njs_vmcode_property_set(njs_vm_t *vm, njs_value_t *object,
                 prop->enumerable = 1;
                 prop->configurable = 1;
                 prop->writable = 1;
+
+                njs_object_prop_cache_invalidate(vm, object->data.u.object);
                 break;
             }
         }
 
+        obj = object->data.u.object;
+
+        ret = njs_object_shape_add(vm, obj, &pq.lhq, &pq.value, value);
+
+        if (ret == NXT_OK) {
+            njs_object_prop_cache_invalidate(vm, obj);
+
+            if (cache != NULL) {
+                pq.prototype = obj;
+                njs_prop_cache_update(vm, cache, obj, &pq);
+            }
+
+            return sizeof(njs_vmcode_prop_set_t);
+        }
+
+        if (nxt_slow_path(ret != NXT_DECLINED)) {
+            return ret;
+        }
+
         prop = njs_object_prop_alloc(vm, &pq.value, &njs_value_undefined, 1);
         if (nxt_slow_path(prop == NULL)) {
             return NXT_ERROR;
@@ -579,12 +1387,17 @@ njs_vmcode_property_set(njs_vm_t *vm, njs_value_t *object,
         pq.lhq.value = prop;
         pq.lhq.pool = vm->mem_pool;
 
-        ret = nxt_lvlhsh_insert(&object->data.u.object->hash, &pq.lhq);
+        ret = nxt_lvlhsh_insert(&obj->hash, &pq.lhq);
         if (nxt_slow_path(ret != NXT_OK)) {
             njs_internal_error(vm, "lvlhsh insert failed");
             return NXT_ERROR;
         }
 
+        njs_object_prop_cache_invalidate(vm, object->data.u.object);
+
+        pq.prototype = object->data.u.object;
+        pq.shared = 0;
+
         break;
 
     case NJS_TRAP:
@@ -602,6 +1415,14 @@ njs_vmcode_property_set(njs_vm_t *vm, njs_value_t *object,
 
     prop->value = *value;
 
+    if (cache != NULL
+        && prop->type == NJS_PROPERTY
+        && pq.prototype == object->data.u.object
+        && !pq.shared)
+    {
+        njs_prop_cache_update(vm, cache, pq.prototype, &pq);
+    }
+
     return sizeof(njs_vmcode_prop_set_t);
 }
 
@@ -666,6 +1487,7 @@ njs_vmcode_property_delete(njs_vm_t *vm, njs_value_t *object,
     retval = &njs_value_false;
 
     njs_property_query_init(&pq, NJS_PROPERTY_QUERY_DELETE, 1);
+    pq.prototype = NULL;
 
     ret = njs_property_query(vm, &pq, object, property);
 
@@ -715,6 +1537,10 @@ njs_vmcode_property_delete(njs_vm_t *vm, njs_value_t *object,
         prop->type = NJS_WHITEOUT;
         njs_set_invalid(&prop->value);
 
+        if (pq.prototype != NULL) {
+            njs_object_prop_cache_invalidate(vm, pq.prototype);
+        }
+
         retval = &njs_value_true;
 
         break;
@@ -756,7 +1582,7 @@ njs_vmcode_property_foreach(njs_vm_t *vm, njs_value_t *object,
 
         vm->retval.data.u.next = next;
 
-        nxt_lvlhsh_each_init(&next->lhe, &njs_object_hash_proto);
+        njs_object_each_init(&next->each);
         next->index = -1;
 
         if (njs_is_array(object) && object->data.u.array->length != 0) {
@@ -818,7 +1644,7 @@ njs_vmcode_property_next(njs_vm_t *vm, njs_value_t *object, njs_value_t *value)
         }
 
         for ( ;; ) {
-            prop = nxt_lvlhsh_each(&object->data.u.object->hash, &next->lhe);
+            prop = njs_object_each(object->data.u.object, &next->each);
 
             if (prop == NULL) {
                 break;
@@ -996,59 +1822,114 @@ njs_vmcode_post_decrement(njs_vm_t *vm, njs_value_t *reference,
 }
 
 
+/* ECMAScript 5.1: null, array and regexp are objects. */
+
+static const njs_value_t  *njs_typeof_types[NJS_TYPE_MAX] = {
+    &njs_string_object,
+    &njs_string_undefined,
+    &njs_string_boolean,
+    &njs_string_number,
+    &njs_string_string,
+    &njs_string_undefined,
+    &njs_string_undefined,
+    &njs_string_undefined,
+    &njs_string_undefined,
+    &njs_string_undefined,
+    &njs_string_undefined,
+    &njs_string_undefined,
+    &njs_string_undefined,
+    &njs_string_undefined,
+    &njs_string_undefined,
+    &njs_string_undefined,
+
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_function,
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_object,
+    &njs_string_object,
+};
+
+
 njs_ret_t
 njs_vmcode_typeof(njs_vm_t *vm, njs_value_t *value, njs_value_t *invld)
 {
     nxt_uint_t  type;
 
-    /* ECMAScript 5.1: null, array and regexp are objects. */
-
-    static const njs_value_t  *types[NJS_TYPE_MAX] = {
-        &njs_string_object,
-        &njs_string_undefined,
-        &njs_string_boolean,
-        &njs_string_number,
-        &njs_string_string,
-        &njs_string_undefined,
-        &njs_string_undefined,
-        &njs_string_undefined,
-        &njs_string_undefined,
-        &njs_string_undefined,
-        &njs_string_undefined,
-        &njs_string_undefined,
-        &njs_string_undefined,
-        &njs_string_undefined,
-        &njs_string_undefined,
-        &njs_string_undefined,
-
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_function,
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_object,
-        &njs_string_object,
-    };
-
     /* A zero index means non-declared variable. */
     type = (value != NULL) ? value->type : NJS_UNDEFINED;
 
-    vm->retval = *types[type];
+    vm->retval = *njs_typeof_types[type];
 
     return sizeof(njs_vmcode_2addr_t);
 }
 
 
+/*
+ * The "typeof value === name" superinstruction compares the types
+ * without creation of the "typeof" result string.
+ */
+
+njs_ret_t
+njs_vmcode_typeof_equal(njs_vm_t *vm, njs_value_t *value, njs_value_t *invld)
+{
+    nxt_bool_t                 equal;
+    nxt_uint_t                 type;
+    njs_vmcode_typeof_equal_t  *code;
+
+    code = (njs_vmcode_typeof_equal_t *) vm->current;
+
+    /* A zero index means non-declared variable. */
+    type = (value != NULL) ? value->type : NJS_UNDEFINED;
+
+    equal = (njs_typeof_types[type] == njs_typeof_types[code->type]);
+
+    vm->retval = (equal ^ code->negative) ? njs_value_true : njs_value_false;
+
+    return sizeof(njs_vmcode_typeof_equal_t);
+}
+
+
+/*
+ * njs_typeof_type() returns a value type which "typeof" result
+ * is equal to the name or NXT_DECLINED if there is no such type.
+ */
+
+nxt_int_t
+njs_typeof_type(const njs_value_t *name)
+{
+    nxt_uint_t  i;
+
+    static const njs_value_type_t  types[] = {
+        NJS_OBJECT,
+        NJS_UNDEFINED,
+        NJS_BOOLEAN,
+        NJS_NUMBER,
+        NJS_STRING,
+        NJS_FUNCTION,
+    };
+
+    for (i = 0; i < nxt_nitems(types); i++) {
+        if (njs_values_strict_equal(name, njs_typeof_types[types[i]])) {
+            return types[i];
+        }
+    }
+
+    return NXT_DECLINED;
+}
+
+
 njs_ret_t
 njs_vmcode_void(njs_vm_t *vm, njs_value_t *invld1, njs_value_t *invld2)
 {
@@ -1143,6 +2024,7 @@ njs_string_concat(njs_vm_t *vm, njs_value_t *val1, njs_value_t *val2)
 {
     u_char             *start;
     size_t             size, length;
+    njs_ret_t          ret;
     njs_string_prop_t  string1, string2;
 
     (void) njs_string_prop(&string1, val1);
@@ -1163,6 +2045,19 @@ njs_string_concat(njs_vm_t *vm, njs_value_t *val1, njs_value_t *val2)
 
     size = string1.size + string2.size;
 
+    if (length == size && size >= NJS_STRING_BUFFER_MIN) {
+        ret = njs_string_buffer_concat(vm, &vm->retval, val1, &string1,
+                                       &string2);
+
+        if (ret == NXT_OK) {
+            return sizeof(njs_vmcode_3addr_t);
+        }
+
+        if (nxt_slow_path(ret == NXT_ERROR)) {
+            return ret;
+        }
+    }
+
     start = njs_string_alloc(vm, &vm->retval, size, length);
 
     if (nxt_slow_path(start == NULL)) {
@@ -1286,8 +2181,8 @@ njs_vmcode_left_shift(njs_vm_t *vm, njs_value_t *val1, njs_value_t *val2)
 
     if (nxt_fast_path(njs_is_numeric(val1) && njs_is_numeric(val2))) {
 
-        num1 = njs_number_to_integer(val1->data.u.number);
-        num2 = njs_number_to_integer(val2->data.u.number);
+        num1 = njs_number_to_int32(val1->data.u.number);
+        num2 = njs_number_to_int32(val2->data.u.number);
         njs_value_number_set(&vm->retval, num1 << (num2 & 0x1f));
 
         return sizeof(njs_vmcode_3addr_t);
@@ -1305,8 +2200,8 @@ njs_vmcode_right_shift(njs_vm_t *vm, njs_value_t *val1, njs_value_t *val2)
 
     if (nxt_fast_path(njs_is_numeric(val1) && njs_is_numeric(val2))) {
 
-        num1 = njs_number_to_integer(val1->data.u.number);
-        num2 = njs_number_to_integer(val2->data.u.number);
+        num1 = njs_number_to_int32(val1->data.u.number);
+        num2 = njs_number_to_int32(val2->data.u.number);
         njs_value_number_set(&vm->retval, num1 >> (num2 & 0x1f));
 
         return sizeof(njs_vmcode_3addr_t);
@@ -1325,8 +2220,8 @@ njs_vmcode_unsigned_right_shift(njs_vm_t *vm, njs_value_t *val1,
 
     if (nxt_fast_path(njs_is_numeric(val1) && njs_is_numeric(val2))) {
 
-        num1 = njs_number_to_integer(val1->data.u.number);
-        num2 = njs_number_to_integer(val2->data.u.number);
+        num1 = njs_number_to_int32(val1->data.u.number);
+        num2 = njs_number_to_int32(val2->data.u.number);
         njs_value_number_set(&vm->retval, num1 >> (num2 & 0x1f));
 
         return sizeof(njs_vmcode_3addr_t);
@@ -1392,7 +2287,7 @@ njs_vmcode_bitwise_not(njs_vm_t *vm, njs_value_t *value, njs_value_t *invld)
     int32_t  num;
 
     if (nxt_fast_path(njs_is_numeric(value))) {
-        num = njs_number_to_integer(value->data.u.number);
+        num = njs_number_to_int32(value->data.u.number);
         njs_value_number_set(&vm->retval, ~num);
 
         return sizeof(njs_vmcode_2addr_t);
@@ -1409,8 +2304,8 @@ njs_vmcode_bitwise_and(njs_vm_t *vm, njs_value_t *val1, njs_value_t *val2)
 
     if (nxt_fast_path(njs_is_numeric(val1) && njs_is_numeric(val2))) {
 
-        num1 = njs_number_to_integer(val1->data.u.number);
-        num2 = njs_number_to_integer(val2->data.u.number);
+        num1 = njs_number_to_int32(val1->data.u.number);
+        num2 = njs_number_to_int32(val2->data.u.number);
         njs_value_number_set(&vm->retval, num1 & num2);
 
         return sizeof(njs_vmcode_3addr_t);
@@ -1427,8 +2322,8 @@ njs_vmcode_bitwise_xor(njs_vm_t *vm, njs_value_t *val1, njs_value_t *val2)
 
     if (nxt_fast_path(njs_is_numeric(val1) && njs_is_numeric(val2))) {
 
-        num1 = njs_number_to_integer(val1->data.u.number);
-        num2 = njs_number_to_integer(val2->data.u.number);
+        num1 = njs_number_to_int32(val1->data.u.number);
+        num2 = njs_number_to_int32(val2->data.u.number);
         njs_value_number_set(&vm->retval, num1 ^ num2);
 
         return sizeof(njs_vmcode_3addr_t);
@@ -1445,8 +2340,8 @@ njs_vmcode_bitwise_or(njs_vm_t *vm, njs_value_t *val1, njs_value_t *val2)
 
     if (nxt_fast_path(njs_is_numeric(val1) && njs_is_numeric(val2))) {
 
-        num1 = njs_number_to_integer(val1->data.u.number);
-        num2 = njs_number_to_integer(val2->data.u.number);
+        num1 = njs_number_to_int32(val1->data.u.number);
+        num2 = njs_number_to_int32(val2->data.u.number);
         njs_value_number_set(&vm->retval, num1 | num2);
 
         return sizeof(njs_vmcode_3addr_t);
@@ -1813,6 +2708,118 @@ njs_vmcode_if_equal_jump(njs_vm_t *vm, njs_value_t *val1, njs_value_t *val2)
 }
 
 
+njs_ret_t
+njs_vmcode_if_not_equal_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2)
+{
+    njs_vmcode_equal_jump_t  *jump;
+
+    if (!njs_values_strict_equal(val1, val2)) {
+        jump = (njs_vmcode_equal_jump_t *) vm->current;
+        return jump->offset;
+    }
+
+    return sizeof(njs_vmcode_equal_jump_t);
+}
+
+
+/*
+ * The compare-and-jump superinstructions replace a comparison followed
+ * by a conditional jump.  The "not" forms are required because
+ * a comparison with NaN is false in both directions.
+ */
+
+njs_ret_t
+njs_vmcode_if_less_jump(njs_vm_t *vm, njs_value_t *val1, njs_value_t *val2)
+{
+    return njs_vmcode_compare_jump(vm, val1, val2, 1, 0);
+}
+
+
+njs_ret_t
+njs_vmcode_if_not_less_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2)
+{
+    return njs_vmcode_compare_jump(vm, val1, val2, 1, 1);
+}
+
+
+njs_ret_t
+njs_vmcode_if_greater_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2)
+{
+    return njs_vmcode_compare_jump(vm, val2, val1, 1, 0);
+}
+
+
+njs_ret_t
+njs_vmcode_if_not_greater_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2)
+{
+    return njs_vmcode_compare_jump(vm, val2, val1, 1, 1);
+}
+
+
+njs_ret_t
+njs_vmcode_if_less_or_equal_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2)
+{
+    return njs_vmcode_compare_jump(vm, val2, val1, 0, 0);
+}
+
+
+njs_ret_t
+njs_vmcode_if_not_less_or_equal_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2)
+{
+    return njs_vmcode_compare_jump(vm, val2, val1, 0, 1);
+}
+
+
+njs_ret_t
+njs_vmcode_if_greater_or_equal_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2)
+{
+    return njs_vmcode_compare_jump(vm, val1, val2, 0, 0);
+}
+
+
+njs_ret_t
+njs_vmcode_if_not_greater_or_equal_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2)
+{
+    return njs_vmcode_compare_jump(vm, val1, val2, 0, 1);
+}
+
+
+/*
+ * njs_vmcode_compare_jump() jumps if njs_values_compare() result
+ * is equal to the expected value or, for the negative form, if it is not.
+ */
+
+static nxt_noinline njs_ret_t
+njs_vmcode_compare_jump(njs_vm_t *vm, const njs_value_t *val1,
+    const njs_value_t *val2, njs_ret_t expected, nxt_bool_t negative)
+{
+    njs_ret_t                ret;
+    njs_vmcode_equal_jump_t  *jump;
+
+    ret = njs_values_compare(vm, val1, val2);
+
+    if (nxt_fast_path(ret >= -1)) {
+
+        if ((ret == expected) ^ negative) {
+            jump = (njs_vmcode_equal_jump_t *) vm->current;
+            return jump->offset;
+        }
+
+        return sizeof(njs_vmcode_equal_jump_t);
+    }
+
+    return ret;
+}
+
+
 njs_ret_t
 njs_vmcode_function_frame(njs_vm_t *vm, njs_value_t *value, njs_value_t *nargs)
 {
@@ -1920,6 +2927,8 @@ njs_vmcode_method_frame(njs_vm_t *vm, njs_value_t *object, njs_value_t *name)
     njs_ret_t                  ret;
     nxt_str_t                  string;
     njs_value_t                *value;
+    njs_object_t               *obj;
+    njs_prop_cache_t           *cache;
     njs_object_prop_t          *prop;
     njs_property_query_t       pq;
     njs_vmcode_method_frame_t  *method;
@@ -1927,7 +2936,26 @@ njs_vmcode_method_frame(njs_vm_t *vm, njs_value_t *object, njs_value_t *name)
     value = NULL;
     method = (njs_vmcode_method_frame_t *) vm->current;
 
+    cache = NULL;
+    obj = NULL;
+
+    if (method->cache != 0) {
+        cache = &vm->prop_cache[method->cache];
+        obj = njs_prop_cache_object(vm, object);
+
+        value = njs_prop_cache_find(vm, cache, obj);
+
+        if (value != NULL) {
+            goto found;
+        }
+    }
+
     njs_property_query_init(&pq, NJS_PROPERTY_QUERY_GET, 0);
+    pq.prototype = NULL;
+
+    if (cache != NULL) {
+        pq.atom = (njs_atom_t *) name;
+    }
 
     ret = njs_property_query(vm, &pq, object, name);
 
@@ -1939,6 +2967,10 @@ njs_vmcode_method_frame(njs_vm_t *vm, njs_value_t *object, njs_value_t *name)
         switch (prop->type) {
         case NJS_PROPERTY:
         case NJS_METHOD:
+            if (cache != NULL) {
+                njs_prop_cache_update(vm, cache, obj, &pq);
+            }
+
             break;
 
         case NJS_PROPERTY_HANDLER:
@@ -1974,6 +3006,8 @@ njs_vmcode_method_frame(njs_vm_t *vm, njs_value_t *object, njs_value_t *name)
         return ret;
     }
 
+found:
+
     if (value == NULL || !njs_is_function(value)) {
         njs_string_get(name, &string);
         njs_type_error(vm, "\"%V\" is not a function", &string);
@@ -1994,11 +3028,12 @@ njs_vmcode_method_frame(njs_vm_t *vm, njs_value_t *object, njs_value_t *name)
 njs_ret_t
 njs_vmcode_function_call(njs_vm_t *vm, njs_value_t *invld, njs_value_t *retval)
 {
-    u_char              *return_address;
-    njs_ret_t           ret;
-    njs_function_t      *function;
-    njs_continuation_t  *cont;
-    njs_native_frame_t  *frame;
+    u_char               *return_address;
+    njs_ret_t            ret;
+    njs_function_t       *function;
+    njs_continuation_t   *cont;
+    njs_native_frame_t   *frame;
+    njs_vmcode_return_t  *code;
 
     frame = vm->top_frame;
     function = frame->function;
@@ -2026,8 +3061,23 @@ njs_vmcode_function_call(njs_vm_t *vm, njs_value_t *invld, njs_value_t *retval)
         }
 
     } else {
-        ret = njs_function_lambda_call(vm, (njs_index_t) retval,
-                                       return_address);
+        ret = NXT_DECLINED;
+
+        /* Backtraces require all frames. */
+
+        code = (njs_vmcode_return_t *) return_address;
+
+        if (code->code.operation == njs_vmcode_return
+            && code->retval == (njs_index_t) retval
+            && vm->debug == NULL)
+        {
+            ret = njs_function_lambda_tail_call(vm);
+        }
+
+        if (ret == NXT_DECLINED) {
+            ret = njs_function_lambda_call(vm, (njs_index_t) retval,
+                                           return_address);
+        }
     }
 
     switch (ret) {
@@ -2599,53 +3649,92 @@ static const njs_vm_trap_t  njs_vm_traps[] = {
 };
 
 
-static void
+static njs_frame_trap_t *
+njs_vm_frame_trap(njs_vm_t *vm)
+{
+    njs_frame_trap_t  *trap;
+
+    trap = vm->top_frame->trap;
+
+    if (trap == NULL) {
+        trap = vm->trap_cache;
+
+        if (trap != NULL) {
+            vm->trap_cache = trap->next;
+
+        } else {
+            trap = nxt_mp_alloc(vm->mem_pool, sizeof(njs_frame_trap_t));
+            if (nxt_slow_path(trap == NULL)) {
+                njs_memory_error(vm);
+                return NULL;
+            }
+        }
+
+        vm->top_frame->trap = trap;
+    }
+
+    return trap;
+}
+
+
+static njs_ret_t
 njs_vm_trap(njs_vm_t *vm, njs_trap_t trap, njs_value_t *value1,
     njs_value_t *value2)
 {
-    njs_native_frame_t  *frame;
+    njs_frame_trap_t  *state;
 
-    frame = vm->top_frame;
+    state = njs_vm_frame_trap(vm);
+    if (nxt_slow_path(state == NULL)) {
+        return NXT_ERROR;
+    }
 
     /*
-     * The trap_scratch value is for results of "valueOf" and "toString"
-     * methods.  The trap_values[] are original operand values which will
+     * The scratch value is for results of "valueOf" and "toString"
+     * methods.  The values[] are original operand values which will
      * be replaced with primitive values returned by "valueOf" or "toString"
      * methods.  The scratch value is stored separately to preserve the
      * original operand values for the second method call if the first
      * method call will return non-primitive value.
      */
-    njs_set_invalid(&frame->trap_scratch);
-    frame->trap_values[1] = *value2;
-    frame->trap_reference = njs_vm_traps[trap].reference;
+    njs_set_invalid(&state->scratch);
+    state->values[1] = *value2;
+    state->reference = njs_vm_traps[trap].reference;
 
     if (njs_vm_traps[trap].reference) {
-        frame->trap_values[0].data.u.value = value1;
+        state->values[0].data.u.value = value1;
 
     } else {
-        frame->trap_values[0] = *value1;
+        state->values[0] = *value1;
     }
 
-    frame->trap_restart = vm->current;
+    state->restart = vm->current;
     vm->current = (u_char *) njs_vm_traps[trap].code;
+
+    return NXT_OK;
 }
 
 
-static void
+static njs_ret_t
 njs_vm_trap_argument(njs_vm_t *vm, njs_trap_t trap)
 {
-    njs_value_t         *value;
-    njs_native_frame_t  *frame;
+    njs_value_t       *value;
+    njs_frame_trap_t  *state;
 
-    frame = vm->top_frame;
-    value = frame->trap_scratch.data.u.value;
-    njs_set_invalid(&frame->trap_scratch);
+    state = njs_vm_frame_trap(vm);
+    if (nxt_slow_path(state == NULL)) {
+        return NXT_ERROR;
+    }
 
-    frame->trap_values[1].data.u.value = value;
-    frame->trap_values[0] = *value;
+    value = vm->trap_value;
+    njs_set_invalid(&state->scratch);
 
-    frame->trap_restart = vm->current;
+    state->values[1].data.u.value = value;
+    state->values[0] = *value;
+
+    state->restart = vm->current;
     vm->current = (u_char *) njs_vm_traps[trap].code;
+
+    return NXT_OK;
 }
 
 
@@ -2656,7 +3745,7 @@ njs_vmcode_number_primitive(njs_vm_t *vm, njs_value_t *invld, njs_value_t *narg)
     njs_ret_t    ret;
     njs_value_t  *value;
 
-    value = &vm->top_frame->trap_values[(uintptr_t) narg];
+    value = &vm->top_frame->trap->values[(uintptr_t) narg];
 
     ret = njs_primitive_value(vm, value, 0);
 
@@ -2685,7 +3774,7 @@ njs_vmcode_string_primitive(njs_vm_t *vm, njs_value_t *invld, njs_value_t *narg)
     njs_ret_t    ret;
     njs_value_t  *value;
 
-    value = &vm->top_frame->trap_values[(uintptr_t) narg];
+    value = &vm->top_frame->trap->values[(uintptr_t) narg];
 
     ret = njs_primitive_value(vm, value, 1);
 
@@ -2709,7 +3798,7 @@ njs_vmcode_addition_primitive(njs_vm_t *vm, njs_value_t *invld,
     nxt_uint_t   hint;
     njs_value_t  *value;
 
-    value = &vm->top_frame->trap_values[(uintptr_t) narg];
+    value = &vm->top_frame->trap->values[(uintptr_t) narg];
 
     /*
      * ECMAScript 5.1:
@@ -2734,7 +3823,7 @@ njs_vmcode_comparison_primitive(njs_vm_t *vm, njs_value_t *invld,
     njs_ret_t    ret;
     njs_value_t  *value;
 
-    value = &vm->top_frame->trap_values[(uintptr_t) narg];
+    value = &vm->top_frame->trap->values[(uintptr_t) narg];
 
     ret = njs_primitive_value(vm, value, 0);
 
@@ -2754,7 +3843,7 @@ njs_vmcode_number_argument(njs_vm_t *vm, njs_value_t *invld1,
     njs_ret_t    ret;
     njs_value_t  *value;
 
-    value = &vm->top_frame->trap_values[0];
+    value = &vm->top_frame->trap->values[0];
 
     ret = njs_primitive_value(vm, value, 0);
 
@@ -2770,10 +3859,10 @@ njs_vmcode_number_argument(njs_vm_t *vm, njs_value_t *invld1,
             njs_value_number_set(value, num);
         }
 
-        *vm->top_frame->trap_values[1].data.u.value = *value;
+        *vm->top_frame->trap->values[1].data.u.value = *value;
 
-        vm->current = vm->top_frame->trap_restart;
-        vm->top_frame->trap_restart = NULL;
+        vm->current = vm->top_frame->trap->restart;
+        vm->top_frame->trap->restart = NULL;
 
         return 0;
     }
@@ -2789,7 +3878,7 @@ njs_vmcode_string_argument(njs_vm_t *vm, njs_value_t *invld1,
     njs_ret_t    ret;
     njs_value_t  *value;
 
-    value = &vm->top_frame->trap_values[0];
+    value = &vm->top_frame->trap->values[0];
 
     ret = njs_primitive_value(vm, value, 1);
 
@@ -2797,10 +3886,10 @@ njs_vmcode_string_argument(njs_vm_t *vm, njs_value_t *invld1,
         ret = njs_primitive_value_to_string(vm, value, value);
 
         if (nxt_fast_path(ret == NXT_OK)) {
-            *vm->top_frame->trap_values[1].data.u.value = *value;
+            *vm->top_frame->trap->values[1].data.u.value = *value;
 
-            vm->current = vm->top_frame->trap_restart;
-            vm->top_frame->trap_restart = NULL;
+            vm->current = vm->top_frame->trap->restart;
+            vm->top_frame->trap->restart = NULL;
         }
     }
 
@@ -2814,22 +3903,22 @@ njs_vmcode_restart(njs_vm_t *vm, njs_value_t *invld1, njs_value_t *invld2)
     u_char                *restart;
     njs_ret_t             ret;
     njs_value_t           *retval, *value1;
-    njs_native_frame_t    *frame;
+    njs_frame_trap_t      *trap;
     njs_vmcode_generic_t  *vmcode;
 
-    frame = vm->top_frame;
-    restart = frame->trap_restart;
-    frame->trap_restart = NULL;
+    trap = vm->top_frame->trap;
+    restart = trap->restart;
+    trap->restart = NULL;
     vm->current = restart;
     vmcode = (njs_vmcode_generic_t *) restart;
 
-    value1 = &frame->trap_values[0];
+    value1 = &trap->values[0];
 
-    if (frame->trap_reference) {
+    if (trap->reference) {
         value1 = value1->data.u.value;
     }
 
-    ret = vmcode->code.operation(vm, value1, &frame->trap_values[1]);
+    ret = vmcode->code.operation(vm, value1, &trap->values[1]);
 
     if (nxt_slow_path(ret == NJS_TRAP)) {
         /* Trap handlers are not reentrant. */
@@ -2837,11 +3926,18 @@ njs_vmcode_restart(njs_vm_t *vm, njs_value_t *invld1, njs_value_t *invld2)
         return NXT_ERROR;
     }
 
-    retval = njs_vmcode_operand(vm, vmcode->operand1);
+    /*
+     * Instructions without result, e.g. property set or compare-and-jump,
+     * use the first operand for other purposes.
+     */
 
-    //njs_release(vm, retval);
+    if (vmcode->code.retval) {
+        retval = njs_vmcode_operand(vm, vmcode->operand1);
 
-    *retval = vm->retval;
+        //njs_release(vm, retval);
+
+        *retval = vm->retval;
+    }
 
     return ret;
 }
@@ -2859,7 +3955,7 @@ njs_primitive_value(njs_vm_t *vm, njs_value_t *value, nxt_uint_t hint)
     njs_ret_t           ret;
     njs_value_t         *retval;
     njs_function_t      *function;
-    njs_object_prop_t   *prop;
+    njs_object_prop_t   *prop, scratch;
     nxt_lvlhsh_query_t  lhq;
 
     static const uint32_t  hashes[] = {
@@ -2873,7 +3969,7 @@ njs_primitive_value(njs_vm_t *vm, njs_value_t *value, nxt_uint_t hint)
     };
 
     if (!njs_is_primitive(value)) {
-        retval = &vm->top_frame->trap_scratch;
+        retval = &vm->top_frame->trap->scratch;
 
         if (!njs_is_primitive(retval)) {
 
@@ -2886,7 +3982,8 @@ njs_primitive_value(njs_vm_t *vm, njs_value_t *value, nxt_uint_t hint)
                     lhq.key_hash = hashes[hint];
                     lhq.key = names[hint];
 
-                    prop = njs_object_property(vm, value->data.u.object, &lhq);
+                    prop = njs_object_property(vm, value->data.u.object,
+                                               &lhq, &scratch);
 
                     if (nxt_fast_path(prop != NULL)) {
 
@@ -2959,30 +4056,47 @@ njs_ret_t
 njs_value_property(njs_vm_t *vm, const njs_value_t *value,
     const njs_value_t *property, njs_value_t *retval)
 {
-    njs_ret_t             ret;
-    njs_object_prop_t     *prop;
     njs_property_query_t  pq;
 
     njs_property_query_init(&pq, NJS_PROPERTY_QUERY_GET, 0);
 
-    ret = njs_property_query(vm, &pq, (njs_value_t *) value, property);
+    return njs_value_property_query(vm, &pq, value, property, retval);
+}
+
+
+/*
+ * The njs_value_property_query() is njs_value_property() which also
+ * returns the property query state in pq for the property cache.
+ * pq->lhq.value is the property found in pq->prototype object
+ * unless the property is an NJS_PROPERTY_HANDLER.
+ */
+
+static njs_ret_t
+njs_value_property_query(njs_vm_t *vm, njs_property_query_t *pq,
+    const njs_value_t *value, const njs_value_t *property, njs_value_t *retval)
+{
+    njs_ret_t          ret;
+    njs_object_prop_t  *prop;
+
+    ret = njs_property_query(vm, pq, (njs_value_t *) value, property);
 
     switch (ret) {
 
     case NXT_OK:
-        prop = pq.lhq.value;
+        prop = pq->lhq.value;
 
         switch (prop->type) {
 
         case NJS_METHOD:
-            if (pq.shared) {
-                ret = njs_method_private_copy(vm, &pq);
+            if (pq->shared) {
+                ret = njs_method_private_copy(vm, pq);
 
                 if (nxt_slow_path(ret != NXT_OK)) {
                     return ret;
                 }
 
-                prop = pq.lhq.value;
+                prop = pq->lhq.value;
+                pq->shared = 0;
             }
 
             /* Fall through. */
@@ -2992,8 +4106,9 @@ njs_value_property(njs_vm_t *vm, const njs_value_t *value,
             break;
 
         case NJS_PROPERTY_HANDLER:
-            pq.scratch = *prop;
-            prop = &pq.scratch;
+            pq->scratch = *prop;
+            prop = &pq->scratch;
+            pq->lhq.value = prop;
             ret = prop->value.data.u.prop_handler(vm, (njs_value_t *) value,
                                                   NULL, &prop->value);
 
@@ -3217,6 +4332,7 @@ njs_object_value_to_string(njs_vm_t *vm, njs_value_t *value)
 {
     u_char              *current;
     njs_ret_t           ret;
+    njs_frame_trap_t    *trap;
     njs_native_frame_t  *previous;
 
     static const njs_vmcode_1addr_t  value_to_string[] = {
@@ -3227,19 +4343,24 @@ njs_object_value_to_string(njs_vm_t *vm, njs_value_t *value)
 
     /*
      * Execute the single njs_vmcode_value_to_string() instruction.
-     * The trap_scratch value is for results of "toString" or "valueOf"
-     * methods.  The trap_values[0] is an original object value which will
+     * The trap scratch value is for results of "toString" or "valueOf"
+     * methods.  The trap values[0] is an original object value which will
      * be replaced with primitive value returned by "toString" or "valueOf"
      * methods.  The scratch value is stored separately to preserve the
      * original object value for the second "valueOf" method call if the
      * first "toString" method call will return non-primitive value.
      */
 
+    trap = njs_vm_frame_trap(vm);
+    if (nxt_slow_path(trap == NULL)) {
+        return NXT_ERROR;
+    }
+
     current = vm->current;
     vm->current = (u_char *) value_to_string;
 
-    njs_set_invalid(&vm->top_frame->trap_scratch);
-    vm->top_frame->trap_values[0] = *value;
+    njs_set_invalid(&trap->scratch);
+    trap->values[0] = *value;
 
     /*
      * Prevent njs_vmcode_interpreter() to unwind the current frame if
@@ -3249,11 +4370,11 @@ njs_object_value_to_string(njs_vm_t *vm, njs_value_t *value)
     previous = vm->top_frame->previous;
     vm->top_frame->previous = NULL;
 
-    ret = njs_vmcode_interpreter(vm);
+    ret = njs_vmcode_run(vm, 0);
 
     if (ret == NJS_STOP) {
         ret = NXT_OK;
-        *value = vm->top_frame->trap_values[0];
+        *value = vm->top_frame->trap->values[0];
     }
 
     vm->current = current;
@@ -3269,7 +4390,7 @@ njs_vmcode_value_to_string(njs_vm_t *vm, njs_value_t *invld1,
 {
     njs_ret_t  ret;
 
-    ret = njs_primitive_value(vm, &vm->top_frame->trap_values[0], 1);
+    ret = njs_primitive_value(vm, &vm->top_frame->trap->values[0], 1);
 
     if (nxt_fast_path(ret > 0)) {
         return NJS_STOP;
@@ -3492,6 +4613,14 @@ njs_vm_add_backtrace_entry(njs_vm_t *vm, njs_frame_t *frame)
     native_frame = &frame->native;
     function = native_frame->function;
 
+    if (vm->backtrace == NULL) {
+        vm->backtrace = nxt_array_create(4, sizeof(njs_backtrace_entry_t),
+                                         &njs_array_mem_proto, vm->mem_pool);
+        if (nxt_slow_path(vm->backtrace == NULL)) {
+            return NXT_ERROR;
+        }
+    }
+
     be = nxt_array_add(vm->backtrace, &njs_array_mem_proto, vm->mem_pool);
     if (nxt_slow_path(be == NULL)) {
         return NXT_ERROR;
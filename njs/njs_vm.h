@@ -18,12 +18,17 @@
 
 #define NJS_MAX_STACK_SIZE       (16 * 1024 * 1024)
 
+/* The number of the last clones the clone sizes are learned from. */
+#define NJS_PRESIZE_SAMPLES      32
+
 /*
  * Negative return values handled by nJSVM interpreter as special events.
  * The values must be in range from -1 to -11, because -12 is minimal jump
  * offset on 32-bit platforms.
  *    -1 (NJS_ERROR/NXT_ERROR):  error or exception;
- *    -2 (NJS_AGAIN/NXT_AGAIN):  postpone nJSVM execution;
+ *    -2 (NJS_AGAIN/NXT_AGAIN):  postpone nJSVM execution, also returned
+ *                               if the execution budget is exhausted in
+ *                               the "preempt" mode;
  *    -3:                        not used;
  *    -4 (NJS_STOP/NXT_DONE):    njs_vmcode_stop() has stopped execution,
  *                               execution has completed successfully;
@@ -164,9 +169,15 @@ typedef struct njs_regexp_pattern_s   njs_regexp_pattern_t;
 typedef struct njs_date_s             njs_date_t;
 typedef struct njs_frame_s            njs_frame_t;
 typedef struct njs_native_frame_s     njs_native_frame_t;
+typedef struct njs_frame_trap_s       njs_frame_trap_t;
 typedef struct njs_property_next_s    njs_property_next_t;
 typedef struct njs_parser_scope_s     njs_parser_scope_t;
 typedef struct njs_parser_node_s      njs_parser_node_t;
+typedef struct njs_prop_cache_s       njs_prop_cache_t;
+typedef struct njs_object_shape_s     njs_object_shape_t;
+typedef struct njs_profile_s          njs_profile_t;
+typedef struct njs_jit_code_s         njs_jit_code_t;
+typedef struct njs_gc_s               njs_gc_t;
 
 
 union njs_value_s {
@@ -230,7 +241,10 @@ union njs_value_s {
         njs_value_type_t              type:8;  /* 6 bits */
         uint8_t                       truth;
 
-        /* 0xff if data is external string. */
+        /*
+         * 0xff if data is external string, NJS_STRING_BUFFER if data
+         * is stored in a string buffer.
+         */
         uint8_t                       external;
         uint8_t                       _spare;
 
@@ -262,10 +276,24 @@ struct njs_object_s {
     /* An object __proto__. */
     njs_object_t                      *__proto__;
 
+    /*
+     * Property names and values of a plain object in the slot mode,
+     * the object hash is empty in this mode.  See njs_shape.h.
+     */
+    njs_object_shape_t                *shape;
+    njs_value_t                       *slots;
+
     /* The type is used in constructor prototypes. */
     njs_value_type_t                  type:8;
     uint8_t                           shared;     /* 1 bit */
     uint8_t                           extensible; /* 1 bit */
+
+    /*
+     * The object is referenced by a property cache entry either as
+     * an object or as a prototype, so adding properties to the object
+     * must invalidate the property caches.
+     */
+    uint8_t                           watched;    /* 1 bit */
 };
 
 
@@ -287,7 +315,8 @@ struct njs_array_s {
 
 typedef struct {
     union {
-        uint32_t                      count;
+        /* The closure size including this header. */
+        uint32_t                      size;
         njs_value_t                   values;
     } u;
 
@@ -587,11 +616,56 @@ typedef njs_ret_t (*njs_vmcode_operation_t)(njs_vm_t *vm, njs_value_t *value1,
 #define NJS_VMCODE_RETVAL      1
 
 
+/*
+ * The threaded interpreter dispatches instructions by opcode and executes
+ * the most frequent of them inline.  The rest instructions have the generic
+ * opcode and are executed via the operation pointer.  The generic opcode is
+ * zero, so statically initialized instructions need not to set it.
+ */
+
+#ifndef NJS_THREADED_CODE
+#define NJS_THREADED_CODE      NXT_HAVE_COMPUTED_GOTO
+#endif
+
+typedef enum {
+    NJS_OPCODE_GENERIC = 0,
+    NJS_OPCODE_MOVE,
+    NJS_OPCODE_JUMP,
+    NJS_OPCODE_IF_TRUE_JUMP,
+    NJS_OPCODE_IF_FALSE_JUMP,
+    NJS_OPCODE_ADDITION,
+    NJS_OPCODE_SUBSTRACTION,
+    NJS_OPCODE_LESS,
+    NJS_OPCODE_GREATER,
+    NJS_OPCODE_LESS_OR_EQUAL,
+    NJS_OPCODE_GREATER_OR_EQUAL,
+    NJS_OPCODE_IF_LESS_JUMP,
+    NJS_OPCODE_IF_NOT_LESS_JUMP,
+    NJS_OPCODE_IF_GREATER_JUMP,
+    NJS_OPCODE_IF_NOT_GREATER_JUMP,
+    NJS_OPCODE_IF_LESS_OR_EQUAL_JUMP,
+    NJS_OPCODE_IF_NOT_LESS_OR_EQUAL_JUMP,
+    NJS_OPCODE_IF_GREATER_OR_EQUAL_JUMP,
+    NJS_OPCODE_IF_NOT_GREATER_OR_EQUAL_JUMP,
+    NJS_OPCODE_INCREMENT,
+    NJS_OPCODE_DECREMENT,
+    NJS_OPCODE_POST_INCREMENT,
+    NJS_OPCODE_POST_DECREMENT,
+    NJS_OPCODE_PROPERTY_GET,
+    NJS_OPCODE_PROPERTY_SET,
+    NJS_OPCODE_FUNCTION_FRAME,
+    NJS_OPCODE_METHOD_FRAME,
+    NJS_OPCODE_FUNCTION_CALL,
+    NJS_OPCODE_RETURN,
+} njs_vmcode_opcode_t;
+
+
 typedef struct {
     njs_vmcode_operation_t     operation;
     uint8_t                    operands;   /* 2 bits */
     uint8_t                    retval;     /* 1 bit  */
     uint8_t                    ctor;       /* 1 bit  */
+    uint8_t                    opcode;     /* njs_vmcode_opcode_t */
 } njs_vmcode_t;
 
 
@@ -684,6 +758,12 @@ typedef struct {
 } njs_vmcode_cond_jump_t;
 
 
+/*
+ * The compare-and-jump instructions njs_vmcode_if_less_jump(), etc.
+ * use njs_vmcode_equal_jump_t.  The offset field of the structure
+ * must be at the same place as in njs_vmcode_cond_jump_t, because
+ * the generator patches both instructions in the same way.
+ */
 typedef struct {
     njs_vmcode_t               code;
     njs_ret_t                  offset;
@@ -692,6 +772,15 @@ typedef struct {
 } njs_vmcode_equal_jump_t;
 
 
+typedef struct {
+    njs_vmcode_t               code;
+    njs_index_t                retval;
+    njs_index_t                value;
+    uint8_t                    type;       /* njs_value_type_t */
+    uint8_t                    negative;   /* 1 bit */
+} njs_vmcode_typeof_equal_t;
+
+
 typedef struct {
     njs_vmcode_t               code;
     njs_index_t                retval;
@@ -705,6 +794,7 @@ typedef struct {
     njs_index_t                value;
     njs_index_t                object;
     njs_index_t                property;
+    njs_index_t                cache;
 } njs_vmcode_prop_get_t;
 
 
@@ -713,6 +803,7 @@ typedef struct {
     njs_index_t                value;
     njs_index_t                object;
     njs_index_t                property;
+    njs_index_t                cache;
 } njs_vmcode_prop_set_t;
 
 
@@ -753,6 +844,7 @@ typedef struct {
     njs_index_t                nargs;
     njs_index_t                object;
     njs_index_t                method;
+    njs_index_t                cache;
 } njs_vmcode_method_frame_t;
 
 
@@ -1020,6 +1112,19 @@ typedef struct {
 } njs_function_debug_t;
 
 
+/*
+ * The pages and stack peaks of the last destroyed or reset clones.
+ * The new clones reserve the 90th percentiles of the peaks.
+ */
+typedef struct {
+    uint32_t                  samples;
+    uint32_t                  pool_size;
+    uint32_t                  stack_size;
+    uint32_t                  pool[NJS_PRESIZE_SAMPLES];
+    uint32_t                  stack[NJS_PRESIZE_SAMPLES];
+} njs_presize_t;
+
+
 struct njs_vm_s {
     /* njs_vm_t must be aligned to njs_value_t due to scratch value. */
     njs_value_t              retval;
@@ -1042,6 +1147,7 @@ struct njs_vm_s {
 
     nxt_lvlhsh_t             variables_hash;
     nxt_lvlhsh_t             values_hash;
+    nxt_lvlhsh_t             atoms_hash;
 
     nxt_array_t              *modules;
     nxt_lvlhsh_t             modules_hash;
@@ -1065,10 +1171,14 @@ struct njs_vm_s {
     njs_value_t              *global_scope;
     size_t                   scope_size;
     size_t                   stack_size;
+    size_t                   stack_peak;
 
     njs_vm_shared_t          *shared;
     njs_parser_t             *parser;
 
+    /* The VM the clone has been created from, NULL if not a clone. */
+    njs_vm_t                 *parent;
+
     nxt_regex_context_t      *regex_context;
     nxt_regex_match_data_t   *single_match_data;
 
@@ -1088,12 +1198,71 @@ struct njs_vm_s {
 
     njs_trap_t               trap:8;
 
+    /* A value passed by njs_vm_trap_value() to an argument trap. */
+    njs_value_t              *trap_value;
+    njs_frame_trap_t         *trap_cache;
+
+    /* The largest freed stack chunk kept for reuse. */
+    njs_native_frame_t       *stack_cache;
+
     /*
      * njs_property_query() uses it to store reference to a temporary
      * PROPERTY_HANDLERs for NJS_EXTERNAL values in NJS_PROPERTY_QUERY_SET
      * and NJS_PROPERTY_QUERY_DELETE modes.
      */
     uintptr_t                stash; /* njs_property_query_t * */
+
+    /*
+     * Property caches of instructions with constant property names,
+     * indexed by the instruction cache field.  The zeroth entry is unused.
+     */
+    njs_prop_cache_t         *prop_cache;
+    uint32_t                 prop_cache_size;
+    uint32_t                 prop_cache_epoch;
+
+    /* The number of property caches allocated by code generator. */
+    uint32_t                 prop_caches;
+
+    /* The root of the object shapes transition tree. */
+    njs_object_shape_t       *shape_root;
+
+    njs_profile_t            *profile;
+
+    /* The garbage collector state, NULL if the collector is not enabled. */
+    njs_gc_t                 *gc;
+
+    /* The clone peaks, NULL if no clone has been destroyed or reset yet. */
+    njs_presize_t            *presize;
+
+    /*
+     * The execution budget left, it is renewed by the outermost
+     * njs_vmcode_run() call.  The countdown is decremented at backward
+     * jumps, calls and returns, njs_vm_budget() is called on zero.
+     */
+    uint64_t                 deadline;
+    uint32_t                 countdown;
+    uint32_t                 steps;
+
+    /* The nesting level of njs_vmcode_run() calls. */
+    uint32_t                 nesting;
+
+    uint8_t                  preemptible;   /* 1 bit */
+    uint8_t                  preempted;     /* 1 bit */
+
+    /* The shared data has been created by the VM. */
+    uint8_t                  shared_owner;  /* 1 bit */
+
+    /*
+     * The global code has been run by njs_vm_snapshot() in the VM or
+     * in the VM clone parent, it is not run again by njs_vm_start().
+     */
+    uint8_t                  snapshot;      /* 1 bit */
+
+    /* The external_objects array is shared with the clones or parent. */
+    uint8_t                  externals_shared;  /* 1 bit */
+
+    /* The VM has been cloned, the clones refer to its objects. */
+    uint8_t                  cloned;        /* 1 bit */
 };
 
 
@@ -1108,6 +1277,7 @@ typedef struct {
 struct njs_vm_shared_s {
     nxt_lvlhsh_t             keywords_hash;
     nxt_lvlhsh_t             values_hash;
+    nxt_lvlhsh_t             atoms_hash;
     nxt_lvlhsh_t             function_prototype_hash;
     nxt_lvlhsh_t             arguments_object_hash;
 
@@ -1122,10 +1292,14 @@ struct njs_vm_shared_s {
     njs_function_t           constructors[NJS_CONSTRUCTOR_MAX];
 
     njs_regexp_pattern_t     *empty_regexp_pattern;
+
+    /* The native code of lambdas, it is freed with the shared data. */
+    njs_jit_code_t           *jit;
 };
 
 
 nxt_int_t njs_vmcode_interpreter(njs_vm_t *vm);
+nxt_int_t njs_vmcode_run(njs_vm_t *vm, nxt_bool_t preemptible);
 
 void njs_value_retain(njs_value_t *value);
 void njs_value_release(njs_vm_t *vm, njs_value_t *value);
@@ -1168,6 +1342,8 @@ njs_ret_t njs_vmcode_post_decrement(njs_vm_t *vm, njs_value_t *reference,
     njs_value_t *value);
 njs_ret_t njs_vmcode_typeof(njs_vm_t *vm, njs_value_t *value,
     njs_value_t *invld);
+njs_ret_t njs_vmcode_typeof_equal(njs_vm_t *vm, njs_value_t *value,
+    njs_value_t *invld);
 njs_ret_t njs_vmcode_void(njs_vm_t *vm, njs_value_t *invld1,
     njs_value_t *invld2);
 njs_ret_t njs_vmcode_delete(njs_vm_t *vm, njs_value_t *value,
@@ -1233,6 +1409,24 @@ njs_ret_t njs_vmcode_if_false_jump(njs_vm_t *vm, njs_value_t *cond,
     njs_value_t *offset);
 njs_ret_t njs_vmcode_if_equal_jump(njs_vm_t *vm, njs_value_t *val1,
     njs_value_t *val2);
+njs_ret_t njs_vmcode_if_not_equal_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2);
+njs_ret_t njs_vmcode_if_less_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2);
+njs_ret_t njs_vmcode_if_not_less_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2);
+njs_ret_t njs_vmcode_if_greater_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2);
+njs_ret_t njs_vmcode_if_not_greater_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2);
+njs_ret_t njs_vmcode_if_less_or_equal_jump(njs_vm_t *vm, njs_value_t *val1,
+    njs_value_t *val2);
+njs_ret_t njs_vmcode_if_not_less_or_equal_jump(njs_vm_t *vm,
+    njs_value_t *val1, njs_value_t *val2);
+njs_ret_t njs_vmcode_if_greater_or_equal_jump(njs_vm_t *vm,
+    njs_value_t *val1, njs_value_t *val2);
+njs_ret_t njs_vmcode_if_not_greater_or_equal_jump(njs_vm_t *vm,
+    njs_value_t *val1, njs_value_t *val2);
 
 njs_ret_t njs_vmcode_function_frame(njs_vm_t *vm, njs_value_t *value,
     njs_value_t *nargs);
@@ -1264,6 +1458,7 @@ njs_ret_t njs_vmcode_finally(njs_vm_t *vm, njs_value_t *invld,
 
 nxt_bool_t njs_values_strict_equal(const njs_value_t *val1,
     const njs_value_t *val2);
+nxt_int_t njs_typeof_type(const njs_value_t *name);
 
 const char *njs_type_string(njs_value_type_t type);
 const char *njs_arg_type_string(uint8_t arg);
@@ -1277,6 +1472,8 @@ nxt_int_t njs_builtin_match_native_function(njs_vm_t *vm,
     njs_function_t *function, nxt_str_t *name);
 
 nxt_array_t *njs_vm_backtrace(njs_vm_t *vm);
+const nxt_str_t *njs_vmcode_name(njs_vmcode_operation_t operation);
+size_t njs_vmcode_size(njs_vmcode_operation_t operation);
 
 void *njs_lvlhsh_alloc(void *data, size_t size, nxt_uint_t nalloc);
 void njs_lvlhsh_free(void *data, void *p, size_t size);
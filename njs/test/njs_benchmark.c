@@ -14,7 +14,7 @@
 
 static nxt_int_t
 njs_unit_test_benchmark(nxt_str_t *script, nxt_str_t *result, const char *msg,
-    nxt_uint_t n)
+    nxt_uint_t n, nxt_bool_t jit, nxt_bool_t snapshot, nxt_bool_t reset)
 {
     u_char         *start;
     njs_vm_t       *vm, *nvm;
@@ -28,6 +28,8 @@ njs_unit_test_benchmark(nxt_str_t *script, nxt_str_t *result, const char *msg,
 
     nxt_memzero(&options, sizeof(njs_vm_opt_t));
 
+    options.jit = jit;
+
     vm = NULL;
     nvm = NULL;
     rc = NXT_ERROR;
@@ -46,12 +48,25 @@ njs_unit_test_benchmark(nxt_str_t *script, nxt_str_t *result, const char *msg,
         goto done;
     }
 
+    if (snapshot && njs_vm_snapshot(vm) != NXT_OK) {
+        nxt_printf("njs_vm_snapshot() failed\n");
+        goto done;
+    }
+
     for (i = 0; i < n; i++) {
 
-        nvm = njs_vm_clone(vm, NULL);
-        if (nvm == NULL) {
-            nxt_printf("njs_vm_clone() failed\n");
-            goto done;
+        if (nvm != NULL) {
+            if (njs_vm_reset(nvm, NULL) != NXT_OK) {
+                nxt_printf("njs_vm_reset() failed\n");
+                goto done;
+            }
+
+        } else {
+            nvm = njs_vm_clone(vm, NULL);
+            if (nvm == NULL) {
+                nxt_printf("njs_vm_clone() failed\n");
+                goto done;
+            }
         }
 
         (void) njs_vm_start(nvm);
@@ -68,8 +83,10 @@ njs_unit_test_benchmark(nxt_str_t *script, nxt_str_t *result, const char *msg,
             goto done;
         }
 
-        njs_vm_destroy(nvm);
-        nvm = NULL;
+        if (!reset) {
+            njs_vm_destroy(nvm);
+            nvm = NULL;
+        }
     }
 
     getrusage(RUSAGE_SELF, &usage);
@@ -142,29 +159,147 @@ main(int argc, char **argv)
 
     static nxt_str_t  fibo_result = nxt_string("3524578");
 
+    static nxt_str_t  recursion = nxt_string(
+        "function depth(n) {"
+        "    if (n == 0)"
+        "        return 0;"
+        "    return 1 + depth(n - 1)"
+        "}"
+        "var s = 0;"
+        "for (var i = 0; i < 2000; i++) { s += depth(1000) }"
+        "s");
+
+    static nxt_str_t  recursion_result = nxt_string("2000000");
+
+    static nxt_str_t  tail_call = nxt_string(
+        "function sum(n, acc) {"
+        "    if (n == 0)"
+        "        return acc;"
+        "    return sum(n - 1, acc + n)"
+        "}"
+        "var s = 0;"
+        "for (var i = 0; i < 200; i++) { s += sum(10000, 0) }"
+        "s");
+
+    static nxt_str_t  tail_call_result = nxt_string("10001000000");
+
+    static nxt_str_t  loop = nxt_string(
+        "function loop(n) {"
+        "    var s = 0;"
+        "    for (var i = 0; i < n; i++) { s = s + i * 2 - 1 }"
+        "    return s"
+        "}"
+        "loop(30000000)");
+
+    static nxt_str_t  loop_result = nxt_string("899999940000000");
+
+    static nxt_str_t  int_loop = nxt_string(
+        "function count(n) {"
+        "    var s = 0, d = n;"
+        "    for (var i = 0; i < n; i++) { s = s + i - d; d-- }"
+        "    return s"
+        "}"
+        "count(30000000)");
+
+    static nxt_str_t  int_loop_result = nxt_string("-30000000");
+
+    static nxt_str_t  init = nxt_string(
+        "var table = {}, re = /^k(\\d+)$/;"
+        "for (var i = 0; i < 100; i++) { table['k' + i] = [i, 'v' + i] }"
+        "table['k' + re.exec('k50')[1]][1]");
+
+    static nxt_str_t  init_result = nxt_string("v50");
+
+    static nxt_str_t  append = nxt_string(
+        "function append(n) {"
+        "    var s = '';"
+        "    for (var i = 0; i < n; i++) { s += 'chunk of data, ' }"
+        "    return s"
+        "}"
+        "append(100000).length");
+
+    static nxt_str_t  append_result = nxt_string("1500000");
+
+    static nxt_str_t  append_1m = nxt_string(
+        "function append(n) {"
+        "    var s = '';"
+        "    for (var i = 0; i < n; i++) { s += 'chunk of data, ' }"
+        "    return s"
+        "}"
+        "append(1000000).length");
+
+    static nxt_str_t  append_1m_result = nxt_string("15000000");
+
 
     if (argc > 1) {
         switch (argv[1][0]) {
 
         case 'v':
             return njs_unit_test_benchmark(&script, &result,
-                                           "nJSVM clone/destroy", 1000000);
+                                           "nJSVM clone/destroy", 1000000, 0,
+                                           0, 0);
+
+        case 'w':
+            return njs_unit_test_benchmark(&script, &result,
+                                           "nJSVM reset", 1000000, 0, 0, 1);
 
         case 'n':
             return njs_unit_test_benchmark(&fibo_number, &fibo_result,
-                                           "fibobench numbers", 1);
+                                           "fibobench numbers", 1, 0, 0, 0);
 
         case 'a':
             return njs_unit_test_benchmark(&fibo_ascii, &fibo_result,
-                                           "fibobench ascii strings", 1);
+                                           "fibobench ascii strings", 1, 0,
+                                           0, 0);
 
         case 'b':
             return njs_unit_test_benchmark(&fibo_bytes, &fibo_result,
-                                           "fibobench byte strings", 1);
+                                           "fibobench byte strings", 1, 0,
+                                           0, 0);
 
         case 'u':
             return njs_unit_test_benchmark(&fibo_utf8, &fibo_result,
-                                           "fibobench utf8 strings", 1);
+                                           "fibobench utf8 strings", 1, 0,
+                                           0, 0);
+
+        case 'r':
+            return njs_unit_test_benchmark(&recursion, &recursion_result,
+                                           "deep recursion", 1, 0, 0, 0);
+
+        case 't':
+            return njs_unit_test_benchmark(&tail_call, &tail_call_result,
+                                           "self-recursive tail calls", 1, 0,
+                                           0, 0);
+
+        case 'l':
+            return njs_unit_test_benchmark(&loop, &loop_result,
+                                           "numeric loop", 1, 0, 0, 0);
+
+        case 'j':
+            return njs_unit_test_benchmark(&loop, &loop_result,
+                                           "numeric loop JIT", 1, 1, 0, 0);
+
+        case 'I':
+            return njs_unit_test_benchmark(&int_loop, &int_loop_result,
+                                           "integer loop", 1, 0, 0, 0);
+
+        case 'i':
+            return njs_unit_test_benchmark(&init, &init_result,
+                                           "global code init", 100000, 0, 0,
+                                           0);
+
+        case 's':
+            return njs_unit_test_benchmark(&init, &init_result,
+                                           "global code snapshot", 100000, 0,
+                                           1, 0);
+
+        case 'c':
+            return njs_unit_test_benchmark(&append, &append_result,
+                                           "string appends 100k", 1, 0, 0, 0);
+
+        case 'C':
+            return njs_unit_test_benchmark(&append_1m, &append_1m_result,
+                                           "string appends 1M", 1, 0, 0, 0);
         }
     }
 
@@ -804,6 +804,24 @@ static njs_unit_test_t  njs_test[] =
     { nxt_string("-2147483648 | 0"),
       nxt_string("-2147483648") },
 
+    { nxt_string("2147483647 | 0"),
+      nxt_string("2147483647") },
+
+    { nxt_string("2147483648 | 0"),
+      nxt_string("-2147483648") },
+
+    { nxt_string("-2147483649 | 0"),
+      nxt_string("2147483647") },
+
+    { nxt_string("-2147483648.5 | 0"),
+      nxt_string("-2147483648") },
+
+    { nxt_string("2147483647.5 | 0"),
+      nxt_string("2147483647") },
+
+    { nxt_string("-0.5 | 0"),
+      nxt_string("0") },
+
     { nxt_string("1024.9 | 0"),
       nxt_string("1024") },
 
@@ -1165,6 +1183,50 @@ static njs_unit_test_t  njs_test[] =
     { nxt_string("undefined < 1"),
       nxt_string("false") },
 
+    { nxt_string("var a = 1, b = NaN;"
+                 "[a < b, a > b, a <= b, a >= b, b <= b, b >= b]"),
+      nxt_string("false,false,false,false,false,false") },
+
+    { nxt_string("var a = true, b = 1;"
+                 "[a < b, a > b, a <= b, a >= b, a + b, a - b, b - '1']"),
+      nxt_string("false,false,true,true,2,0,0") },
+
+    { nxt_string("var a = '2', b = 10; [a < b, a + b, a - b]"),
+      nxt_string("true,210,-8") },
+
+    { nxt_string("var a = { valueOf: function() { return 2 } };"
+                 "[a < 3, a > 3, a + 1, a - 1]"),
+      nxt_string("true,false,3,1") },
+
+    { nxt_string("var a = 0, b = NaN, i, n = 0;"
+                 "for (i = 0; i < 3; i++) { if (a < b) n++; if (a >= b) n++;"
+                 "                          if (a > b) n++; if (a <= b) n++;"
+                 "                          if (!(a < b)) n += 10 }"
+                 "while (a < b) { n = -1 } n"),
+      nxt_string("30") },
+
+    { nxt_string("var s = '', i = 0;"
+                 "var a = { valueOf: function() { s += 'a'; return i } };"
+                 "var b = { valueOf: function() { s += 'b'; return 2 } };"
+                 "while (a < b) { i++ } if (a > b) {} if (a <= b) {}"
+                 "do { i-- } while (a >= b); s"),
+      nxt_string("abababababab") },
+
+    { nxt_string("var a = 'b', n = 0;"
+                 "if (a > 'a') n++; if (a === 'b') n++; if (a !== 'c') n++;"
+                 "for (var i = 0; i !== 3; i++) n++; n"),
+      nxt_string("6") },
+
+    { nxt_string("var i = 1, a = [i++, i--, ++i, --i, i]; a"),
+      nxt_string("1,2,2,1,1") },
+
+    { nxt_string("var i = '1', j = i++; [typeof i, i, typeof j, j]"),
+      nxt_string("number,2,number,1") },
+
+    { nxt_string("var o = {}, v = 5, k = { toString: function() { return 'x' } };"
+                 "o[k] = v; [v, o.x]"),
+      nxt_string("5,5") },
+
     { nxt_string("[] == false"),
       nxt_string("true") },
 
@@ -2156,6 +2218,50 @@ static njs_unit_test_t  njs_test[] =
     { nxt_string("var x = 0, y = 2; x\n--\ny; [x,y]"),
       nxt_string("0,1") },
 
+    /* Constant folding. */
+
+    { nxt_string("60 * 60 * 24"),
+      nxt_string("86400") },
+
+    { nxt_string("'prefix' + 'suffix' + 1 + 2"),
+      nxt_string("prefixsuffix12") },
+
+    { nxt_string("1 + 2 + 'a'"),
+      nxt_string("3a") },
+
+    { nxt_string("('abcdefghijklmno' + 'pqrstuvwxyz').length"),
+      nxt_string("26") },
+
+    { nxt_string("('α' + 'β' + 'γ').length"),
+      nxt_string("3") },
+
+    { nxt_string("[1 / 0, -1 / 0, 0 / 0, 1 / (0 * -1), 2 ** 10, 7 % 3]"),
+      nxt_string("Infinity,-Infinity,NaN,-Infinity,1024,1") },
+
+    { nxt_string("[1 << 4, -16 >> 2, -16 >>> 28, 5 & 3, 5 | 3, 5 ^ 3, ~5]"),
+      nxt_string("16,-4,15,1,7,6,-6") },
+
+    { nxt_string("[!true, !0, !'', 1 < 2, 'a' < 'b', 1 == '1', 1 === '1']"),
+      nxt_string("false,true,true,true,true,true,false") },
+
+    { nxt_string("[null == undefined, null === undefined, void 0]"),
+      nxt_string("true,false,") },
+
+    { nxt_string("typeof 1 + typeof 'a' + typeof null + typeof undefined"),
+      nxt_string("numberstringobjectundefined") },
+
+    { nxt_string("typeof 1 == 'number'"),
+      nxt_string("true") },
+
+    { nxt_string("['3' * 2, -'3', +'3', '3' - 1]"),
+      nxt_string("6,-3,3,2") },
+
+    { nxt_string("var x = 5; [0 && x, 1 && x, 0 || x, 1 || x, '' ? 1 : x]"),
+      nxt_string("0,5,5,1,5") },
+
+    { nxt_string("var x = 5; [true && (x = 6), x]"),
+      nxt_string("6,6") },
+
     /* if. */
 
     { nxt_string("if (0);"),
@@ -2197,6 +2303,24 @@ static njs_unit_test_t  njs_test[] =
     { nxt_string("(function(){ if(true) return 1\n else return 0; })()"),
       nxt_string("1") },
 
+    { nxt_string("var a = 1; if (false) { a = 2 } else { a = 3 } a"),
+      nxt_string("3") },
+
+    { nxt_string("var a = 1; if ('s') { a = 2 } else { a = 3 } a"),
+      nxt_string("2") },
+
+    { nxt_string("var a = 1; if (null) { var a = 2 } a"),
+      nxt_string("1") },
+
+    { nxt_string("if (false) { var a = 2 } typeof a"),
+      nxt_string("undefined") },
+
+    { nxt_string("if (false) { function f() { return 1 } } f()"),
+      nxt_string("1") },
+
+    { nxt_string("var i = 0; while (false) { i++ } i"),
+      nxt_string("0") },
+
     { nxt_string("(function(){ if(true) return 1\n;\n else return 0; })()"),
       nxt_string("1") },
 
@@ -2798,6 +2922,32 @@ static njs_unit_test_t  njs_test[] =
     { nxt_string("3 + 'abc' + 'def' + null + true + false + undefined"),
       nxt_string("3abcdefnulltruefalseundefined") },
 
+    /* Long ASCII strings extended in place. */
+
+    { nxt_string("var s = ''; for (var i = 0; i < 1000; i++) { s += 'abc' }"
+                 "s.length + s.slice(-4) + s[2999]"),
+      nxt_string("3000cabcc") },
+
+    { nxt_string("var a = 'x'.repeat(300), b = a + 'y', c = a + 'z';"
+                 "[a.length, b.slice(-2), c.slice(-2), b === c]"),
+      nxt_string("300,xy,xz,false") },
+
+    { nxt_string("var a = 'x'.repeat(300), b = a + 'y', c = b + 'z';"
+                 "var d = b + 'w'; [b.slice(-2), c.slice(-3), d.slice(-3)]"),
+      nxt_string("xy,xyz,xyw") },
+
+    { nxt_string("var s = 'ab'.repeat(200); s = s + s;"
+                 "s.length + s.slice(398, 402)"),
+      nxt_string("800abab") },
+
+    { nxt_string("var s = 'a'.repeat(300); s += 'α'; s += 'β';"
+                 "[s.length, s[300], s.slice(-3)]"),
+      nxt_string("302,α,aαβ") },
+
+    { nxt_string("var s = ''; for (var i = 0; i < 100; i++) { s += i + ',' }"
+                 "[s.match(/9,/g).length, s.indexOf('99'), s.split(',')[50]]"),
+      nxt_string("10,287,50") },
+
     { nxt_string("var a = 0; do a++; while (a < 5) if (a == 5) a = 7.33 \n"
                  "else a = 8; while (a < 10) a++; a"),
       nxt_string("10.33") },
@@ -2852,6 +3002,17 @@ static njs_unit_test_t  njs_test[] =
     { nxt_string("typeof Date.prototype"),
       nxt_string("object") },
 
+    { nxt_string("var a = 1, f = function() {};"
+                 "[typeof a == 'number', typeof a === 'string',"
+                 " 'function' === typeof f, typeof f != 'function',"
+                 " typeof b === 'undefined', typeof null !== 'object',"
+                 " typeof [] == 'object', typeof a === 'num']"),
+      nxt_string("true,false,true,false,true,false,true,false") },
+
+    { nxt_string("var n = 0; if (typeof n === 'number') n++;"
+                 "if (typeof n !== 'string') n++; n"),
+      nxt_string("2") },
+
     { nxt_string("typeof a"),
       nxt_string("undefined") },
 
@@ -5097,6 +5258,14 @@ static njs_unit_test_t  njs_test[] =
     { nxt_string("'абв'.toUpperCase()"),
       nxt_string("АБВ") },
 
+    { nxt_string("var s = String.fromCharCode(575).toUpperCase();"
+                 "[s.charCodeAt(0), s.toLowerCase().charCodeAt(0)]"),
+      nxt_string("11390,575") },
+
+    { nxt_string("var s = String.fromCharCode(11390, 97).toLowerCase();"
+                 "[s.length, s.charCodeAt(0), s.charCodeAt(1)]"),
+      nxt_string("2,575,97") },
+
     { nxt_string("var a = [], code;"
                  "for (code = 0; code <= 1114111; code++) {"
                  "    var s = String.fromCharCode(code);"
@@ -5697,6 +5866,37 @@ static njs_unit_test_t  njs_test[] =
     { nxt_string("function f() { return f() } f()"),
       nxt_string("RangeError: Maximum call stack size exceeded") },
 
+    { nxt_string("function f(n, a) { if (n == 0) return a; return f(n - 1, a + n) }"
+                 "f(10000, 0)"),
+      nxt_string("50005000") },
+
+    { nxt_string("function f(n, a) {"
+                 "    if (n == 0) return a;"
+                 "    a.push(function() { return n });"
+                 "    return f(n - 1, a) }"
+                 "f(3, []).map(function(g) { return g() })"),
+      nxt_string("3,2,1") },
+
+    { nxt_string("function f(n) { if (n == 0) return arguments.length;"
+                 "                return f(n - 1, 1, 2, 3) }"
+                 "f(3, 1)"),
+      nxt_string("4") },
+
+    { nxt_string("function f(n, a, b) { if (n == 0) return [a, b];"
+                 "                      return f(n - 1) }"
+                 "f(3, 1, 2)"),
+      nxt_string(",") },
+
+    { nxt_string("function f(n) { if (n == 0) throw n;"
+                 "                try { return f(n - 1) } catch (e) { return e + n } }"
+                 "f(3)"),
+      nxt_string("1") },
+
+    { nxt_string("var o = { v: 'v', m: function(n) {"
+                 "    if (n == 0) return this.v; return this.m(n - 1) } };"
+                 "o.m(3)"),
+      nxt_string("v") },
+
     { nxt_string("function () { } f()"),
       nxt_string("SyntaxError: Unexpected token \"(\" in 1") },
 
@@ -7535,6 +7735,27 @@ static njs_unit_test_t  njs_test[] =
     { nxt_string("njs"),
       nxt_string("[object Object]") },
 
+    { nxt_string("Object.keys(njs.memoryUsage()).sort()"),
+      nxt_string("cache,chunks,clusters,freePages,large,largeSize,pages,"
+                 "peak,presize,size,used") },
+
+    { nxt_string("Object.keys(njs.memoryUsage().chunks)"),
+      nxt_string("16,32,64,128,256") },
+
+    { nxt_string("Object.keys(njs.memoryUsage().cache)"),
+      nxt_string("size,clusters,hits,misses,returns,frees") },
+
+    { nxt_string("Object.keys(njs.memoryUsage().presize)"),
+      nxt_string("samples,poolSize,stackSize") },
+
+    { nxt_string("var u = njs.memoryUsage();"
+                 "u.used > 0 && u.used <= u.size && u.size <= u.peak"),
+      nxt_string("true") },
+
+    { nxt_string("var u = njs.memoryUsage(), a = 'x'.repeat(1 << 20);"
+                 "njs.memoryUsage().largeSize - u.largeSize >= 1 << 20"),
+      nxt_string("true") },
+
     { nxt_string("var o = Object(); o"),
       nxt_string("[object Object]") },
 
@@ -7574,6 +7795,124 @@ static njs_unit_test_t  njs_test[] =
     { nxt_string("var o = {}; var o2 = Object.create(o); o.__proto__ = o2"),
       nxt_string("TypeError: Cyclic __proto__ value") },
 
+    /* Property caches. */
+
+    { nxt_string("function P() {}; P.prototype.x = 1;"
+                 "var o = new P(), r = [];"
+                 "function g(o) { return o.x };"
+                 "r.push(g(o), g(o)); P.prototype.x = 2; r.push(g(o));"
+                 "o.x = 3; r.push(g(o)); delete o.x; r.push(g(o));"
+                 "o.x = 4; r.push(g(o)); delete o.x; delete P.prototype.x;"
+                 "r.push(g(o)); r"),
+      nxt_string("1,1,2,3,2,4,") },
+
+    { nxt_string("var p = {x:1}, q = {x:2}, o = Object.create(p), r = [];"
+                 "function g(o) { return o.x };"
+                 "r.push(g(o), g(o)); o.__proto__ = q; r.push(g(o));"
+                 "o.__proto__ = p; r.push(g(o)); r"),
+      nxt_string("1,1,2,1") },
+
+    { nxt_string("var a = [{x:'a'}, {y:1, x:'b'}, Object.create({x:'c'}),"
+                 "           {z:1, y:2, x:'d'}, {x:'e'}, {w:0, x:'f'}];"
+                 "function g(o) { return o.x }; var s = '';"
+                 "for (var i = 0; i < 12; i++) { s += g(a[i % 6]) }; s"),
+      nxt_string("abcdefabcdef") },
+
+    { nxt_string("function g(v) { return v.x }; var r = [g('s'), g(1)];"
+                 "String.prototype.x = 'S'; Number.prototype.x = 'N';"
+                 "r.push(g('s'), g(1), g(true)); r"),
+      nxt_string(",,S,N,") },
+
+    { nxt_string("function s(o, v) { o.x = v }; var o = {x:1}, f = {x:1};"
+                 "s(o, 2); s(o, 3); Object.freeze(f); s(f, 2); [o.x, f.x]"),
+      nxt_string("TypeError: Cannot assign to read-only property \"x\" of object") },
+
+    { nxt_string("var m = {f: function() { return 1 }};"
+                 "function c(m) { return m.f() }; var r = [c(m), c(m)];"
+                 "m.f = function() { return 2 }; r.push(c(m));"
+                 "Object.defineProperty(m, 'g', {value:3}); r.push(m.g); r"),
+      nxt_string("1,1,2,3") },
+
+    { nxt_string("var p = {f: function() { return 1 }}, o = Object.create(p);"
+                 "function c(o) { return o.f() }; var r = [c(o), c(o)];"
+                 "Object.defineProperty(o, 'f', {value:function() { return 2 }});"
+                 "r.push(c(o)); r"),
+      nxt_string("1,1,2") },
+
+    /* Property name atoms. */
+
+    { nxt_string("var o = {}; o.a_very_long_property_name = 1;"
+                 "o['a_very_long_property_name'] += 1;"
+                 "o.a_very_long_property_name + Object.keys(o).length"),
+      nxt_string("3") },
+
+    { nxt_string("var a = [{x:1}, {y:2, x:3}, Object.create({x:4}), 'x', 5];"
+                 "a.map(function(o) { return o.x })"),
+      nxt_string("1,3,4,,") },
+
+    { nxt_string("var o = {'\u0430\u0431\u0432': 1}; o['абв'] += 1;"
+                 "o['абв']"),
+      nxt_string("2") },
+
+    { nxt_string("var o = {}; o.toString = function() { return 'X' };"
+                 "o.toString() + o.valueOf().toString()"),
+      nxt_string("XX") },
+
+    /* Array element fast path. */
+
+    { nxt_string("var a = [1,2,3]; a[1] = 5; a[1.5] = 6; a[-1] = 7;"
+                 "[a[0], a[1], a[1.5], a[-1], a[3], a.length]"),
+      nxt_string("1,5,6,7,,3") },
+
+    { nxt_string("var a = [1,,3]; [a[1], 1 in a, a.length]"),
+      nxt_string(",false,3") },
+
+    { nxt_string("var a = [1,,3]; a[1] = 2; a[1] + a.length"),
+      nxt_string("5") },
+
+    { nxt_string("var a = [], s = 0; for (var i = 0; i < 100; i++) a[i] = i;"
+                 "for (i = 0; i < 100; i++) s += a[i]; s"),
+      nxt_string("4950") },
+
+    /* Object shapes. */
+
+    { nxt_string("var o = {a:1, b:2, c:3}, r = [];"
+                 "delete o.b; r.push(Object.keys(o)); o.b = 4;"
+                 "r.push(Object.keys(o), o.b); r.join(';')"),
+      nxt_string("a,c;a,b,c;4") },
+
+    { nxt_string("var o = {}; for (var i = 0; i < 20; i++) { o['k' + i] = i }"
+                 "[Object.keys(o).length, o.k0, o.k19, o.hasOwnProperty('k16')]"),
+      nxt_string("20,0,19,true") },
+
+    { nxt_string("var o = {x:1, y:2, z:3}, s = '';"
+                 "for (var k in o) { s += k; delete o.y }; s"),
+      nxt_string("xz") },
+
+    { nxt_string("var a = {p:1, q:2}, b = {p:3, q:4};"
+                 "Object.freeze(a); a.p = 5; b.p = 6;"
+                 "[a.p, b.p, Object.isFrozen(a), Object.isFrozen(b)]"),
+      nxt_string("TypeError: Cannot assign to read-only property \"p\" of object") },
+
+    { nxt_string("var a = {p:1, q:2}, b = {p:3, q:4};"
+                 "Object.seal(a); a.p = 5; b.p = 6;"
+                 "[a.p, b.p, Object.isSealed(a), Object.isSealed(b)]"),
+      nxt_string("5,6,true,false") },
+
+    { nxt_string("var o = {u:1, v:2};"
+                 "Object.defineProperty(o, 'u', {enumerable:false});"
+                 "[Object.keys(o), o.u, JSON.stringify(o)]"),
+      nxt_string("v,1,{\"v\":2}") },
+
+    { nxt_string("var o = JSON.parse('{\"a\":1,\"b\":{\"c\":2},\"a\":3}');"
+                 "[JSON.stringify(o), Object.keys(o)]"),
+      nxt_string("{\"a\":3,\"b\":{\"c\":2}},a,b") },
+
+    { nxt_string("var o = {a:1, b:2};"
+                 "JSON.stringify(Object.defineProperties(o, {c:{value:3}}))"
+                 "+ Object.getOwnPropertyNames(o)"),
+      nxt_string("{\"a\":1,\"b\":2}a,b,c") },
+
     { nxt_string("Object.prototype.__proto__.f()"),
       nxt_string("TypeError: cannot get property \"f\" of undefined") },
 
@@ -12380,12 +12719,13 @@ njs_externals_init(njs_vm_t *vm)
 
 static nxt_int_t
 njs_unit_test(njs_unit_test_t tests[], size_t num, nxt_bool_t disassemble,
-    nxt_bool_t verbose)
+    nxt_bool_t verbose, nxt_bool_t jit, nxt_bool_t image,
+    nxt_bool_t snapshot, nxt_bool_t gc)
 {
     u_char        *start;
-    njs_vm_t      *vm, *nvm;
+    njs_vm_t      *vm, *nvm, *ivm;
     nxt_int_t     ret, rc;
-    nxt_str_t     s;
+    nxt_str_t     s, img;
     nxt_uint_t    i;
     nxt_bool_t    success;
     njs_vm_opt_t  options;
@@ -12403,6 +12743,15 @@ njs_unit_test(njs_unit_test_t tests[], size_t num, nxt_bool_t disassemble,
 
         nxt_memzero(&options, sizeof(njs_vm_opt_t));
 
+        /* All functions are compiled on the first call. */
+        options.jit = jit;
+
+        if (gc) {
+            /* The garbage is collected on every return to the host. */
+            options.gc_threshold = 1;
+            options.gc_pause = 100;
+        }
+
         vm = njs_vm_create(&options);
         if (vm == NULL) {
             nxt_printf("njs_vm_create() failed\n");
@@ -12418,6 +12767,46 @@ njs_unit_test(njs_unit_test_t tests[], size_t num, nxt_bool_t disassemble,
 
         ret = njs_vm_compile(vm, &start, start + njs_test[i].script.length);
 
+        if (ret == NXT_OK && image && njs_vm_image(vm, &img) == NXT_OK) {
+
+            /* The script is run from the image loaded into a new VM. */
+
+            options.shared = NULL;
+
+            ivm = njs_vm_create(&options);
+            if (ivm == NULL) {
+                nxt_printf("njs_vm_create() failed\n");
+                goto done;
+            }
+
+            ret = njs_externals_init(ivm);
+            if (ret != NXT_OK) {
+                njs_vm_destroy(ivm);
+                goto done;
+            }
+
+            ret = njs_vm_compile_from_image(ivm, img.start,
+                                            img.start + img.length);
+
+            njs_vm_destroy(vm);
+            vm = ivm;
+        }
+
+        if (ret == NXT_OK && snapshot) {
+
+            /*
+             * The global code is run in the parent VM and the clone
+             * gets the resulting state.  The scripts posting events
+             * are run in the clone as usual.
+             */
+
+            ret = njs_vm_snapshot(vm);
+
+            if (ret == NJS_DECLINED) {
+                ret = NXT_OK;
+            }
+        }
+
         if (ret == NXT_OK) {
             if (disassemble) {
                 njs_disassembler(vm);
@@ -12643,132 +13032,1523 @@ njs_vm_object_alloc_test(njs_vm_t * vm, nxt_bool_t disassemble,
 
 
 static nxt_int_t
-nxt_file_basename_test(njs_vm_t * vm, nxt_bool_t disassemble,
+njs_vm_profile_test(njs_vm_t * vm, nxt_bool_t disassemble,
     nxt_bool_t verbose)
 {
-    nxt_str_t   name;
-    nxt_bool_t  success;
-    nxt_uint_t  i;
+    u_char        *start, *p;
+    njs_vm_t      *pvm, *nvm;
+    nxt_int_t     ret;
+    nxt_str_t     out;
+    njs_vm_opt_t  options;
 
-    static const struct {
-        nxt_str_t   path;
-        nxt_str_t   expected;
-    } tests[] = {
-        { nxt_string(""),            nxt_string("") },
-        { nxt_string("/"),           nxt_string("") },
-        { nxt_string("/a"),          nxt_string("a") },
-        { nxt_string("///"),         nxt_string("") },
-        { nxt_string("///a"),        nxt_string("a") },
-        { nxt_string("///a/"),       nxt_string("") },
-        { nxt_string("a"),           nxt_string("a") },
-        { nxt_string("a/"),          nxt_string("") },
-        { nxt_string("a//"),         nxt_string("") },
-        { nxt_string("path/name"),   nxt_string("name") },
-        { nxt_string("/path/name"),  nxt_string("name") },
-        { nxt_string("/path/name/"), nxt_string("") },
-    };
+    static const nxt_str_t  script =
+        nxt_string("function f(n) { return n + 1 }"
+                   "var s = 0; for (var i = 0; i < 10; i++) { s = f(s) } s");
 
-    for (i = 0; i < nxt_nitems(tests); i++) {
-        nxt_file_basename(&tests[i].path, &name);
+    static const nxt_str_t  expected =
+        nxt_string("          10           20");
 
-        success = nxt_strstr_eq(&tests[i].expected, &name);
+    if (njs_vm_profile_dump(vm, &out) != NXT_DECLINED) {
+        return NXT_ERROR;
+    }
 
-        if (!success) {
-            nxt_printf("nxt_file_basename_test(\"%V\"):\n"
-                       "expected: \"%V\"\n     got: \"%V\"\n",
-                       &tests[i].path, &tests[i].expected, &name);
-            return NXT_ERROR;
-        }
+    ret = NXT_ERROR;
+    nvm = NULL;
+
+    nxt_memzero(&options, sizeof(njs_vm_opt_t));
+    options.profile = 1;
+
+    pvm = njs_vm_create(&options);
+    if (pvm == NULL) {
+        return NXT_ERROR;
     }
 
-    return NXT_OK;
-}
+    start = script.start;
 
+    if (njs_vm_compile(pvm, &start, start + script.length) != NXT_OK) {
+        goto done;
+    }
 
-static nxt_int_t
-nxt_file_dirname_test(njs_vm_t * vm, nxt_bool_t disassemble,
-    nxt_bool_t verbose)
-{
-    nxt_str_t   name;
-    nxt_bool_t  success;
-    nxt_uint_t  i;
+    nvm = njs_vm_clone(pvm, NULL);
+    if (nvm == NULL) {
+        goto done;
+    }
 
-    static const struct {
-        nxt_str_t   path;
-        nxt_str_t   expected;
-    } tests[] = {
-        { nxt_string(""),               nxt_string(".") },
-        { nxt_string("/"),              nxt_string("/") },
-        { nxt_string("/a"),             nxt_string("/") },
-        { nxt_string("///"),            nxt_string("///") },
-        { nxt_string("///a"),           nxt_string("///") },
-        { nxt_string("///a/"),          nxt_string("///a") },
-        { nxt_string("a"),              nxt_string(".") },
-        { nxt_string("a/"),             nxt_string("a") },
-        { nxt_string("a//"),            nxt_string("a") },
-        { nxt_string("p1/p2/name"),     nxt_string("p1/p2") },
-        { nxt_string("/p1/p2/name"),    nxt_string("/p1/p2") },
-        { nxt_string("/p1/p2///name"),  nxt_string("/p1/p2") },
-        { nxt_string("/p1/p2/name/"),   nxt_string("/p1/p2/name") },
-    };
+    if (njs_vm_start(nvm) != NXT_OK
+        || njs_vm_profile_dump(nvm, &out) != NXT_OK)
+    {
+        goto done;
+    }
 
-    for (i = 0; i < nxt_nitems(tests); i++) {
-        nxt_file_dirname(&tests[i].path, &name);
+    if (verbose) {
+        nxt_printf("%V\n", &out);
+    }
 
-        success = nxt_strstr_eq(&tests[i].expected, &name);
+    /* The function "f" is called 10 times and executes 20 instructions. */
 
-        if (!success) {
-            nxt_printf("nxt_file_dirname_test(\"%V\"):\n"
-                       "expected: \"%V\"\n     got: \"%V\"\n",
-                       &tests[i].path, &tests[i].expected, &name);
-            return NXT_ERROR;
+    for (p = out.start; p + expected.length <= out.start + out.length; p++) {
+        if (memcmp(p, expected.start, expected.length) == 0) {
+            ret = NXT_OK;
+            break;
         }
     }
 
-    return NXT_OK;
+done:
+
+    if (nvm != NULL) {
+        njs_vm_destroy(nvm);
+    }
+
+    njs_vm_destroy(pvm);
+
+    return ret;
 }
 
 
 static nxt_int_t
-njs_api_test(nxt_bool_t disassemble, nxt_bool_t verbose)
+njs_vm_profile_stacks_test(njs_vm_t * vm, nxt_bool_t disassemble,
+    nxt_bool_t verbose)
 {
-    njs_vm_t      *vm;
-    nxt_int_t     ret, rc;
-    nxt_uint_t    i;
+    u_char        *start, *p;
+    njs_vm_t      *pvm, *nvm;
+    nxt_int_t     ret;
+    nxt_str_t     out, dump;
+    nxt_uint_t    n, found;
     njs_vm_opt_t  options;
 
-    static const struct {
-        nxt_int_t  (*test)(njs_vm_t *, nxt_bool_t, nxt_bool_t);
-        nxt_str_t  name;
-    } tests[] = {
-        { njs_vm_object_alloc_test,
-          nxt_string("njs_vm_object_alloc_test") },
-        { nxt_file_basename_test,
-          nxt_string("nxt_file_basename_test") },
-        { nxt_file_dirname_test,
-          nxt_string("nxt_file_dirname_test") },
+    static const nxt_str_t  script =
+        nxt_string("function f(n) { return [n].map(function g(v) {"
+                   "                     return v + 1 })[0] }"
+                   "var s = 0; for (var i = 0; i < 10; i++) { s = f(s) } s");
+
+    static const nxt_str_t  expected[] = {
+        nxt_string("main;f (:1) "),
+        nxt_string("main;f (:1);Array.prototype.map;anonymous (:1) "),
     };
 
-    rc = NXT_ERROR;
+    if (njs_vm_profile_stacks(vm, &out) != NXT_DECLINED) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_ERROR;
+    nvm = NULL;
 
-    vm = NULL;
     nxt_memzero(&options, sizeof(njs_vm_opt_t));
+    options.sample_interval = 1;
 
-    for (i = 0; i < nxt_nitems(tests); i++) {
-        vm = njs_vm_create(&options);
-        if (vm == NULL) {
-            nxt_printf("njs_vm_create() failed\n");
-            goto done;
-        }
+    pvm = njs_vm_create(&options);
+    if (pvm == NULL) {
+        return NXT_ERROR;
+    }
 
-        ret = tests[i].test(vm, disassemble, verbose);
-        if (nxt_slow_path(ret != NXT_OK)) {
-            nxt_printf("njs_api_test: \"%V\" test failed\n", &tests[i].name);
-            goto done;
-        }
+    start = script.start;
 
-        njs_vm_destroy(vm);
-        vm = NULL;
+    if (njs_vm_compile(pvm, &start, start + script.length) != NXT_OK) {
+        goto done;
+    }
+
+    nvm = njs_vm_clone(pvm, NULL);
+    if (nvm == NULL) {
+        goto done;
+    }
+
+    if (njs_vm_start(nvm) != NXT_OK
+        || njs_vm_profile_stacks(nvm, &out) != NXT_OK)
+    {
+        goto done;
+    }
+
+    if (verbose) {
+        nxt_printf("%V\n", &out);
+    }
+
+    /* The instruction counters are not enabled. */
+
+    if (njs_vm_profile_dump(nvm, &dump) != NXT_DECLINED) {
+        goto done;
+    }
+
+    found = 0;
+
+    for (n = 0; n < nxt_nitems(expected); n++) {
+        for (p = out.start; p + expected[n].length <= out.start + out.length;
+             p++)
+        {
+            if (memcmp(p, expected[n].start, expected[n].length) == 0) {
+                found++;
+                break;
+            }
+        }
+    }
+
+    if (found == nxt_nitems(expected)) {
+        ret = NXT_OK;
+    }
+
+done:
+
+    if (nvm != NULL) {
+        njs_vm_destroy(nvm);
+    }
+
+    njs_vm_destroy(pvm);
+
+    return ret;
+}
+
+
+static nxt_int_t
+njs_vm_budget_script(const njs_vm_opt_t *options, const char *script,
+    nxt_int_t expected_ret, const char *expected)
+{
+    u_char        *start;
+    njs_vm_t      *vm, *nvm;
+    nxt_int_t     ret;
+    nxt_str_t     s;
+    njs_vm_opt_t  opt;
+
+    ret = NXT_ERROR;
+    nvm = NULL;
+
+    /* njs_vm_create() sets opt.shared. */
+    opt = *options;
+
+    vm = njs_vm_create(&opt);
+    if (vm == NULL) {
+        return NXT_ERROR;
+    }
+
+    start = (u_char *) script;
+
+    if (njs_vm_compile(vm, &start, start + strlen(script)) != NXT_OK) {
+        goto done;
+    }
+
+    nvm = njs_vm_clone(vm, NULL);
+    if (nvm == NULL) {
+        goto done;
+    }
+
+    if (njs_vm_start(nvm) != expected_ret
+        || njs_vm_retval_to_ext_string(nvm, &s) != NXT_OK)
+    {
+        goto done;
+    }
+
+    if (s.length == strlen(expected)
+        && memcmp(s.start, expected, s.length) == 0)
+    {
+        ret = NXT_OK;
+
+    } else {
+        nxt_printf("njs_vm_budget_test: \"%s\"\n"
+                   "expected: \"%s\"\n     got: \"%V\"\n",
+                   script, expected, &s);
+    }
+
+done:
+
+    if (nvm != NULL) {
+        njs_vm_destroy(nvm);
+    }
+
+    njs_vm_destroy(vm);
+
+    return ret;
+}
+
+
+static nxt_int_t
+njs_vm_budget_test(njs_vm_t * vm, nxt_bool_t disassemble,
+    nxt_bool_t verbose)
+{
+    u_char          *start;
+    njs_vm_t        *pvm, *nvm;
+    nxt_int_t       ret;
+    nxt_str_t       s;
+    nxt_uint_t      n;
+    njs_vm_opt_t    options;
+    njs_function_t  *f;
+
+    static const nxt_str_t  script =
+        nxt_string("function f() {"
+                   "    var s = 0;"
+                   "    for (var i = 0; i < 1000; i++) { s += i }"
+                   "    return s"
+                   "}");
+
+    static const nxt_str_t  fname = nxt_string("f");
+
+    static const nxt_str_t  exceeded =
+        nxt_string("InternalError: execution budget exceeded");
+
+    nxt_memzero(&options, sizeof(njs_vm_opt_t));
+    options.max_steps = 100;
+
+    ret = njs_vm_budget_script(&options, "for (;;) {}", NXT_ERROR,
+                               "InternalError: execution budget exceeded");
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    ret = njs_vm_budget_script(&options, "function f() { return f() } f()",
+                               NXT_ERROR,
+                               "InternalError: execution budget exceeded");
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    ret = njs_vm_budget_script(&options,
+                               "var r; try { for (;;) {} }"
+                               "catch (e) { r = e.message } r",
+                               NXT_OK, "execution budget exceeded");
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    ret = njs_vm_budget_script(&options,
+                               "var s = 0; for (var i = 0; i < 10; i++) {"
+                               "s += i } s",
+                               NXT_OK, "45");
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    options.max_steps = 0;
+    options.max_time = 1;
+
+    ret = njs_vm_budget_script(&options, "while (true) {}", NXT_ERROR,
+                               "InternalError: execution budget exceeded");
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    /* The preempted function is resumed by njs_vm_run(). */
+
+    options.max_steps = 100;
+    options.max_time = 0;
+    options.preempt = 1;
+
+    ret = NXT_ERROR;
+    nvm = NULL;
+
+    pvm = njs_vm_create(&options);
+    if (pvm == NULL) {
+        return NXT_ERROR;
+    }
+
+    start = script.start;
+
+    if (njs_vm_compile(pvm, &start, start + script.length) != NXT_OK) {
+        goto done;
+    }
+
+    nvm = njs_vm_clone(pvm, NULL);
+    if (nvm == NULL || njs_vm_start(nvm) != NXT_OK) {
+        goto done;
+    }
+
+    f = njs_vm_function(nvm, &fname);
+    if (f == NULL || njs_vm_call(nvm, f, NULL, 0) != NJS_AGAIN) {
+        goto done;
+    }
+
+    for (n = 1; njs_vm_posted(nvm); n++) {
+        if (njs_vm_call(nvm, f, NULL, 0) != NJS_ERROR) {
+            goto done;
+        }
+
+        if (njs_vm_run(nvm) == NJS_ERROR) {
+            goto done;
+        }
+    }
+
+    if (verbose) {
+        nxt_printf("njs_vm_budget_test: resumed %ui times\n", n);
+    }
+
+    if (n < 10 || njs_vm_retval_to_ext_string(nvm, &s) != NXT_OK) {
+        goto done;
+    }
+
+    if (s.length != nxt_length("499500")
+        || memcmp(s.start, "499500", s.length) != 0)
+    {
+        goto done;
+    }
+
+    /*
+     * The function called by njs_vm_call_nonpreemptive() fails and
+     * leaves the VM ready for the next call.
+     */
+
+    for (n = 0; n < 2; n++) {
+        if (njs_vm_call_nonpreemptive(nvm, f, NULL, 0) != NJS_ERROR
+            || njs_vm_pending(nvm)
+            || njs_vm_retval_to_ext_string(nvm, &s) != NXT_OK)
+        {
+            goto done;
+        }
+
+        if (s.length != exceeded.length
+            || memcmp(s.start, exceeded.start, s.length) != 0)
+        {
+            goto done;
+        }
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    if (nvm != NULL) {
+        njs_vm_destroy(nvm);
+    }
+
+    njs_vm_destroy(pvm);
+
+    return ret;
+}
+
+
+static nxt_int_t
+njs_vm_image_load_test(njs_vm_t *vm, u_char *start, u_char *end,
+    nxt_int_t expected, const char *retval)
+{
+    njs_vm_t      *ivm, *nvm;
+    nxt_int_t     ret, rc;
+    nxt_str_t     s, expected_retval;
+    njs_vm_opt_t  options;
+
+    rc = NXT_ERROR;
+    nvm = NULL;
+
+    nxt_memzero(&options, sizeof(njs_vm_opt_t));
+
+    ivm = njs_vm_create(&options);
+    if (ivm == NULL) {
+        return NXT_ERROR;
+    }
+
+    ret = njs_vm_compile_from_image(ivm, start, end);
+    if (ret != expected) {
+        nxt_printf("njs_vm_compile_from_image() returned %d\n", (int) ret);
+        goto done;
+    }
+
+    if (ret == NXT_OK) {
+        nvm = njs_vm_clone(ivm, NULL);
+        if (nvm == NULL) {
+            goto done;
+        }
+
+        (void) njs_vm_start(nvm);
+
+        ret = njs_vm_retval_to_ext_string(nvm, &s);
+
+    } else {
+        ret = njs_vm_retval_to_ext_string(ivm, &s);
+    }
+
+    if (ret != NXT_OK) {
+        goto done;
+    }
+
+    expected_retval.start = (u_char *) retval;
+    expected_retval.length = strlen(retval);
+
+    if (!nxt_strstr_eq(&expected_retval, &s)) {
+        nxt_printf("njs_vm_image_test:\nexpected: \"%V\"\n"
+                   "     got: \"%V\"\n", &expected_retval, &s);
+        goto done;
+    }
+
+    rc = NXT_OK;
+
+done:
+
+    if (nvm != NULL) {
+        njs_vm_destroy(nvm);
+    }
+
+    njs_vm_destroy(ivm);
+
+    return rc;
+}
+
+
+static nxt_int_t
+njs_vm_image_test(njs_vm_t * vm, nxt_bool_t disassemble, nxt_bool_t verbose)
+{
+    u_char     *start, *end;
+    nxt_int_t  ret;
+    nxt_str_t  image;
+
+    static const nxt_str_t  script =
+        nxt_string("function f(a) { return function(b) { return a + b } }"
+                   "var re = /(b+)/g;"
+                   "f('a very long string which is not a short one ')"
+                   "(Math.max(1, 2)) + re.exec('abbc')[1]");
+
+    static const char  *invalid = "InternalError: invalid script image";
+
+    start = script.start;
+
+    ret = njs_vm_compile(vm, &start, start + script.length);
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    ret = njs_vm_image(vm, &image);
+    if (ret != NXT_OK) {
+        nxt_printf("njs_vm_image() failed\n");
+        return NXT_ERROR;
+    }
+
+    start = image.start;
+    end = image.start + image.length;
+
+    if (!njs_vm_is_image(start, end) || njs_vm_is_image(start, start + 8)) {
+        return NXT_ERROR;
+    }
+
+    ret = njs_vm_image_load_test(vm, start, end, NXT_OK,
+                      "a very long string which is not a short one 2bb");
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    ret = njs_vm_image_load_test(vm, start, end - 1, NXT_ERROR, invalid);
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    /* The damaged image is detected by the hash. */
+
+    end[-1] ^= 1;
+
+    ret = njs_vm_image_load_test(vm, start, end, NXT_ERROR, invalid);
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    end[-1] ^= 1;
+
+    /* The image version is the second field of the header. */
+
+    start[4] ^= 1;
+
+    ret = njs_vm_image_load_test(vm, start, end, NXT_ERROR,
+                         "InternalError: incompatible script image version");
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    start[4] ^= 1;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+njs_vm_handler_call(njs_vm_t *vm, const char *test, const char *expected)
+{
+    nxt_str_t       s;
+    njs_function_t  *function;
+
+    static const nxt_str_t  handler = nxt_string("handler");
+
+    function = njs_vm_function(vm, &handler);
+    if (function == NULL) {
+        return NXT_ERROR;
+    }
+
+    if (njs_vm_call(vm, function, NULL, 0) != NXT_OK
+        || njs_vm_retval_to_ext_string(vm, &s) != NXT_OK)
+    {
+        return NXT_ERROR;
+    }
+
+    if (s.length != strlen(expected)
+        || memcmp(s.start, expected, s.length) != 0)
+    {
+        nxt_printf("%s:\nexpected: \"%s\"\n     got: \"%V\"\n",
+                   test, expected, &s);
+        return NXT_ERROR;
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+njs_vm_snapshot_test(njs_vm_t * vm, nxt_bool_t disassemble,
+    nxt_bool_t verbose)
+{
+    u_char     *start;
+    njs_vm_t   *nvm;
+    nxt_int_t  ret;
+    nxt_str_t  s;
+
+    static const char       test[] = "njs_vm_snapshot_test";
+    static const nxt_str_t  script =
+        nxt_string("var inits = 0, table = {a:1}, list = [1, 2], re = /(b+)/;"
+                   "function counter() { var n = 0; return function() {"
+                   "                     return ++n } }"
+                   "var next = counter(), proto = Object.create(table);"
+                   "String.prototype.twice = function() {"
+                   "                         return this + this };"
+                   "function handler() {"
+                   "    table.a++; list.push(list.length + 1);"
+                   "    return [inits, proto.a, list.length, next(),"
+                   "            re.exec('abbc')[1], 'x'.twice()] }"
+                   "inits++; 'initialized'");
+
+    start = script.start;
+
+    ret = njs_vm_compile(vm, &start, start + script.length);
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    if (njs_vm_snapshot(vm) != NXT_OK
+        || njs_vm_snapshot(vm) != NJS_DECLINED)
+    {
+        return NXT_ERROR;
+    }
+
+    /* The global code is run once, the clones share no mutable state. */
+
+    nvm = njs_vm_clone(vm, NULL);
+    if (nvm == NULL) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_ERROR;
+
+    if (njs_vm_start(nvm) != NXT_OK
+        || njs_vm_retval_to_ext_string(nvm, &s) != NXT_OK
+        || s.length != nxt_length("initialized"))
+    {
+        goto done;
+    }
+
+    if (njs_vm_handler_call(nvm, test, "1,2,3,1,bb,xx") != NXT_OK
+        || njs_vm_handler_call(nvm, test, "1,3,4,2,bb,xx") != NXT_OK)
+    {
+        goto done;
+    }
+
+    njs_vm_destroy(nvm);
+
+    nvm = njs_vm_clone(vm, NULL);
+    if (nvm == NULL) {
+        return NXT_ERROR;
+    }
+
+    if (njs_vm_start(nvm) != NXT_OK
+        || njs_vm_handler_call(nvm, test, "1,2,3,1,bb,xx") != NXT_OK)
+    {
+        goto done;
+    }
+
+    /* A reset clone restores the snapshot again. */
+
+    if (njs_vm_reset(nvm, NULL) != NXT_OK
+        || njs_vm_start(nvm) != NXT_OK
+        || njs_vm_handler_call(nvm, test, "1,2,3,1,bb,xx") != NXT_OK)
+    {
+        goto done;
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    njs_vm_destroy(nvm);
+
+    return ret;
+}
+
+
+static nxt_int_t
+njs_vm_reset_test(njs_vm_t * vm, nxt_bool_t disassemble,
+    nxt_bool_t verbose)
+{
+    u_char      *start;
+    njs_vm_t    *nvm;
+    nxt_int_t   ret;
+    nxt_uint_t  i;
+
+    static const char       test[] = "njs_vm_reset_test";
+    static const nxt_str_t  script =
+        nxt_string("var list = [], re = /(a+)/;"
+                   "function handler() {"
+                   "    list.push(re.exec('baa')[1]);"
+                   "    Object.prototype.extra = list.length;"
+                   "    try { throw new Error('e') } catch (e) {}"
+                   "    return [list, ({}).extra] }");
+
+    start = script.start;
+
+    ret = njs_vm_compile(vm, &start, start + script.length);
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    if (njs_vm_reset(vm, NULL) != NXT_DECLINED) {
+        return NXT_ERROR;
+    }
+
+    nvm = njs_vm_clone(vm, NULL);
+    if (nvm == NULL) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_ERROR;
+
+    /* A reset clone does not see the modifications made before reset. */
+
+    for (i = 0; i < 100; i++) {
+        if (njs_vm_start(nvm) != NXT_OK
+            || njs_vm_handler_call(nvm, test, "aa,1") != NXT_OK
+            || njs_vm_handler_call(nvm, test, "aa,aa,2") != NXT_OK)
+        {
+            goto done;
+        }
+
+        if (njs_vm_reset(nvm, NULL) != NXT_OK) {
+            goto done;
+        }
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    njs_vm_destroy(nvm);
+
+    return ret;
+}
+
+
+static nxt_int_t
+njs_vm_gc_test(njs_vm_t * vm, nxt_bool_t disassemble, nxt_bool_t verbose)
+{
+    u_char             *start, *p;
+    u_char             expected[64];
+    uint64_t           size;
+    njs_vm_t           *pvm, *nvm;
+    nxt_int_t          ret;
+    nxt_uint_t         i;
+    njs_vm_opt_t       options;
+    njs_vm_gc_stats_t  stats;
+
+    static const char       test[] = "njs_vm_gc_test";
+    static const nxt_str_t  script =
+        nxt_string("var keep = [], n = 0;"
+                   "function handler() {"
+                   "    var garbage = [];"
+                   "    for (var i = 0; i < 100; i++) {"
+                   "        garbage.push({i: i, s: 'garbage string ' + i,"
+                   "                     f: function() { return i }}) }"
+                   "    if (++n % 100 == 0) { keep.push('kept ' + n) }"
+                   "    return [n, keep.length, keep[keep.length - 1]] }");
+
+    if (njs_vm_gc(vm) != NJS_DECLINED
+        || njs_vm_gc_stats(vm, &stats) != NJS_DECLINED)
+    {
+        return NXT_ERROR;
+    }
+
+    nxt_memzero(&options, sizeof(njs_vm_opt_t));
+    options.gc_threshold = 64 * 1024;
+
+    ret = NXT_ERROR;
+    nvm = NULL;
+
+    pvm = njs_vm_create(&options);
+    if (pvm == NULL) {
+        return NXT_ERROR;
+    }
+
+    start = script.start;
+
+    if (njs_vm_compile(pvm, &start, start + script.length) != NXT_OK) {
+        goto done;
+    }
+
+    nvm = njs_vm_clone(pvm, NULL);
+    if (nvm == NULL || njs_vm_start(nvm) != NXT_OK) {
+        goto done;
+    }
+
+    /* The parent VM objects are referred by the clone. */
+
+    if (njs_vm_gc(pvm) != NJS_DECLINED) {
+        goto done;
+    }
+
+    size = 0;
+
+    for (i = 1; i <= 1000; i++) {
+        p = nxt_sprintf(expected, expected + sizeof(expected) - 1,
+                        "%ui,%ui,", i, i / 100);
+
+        if (i >= 100) {
+            p = nxt_sprintf(p, expected + sizeof(expected) - 1,
+                            "kept %ui", i - i % 100);
+        }
+
+        *p = '\0';
+
+        if (njs_vm_handler_call(nvm, test, (char *) expected) != NXT_OK) {
+            goto done;
+        }
+
+        if (njs_vm_gc_stats(nvm, &stats) != NXT_OK) {
+            goto done;
+        }
+
+        if (i == 100) {
+            size = stats.size;
+        }
+
+        /* The memory in use does not grow with the number of calls. */
+
+        if (i > 100 && stats.size > 4 * size + 64 * 1024) {
+            nxt_printf("%s: %uL bytes in use after %ui calls, "
+                       "%uL after 100\n", test, stats.size, i, size);
+            goto done;
+        }
+    }
+
+    if (stats.collections == 0 || stats.freed == 0) {
+        goto done;
+    }
+
+    if (njs_vm_gc(nvm) != NXT_OK
+        || njs_vm_gc_stats(nvm, &stats) != NXT_OK
+        || njs_vm_handler_call(nvm, test, "1001,10,kept 1000") != NXT_OK)
+    {
+        goto done;
+    }
+
+    /* The collector is restarted in a reset clone. */
+
+    if (njs_vm_reset(nvm, NULL) != NXT_OK
+        || njs_vm_start(nvm) != NXT_OK
+        || njs_vm_handler_call(nvm, test, "1,0,") != NXT_OK
+        || njs_vm_gc(nvm) != NXT_OK)
+    {
+        goto done;
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    if (nvm != NULL) {
+        njs_vm_destroy(nvm);
+    }
+
+    njs_vm_destroy(pvm);
+
+    return ret;
+}
+
+
+static nxt_int_t
+njs_vm_memory_limit_test(njs_vm_t * vm, nxt_bool_t disassemble,
+    nxt_bool_t verbose)
+{
+    u_char        *start;
+    njs_vm_t      *pvm, *nvm;
+    nxt_int_t     ret;
+    nxt_str_t     s;
+    nxt_uint_t    i;
+    njs_vm_opt_t  options;
+
+    static const struct {
+        nxt_str_t   script;
+        nxt_int_t   ret;
+        nxt_str_t   expected;
+    } tests[] = {
+        { nxt_string("var s = 'x'; for (;;) { s += s }"),
+          NXT_ERROR, nxt_string("MemoryError") },
+        { nxt_string("var a = []; for (;;) { a.push({a: [1, 2, 3]}) }"),
+          NXT_ERROR, nxt_string("MemoryError") },
+        { nxt_string("var a = [];"
+                     "for (;;) { a.push('a-b'.replace(/-/, '$&')) }"),
+          NXT_ERROR, nxt_string("MemoryError") },
+        { nxt_string("var r; try { 'x'.repeat(1 << 21) }"
+                     "catch (e) { r = e instanceof MemoryError } r"),
+          NXT_OK, nxt_string("true") },
+        { nxt_string("'x'.repeat(1 << 16).length"),
+          NXT_OK, nxt_string("65536") },
+    };
+
+    for (i = 0; i < nxt_nitems(tests); i++) {
+        nxt_memzero(&options, sizeof(njs_vm_opt_t));
+        options.max_memory = 1024 * 1024;
+
+        pvm = njs_vm_create(&options);
+        if (pvm == NULL) {
+            return NXT_ERROR;
+        }
+
+        start = tests[i].script.start;
+
+        ret = njs_vm_compile(pvm, &start, start + tests[i].script.length);
+        if (ret != NXT_OK) {
+            njs_vm_destroy(pvm);
+            return NXT_ERROR;
+        }
+
+        nvm = njs_vm_clone(pvm, NULL);
+        if (nvm == NULL) {
+            njs_vm_destroy(pvm);
+            return NXT_ERROR;
+        }
+
+        ret = njs_vm_start(nvm);
+
+        if (ret != tests[i].ret
+            || njs_vm_retval_to_ext_string(nvm, &s) != NXT_OK
+            || !nxt_strstr_eq(&s, &tests[i].expected))
+        {
+            nxt_printf("njs_vm_memory_limit_test(\"%V\"):\n"
+                       "expected: \"%V\"\n", &tests[i].script,
+                       &tests[i].expected);
+            ret = NXT_ERROR;
+
+        } else {
+            /* The clone limit is set apart and restored by reset. */
+
+            njs_vm_memory_limit(nvm, 0);
+
+            ret = NXT_OK;
+
+            if (njs_vm_reset(nvm, NULL) != NXT_OK
+                || njs_vm_start(nvm) != tests[i].ret)
+            {
+                ret = NXT_ERROR;
+            }
+        }
+
+        njs_vm_destroy(nvm);
+        njs_vm_destroy(pvm);
+
+        if (ret != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+njs_vm_presize_test(njs_vm_t * vm, nxt_bool_t disassemble, nxt_bool_t verbose)
+{
+    u_char                  *start;
+    njs_vm_t                *pvm, *nvm;
+    nxt_int_t               ret;
+    nxt_uint_t              i, clusters;
+    njs_vm_opt_t            options;
+    nxt_mp_stat_t           stat;
+    njs_vm_presize_stats_t  stats;
+
+    static const nxt_str_t  script =
+        nxt_string("function f(n) { return n == 0 ? 0 : 1 + f(n - 1) }"
+                   "var a = [];"
+                   "for (var i = 0; i < 1000; i++) { a.push({i: i}) }"
+                   "f(100)");
+
+    for (i = 0; i < 2; i++) {
+        nxt_memzero(&options, sizeof(njs_vm_opt_t));
+        options.no_presize = (i == 1);
+
+        ret = NXT_ERROR;
+        nvm = NULL;
+
+        pvm = njs_vm_create(&options);
+        if (pvm == NULL) {
+            return NXT_ERROR;
+        }
+
+        start = script.start;
+
+        if (njs_vm_compile(pvm, &start, start + script.length) != NXT_OK) {
+            goto done;
+        }
+
+        /* The first clone runs in the pool of default size. */
+
+        nvm = njs_vm_clone(pvm, NULL);
+        if (nvm == NULL || njs_vm_start(nvm) != NXT_OK) {
+            goto done;
+        }
+
+        njs_vm_destroy(nvm);
+
+        nvm = njs_vm_clone(pvm, NULL);
+        if (nvm == NULL) {
+            goto done;
+        }
+
+        njs_vm_presize_stats(nvm, &stats);
+        njs_vm_memory_stats(nvm, &stat);
+
+        clusters = stat.clusters;
+
+        if (verbose) {
+            nxt_printf("njs_vm_presize_test: %uD samples, pool %uz, "
+                       "stack %uz, %uz clusters\n", stats.samples,
+                       stats.pool_size, stats.stack_size, stat.clusters);
+        }
+
+        if (options.no_presize) {
+            if (stats.samples != 0 || stats.pool_size != 0) {
+                goto done;
+            }
+
+        } else {
+            if (stats.samples != 1
+                || stats.pool_size == 0
+                || stats.stack_size == 0
+                || stat.clusters * 2 * nxt_pagesize() < stats.pool_size)
+            {
+                goto done;
+            }
+
+            /* The presized clone pool does not grow. */
+
+            if (njs_vm_start(nvm) != NXT_OK) {
+                goto done;
+            }
+
+            njs_vm_memory_stats(nvm, &stat);
+
+            if (stat.clusters != clusters) {
+                goto done;
+            }
+
+            /* The reset clone is counted and presized again. */
+
+            if (njs_vm_reset(nvm, NULL) != NXT_OK
+                || njs_vm_start(nvm) != NXT_OK)
+            {
+                goto done;
+            }
+
+            njs_vm_presize_stats(nvm, &stats);
+
+            if (stats.samples != 2) {
+                goto done;
+            }
+        }
+
+        ret = NXT_OK;
+
+    done:
+
+        if (nvm != NULL) {
+            njs_vm_destroy(nvm);
+        }
+
+        njs_vm_destroy(pvm);
+
+        if (ret != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+njs_vm_cache_test(njs_vm_t * vm, nxt_bool_t disassemble, nxt_bool_t verbose)
+{
+    u_char               *start;
+    njs_vm_t             *pvm, *nvm;
+    nxt_int_t            ret;
+    nxt_uint_t           i;
+    njs_vm_opt_t         options;
+    nxt_mp_cache_stat_t  stats;
+
+    static const nxt_str_t  script =
+        nxt_string("var a = [];"
+                   "for (var i = 0; i < 100; i++) { a.push({i: i}) }");
+
+    if (njs_vm_cache_init(64 * 1024, 256 * 1024) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    nxt_memzero(&options, sizeof(njs_vm_opt_t));
+
+    ret = NXT_ERROR;
+
+    pvm = njs_vm_create(&options);
+    if (pvm == NULL) {
+        goto done;
+    }
+
+    start = script.start;
+
+    if (njs_vm_compile(pvm, &start, start + script.length) != NXT_OK) {
+        goto done;
+    }
+
+    for (i = 0; i < 100; i++) {
+        nvm = njs_vm_clone(pvm, NULL);
+        if (nvm == NULL) {
+            goto done;
+        }
+
+        ret = njs_vm_start(nvm);
+
+        njs_vm_destroy(nvm);
+
+        if (ret != NXT_OK) {
+            goto done;
+        }
+    }
+
+    ret = NXT_ERROR;
+
+    njs_vm_cache_stats(&stats);
+
+    if (verbose) {
+        nxt_printf("njs_vm_cache_test: %uz clusters, %uz bytes, "
+                   "%uz hits, %uz misses, %uz returns, %uz frees\n",
+                   stats.clusters, stats.size, stats.hits, stats.misses,
+                   stats.returns, stats.frees);
+    }
+
+    /* The clones take the clusters freed by the previous clones. */
+
+    if (stats.hits < 10 * stats.misses
+        || stats.size > 256 * 1024
+        || stats.size != stats.clusters * 2 * nxt_pagesize())
+    {
+        goto done;
+    }
+
+    /* The zero high watermark frees the cached clusters. */
+
+    if (njs_vm_cache_init(0, 0) != NXT_OK) {
+        goto done;
+    }
+
+    njs_vm_cache_stats(&stats);
+
+    if (stats.size != 0 || stats.clusters != 0 || stats.frees == 0) {
+        goto done;
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    if (pvm != NULL) {
+        njs_vm_destroy(pvm);
+    }
+
+    (void) njs_vm_cache_init(0, 0);
+
+    return ret;
+}
+
+
+/*
+ * The host pool of the allocator test keeps its allocations
+ * to free them when it is destroyed.
+ */
+
+typedef struct {
+    void                    **blocks;
+    nxt_uint_t              items;
+    nxt_uint_t              available;
+    nxt_uint_t              allocations;
+} njs_test_pool_t;
+
+
+static void *
+njs_test_pool_add(njs_test_pool_t *pool, void *p)
+{
+    void        **blocks;
+    nxt_uint_t  n;
+
+    if (p == NULL) {
+        return NULL;
+    }
+
+    if (pool->items == pool->available) {
+        n = (pool->available != 0) ? 2 * pool->available : 64;
+
+        blocks = nxt_malloc(n * sizeof(void *));
+        if (blocks == NULL) {
+            nxt_free(p);
+            return NULL;
+        }
+
+        if (pool->blocks != NULL) {
+            memcpy(blocks, pool->blocks, pool->items * sizeof(void *));
+            nxt_free(pool->blocks);
+        }
+
+        pool->blocks = blocks;
+        pool->available = n;
+    }
+
+    pool->blocks[pool->items++] = p;
+    pool->allocations++;
+
+    return p;
+}
+
+
+static void *
+njs_test_pool_alloc(void *mem, size_t size)
+{
+    return njs_test_pool_add(mem, nxt_malloc(size));
+}
+
+
+static void *
+njs_test_pool_zalloc(void *mem, size_t size)
+{
+    void  *p;
+
+    p = nxt_malloc(size);
+
+    if (p != NULL) {
+        nxt_memzero(p, size);
+    }
+
+    return njs_test_pool_add(mem, p);
+}
+
+
+static void *
+njs_test_pool_align(void *mem, size_t alignment, size_t size)
+{
+    return njs_test_pool_add(mem, nxt_memalign(alignment, size));
+}
+
+
+static void
+njs_test_pool_free(void *mem, void *p)
+{
+    nxt_uint_t       i;
+    njs_test_pool_t  *pool;
+
+    pool = mem;
+
+    for (i = 0; i < pool->items; i++) {
+        if (pool->blocks[i] == p) {
+            pool->blocks[i] = pool->blocks[--pool->items];
+            nxt_free(p);
+            return;
+        }
+    }
+
+    nxt_printf("njs_test_pool_free: %p is not in the pool\n", p);
+}
+
+
+static void
+njs_test_pool_destroy(njs_test_pool_t *pool)
+{
+    while (pool->items != 0) {
+        nxt_free(pool->blocks[--pool->items]);
+    }
+
+    nxt_free(pool->blocks);
+    pool->blocks = NULL;
+    pool->available = 0;
+}
+
+
+static const nxt_mem_proto_t  njs_test_pool_proto = {
+    njs_test_pool_alloc,
+    njs_test_pool_zalloc,
+    njs_test_pool_align,
+    NULL,
+    njs_test_pool_free,
+    NULL,
+    NULL,
+};
+
+
+static nxt_int_t
+njs_vm_clone_mem_test(njs_vm_t * vm, nxt_bool_t disassemble,
+    nxt_bool_t verbose)
+{
+    u_char           *start;
+    njs_vm_t         *pvm, *nvm;
+    nxt_int_t        ret;
+    nxt_uint_t       items;
+    njs_vm_opt_t     options;
+    njs_test_pool_t  vm_pool, clone_pool;
+
+    static const nxt_str_t  script =
+        nxt_string("var a = [];"
+                   "for (var i = 0; i < 1000; i++) { a.push({i: i}) }");
+
+    nxt_memzero(&vm_pool, sizeof(njs_test_pool_t));
+    nxt_memzero(&clone_pool, sizeof(njs_test_pool_t));
+
+    nxt_memzero(&options, sizeof(njs_vm_opt_t));
+
+    options.mem_proto = &njs_test_pool_proto;
+    options.mem = &vm_pool;
+    options.no_presize = 1;
+
+    ret = NXT_ERROR;
+
+    pvm = njs_vm_create(&options);
+    if (pvm == NULL) {
+        goto done;
+    }
+
+    start = script.start;
+
+    if (njs_vm_compile(pvm, &start, start + script.length) != NXT_OK) {
+        goto done;
+    }
+
+    items = vm_pool.items;
+
+    if (items == 0) {
+        goto done;
+    }
+
+    /* The clone memory is allocated from the clone pool. */
+
+    nvm = njs_vm_clone_mem(pvm, NULL, &clone_pool);
+    if (nvm == NULL) {
+        goto done;
+    }
+
+    if (njs_vm_start(nvm) != NXT_OK) {
+        njs_vm_release(nvm);
+        goto done;
+    }
+
+    njs_vm_release(nvm);
+
+    if (verbose) {
+        nxt_printf("njs_vm_clone_mem_test: %ui VM blocks, "
+                   "%ui clone blocks, %ui clone allocations\n",
+                   vm_pool.items, clone_pool.items, clone_pool.allocations);
+    }
+
+    /* The released clone memory is freed with the clone pool. */
+
+    if (clone_pool.items == 0 || vm_pool.items != items) {
+        goto done;
+    }
+
+    njs_test_pool_destroy(&clone_pool);
+
+    /* The clone memory is freed by njs_vm_destroy(). */
+
+    items = vm_pool.items;
+
+    nvm = njs_vm_clone(pvm, NULL);
+    if (nvm == NULL) {
+        goto done;
+    }
+
+    ret = njs_vm_start(nvm);
+
+    njs_vm_destroy(nvm);
+
+    if (ret != NXT_OK) {
+        goto done;
+    }
+
+    ret = NXT_ERROR;
+
+    if (vm_pool.items != items) {
+        goto done;
+    }
+
+    njs_vm_destroy(pvm);
+    pvm = NULL;
+
+    if (vm_pool.items != 0) {
+        goto done;
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    if (pvm != NULL) {
+        njs_vm_destroy(pvm);
+    }
+
+    njs_test_pool_destroy(&clone_pool);
+    njs_test_pool_destroy(&vm_pool);
+
+    return ret;
+}
+
+
+static nxt_int_t
+nxt_file_basename_test(njs_vm_t * vm, nxt_bool_t disassemble,
+    nxt_bool_t verbose)
+{
+    nxt_str_t   name;
+    nxt_bool_t  success;
+    nxt_uint_t  i;
+
+    static const struct {
+        nxt_str_t   path;
+        nxt_str_t   expected;
+    } tests[] = {
+        { nxt_string(""),            nxt_string("") },
+        { nxt_string("/"),           nxt_string("") },
+        { nxt_string("/a"),          nxt_string("a") },
+        { nxt_string("///"),         nxt_string("") },
+        { nxt_string("///a"),        nxt_string("a") },
+        { nxt_string("///a/"),       nxt_string("") },
+        { nxt_string("a"),           nxt_string("a") },
+        { nxt_string("a/"),          nxt_string("") },
+        { nxt_string("a//"),         nxt_string("") },
+        { nxt_string("path/name"),   nxt_string("name") },
+        { nxt_string("/path/name"),  nxt_string("name") },
+        { nxt_string("/path/name/"), nxt_string("") },
+    };
+
+    for (i = 0; i < nxt_nitems(tests); i++) {
+        nxt_file_basename(&tests[i].path, &name);
+
+        success = nxt_strstr_eq(&tests[i].expected, &name);
+
+        if (!success) {
+            nxt_printf("nxt_file_basename_test(\"%V\"):\n"
+                       "expected: \"%V\"\n     got: \"%V\"\n",
+                       &tests[i].path, &tests[i].expected, &name);
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_file_dirname_test(njs_vm_t * vm, nxt_bool_t disassemble,
+    nxt_bool_t verbose)
+{
+    nxt_str_t   name;
+    nxt_bool_t  success;
+    nxt_uint_t  i;
+
+    static const struct {
+        nxt_str_t   path;
+        nxt_str_t   expected;
+    } tests[] = {
+        { nxt_string(""),               nxt_string(".") },
+        { nxt_string("/"),              nxt_string("/") },
+        { nxt_string("/a"),             nxt_string("/") },
+        { nxt_string("///"),            nxt_string("///") },
+        { nxt_string("///a"),           nxt_string("///") },
+        { nxt_string("///a/"),          nxt_string("///a") },
+        { nxt_string("a"),              nxt_string(".") },
+        { nxt_string("a/"),             nxt_string("a") },
+        { nxt_string("a//"),            nxt_string("a") },
+        { nxt_string("p1/p2/name"),     nxt_string("p1/p2") },
+        { nxt_string("/p1/p2/name"),    nxt_string("/p1/p2") },
+        { nxt_string("/p1/p2///name"),  nxt_string("/p1/p2") },
+        { nxt_string("/p1/p2/name/"),   nxt_string("/p1/p2/name") },
+    };
+
+    for (i = 0; i < nxt_nitems(tests); i++) {
+        nxt_file_dirname(&tests[i].path, &name);
+
+        success = nxt_strstr_eq(&tests[i].expected, &name);
+
+        if (!success) {
+            nxt_printf("nxt_file_dirname_test(\"%V\"):\n"
+                       "expected: \"%V\"\n     got: \"%V\"\n",
+                       &tests[i].path, &tests[i].expected, &name);
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+njs_api_test(nxt_bool_t disassemble, nxt_bool_t verbose)
+{
+    njs_vm_t      *vm;
+    nxt_int_t     ret, rc;
+    nxt_uint_t    i;
+    njs_vm_opt_t  options;
+
+    static const struct {
+        nxt_int_t  (*test)(njs_vm_t *, nxt_bool_t, nxt_bool_t);
+        nxt_str_t  name;
+    } tests[] = {
+        { njs_vm_object_alloc_test,
+          nxt_string("njs_vm_object_alloc_test") },
+        { njs_vm_profile_test,
+          nxt_string("njs_vm_profile_test") },
+        { njs_vm_profile_stacks_test,
+          nxt_string("njs_vm_profile_stacks_test") },
+        { njs_vm_budget_test,
+          nxt_string("njs_vm_budget_test") },
+        { njs_vm_image_test,
+          nxt_string("njs_vm_image_test") },
+        { njs_vm_snapshot_test,
+          nxt_string("njs_vm_snapshot_test") },
+        { njs_vm_reset_test,
+          nxt_string("njs_vm_reset_test") },
+        { njs_vm_gc_test,
+          nxt_string("njs_vm_gc_test") },
+        { njs_vm_memory_limit_test,
+          nxt_string("njs_vm_memory_limit_test") },
+        { njs_vm_cache_test,
+          nxt_string("njs_vm_cache_test") },
+        { njs_vm_presize_test,
+          nxt_string("njs_vm_presize_test") },
+        { njs_vm_clone_mem_test,
+          nxt_string("njs_vm_clone_mem_test") },
+        { nxt_file_basename_test,
+          nxt_string("nxt_file_basename_test") },
+        { nxt_file_dirname_test,
+          nxt_string("nxt_file_dirname_test") },
+    };
+
+    rc = NXT_ERROR;
+
+    vm = NULL;
+
+    for (i = 0; i < nxt_nitems(tests); i++) {
+        nxt_memzero(&options, sizeof(njs_vm_opt_t));
+
+        vm = njs_vm_create(&options);
+        if (vm == NULL) {
+            nxt_printf("njs_vm_create() failed\n");
+            goto done;
+        }
+
+        ret = tests[i].test(vm, disassemble, verbose);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            nxt_printf("njs_api_test: \"%V\" test failed\n", &tests[i].name);
+            goto done;
+        }
+
+        njs_vm_destroy(vm);
+        vm = NULL;
     }
 
     rc = NXT_OK;
@@ -12795,10 +14575,14 @@ main(int argc, char **argv)
     time_t      clock;
     struct tm   tm;
     nxt_int_t   ret;
-    nxt_bool_t  disassemble, verbose;
+    nxt_bool_t  disassemble, verbose, jit, image, snapshot, gc;
 
     disassemble = 0;
     verbose = 0;
+    jit = 0;
+    image = 0;
+    snapshot = 0;
+    gc = 0;
 
     if (argc > 1) {
         switch (argv[1][0]) {
@@ -12811,6 +14595,22 @@ main(int argc, char **argv)
             verbose = 1;
             break;
 
+        case 'j':
+            jit = 1;
+            break;
+
+        case 'i':
+            image = 1;
+            break;
+
+        case 's':
+            snapshot = 1;
+            break;
+
+        case 'g':
+            gc = 1;
+            break;
+
         default:
             break;
         }
@@ -12819,7 +14619,8 @@ main(int argc, char **argv)
     (void) putenv((char *) "TZ=UTC");
     tzset();
 
-    ret = njs_unit_test(njs_test, nxt_nitems(njs_test), disassemble, verbose);
+    ret = njs_unit_test(njs_test, nxt_nitems(njs_test), disassemble, verbose,
+                        jit, image, snapshot, gc);
     if (ret != NXT_OK) {
         return ret;
     }
@@ -12840,7 +14641,7 @@ main(int argc, char **argv)
 
     if (memcmp(buf, "+1245", size) == 0) {
         ret = njs_unit_test(njs_tz_test, nxt_nitems(njs_tz_test), disassemble,
-                            verbose);
+                            verbose, jit, image, snapshot, gc);
         if (ret != NXT_OK) {
             return ret;
         }
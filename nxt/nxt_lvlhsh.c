@@ -171,6 +171,8 @@ static nxt_int_t nxt_lvlhsh_bucket_delete(nxt_lvlhsh_query_t *lhq, void **bkt);
 static void *nxt_lvlhsh_level_each(nxt_lvlhsh_each_t *lhe, void **level,
     nxt_uint_t nlvl, nxt_uint_t shift);
 static void *nxt_lvlhsh_bucket_each(nxt_lvlhsh_each_t *lhe);
+static void nxt_lvlhsh_level_destroy(void **slot,
+    const nxt_lvlhsh_proto_t *proto, void *pool, nxt_uint_t nlvl);
 
 
 nxt_int_t
@@ -857,3 +859,51 @@ nxt_lvlhsh_bucket_each(nxt_lvlhsh_each_t *lhe)
 
     return value;
 }
+
+
+void
+nxt_lvlhsh_destroy(nxt_lvlhsh_t *lh, const nxt_lvlhsh_proto_t *proto,
+    void *pool)
+{
+    if (lh->slot != NULL) {
+        nxt_lvlhsh_level_destroy(lh->slot, proto, pool, 0);
+        lh->slot = NULL;
+    }
+}
+
+
+static void
+nxt_lvlhsh_level_destroy(void **slot, const nxt_lvlhsh_proto_t *proto,
+    void *pool, nxt_uint_t nlvl)
+{
+    void        **level;
+    uint32_t    *bucket;
+    uintptr_t   mask;
+    nxt_uint_t  i, size;
+
+    if (nxt_lvlhsh_is_bucket(slot)) {
+
+        do {
+            bucket = nxt_lvlhsh_bucket(proto, slot);
+            slot = *nxt_lvlhsh_next_bucket(proto, bucket);
+
+            proto->free(pool, bucket, nxt_lvlhsh_bucket_size(proto));
+
+        } while (slot != NULL);
+
+        return;
+    }
+
+    size = nxt_lvlhsh_level_size(proto, nlvl);
+    mask = size - 1;
+
+    level = nxt_lvlhsh_level(slot, mask);
+
+    for (i = 0; i < size; i++) {
+        if (level[i] != NULL) {
+            nxt_lvlhsh_level_destroy(level[i], proto, pool, nlvl + 1);
+        }
+    }
+
+    proto->free(pool, level, size * sizeof(void *));
+}
@@ -183,5 +183,12 @@ typedef struct {
 NXT_EXPORT void *nxt_lvlhsh_each(const nxt_lvlhsh_t *lh,
     nxt_lvlhsh_each_t *lhe);
 
+/*
+ * nxt_lvlhsh_destroy() frees the levels and buckets of lvlhsh and leaves
+ * it empty.  The elements are not freed.
+ */
+NXT_EXPORT void nxt_lvlhsh_destroy(nxt_lvlhsh_t *lh,
+    const nxt_lvlhsh_proto_t *proto, void *pool);
+
 
 #endif /* _NXT_LVLHSH_H_INCLUDED_ */
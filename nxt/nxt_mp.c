@@ -11,7 +11,6 @@
 #include <nxt_stub.h>
 #include <nxt_string.h>
 #include <nxt_queue.h>
-#include <nxt_rbtree.h>
 #include <nxt_mp.h>
 #include <string.h>
 #include <stdint.h>
@@ -24,10 +23,20 @@
  * can be divided on chunks of equal size.  Chunk size must be a power of 2.
  * A cluster can contains pages with different chunk sizes.  Cluster size
  * must be a multiple of page size and may be not a power of 2.  Allocations
- * greater than page are allocated outside clusters.  Start addresses and
- * sizes of the clusters and large allocations are stored in rbtree blocks
- * to find them on free operations.  The rbtree nodes are sorted by start
- * addresses.
+ * greater than page are allocated outside clusters.  The clusters are
+ * aligned to the power of 2 not less than cluster size, so the cluster of
+ * a freed pointer is found by masking the pointer.  The cluster blocks are
+ * stored in a hash of the aligned start addresses and the large allocation
+ * blocks are stored in a hash of the allocation addresses, both hashes use
+ * open addressing, so free operations do not walk trees and lists.
+ * The total size of the clusters and large allocations may be limited,
+ * the allocations exceeding the limit fail.
+ *
+ * Pools having the same memory prototype, cluster and page sizes may
+ * share a cache of free clusters.  The clusters freed by the pools are
+ * returned to the cache and the new clusters are taken from the cache.
+ * If the size of the cache exceeds its high watermark, the cache frees
+ * the clusters down to its low watermark.  The cache is not thread-safe.
  */
 
 
@@ -55,8 +64,11 @@ typedef struct {
 
     uint8_t                     _unused;
 
-    /* Chunk bitmap.  There can be no more than 32 chunks in a page. */
-    uint8_t                     map[4];
+    /*
+     * Chunk bitmap, the most significant bit is the first chunk.
+     * There can be no more than 32 chunks in a page.
+     */
+    uint32_t                    map;
 } nxt_mp_page_t;
 
 
@@ -77,9 +89,11 @@ typedef enum {
 
 
 typedef struct {
-    NXT_RBTREE_NODE             (node);
     nxt_mp_block_type_t         type:8;
 
+    /* Number of used pages of a cluster. */
+    uint16_t                    used;
+
     /* Block size must be less than 4G. */
     uint32_t                    size;
 
@@ -103,32 +117,80 @@ typedef struct {
 } nxt_mp_slot_t;
 
 
+typedef struct {
+    /* Open addressing hash of nxt_mp_block_t, keyed by block start. */
+    nxt_mp_block_t              **blocks;
+
+    /* Hash size is a power of 2, zero means that hash is not allocated. */
+    uint32_t                    size;
+    uint32_t                    items;
+
+    /* Start addresses are shifted to get hash index. */
+    uint8_t                     shift;
+} nxt_mp_hash_t;
+
+
+struct nxt_mp_cache_s {
+    /* List of free clusters linked through the cluster memory. */
+    nxt_mp_block_t              *free;
+
+    const nxt_mem_proto_t       *proto;
+    void                        *mem;
+
+    uint32_t                    cluster_size;
+    uint32_t                    page_size;
+
+    size_t                      low;
+    size_t                      high;
+
+    nxt_mp_cache_stat_t         stat;
+};
+
+
 struct nxt_mp_s {
-    /* rbtree of nxt_mp_block_t. */
-    nxt_rbtree_t                blocks;
+    nxt_mp_hash_t               clusters;
+    nxt_mp_hash_t               large;
 
     nxt_queue_t                 free_pages;
 
     uint8_t                     chunk_size_shift;
     uint8_t                     page_size_shift;
+
+    /* Clusters are aligned to 1 << cluster_shift. */
+    uint8_t                     cluster_shift;
     uint32_t                    page_size;
     uint32_t                    page_alignment;
     uint32_t                    cluster_size;
 
+    /* The size of clusters and large allocations, its maximum and limit. */
+    size_t                      size;
+    size_t                      peak;
+    size_t                      limit;
+
+    /* The number of pages in use and its maximum. */
+    uint32_t                    pages;
+    uint32_t                    pages_peak;
+
     const nxt_mem_proto_t       *proto;
     void                        *mem;
     void                        *trace;
 
+    nxt_mp_cache_t              *cache;
+
     nxt_mp_slot_t               slots[];
 };
 
 
+#define nxt_mp_chunk_bit(chunk)                                               \
+    (0x80000000 >> (chunk))
+
+
 #define nxt_mp_chunk_is_free(map, chunk)                                      \
-    ((map[chunk / 8] & (0x80 >> (chunk & 7))) == 0)
+    (((map) & nxt_mp_chunk_bit(chunk)) == 0)
 
 
 #define nxt_mp_chunk_set_free(map, chunk)                                     \
-    map[chunk / 8] &= ~(0x80 >> (chunk & 7))
+    (map) &= ~nxt_mp_chunk_bit(chunk)
 
 
 #define nxt_mp_free_junk(p, size)                                             \
@@ -139,18 +201,27 @@ struct nxt_mp_s {
     ((((value) - 1) & (value)) == 0)
 
 
+#define nxt_mp_limit_exceeded(mp, n)                                          \
+    ((mp)->limit != 0 && (mp)->size + (n) > (mp)->limit)
+
+
 static nxt_uint_t nxt_mp_shift(nxt_uint_t n);
 #if !(NXT_DEBUG_MEMORY)
 static void *nxt_mp_alloc_small(nxt_mp_t *mp, size_t size);
-static nxt_uint_t nxt_mp_alloc_chunk(u_char *map, nxt_uint_t size);
+static nxt_uint_t nxt_mp_alloc_chunk(uint32_t *map, nxt_uint_t size);
 static nxt_mp_page_t *nxt_mp_alloc_page(nxt_mp_t *mp);
 static nxt_mp_block_t *nxt_mp_alloc_cluster(nxt_mp_t *mp);
+static nxt_mp_block_t *nxt_mp_cache_get(nxt_mp_cache_t *cache);
 #endif
 static void *nxt_mp_alloc_large(nxt_mp_t *mp, size_t alignment, size_t size);
-static intptr_t nxt_mp_rbtree_compare(nxt_rbtree_node_t *node1,
-    nxt_rbtree_node_t *node2);
-static nxt_mp_block_t *nxt_mp_find_block(nxt_rbtree_t *tree,
-    u_char *p);
+static void nxt_mp_free_cluster(nxt_mp_t *mp, nxt_mp_block_t *cluster);
+static void nxt_mp_free_block(nxt_mp_t *mp, nxt_mp_block_t *block);
+static void nxt_mp_cache_trim(nxt_mp_cache_t *cache, size_t size);
+static nxt_int_t nxt_mp_hash_insert(nxt_mp_t *mp, nxt_mp_hash_t *hash,
+    nxt_mp_block_t *block);
+static void nxt_mp_hash_add(nxt_mp_hash_t *hash, nxt_mp_block_t *block);
+static nxt_mp_block_t **nxt_mp_hash_find(nxt_mp_hash_t *hash, u_char *start);
+static void nxt_mp_hash_delete(nxt_mp_hash_t *hash, nxt_mp_block_t **slot);
 static const char *nxt_mp_chunk_free(nxt_mp_t *mp, nxt_mp_block_t *cluster,
     u_char *p);
 
@@ -230,8 +301,14 @@ nxt_mp_fast_create(const nxt_mem_proto_t *proto, void *mem,
 
         mp->chunk_size_shift = nxt_mp_shift(min_chunk_size);
         mp->page_size_shift = nxt_mp_shift(page_size);
+        mp->cluster_shift = nxt_mp_shift(cluster_size);
+
+        if (((size_t) 1 << mp->cluster_shift) < cluster_size) {
+            mp->cluster_shift++;
+        }
 
-        nxt_rbtree_init(&mp->blocks, nxt_mp_rbtree_compare);
+        mp->clusters.shift = mp->cluster_shift;
+        mp->large.shift = mp->page_size_shift;
 
         nxt_queue_init(&mp->free_pages);
     }
@@ -257,41 +334,297 @@ nxt_mp_shift(nxt_uint_t n)
 }
 
 
+/* The index of the slot with the least chunk size not less than size. */
+
+nxt_inline nxt_uint_t
+nxt_mp_slot_index(nxt_mp_t *mp, size_t size)
+{
+    uint32_t  n;
+
+    n = (nxt_max(size, 1) - 1) >> mp->chunk_size_shift;
+
+    return 32 - nxt_leading_zeros(n);
+}
+
+
 nxt_bool_t
 nxt_mp_is_empty(nxt_mp_t *mp)
 {
-    return (nxt_rbtree_is_empty(&mp->blocks)
+    return (mp->clusters.items == 0
+            && mp->large.items == 0
             && nxt_queue_is_empty(&mp->free_pages));
 }
 
 
+size_t
+nxt_mp_size(nxt_mp_t *mp)
+{
+    return mp->size;
+}
+
+
+/*
+ * nxt_mp_limit() limits the total size of the pool clusters and large
+ * allocations, 0 removes the limit.  The memory already allocated is not
+ * affected even if it exceeds the limit.
+ */
+
+void
+nxt_mp_limit(nxt_mp_t *mp, size_t limit)
+{
+    mp->limit = limit;
+}
+
+
+/*
+ * nxt_mp_stat() walks the pool blocks, so it is intended for diagnostics
+ * rather than for frequent calls.
+ */
+
 void
-nxt_mp_destroy(nxt_mp_t *mp)
+nxt_mp_stat(nxt_mp_t *mp, nxt_mp_stat_t *stat)
 {
-    void               *p;
-    nxt_mp_block_t     *block;
-    nxt_rbtree_node_t  *node, *next;
+    nxt_uint_t      i, n, size, chunks;
+    nxt_mp_page_t   *page;
+    nxt_mp_slot_t   *slot;
+    nxt_mp_block_t  *block;
 
-    next = nxt_rbtree_root(&mp->blocks);
+    nxt_memzero(stat, sizeof(nxt_mp_stat_t));
 
-    while (next != nxt_rbtree_sentinel(&mp->blocks)) {
+    stat->size = mp->size;
+    stat->peak = mp->peak;
 
-        node = nxt_rbtree_destroy_next(&mp->blocks, &next);
-        block = (nxt_mp_block_t *) node;
+    slot = mp->slots;
 
-        p = block->start;
+    for (i = 0; i < NXT_MP_CHUNK_SIZES && slot[i].size < mp->page_size; i++) {
+        stat->chunk_size[i] = slot[i].size;
+    }
 
-        if (block->type != NXT_MP_EMBEDDED_BLOCK) {
-            mp->proto->free(mp->mem, block);
+    for (i = 0; i < mp->large.size; i++) {
+        block = mp->large.blocks[i];
+
+        if (block != NULL) {
+            stat->large++;
+            stat->large_size += block->size;
+            stat->used += block->size;
+        }
+    }
+
+    for (i = 0; i < mp->clusters.size; i++) {
+        block = mp->clusters.blocks[i];
+
+        if (block == NULL) {
+            continue;
+        }
+
+        stat->clusters++;
+
+        n = mp->cluster_size >> mp->page_size_shift;
+
+        for (page = block->pages; n != 0; page++, n--) {
+
+            if (page->size == 0) {
+                stat->free_pages++;
+                continue;
+            }
+
+            stat->pages++;
+
+            size = page->size << mp->chunk_size_shift;
+
+            if (size == mp->page_size) {
+                stat->used += size;
+                continue;
+            }
+
+            slot = &mp->slots[nxt_mp_slot_index(mp, size)];
+
+            /* page->chunks is the number of free chunks. */
+            chunks = slot->chunks + 1 - page->chunks;
+
+            if (slot < &mp->slots[NXT_MP_CHUNK_SIZES]) {
+                stat->chunks[slot - mp->slots] += chunks;
+            }
+
+            stat->used += chunks * size;
+        }
+    }
+}
+
+
+/*
+ * nxt_mp_use_cache() makes the pool take and return its clusters through
+ * the cache.  The cache must have the same memory prototype, cluster and
+ * page sizes as the pool.
+ */
+
+nxt_int_t
+nxt_mp_use_cache(nxt_mp_t *mp, nxt_mp_cache_t *cache)
+{
+    if (cache->proto != mp->proto
+        || cache->mem != mp->mem
+        || cache->cluster_size != mp->cluster_size
+        || cache->page_size != mp->page_size)
+    {
+        return NXT_DECLINED;
+    }
+
+    mp->cache = cache;
+
+    return NXT_OK;
+}
+
+
+void
+nxt_mp_destroy(nxt_mp_t *mp)
+{
+    nxt_uint_t      i;
+    nxt_mp_block_t  *block;
+
+    for (i = 0; i < mp->clusters.size; i++) {
+        block = mp->clusters.blocks[i];
+
+        if (block != NULL) {
+            nxt_mp_free_cluster(mp, block);
         }
+    }
+
+    for (i = 0; i < mp->large.size; i++) {
+        block = mp->large.blocks[i];
+
+        if (block != NULL) {
+            nxt_mp_free_block(mp, block);
+        }
+    }
 
-        mp->proto->free(mp->mem, p);
+    if (mp->clusters.blocks != NULL) {
+        mp->proto->free(mp->mem, mp->clusters.blocks);
+    }
+
+    if (mp->large.blocks != NULL) {
+        mp->proto->free(mp->mem, mp->large.blocks);
     }
 
     mp->proto->free(mp->mem, mp);
 }
 
 
+/*
+ * nxt_mp_reset() frees all pool allocations except the "keep" large
+ * allocation, if it is not NULL.  The clusters are not freed but all
+ * their pages become free, so the pool memory can be reused without
+ * new system allocations.
+ */
+
+void
+nxt_mp_reset(nxt_mp_t *mp, void *keep)
+{
+    nxt_uint_t      i, n;
+    nxt_mp_slot_t   *slot;
+    nxt_mp_block_t  *block, *kept;
+
+    nxt_queue_init(&mp->free_pages);
+
+    mp->size = 0;
+
+    slot = mp->slots;
+
+    for ( ;; ) {
+        nxt_queue_init(&slot->pages);
+
+        if (slot->size == mp->page_size / 2) {
+            break;
+        }
+
+        slot++;
+    }
+
+    for (i = 0; i < mp->clusters.size; i++) {
+        block = mp->clusters.blocks[i];
+
+        if (block == NULL) {
+            continue;
+        }
+
+        n = mp->cluster_size >> mp->page_size_shift;
+
+        do {
+            n--;
+            block->pages[n].size = 0;
+            nxt_queue_insert_head(&mp->free_pages, &block->pages[n].link);
+        } while (n != 0);
+
+        block->used = 0;
+
+        mp->size += block->size;
+    }
+
+    kept = NULL;
+
+    for (i = 0; i < mp->large.size; i++) {
+        block = mp->large.blocks[i];
+
+        if (block == NULL) {
+            continue;
+        }
+
+        mp->large.blocks[i] = NULL;
+
+        if (block->start == keep) {
+            kept = block;
+            mp->size += block->size;
+
+        } else {
+            nxt_mp_free_block(mp, block);
+        }
+    }
+
+    mp->large.items = 0;
+
+    if (kept != NULL) {
+        nxt_mp_hash_add(&mp->large, kept);
+    }
+
+    mp->peak = mp->size;
+    mp->pages = 0;
+    mp->pages_peak = 0;
+}
+
+
+/*
+ * nxt_mp_pages_peak() returns the maximum size of the pages in use since
+ * the pool creation or reset, that is the cluster memory the pool needed.
+ */
+
+size_t
+nxt_mp_pages_peak(nxt_mp_t *mp)
+{
+    return (size_t) mp->pages_peak << mp->page_size_shift;
+}
+
+
+/*
+ * nxt_mp_reserve() allocates clusters in advance until the size of
+ * the pool clusters is not less than the size.
+ */
+
+nxt_int_t
+nxt_mp_reserve(nxt_mp_t *mp, size_t size)
+{
+#if !(NXT_DEBUG_MEMORY)
+
+    while ((size_t) mp->clusters.items * mp->cluster_size < size) {
+        if (nxt_slow_path(nxt_mp_alloc_cluster(mp) == NULL)) {
+            return NXT_ERROR;
+        }
+    }
+
+#endif
+
+    return NXT_OK;
+}
+
+
 void *
 nxt_mp_alloc(nxt_mp_t *mp, size_t size)
 {
@@ -374,14 +707,21 @@ nxt_mp_zalign(nxt_mp_t *mp, size_t alignment, size_t size)
 
 #if !(NXT_DEBUG_MEMORY)
 
+nxt_inline nxt_mp_block_t *
+nxt_mp_page_cluster(nxt_mp_page_t *page)
+{
+    return (nxt_mp_block_t *)
+               ((u_char *) page - page->number * sizeof(nxt_mp_page_t)
+                - offsetof(nxt_mp_block_t, pages));
+}
+
+
 nxt_inline u_char *
 nxt_mp_page_addr(nxt_mp_t *mp, nxt_mp_page_t *page)
 {
     nxt_mp_block_t  *block;
 
-    block = (nxt_mp_block_t *)
-                ((u_char *) page - page->number * sizeof(nxt_mp_page_t)
-                 - offsetof(nxt_mp_block_t, pages));
+    block = nxt_mp_page_cluster(page);
 
     return block->start + (page->number << mp->page_size_shift);
 }
@@ -400,7 +740,7 @@ nxt_mp_alloc_small(nxt_mp_t *mp, size_t size)
     if (size <= mp->page_size / 2) {
 
         /* Find a slot with appropriate chunk size. */
-        for (slot = mp->slots; slot->size < size; slot++) { /* void */ }
+        slot = &mp->slots[nxt_mp_slot_index(mp, size)];
 
         size = slot->size;
 
@@ -410,7 +750,7 @@ nxt_mp_alloc_small(nxt_mp_t *mp, size_t size)
             page = nxt_queue_link_data(link, nxt_mp_page_t, link);
 
             p = nxt_mp_page_addr(mp, page);
-            p += nxt_mp_alloc_chunk(page->map, size);
+            p += nxt_mp_alloc_chunk(&page->map, size);
 
             page->chunks--;
 
@@ -430,10 +770,7 @@ nxt_mp_alloc_small(nxt_mp_t *mp, size_t size)
                 nxt_queue_insert_head(&slot->pages, &page->link);
 
                 /* Mark the first chunk as busy. */
-                page->map[0] = 0x80;
-                page->map[1] = 0;
-                page->map[2] = 0;
-                page->map[3] = 0;
+                page->map = nxt_mp_chunk_bit(0);
 
                 /* slot->chunks are already one less. */
                 page->chunks = slot->chunks;
@@ -466,40 +803,17 @@ nxt_mp_alloc_small(nxt_mp_t *mp, size_t size)
 
 
 static nxt_uint_t
-nxt_mp_alloc_chunk(uint8_t *map, nxt_uint_t size)
+nxt_mp_alloc_chunk(uint32_t *map, nxt_uint_t size)
 {
-    uint8_t     mask;
-    nxt_uint_t  n, offset;
-
-    offset = 0;
-    n = 0;
+    nxt_uint_t  chunk;
 
     /* The page must have at least one free chunk. */
 
-    for ( ;; ) {
-        if (map[n] != 0xff) {
-
-            mask = 0x80;
-
-            do {
-                if ((map[n] & mask) == 0) {
-                    /* A free chunk is found. */
-                    map[n] |= mask;
-                    return offset;
-                }
-
-                offset += size;
-                mask >>= 1;
+    chunk = nxt_leading_zeros(~*map);
 
-            } while (mask != 0);
+    *map |= nxt_mp_chunk_bit(chunk);
 
-        } else {
-            /* Fast-forward: all 8 chunks are occupied. */
-            offset += size * 8;
-        }
-
-        n++;
-    }
+    return chunk * size;
 }
 
 
@@ -522,6 +836,11 @@ nxt_mp_alloc_page(nxt_mp_t *mp)
 
     page = nxt_queue_link_data(link, nxt_mp_page_t, link);
 
+    nxt_mp_page_cluster(page)->used++;
+
+    mp->pages++;
+    mp->pages_peak = nxt_max(mp->pages_peak, mp->pages);
+
     return page;
 }
 
@@ -532,24 +851,40 @@ nxt_mp_alloc_cluster(nxt_mp_t *mp)
     nxt_uint_t      n;
     nxt_mp_block_t  *cluster;
 
+    if (nxt_slow_path(nxt_mp_limit_exceeded(mp, mp->cluster_size))) {
+        return NULL;
+    }
+
     n = mp->cluster_size >> mp->page_size_shift;
 
-    cluster = mp->proto->zalloc(mp->mem,
-                                sizeof(nxt_mp_block_t)
-                                + n * sizeof(nxt_mp_page_t));
+    cluster = (mp->cache != NULL) ? nxt_mp_cache_get(mp->cache) : NULL;
 
-    if (nxt_slow_path(cluster == NULL)) {
-        return NULL;
-    }
+    if (cluster == NULL) {
+        cluster = mp->proto->zalloc(mp->mem,
+                                    sizeof(nxt_mp_block_t)
+                                    + n * sizeof(nxt_mp_page_t));
 
-    /* NXT_MP_CLUSTER_BLOCK type is zero. */
+        if (nxt_slow_path(cluster == NULL)) {
+            return NULL;
+        }
 
-    cluster->size = mp->cluster_size;
+        /* NXT_MP_CLUSTER_BLOCK type is zero. */
 
-    cluster->start = mp->proto->align(mp->mem, mp->page_alignment,
-                                      mp->cluster_size);
-    if (nxt_slow_path(cluster->start == NULL)) {
-        mp->proto->free(mp->mem, cluster);
+        cluster->size = mp->cluster_size;
+
+        cluster->start = mp->proto->align(mp->mem,
+                                          (size_t) 1 << mp->cluster_shift,
+                                          mp->cluster_size);
+        if (nxt_slow_path(cluster->start == NULL)) {
+            mp->proto->free(mp->mem, cluster);
+            return NULL;
+        }
+    }
+
+    if (nxt_slow_path(nxt_mp_hash_insert(mp, &mp->clusters, cluster)
+                      != NXT_OK))
+    {
+        nxt_mp_free_cluster(mp, cluster);
         return NULL;
     }
 
@@ -564,7 +899,30 @@ nxt_mp_alloc_cluster(nxt_mp_t *mp)
                                 &cluster->pages[n].link);
     }
 
-    nxt_rbtree_insert(&mp->blocks, &cluster->node);
+    mp->size += mp->cluster_size;
+    mp->peak = nxt_max(mp->peak, mp->size);
+
+    return cluster;
+}
+
+
+static nxt_mp_block_t *
+nxt_mp_cache_get(nxt_mp_cache_t *cache)
+{
+    nxt_mp_block_t  *cluster;
+
+    cluster = cache->free;
+
+    if (cluster == NULL) {
+        cache->stat.misses++;
+        return NULL;
+    }
+
+    cache->free = *(nxt_mp_block_t **) cluster->start;
+
+    cache->stat.clusters--;
+    cache->stat.size -= cache->cluster_size;
+    cache->stat.hits++;
 
     return cluster;
 }
@@ -585,6 +943,10 @@ nxt_mp_alloc_large(nxt_mp_t *mp, size_t alignment, size_t size)
         return NULL;
     }
 
+    if (nxt_slow_path(nxt_mp_limit_exceeded(mp, size))) {
+        return NULL;
+    }
+
     if (nxt_is_power_of_two(size)) {
         block = mp->proto->alloc(mp->mem, sizeof(nxt_mp_block_t));
         if (nxt_slow_path(block == NULL)) {
@@ -617,61 +979,103 @@ nxt_mp_alloc_large(nxt_mp_t *mp, size_t alignment, size_t size)
     block->size = size;
     block->start = p;
 
-    nxt_rbtree_insert(&mp->blocks, &block->node);
+    if (nxt_slow_path(nxt_mp_hash_insert(mp, &mp->large, block) != NXT_OK)) {
+        nxt_mp_free_block(mp, block);
+        return NULL;
+    }
+
+    mp->size += size;
+    mp->peak = nxt_max(mp->peak, mp->size);
 
     return p;
 }
 
 
-static intptr_t
-nxt_mp_rbtree_compare(nxt_rbtree_node_t *node1, nxt_rbtree_node_t *node2)
+static void
+nxt_mp_free_cluster(nxt_mp_t *mp, nxt_mp_block_t *cluster)
+{
+    nxt_mp_cache_t  *cache;
+
+    cache = mp->cache;
+
+    if (cache == NULL) {
+        mp->proto->free(mp->mem, cluster->start);
+        mp->proto->free(mp->mem, cluster);
+        return;
+    }
+
+    /* The cluster pages are returned to the cache free. */
+
+    nxt_memzero(cluster->pages, (cache->cluster_size / cache->page_size)
+                                * sizeof(nxt_mp_page_t));
+    cluster->used = 0;
+
+    *(nxt_mp_block_t **) cluster->start = cache->free;
+    cache->free = cluster;
+
+    cache->stat.clusters++;
+    cache->stat.size += cache->cluster_size;
+    cache->stat.returns++;
+
+    if (cache->stat.size > cache->high) {
+        nxt_mp_cache_trim(cache, cache->low);
+    }
+}
+
+
+static void
+nxt_mp_free_block(nxt_mp_t *mp, nxt_mp_block_t *block)
 {
-    nxt_mp_block_t  *block1, *block2;
+    void  *p;
+
+    p = block->start;
 
-    block1 = (nxt_mp_block_t *) node1;
-    block2 = (nxt_mp_block_t *) node2;
+    if (block->type == NXT_MP_DISCRETE_BLOCK) {
+        mp->proto->free(mp->mem, block);
+    }
 
-    return (uintptr_t) block1->start - (uintptr_t) block2->start;
+    mp->proto->free(mp->mem, p);
 }
 
 
 void
 nxt_mp_free(nxt_mp_t *mp, void *p)
 {
+    u_char          *start;
     const char      *err;
-    nxt_mp_block_t  *block;
+    nxt_mp_block_t  *block, **slot;
 
     if (mp->proto->trace != NULL) {
         mp->proto->trace(mp->trace, "mem cache free %p", p);
     }
 
-    block = nxt_mp_find_block(&mp->blocks, p);
+    start = (u_char *) ((uintptr_t) p
+                        & ~(((uintptr_t) 1 << mp->cluster_shift) - 1));
 
-    if (nxt_fast_path(block != NULL)) {
+    slot = nxt_mp_hash_find(&mp->clusters, start);
 
-        if (block->type == NXT_MP_CLUSTER_BLOCK) {
-            err = nxt_mp_chunk_free(mp, block, p);
+    if (slot != NULL && (u_char *) p < start + mp->cluster_size) {
+        err = nxt_mp_chunk_free(mp, *slot, p);
 
-            if (nxt_fast_path(err == NULL)) {
-                return;
-            }
+        if (nxt_fast_path(err == NULL)) {
+            return;
+        }
 
-        } else if (nxt_fast_path(p == block->start)) {
-            nxt_rbtree_delete(&mp->blocks, &block->node);
+    } else {
+        slot = nxt_mp_hash_find(&mp->large, p);
 
-            if (block->type == NXT_MP_DISCRETE_BLOCK) {
-                mp->proto->free(mp->mem, block);
-            }
+        if (nxt_fast_path(slot != NULL)) {
+            block = *slot;
 
-            mp->proto->free(mp->mem, p);
+            nxt_mp_hash_delete(&mp->large, slot);
 
-            return;
+            mp->size -= block->size;
 
-        } else {
-            err = "freed pointer points to middle of block: %p";
+            nxt_mp_free_block(mp, block);
+
+            return;
         }
 
-    } else {
         err = "freed pointer is out of mp: %p";
     }
 
@@ -681,31 +1085,130 @@ nxt_mp_free(nxt_mp_t *mp, void *p)
 }
 
 
-static nxt_mp_block_t *
-nxt_mp_find_block(nxt_rbtree_t *tree, u_char *p)
+static nxt_int_t
+nxt_mp_hash_insert(nxt_mp_t *mp, nxt_mp_hash_t *hash, nxt_mp_block_t *block)
 {
-    nxt_mp_block_t     *block;
-    nxt_rbtree_node_t  *node, *sentinel;
+    uint32_t        i, n, size;
+    nxt_mp_block_t  **blocks, **prev;
 
-    node = nxt_rbtree_root(tree);
-    sentinel = nxt_rbtree_sentinel(tree);
+    /* The hash is kept at most half full. */
 
-    while (node != sentinel) {
+    if (nxt_slow_path((hash->items + 1) * 2 > hash->size)) {
+        n = hash->size;
+        size = (n != 0) ? n * 2 : 16;
 
-        block = (nxt_mp_block_t *) node;
+        blocks = mp->proto->zalloc(mp->mem, size * sizeof(nxt_mp_block_t *));
+        if (nxt_slow_path(blocks == NULL)) {
+            return NXT_ERROR;
+        }
 
-        if (p < block->start) {
-            node = node->left;
+        prev = hash->blocks;
 
-        } else if (p >= block->start + block->size) {
-            node = node->right;
+        hash->blocks = blocks;
+        hash->size = size;
+        hash->items = 0;
 
-        } else {
-            return block;
+        for (i = 0; i < n; i++) {
+            if (prev[i] != NULL) {
+                nxt_mp_hash_add(hash, prev[i]);
+            }
+        }
+
+        if (prev != NULL) {
+            mp->proto->free(mp->mem, prev);
         }
     }
 
-    return NULL;
+    nxt_mp_hash_add(hash, block);
+
+    return NXT_OK;
+}
+
+
+nxt_inline uint32_t
+nxt_mp_hash_index(nxt_mp_hash_t *hash, u_char *start)
+{
+    return ((uintptr_t) start >> hash->shift) & (hash->size - 1);
+}
+
+
+static void
+nxt_mp_hash_add(nxt_mp_hash_t *hash, nxt_mp_block_t *block)
+{
+    uint32_t  i;
+
+    i = nxt_mp_hash_index(hash, block->start);
+
+    while (hash->blocks[i] != NULL) {
+        i = (i + 1) & (hash->size - 1);
+    }
+
+    hash->blocks[i] = block;
+    hash->items++;
+}
+
+
+static nxt_mp_block_t **
+nxt_mp_hash_find(nxt_mp_hash_t *hash, u_char *start)
+{
+    uint32_t        i;
+    nxt_mp_block_t  *block;
+
+    if (hash->size == 0) {
+        return NULL;
+    }
+
+    i = nxt_mp_hash_index(hash, start);
+
+    for ( ;; ) {
+        block = hash->blocks[i];
+
+        if (block == NULL) {
+            return NULL;
+        }
+
+        if (block->start == start) {
+            return &hash->blocks[i];
+        }
+
+        i = (i + 1) & (hash->size - 1);
+    }
+}
+
+
+static void
+nxt_mp_hash_delete(nxt_mp_hash_t *hash, nxt_mp_block_t **slot)
+{
+    uint32_t        i, j, k;
+    nxt_mp_block_t  *block;
+
+    i = slot - hash->blocks;
+    j = i;
+
+    /*
+     * The following blocks of the probe sequence are shifted back
+     * to the freed slot unless their own slot lies cyclically
+     * between the freed slot and their current position.
+     */
+
+    for ( ;; ) {
+        j = (j + 1) & (hash->size - 1);
+        block = hash->blocks[j];
+
+        if (block == NULL) {
+            break;
+        }
+
+        k = nxt_mp_hash_index(hash, block->start);
+
+        if ((i < j) ? (k <= i || k > j) : (k <= i && k > j)) {
+            hash->blocks[i] = block;
+            i = j;
+        }
+    }
+
+    hash->blocks[i] = NULL;
+    hash->items--;
 }
 
 
@@ -745,8 +1248,7 @@ nxt_mp_chunk_free(nxt_mp_t *mp, nxt_mp_block_t *cluster,
 
         nxt_mp_chunk_set_free(page->map, chunk);
 
-        /* Find a slot with appropriate chunk size. */
-        for (slot = mp->slots; slot->size < size; slot++) { /* void */ }
+        slot = &mp->slots[nxt_mp_slot_index(mp, size)];
 
         if (page->chunks != slot->chunks) {
             page->chunks++;
@@ -782,19 +1284,12 @@ nxt_mp_chunk_free(nxt_mp_t *mp, nxt_mp_block_t *cluster,
 
     nxt_mp_free_junk(p, size);
 
-    /* Test if all pages in the cluster are free. */
-
-    page = cluster->pages;
-    n = mp->cluster_size >> mp->page_size_shift;
-
-    do {
-         if (page->size != 0) {
-             return NULL;
-         }
+    mp->pages--;
+    cluster->used--;
 
-         page++;
-         n--;
-    } while (n != 0);
+    if (cluster->used != 0) {
+        return NULL;
+    }
 
     /* Free cluster. */
 
@@ -807,12 +1302,83 @@ nxt_mp_chunk_free(nxt_mp_t *mp, nxt_mp_block_t *cluster,
          n--;
     } while (n != 0);
 
-    nxt_rbtree_delete(&mp->blocks, &cluster->node);
+    nxt_mp_hash_delete(&mp->clusters,
+                       nxt_mp_hash_find(&mp->clusters, cluster->start));
 
-    p = cluster->start;
+    mp->size -= cluster->size;
 
-    mp->proto->free(mp->mem, cluster);
-    mp->proto->free(mp->mem, p);
+    nxt_mp_free_cluster(mp, cluster);
 
     return NULL;
 }
+
+
+nxt_mp_cache_t *
+nxt_mp_cache_create(const nxt_mem_proto_t *proto, void *mem,
+    size_t cluster_size, size_t page_size)
+{
+    nxt_mp_cache_t  *cache;
+
+    cache = proto->zalloc(mem, sizeof(nxt_mp_cache_t));
+
+    if (nxt_fast_path(cache != NULL)) {
+        cache->proto = proto;
+        cache->mem = mem;
+        cache->cluster_size = cluster_size;
+        cache->page_size = page_size;
+    }
+
+    return cache;
+}
+
+
+/*
+ * nxt_mp_cache_watermarks() sets the cache size watermarks in bytes,
+ * the zero high watermark disables caching.
+ */
+
+void
+nxt_mp_cache_watermarks(nxt_mp_cache_t *cache, size_t low, size_t high)
+{
+    cache->low = nxt_min(low, high);
+    cache->high = high;
+
+    if (cache->stat.size > cache->high) {
+        nxt_mp_cache_trim(cache, cache->low);
+    }
+}
+
+
+void
+nxt_mp_cache_stat(nxt_mp_cache_t *cache, nxt_mp_cache_stat_t *stat)
+{
+    *stat = cache->stat;
+}
+
+
+void
+nxt_mp_cache_destroy(nxt_mp_cache_t *cache)
+{
+    nxt_mp_cache_trim(cache, 0);
+
+    cache->proto->free(cache->mem, cache);
+}
+
+
+static void
+nxt_mp_cache_trim(nxt_mp_cache_t *cache, size_t size)
+{
+    nxt_mp_block_t  *cluster;
+
+    while (cache->stat.size > size) {
+        cluster = cache->free;
+        cache->free = *(nxt_mp_block_t **) cluster->start;
+
+        cache->proto->free(cache->mem, cluster->start);
+        cache->proto->free(cache->mem, cluster);
+
+        cache->stat.clusters--;
+        cache->stat.size -= cache->cluster_size;
+        cache->stat.frees++;
+    }
+}
@@ -8,7 +8,50 @@
 #define _NXT_MP_H_INCLUDED_
 
 
-typedef struct nxt_mp_s  nxt_mp_t;
+typedef struct nxt_mp_s        nxt_mp_t;
+typedef struct nxt_mp_cache_s  nxt_mp_cache_t;
+
+
+/* There can be no more than 32 chunks in a page, so 5 chunk sizes. */
+#define NXT_MP_CHUNK_SIZES  5
+
+
+typedef struct {
+    /* The size of clusters and large allocations and its maximum. */
+    size_t                      size;
+    size_t                      peak;
+
+    /*
+     * The size of allocated pages, chunks and large allocations,
+     * the rest of the pool size is free memory of the clusters.
+     */
+    size_t                      used;
+
+    size_t                      clusters;
+    size_t                      pages;
+    size_t                      free_pages;
+    size_t                      large;
+    size_t                      large_size;
+
+    /* The number of allocated chunks of each size. */
+    uint32_t                    chunk_size[NXT_MP_CHUNK_SIZES];
+    size_t                      chunks[NXT_MP_CHUNK_SIZES];
+} nxt_mp_stat_t;
+
+
+typedef struct {
+    /* The number and size of free clusters in the cache. */
+    size_t                      clusters;
+    size_t                      size;
+
+    /* Clusters taken from the cache and allocated when it was empty. */
+    size_t                      hits;
+    size_t                      misses;
+
+    /* Clusters returned to the cache and freed by the watermarks. */
+    size_t                      returns;
+    size_t                      frees;
+} nxt_mp_cache_stat_t;
 
 
 NXT_EXPORT nxt_mp_t *nxt_mp_create(const nxt_mem_proto_t *proto, void *mem,
@@ -20,7 +63,14 @@ NXT_EXPORT nxt_mp_t * nxt_mp_fast_create(const nxt_mem_proto_t *proto,
     size_t page_size, size_t min_chunk_size)
     NXT_MALLOC_LIKE;
 NXT_EXPORT nxt_bool_t nxt_mp_is_empty(nxt_mp_t *mp);
+NXT_EXPORT size_t nxt_mp_size(nxt_mp_t *mp);
+NXT_EXPORT void nxt_mp_limit(nxt_mp_t *mp, size_t limit);
+NXT_EXPORT void nxt_mp_stat(nxt_mp_t *mp, nxt_mp_stat_t *stat);
+NXT_EXPORT nxt_int_t nxt_mp_use_cache(nxt_mp_t *mp, nxt_mp_cache_t *cache);
 NXT_EXPORT void nxt_mp_destroy(nxt_mp_t *mp);
+NXT_EXPORT void nxt_mp_reset(nxt_mp_t *mp, void *keep);
+NXT_EXPORT size_t nxt_mp_pages_peak(nxt_mp_t *mp);
+NXT_EXPORT nxt_int_t nxt_mp_reserve(nxt_mp_t *mp, size_t size);
 
 NXT_EXPORT void *nxt_mp_alloc(nxt_mp_t *mp, size_t size)
     NXT_MALLOC_LIKE;
@@ -33,5 +83,13 @@ NXT_EXPORT void *nxt_mp_zalign(nxt_mp_t *mp,
     NXT_MALLOC_LIKE;
 NXT_EXPORT void nxt_mp_free(nxt_mp_t *mp, void *p);
 
+NXT_EXPORT nxt_mp_cache_t *nxt_mp_cache_create(const nxt_mem_proto_t *proto,
+    void *mem, size_t cluster_size, size_t page_size);
+NXT_EXPORT void nxt_mp_cache_watermarks(nxt_mp_cache_t *cache, size_t low,
+    size_t high);
+NXT_EXPORT void nxt_mp_cache_stat(nxt_mp_cache_t *cache,
+    nxt_mp_cache_stat_t *stat);
+NXT_EXPORT void nxt_mp_cache_destroy(nxt_mp_cache_t *cache);
+
 
 #endif /* _NXT_MP_H_INCLUDED_ */
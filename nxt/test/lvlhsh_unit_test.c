@@ -262,6 +262,23 @@ lvlhsh_unit_test(nxt_uint_t n)
         return NXT_ERROR;
     }
 
+    key = 0;
+    for (i = 0; i < n; i++) {
+        key = nxt_murmur_hash2(&key, sizeof(uint32_t));
+
+        if (lvlhsh_unit_test_add(&lh, &lvlhsh_proto, pool, key) != NXT_OK) {
+            nxt_printf("lvlhsh add unit test failed at %l\n", (long) i);
+            return NXT_ERROR;
+        }
+    }
+
+    nxt_lvlhsh_destroy(&lh, &lvlhsh_proto, pool);
+
+    if (!nxt_lvlhsh_is_empty(&lh) || !nxt_mp_is_empty(pool)) {
+        nxt_printf("lvlhsh destroy unit test failed\n");
+        return NXT_ERROR;
+    }
+
     nxt_mp_destroy(pool);
 
     nxt_printf("lvlhsh unit test passed\n");
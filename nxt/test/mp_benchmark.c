@@ -0,0 +1,239 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_auto_config.h>
+#include <nxt_types.h>
+#include <nxt_clang.h>
+#include <nxt_sprintf.h>
+#include <nxt_string.h>
+#include <nxt_stub.h>
+#include <nxt_malloc.h>
+#include <nxt_time.h>
+#include <nxt_mp.h>
+#include <string.h>
+
+
+/*
+ * The benchmark replaces random items of a working set by allocations
+ * of random sizes and then frees the working set in random order.
+ * The same sequence is run with malloc() for reference.  The pool
+ * fragmentation is the share of the pool memory used by the working set
+ * after the replacements.
+ */
+
+typedef struct {
+    const char                  *name;
+    size_t                      min_size;
+    size_t                      max_size;
+    nxt_uint_t                  items;
+    nxt_uint_t                  ops;
+} mp_benchmark_t;
+
+
+static const mp_benchmark_t  mp_benchmarks[] = {
+    { "small chunks", 8, 128, 10000, 5000000 },
+    { "chunks and pages", 8, 512, 10000, 5000000 },
+    { "with large allocations", 8, 2048, 10000, 2000000 },
+    { "large working set", 8, 512, 200000, 5000000 },
+};
+
+
+static void *
+mp_benchmark_alloc(void *mem, size_t size)
+{
+    return nxt_malloc(size);
+}
+
+
+static void *
+mp_benchmark_zalloc(void *mem, size_t size)
+{
+    void  *p;
+
+    p = nxt_malloc(size);
+
+    if (p != NULL) {
+        nxt_memzero(p, size);
+    }
+
+    return p;
+}
+
+
+static void *
+mp_benchmark_align(void *mem, size_t alignment, size_t size)
+{
+    return nxt_memalign(alignment, size);
+}
+
+
+static void
+mp_benchmark_free(void *mem, void *p)
+{
+    nxt_free(p);
+}
+
+
+static void
+mp_benchmark_alert(void *mem, const char *fmt, ...)
+{
+    u_char   buf[1024], *p;
+    va_list  args;
+
+    va_start(args, fmt);
+    p = nxt_vsprintf(buf, buf + sizeof(buf), fmt, args);
+    va_end(args);
+
+    (void) nxt_error("alert: \"%*s\"\n", p - buf, buf);
+}
+
+
+static const nxt_mem_proto_t  mp_benchmark_proto = {
+    mp_benchmark_alloc,
+    mp_benchmark_zalloc,
+    mp_benchmark_align,
+    NULL,
+    mp_benchmark_free,
+    mp_benchmark_alert,
+    NULL,
+};
+
+
+nxt_inline uint32_t
+mp_benchmark_random(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+
+    return *seed >> 8;
+}
+
+
+static uint64_t
+mp_benchmark_run(const mp_benchmark_t *bm, nxt_mp_t *mp, void **items,
+    nxt_mp_stat_t *stat)
+{
+    void        *p;
+    size_t      size, range;
+    uint32_t    seed;
+    uint64_t    start;
+    nxt_uint_t  i, n;
+
+    seed = 1;
+    range = bm->max_size - bm->min_size + 1;
+
+    start = nxt_time();
+
+    for (i = 0; i < bm->ops; i++) {
+        n = mp_benchmark_random(&seed) % bm->items;
+        size = bm->min_size + mp_benchmark_random(&seed) % range;
+
+        if (items[n] != NULL) {
+            if (mp != NULL) {
+                nxt_mp_free(mp, items[n]);
+
+            } else {
+                nxt_free(items[n]);
+            }
+        }
+
+        p = (mp != NULL) ? nxt_mp_alloc(mp, size) : nxt_malloc(size);
+
+        if (nxt_slow_path(p == NULL)) {
+            return 0;
+        }
+
+        *(u_char *) p = (u_char) i;
+        items[n] = p;
+    }
+
+    if (mp != NULL) {
+        nxt_mp_stat(mp, stat);
+    }
+
+    /* Free the working set in random order. */
+
+    for (i = bm->items; i != 0; i--) {
+        n = mp_benchmark_random(&seed) % i;
+
+        p = items[n];
+        items[n] = items[i - 1];
+        items[i - 1] = NULL;
+
+        if (p == NULL) {
+            continue;
+        }
+
+        if (mp != NULL) {
+            nxt_mp_free(mp, p);
+
+        } else {
+            nxt_free(p);
+        }
+    }
+
+    return nxt_time() - start;
+}
+
+
+static nxt_int_t
+mp_benchmark(const mp_benchmark_t *bm)
+{
+    void           **items;
+    uint64_t       mp_ns, malloc_ns;
+    nxt_mp_t       *mp;
+    nxt_mp_stat_t  stat;
+
+    items = nxt_malloc(bm->items * sizeof(void *));
+    if (items == NULL) {
+        return NXT_ERROR;
+    }
+
+    nxt_memzero(items, bm->items * sizeof(void *));
+
+    mp = nxt_mp_create(&mp_benchmark_proto, NULL, NULL, 2 * nxt_pagesize(),
+                       128, 512, 16);
+    if (mp == NULL) {
+        return NXT_ERROR;
+    }
+
+    mp_ns = mp_benchmark_run(bm, mp, items, &stat);
+    malloc_ns = mp_benchmark_run(bm, NULL, items, NULL);
+
+    if (mp_ns == 0 || malloc_ns == 0) {
+        nxt_printf("%s: allocation failed\n", bm->name);
+        return NXT_ERROR;
+    }
+
+    if (!nxt_mp_is_empty(mp)) {
+        nxt_printf("%s: mem cache pool is not empty\n", bm->name);
+        return NXT_ERROR;
+    }
+
+    nxt_printf("%s: mp %.1fns/op, malloc %.1fns/op, "
+               "used %.1f%% of %uzK, peak %uzK\n", bm->name,
+               (double) mp_ns / bm->ops, (double) malloc_ns / bm->ops,
+               (double) stat.used * 100 / stat.size, stat.size / 1024,
+               stat.peak / 1024);
+
+    nxt_mp_destroy(mp);
+    nxt_free(items);
+
+    return NXT_OK;
+}
+
+
+int
+main(void)
+{
+    nxt_uint_t  i;
+
+    for (i = 0; i < nxt_nitems(mp_benchmarks); i++) {
+        if (mp_benchmark(&mp_benchmarks[i]) != NXT_OK) {
+            return 1;
+        }
+    }
+
+    return 0;
+}